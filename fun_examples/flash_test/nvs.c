@@ -5,7 +5,21 @@
 //------------------------------------------------------------------------------
 //       Purpose : Implements the nvs API
 //------------------------------------------------------------------------------
-//       Notes : None
+//       Notes : Page layout, all fields 16 bit:
+//                 [magic][sequence][record][record]...[erased]
+//               Record layout:
+//                 [key | len << 8][value, padded to even][crc16]
+//               A record is live when its CRC matches and no later record
+//               has the same key; len 0 deletes the key. Records are written
+//               header first and CRC last, so a power cut leaves at most one
+//               torn record that the scan skips over.
+//
+//               The page after the active one is always erased. When the
+//               active page fills, that spare is opened with the next
+//               sequence number, the live records of the page after it
+//               (the oldest) are copied in and the oldest is erased to
+//               become the new spare. A cut during the copy is finished by
+//               the next NVS_Init().
 //------------------------------------------------------------------------------
 
 //------------------------------------------------------------------------------
@@ -13,13 +27,21 @@
 //------------------------------------------------------------------------------
 #include "nvs.h"
 #include "ch32v003_flash.h"
+#include "../../fun_modules/fun_crc.h"
+#include <string.h>
 // #include "log.h"
 
 //------------------------------------------------------------------------------
 // Module constant defines
 //------------------------------------------------------------------------------
 #define TAG           "nvs"
-#define NVS_PAGE_SIZE (64)
+#define NVS_ERASED    (0xE339)  // an erased CH32V003 halfword reads back as this
+#define NVS_MAGIC     (0x4E56)
+#define NVS_HDR_SIZE  (4)
+
+#if NVS_PAGES < 2
+#error "NVS_PAGES must be at least 2"
+#endif
 
 //------------------------------------------------------------------------------
 // External variables
@@ -37,10 +59,16 @@
 // Module static variables
 //------------------------------------------------------------------------------
 static uint32_t nvs_page_start = 0;
+static uint16_t nvs_index[NVS_MAX_KEYS];  // ring offset of each key's record, 0 = none
+static uint8_t  nvs_active;               // page records are appended to
+static uint16_t nvs_seq;                  // its sequence number
+static uint16_t nvs_write;                // ring offset of the next record
 
 //------------------------------------------------------------------------------
 // Module static function prototypes
 //------------------------------------------------------------------------------
+static void      nvs_mount(void);
+static nvs_err_t nvs_append(uint8_t key, const uint8_t *data, uint8_t len);
 
 //------------------------------------------------------------------------------
 // Module externally exported functions
@@ -50,46 +78,225 @@ void NVS_Init(void) {
     flash_set_latency();
     nvs_page_start = flash_calculate_runtime_address(0);
     // LOGD(TAG, "NVS page start: 0x%08X", nvs_page_start);
+    nvs_mount();
+}
+
+nvs_err_t NVS_Save(u8 *data, size_t size) {
+    return NVS_Put(NVS_BLOB_KEY, data, size);
+}
+
+nvs_err_t NVS_Load(u8 *data, size_t offset, size_t size) {
+    return NVS_Get(NVS_BLOB_KEY, data, offset, size, NULL);
 }
 
-void NVS_Save(u8 *data, size_t size) {
-    if (size > NVS_PAGE_SIZE) {
+nvs_err_t NVS_Put(uint8_t key, const void *data, size_t size) {
+    if (key >= NVS_MAX_KEYS) return NVS_ERR_KEY;
+    if (size > NVS_MAX_VALUE) {
         // LOGE(TAG, "Cannot save data, size %d is too big", size);
-        return;
+        return NVS_ERR_SIZE;
     }
-    flash_unlock();
-    // LOGD(TAG, "Memory unlocked");
-
-    // LOGD(TAG, "Erasing 64b page");
-    flash_erase_page(nvs_page_start);
-    // LOGD(TAG, "Memory erased");
 
-    // LOGW(TAG, "Writing %d bytes", size);
-    for (size_t i = 0; i < size; i += 2) {
-        const u16 value = data[i] | (data[i + 1] << 8);
-        flash_program_16(nvs_page_start + i, value);
+    // an unchanged value costs no flash
+    const uint16_t off = nvs_index[key];
+    if (off && (flash_read_16_bits(nvs_page_start + off) >> 8) == size &&
+        memcmp((const void *)(uintptr_t)(nvs_page_start + off + 2), data, size) == 0) {
+        return NVS_OK;
     }
-    // LOGD(TAG, "Memory written");
 
-    flash_lock();
-    // LOGD(TAG, "Memory locked");
+    return nvs_append(key, data, size);
 }
 
-void NVS_Load(u8 *data, size_t offset, size_t size) {
-    if (offset + size > NVS_PAGE_SIZE) {
-        // LOGE(TAG, "Cannot load data, offset %d and size %d are too big", offset, size);
-        return;
-    }
+nvs_err_t NVS_Get(uint8_t key, void *data, size_t offset, size_t size, size_t *len) {
+    if (key >= NVS_MAX_KEYS) return NVS_ERR_KEY;
+
+    const uint16_t off = nvs_index[key];
+    if (!off) return NVS_ERR_NOT_FOUND;
+
+    const size_t value_len = flash_read_16_bits(nvs_page_start + off) >> 8;
+    if (len) *len = value_len;
+
+    if (offset >= value_len) return NVS_OK;
+    if (offset + size > value_len) size = value_len - offset;
 
     for (size_t i = 0; i < size; i++) {
-        data[i] = flash_read_8_bits(nvs_page_start + offset + i);
+        ((u8 *)data)[i] = flash_read_8_bits(nvs_page_start + off + 2 + offset + i);
     }
+    return NVS_OK;
+}
+
+nvs_err_t NVS_Delete(uint8_t key) {
+    if (key >= NVS_MAX_KEYS) return NVS_ERR_KEY;
+    if (!nvs_index[key]) return NVS_ERR_NOT_FOUND;
+    return nvs_append(key, NULL, 0);
 }
 
 //------------------------------------------------------------------------------
 // Module static functions
 //------------------------------------------------------------------------------
 
+static inline uint16_t nvs_read(uint16_t off) {
+    return flash_read_16_bits(nvs_page_start + off);
+}
+
+static inline uint16_t nvs_page_off(uint8_t page) {
+    return page * NVS_PAGE_SIZE;
+}
+
+static inline uint8_t nvs_next(uint8_t page) {
+    return (page + 1) % NVS_PAGES;
+}
+
+static inline uint16_t nvs_record_size(uint8_t len) {
+    return 2 + ((len + 1) & ~1) + 2;
+}
+
+static uint8_t nvs_page_valid(uint8_t page) {
+    return nvs_read(nvs_page_off(page)) == NVS_MAGIC &&
+           nvs_read(nvs_page_off(page) + 2) != NVS_ERASED;
+}
+
+static uint8_t nvs_page_erased(uint8_t page) {
+    for (uint16_t i = 0; i < NVS_PAGE_SIZE; i += 2) {
+        if (nvs_read(nvs_page_off(page) + i) != NVS_ERASED) return 0;
+    }
+    return 1;
+}
+
+static uint16_t nvs_record_crc(uint16_t hdr, const uint8_t *data, uint8_t len) {
+    const uint8_t hdr_bytes[2] = { hdr & 0xFF, hdr >> 8 };
+    uint16_t crc = crc16_update(crc16_init(), hdr_bytes, 2);
+    return crc16_final(crc16_update(crc, data, len));
+}
+
+// Index every intact record of [page], returns the offset of its free space
+static uint16_t nvs_scan_page(uint8_t page) {
+    const uint16_t end = nvs_page_off(page) + NVS_PAGE_SIZE;
+    uint16_t off = nvs_page_off(page) + NVS_HDR_SIZE;
+
+    while (off < end) {
+        const uint16_t hdr = nvs_read(off);
+        if (hdr == NVS_ERASED) break;
+
+        const uint8_t key = hdr & 0xFF, len = hdr >> 8;
+        const uint16_t size = nvs_record_size(len);
+        // not something we wrote, nothing after it can be trusted
+        if (len > NVS_MAX_VALUE || off + size > end) return end;
+
+        const uint8_t *value = (const uint8_t *)(uintptr_t)(nvs_page_start + off + 2);
+        if (key < NVS_MAX_KEYS && nvs_read(off + size - 2) == nvs_record_crc(hdr, value, len)) {
+            nvs_index[key] = len ? off : 0;
+        }
+        off += size;
+    }
+    return off;
+}
+
+static void nvs_program_record(uint16_t hdr, const uint8_t *data, uint8_t len) {
+    uint16_t off = nvs_write;
+
+    flash_program_16(nvs_page_start + off, hdr);
+    for (uint8_t i = 0; i < len; i += 2) {
+        const u16 value = data[i] | ((i + 1 < len ? data[i + 1] : 0) << 8);
+        flash_program_16(nvs_page_start + off + 2 + i, value);
+    }
+    flash_program_16(nvs_page_start + off + nvs_record_size(len) - 2,
+                     nvs_record_crc(hdr, data, len));
+
+    nvs_write += nvs_record_size(len);
+}
+
+// Move the live records of [page] to the active page, then erase it
+static void nvs_collect(uint8_t page) {
+    for (uint8_t key = 0; key < NVS_MAX_KEYS; key++) {
+        const uint16_t off = nvs_index[key];
+        if (!off || off / NVS_PAGE_SIZE != page) continue;
+
+        const uint16_t hdr = nvs_read(off);
+        nvs_index[key] = nvs_write;
+        nvs_program_record(hdr, (const uint8_t *)(uintptr_t)(nvs_page_start + off + 2), hdr >> 8);
+    }
+    flash_erase_page(nvs_page_start + nvs_page_off(page));
+}
+
+// Open the spare page after the active one and reclaim the oldest page
+static void nvs_advance(void) {
+    const uint8_t page = nvs_next(nvs_active);
+    if (++nvs_seq == NVS_ERASED) nvs_seq++;
+
+    flash_program_16(nvs_page_start + nvs_page_off(page) + 2, nvs_seq);
+    flash_program_16(nvs_page_start + nvs_page_off(page), NVS_MAGIC);
+    nvs_active = page;
+    nvs_write = nvs_page_off(page) + NVS_HDR_SIZE;
+
+    const uint8_t oldest = nvs_next(page);
+    if (nvs_page_valid(oldest)) nvs_collect(oldest);
+}
+
+static nvs_err_t nvs_append(uint8_t key, const uint8_t *data, uint8_t len) {
+    const uint16_t size = nvs_record_size(len);
+    nvs_err_t err = NVS_OK;
+
+    flash_unlock();
+
+    // every page tried and still no room: the live values fill the ring
+    for (uint8_t tries = 0; nvs_write + size > nvs_page_off(nvs_active) + NVS_PAGE_SIZE; tries++) {
+        if (tries == NVS_PAGES) {
+            err = NVS_ERR_FULL;
+            break;
+        }
+        nvs_advance();
+    }
+
+    if (err == NVS_OK) {
+        const uint16_t off = nvs_write;
+        nvs_program_record(key | len << 8, data, len);
+        nvs_index[key] = len ? off : 0;
+    }
+
+    flash_lock();
+    return err;
+}
+
+static void nvs_mount(void) {
+    int8_t active = -1;
+    memset(nvs_index, 0, sizeof(nvs_index));
+
+    flash_unlock();
+
+    // newest page by sequence number, anything else that is not erased is
+    // left over from a torn page open or from other firmware
+    for (uint8_t page = 0; page < NVS_PAGES; page++) {
+        if (nvs_page_valid(page)) {
+            const uint16_t seq = nvs_read(nvs_page_off(page) + 2);
+            if (active < 0 || (int16_t)(seq - nvs_seq) > 0) {
+                active = page;
+                nvs_seq = seq;
+            }
+        } else if (!nvs_page_erased(page)) {
+            flash_erase_page(nvs_page_start + nvs_page_off(page));
+        }
+    }
+
+    if (active < 0) {
+        // blank ring: the page before 0 plays the full active page
+        nvs_active = NVS_PAGES - 1;
+        nvs_seq = 0;
+        nvs_advance();
+    } else {
+        // oldest to newest, later records of a key replace earlier ones
+        nvs_active = active;
+        for (uint8_t i = 1; i <= NVS_PAGES; i++) {
+            const uint8_t page = (active + i) % NVS_PAGES;
+            if (nvs_page_valid(page)) nvs_write = nvs_scan_page(page);
+        }
+
+        // cut between opening the active page and erasing the oldest one
+        if (nvs_page_valid(nvs_next(nvs_active))) nvs_collect(nvs_next(nvs_active));
+    }
+
+    flash_lock();
+}
+
 //------------------------------------------------------------------------------
 //------------------------------------------------------------------------------
 //------------------------------------------------------------------------------
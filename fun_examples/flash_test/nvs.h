@@ -5,7 +5,9 @@
 //------------------------------------------------------------------------------
 //       Purpose : Defines the nvs API
 //------------------------------------------------------------------------------
-//       Notes : None
+//       Notes : Log structured key/value store over a ring of NVS_PAGES
+//               flash pages. Records are appended, a page is only erased
+//               when the ring wraps onto it. See nvs.c for the layout.
 //------------------------------------------------------------------------------
 #pragma once
 
@@ -23,17 +25,49 @@ extern "C" {
 //------------------------------------------------------------------------------
 // Module exported defines
 //------------------------------------------------------------------------------
+// Pages in the ring, at least 2. nonvolatile.ld must reserve
+// NVS_PAGES * NVS_PAGE_SIZE bytes at the end of flash.
+#ifndef NVS_PAGES
+#define NVS_PAGES     (4)
+#endif
+
+// Keys are 0 .. NVS_MAX_KEYS - 1, the RAM index holds one u16 per key
+#ifndef NVS_MAX_KEYS
+#define NVS_MAX_KEYS  (16)
+#endif
+
+#define NVS_PAGE_SIZE (64)
+
+// Largest value: a page less its header, the record header and the CRC
+#define NVS_MAX_VALUE (NVS_PAGE_SIZE - 4 - 4)
+
+// NVS_Save/NVS_Load keep the whole blob under this key, so a blob is now
+// capped at NVS_MAX_VALUE (56) bytes, not the whole 64 byte page it used
+// to take. Larger saves return NVS_ERR_SIZE and leave flash untouched.
+#define NVS_BLOB_KEY  (0)
 
 //------------------------------------------------------------------------------
 // Module exported type definitions
 //------------------------------------------------------------------------------
+typedef enum {
+    NVS_OK = 0,
+    NVS_ERR_KEY,        // key out of range
+    NVS_ERR_SIZE,       // value longer than NVS_MAX_VALUE
+    NVS_ERR_FULL,       // live values do not fit in the ring
+    NVS_ERR_NOT_FOUND,
+} nvs_err_t;
 
 //------------------------------------------------------------------------------
 // Module exported functions
 //------------------------------------------------------------------------------
 void NVS_Init(void);
-void NVS_Save(uint8_t *data, size_t size);
-void NVS_Load(uint8_t *data, size_t offset, size_t size);
+nvs_err_t NVS_Save(uint8_t *data, size_t size);
+nvs_err_t NVS_Load(uint8_t *data, size_t offset, size_t size);
+
+nvs_err_t NVS_Put(uint8_t key, const void *data, size_t size);
+// copies up to [size] bytes from [offset] of the value, [*len] gets its length
+nvs_err_t NVS_Get(uint8_t key, void *data, size_t offset, size_t size, size_t *len);
+nvs_err_t NVS_Delete(uint8_t key);
 
 //------------------------------------------------------------------------------
 // Module exported variables
@@ -3,7 +3,7 @@
 #include "../../fun_modules/fun_encoder_gpio.h"
 #include "../../fun_modules/fun_button.h"
 #include "../../fun_modules/fun_irSender.h"
-#include "../../fun_modules/fun_irReceiver.h"
+#include "../../fun_modules/fun_irReceiver.h"	// polling, IR_RECEIVER_USE_DMA needs the TIM1 the sender owns
 
 #include "i2c_manager.h"
 
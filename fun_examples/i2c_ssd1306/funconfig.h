@@ -6,4 +6,7 @@
 #define FUNCONF_USE_DEBUGPRINTF 1
 #define FUNCONF_SYSTICK_USE_HCLK 1
 
+// flush the display on the I2C DMA, see i2c_manager.h
+// #define I2C_ASYNC
+
 #endif
\ No newline at end of file
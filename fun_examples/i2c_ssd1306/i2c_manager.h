@@ -12,8 +12,19 @@ i2c_device_t dev_ssd1306 = {
 };
 
 //# SSD1306 INTERFACES
+// with I2C_ASYNC (funconfig.h) a flush goes out on the DMA while the main
+// loop runs, and the blocking transfers wait for it first
+#ifdef I2C_ASYNC
+	#define MENU_FLUSH()		ssd1306_flush_dirty_async(&dev_ssd1306)
+	#define MENU_FLUSH_WAIT()	ssd1306_flush_wait()
+#else
+	#define MENU_FLUSH()		ssd1306_flush_dirty()
+	#define MENU_FLUSH_WAIT()
+#endif
+
 /* send OLED command byte */
 u8 SSD1306_CMD(u8 cmd) {
+	MENU_FLUSH_WAIT();
 	u8 pkt[2];
 	pkt[0] = 0;
 	pkt[1] = cmd;
@@ -21,7 +32,8 @@ u8 SSD1306_CMD(u8 cmd) {
 }
 
 /* send OLED data packet (up to 32 bytes) */
-u8 SSD1306_DATA(u8 *data, int sz) {
+u8 SSD1306_DATA(const u8 *data, int sz) {
+	MENU_FLUSH_WAIT();
 	u8 pkt[33];
 	pkt[0] = 0x40;
 	memcpy(&pkt[1], data, sz);
@@ -70,6 +82,7 @@ void i2c_scan_callback(const u8 addr) {
 }
 
 void i2c_start_scan() {
+	MENU_FLUSH_WAIT();
 	// Scan the I2C Bus, prints any devices that respond
 	printf("\n* Scanning I2Cs *\n");
 	i2c_scan(i2c_scan_callback);
@@ -132,6 +145,10 @@ void i2c_menu_init() {
 		printf("Err: I2C init failed\n");
 	} 
 	else {
+		#ifdef I2C_ASYNC
+			i2c_async_init();
+		#endif
+
 		if (i2c_ping_display()) {
 			ssd1306_init();
 			ssd1306_render_fill(0x00);
@@ -181,7 +198,10 @@ u8 i2c_menu_period_tick() {
 	if (is_main_menu) return 0;
 	static char str_output[SSD1306_MAX_STR_LEN] = { 0 };
 
-	// clear screen
+	// the last flush may still be reading the buffer
+	MENU_FLUSH_WAIT();
+
+	// clear screen, only what changes since the last tick is flushed
 	ssd1306_render_fill(0x00);
 
 	switch (menu_selectedIdx) {
@@ -207,19 +227,19 @@ u8 i2c_menu_period_tick() {
 			sprintf(str_output, "%d uA, %d uW", current_uA, power_uW);
 			i2c_menu_render_text_at(4, str_output);
 
-			ssd1306_draw_all();
+			MENU_FLUSH();
 			return 1;			
 		}
 		case 1: {
 			I2C_DEVICES_COUNT = 0;
-			ssd1306_draw_all();
+			MENU_FLUSH();
 			i2c_start_scan();
 			return 1;
 		}
 		case 2: {
 			sprintf(str_output, "IR Sending %d", irCount++);
 			i2c_menu_render_text_at(0, str_output);
-			ssd1306_draw_all();
+			MENU_FLUSH();
 			return 1;
 		}
 		case 3: {
@@ -231,7 +251,7 @@ u8 i2c_menu_period_tick() {
 			i2c_menu_render_text_at(1, IR_Receive_Str);
 			memset(IR_Receive_Str, 0, sizeof(IR_Receive_Str));
 
-			ssd1306_draw_all();
+			MENU_FLUSH();
 			return 1;
 		}
 	}
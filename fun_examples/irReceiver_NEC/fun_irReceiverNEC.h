@@ -20,13 +20,16 @@ typedef struct {
 	u8 ir_started;
 	u16 BUFFER[IR_NEC_BUFFER_LEN];	// store the received data
 
-	int16_t counterIdx;			// store pulses count (for gpio) Or tails (for DMA)
+	int16_t counterIdx;			// store pulses count (for gpio)
 	u32 bits_processed;			// number of bits processed
 	u32 time_ref;
 
     // for GPIO ONLY
     u32 pulse_buf[64];
     u8 prev_state, current_state;
+
+    // for DMA ONLY
+    u16 prev_tick;              // capture of the previous edge
 } IR_ReceiverNEC_t;
 
 #ifdef IR_RECEIVER_NEC_USE_DMA
@@ -39,8 +42,8 @@ typedef struct {
 
     //! For generating the mask/modulus, this must be a power of 2 size.
     #define IR_MAX_PULSES 128
-    #define TIM1_BUFFER_LAST_IDX (IR_MAX_PULSES - 1)
     uint16_t ir_ticks_buff[IR_MAX_PULSES];
+    UTIL_Ring_t ir_ticks_ring;
 
     //* INIT FUNCTION
     void fun_irReceiver_NEC_init(IR_ReceiverNEC_t* model) {
@@ -48,6 +51,8 @@ typedef struct {
         funPinMode(model->pin, GPIO_CFGLR_IN_PUPD);
         funDigitalWrite(model->pin, 1);
         model->ir_started = 0;
+        model->prev_tick = 0;
+        UTIL_ring_init(&ir_ticks_ring, ir_ticks_buff, IR_MAX_PULSES, sizeof(uint16_t));
 
         // Enable GPIOs
         RCC->APB2PCENR |= RCC_APB2Periph_TIM1 | RCC_APB2Periph_AFIO;
@@ -101,25 +106,15 @@ typedef struct {
 
     //* TASK FUNCTION
     void fun_irReceiver_NEC_task(IR_ReceiverNEC_t* model, void(*handler)(u16*, u8)) {
-        // Must perform modulus here, in case DMA_IN->CNTR == 0.
-        int head = (IR_MAX_PULSES - IR_DMA_IN->CNTR) & TIM1_BUFFER_LAST_IDX;
-
-        if( head != model->counterIdx ) {
-            u32 time_of_event = ir_ticks_buff[model->counterIdx];
-            u8 prev_event_idx = (model->counterIdx-1) & TIM1_BUFFER_LAST_IDX;		// modulus to loop back
-            u32 prev_time_of_event = ir_ticks_buff[prev_event_idx];
-            u32 elapsed = time_of_event - prev_time_of_event;
-
-            //! Performs modulus to loop back.
-            model->counterIdx = (model->counterIdx+1) & TIM1_BUFFER_LAST_IDX;
-
-            //! Timer overflow handling
-            if (time_of_event >= prev_time_of_event) {
-                elapsed = time_of_event - prev_time_of_event;
-            } else {
-                // Timer wrapped around (0xFFFF -> 0x0000)
-                elapsed = (65536 - prev_time_of_event) + time_of_event;
-            }
+        UTIL_ring_dmaHead(&ir_ticks_ring, IR_DMA_IN);
+
+        if (UTIL_ring_count(&ir_ticks_ring)) {
+            u16 time_of_event = *(u16*)UTIL_ring_at(&ir_ticks_ring, 0);
+            UTIL_ring_consume(&ir_ticks_ring, 1);
+
+            //! u16 difference handles the timer wrap (0xFFFF -> 0x0000)
+            u16 elapsed = time_of_event - model->prev_tick;
+            model->prev_tick = time_of_event;
 
             if (model->ir_started) {
                 //# STEP 2: filter LOW start frame (> 1000 ticks)
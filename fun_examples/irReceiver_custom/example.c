@@ -1,3 +1,5 @@
+// timestamp the edges with TIM1 capture + DMA instead of polling the pin (PA1 only)
+// #define IR_RECEIVER_USE_DMA
 #include "../../fun_modules/fun_irReceiver.h"
 
 #define IR_RECEIVER_PIN PA1
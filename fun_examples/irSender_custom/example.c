@@ -1,3 +1,5 @@
+// mark/space timing by TIM2 + DMA, asyncTask becomes a no-op (uses TIM2, DMA1_CH1/CH7)
+// #define IR_SENDER_USE_DMA
 #include "../../fun_modules/fun_irSender.h"
 
 #define IR_SENDER_PIN PD0
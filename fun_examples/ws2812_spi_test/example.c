@@ -10,6 +10,18 @@
 #define SPI_DC_PIN		PD2
 #define SPI_RST_PIN		PC3
 
+void onNeo_step(u32 time, void *arg) {
+	Neo_step(time);
+}
+
+void onNext_command(u32 time, void *arg) {
+	static int counter = 0;
+	Neo_loadCommand(counter++);
+}
+
+Sched_Task_t neo_task = { .handler = onNeo_step, .period_ms = NEO_TASK_PERIOD_MS };
+Sched_Task_t command_task = { .handler = onNext_command, .period_ms = 7000 };
+
 int main() {
 	SystemInit();
 	systick_init();			//! REQUIRED for millis()
@@ -22,16 +34,9 @@ int main() {
 	SPI_DMA_WS2812_init(DMALEDS, DMA1_Channel3);
 	Neo_loadCommand(NEO_RAINBOW_FAST);
 
-	u32 moment = micros();
-	int counter = 0;
-	
-	while(1) {
-		if (millis() - moment > 7000) {
-			Neo_loadCommand(counter++);
-			moment = millis();
-		}
-
-		Neo_task(millis());
-	}
-}
+	fun_sched_add(&neo_task, 0);
+	fun_sched_add(&command_task, 7000);
 
+	// runs the due tasks, sleeps in WFI in between
+	while(1) fun_sched_idle();
+}
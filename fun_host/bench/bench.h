@@ -0,0 +1,43 @@
+// Minimal helpers shared by the host benches.
+// Results are printed one per line as `name: value unit` so CI can diff or
+// scrape them; a failed BENCH_CHECK makes the bench exit non-zero.
+
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+static int bench_failures;
+
+#define BENCH_CHECK(cond) do { \
+	if (!(cond)) { \
+		printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		bench_failures++; \
+	} \
+} while (0)
+
+#define BENCH_REPORT(name, value, unit) \
+	printf("%-28s %12llu %s\n", name ":", (unsigned long long)(value), unit)
+
+#define BENCH_REPORT_F(name, value, unit) \
+	printf("%-28s %12.2f %s\n", name ":", (double)(value), unit)
+
+// time a statement with the host wall clock, best of `reps` runs in ns
+#define BENCH_NS(reps, stmt) ({ \
+	uint64_t _best = UINT64_MAX; \
+	for (int _r = 0; _r < (reps); _r++) { \
+		uint64_t _t0 = host_now_ns(); \
+		stmt; \
+		uint64_t _dt = host_now_ns() - _t0; \
+		if (_dt < _best) _best = _dt; \
+	} \
+	_best; \
+})
+
+static inline int bench_result(void) {
+	if (bench_failures) printf("%d check(s) failed\n", bench_failures);
+	return bench_failures ? 1 : 0;
+}
+
+#endif
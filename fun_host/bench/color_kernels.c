@@ -0,0 +1,135 @@
+// Packed color kernels (util_colors.h): COLOR_scale and COLOR_blend must
+// match the per channel formula for every value in every lane,
+// COLOR_scale_buffer must match COLOR_scale pixel for pixel, and
+// COLOR_PERCENT must equal perc * 255 / 100 for every perc 0..100. The fade and brightness paths
+// may differ from the percentage macros they replaced by a few steps only.
+// Timed over 1024 pixels, since the old fade divides by 100 per channel and
+// the CH32V003 (RV32EC) has no divide instruction.
+
+#include <stdlib.h>
+
+#include "../../fun_modules/fun_base.h"
+#include "../../fun_modules/util_colors.h"
+#include "../../fun_modules/util_rand32.h"
+
+#include "bench.h"
+
+#define PIXELS		1024
+#define REPS		200
+
+//# the macros as they were before the packed kernels
+#define OLD_DECREMENT_PERCENTAGE(value, perc) \
+	((uint8_t)( \
+		((value) - ((value) * (perc)) / 100) > 0 \
+		? ((value) - ((value) * (perc)) / 100) \
+		: 0 \
+	))
+
+#define OLD_COLOR_DECREMENT(color_t, perc) \
+	MAKE_COLOR_RGB( \
+		OLD_DECREMENT_PERCENTAGE(color_t.R, perc), \
+		OLD_DECREMENT_PERCENTAGE(color_t.G, perc), \
+		OLD_DECREMENT_PERCENTAGE(color_t.B, perc) \
+	)
+
+#define OLD_COLOR_SET_BRIGHTNESS(color, percent) \
+	({ \
+		RGB_t result = color; \
+		uint8_t lut_index = (percent * 255) / 100; \
+		uint8_t factor = LUT_SIN[lut_index]; \
+		result.R = ((uint16_t)result.R * factor) >> 8; \
+		result.G = ((uint16_t)result.G * factor) >> 8; \
+		result.B = ((uint16_t)result.B * factor) >> 8; \
+		result; \
+	})
+
+static RGB_t src[PIXELS], dst[PIXELS];
+
+static int near(RGB_t a, RGB_t b, int tol) {
+	return abs(a.R - b.R) <= tol && abs(a.G - b.G) <= tol && abs(a.B - b.B) <= tol;
+}
+
+int main() {
+	for (u32 i = 0; i < PIXELS; i++) src[i].packed = rand_make_u32();
+
+	//# exact per channel results, every value in every lane
+	u32 scale_bad = 0, blend_bad = 0;
+	for (u32 v = 0; v < 256; v++) {
+		for (u32 f = 0; f < 256; f++) {
+			// the top byte is garbage on purpose
+			RGB_t c = { .packed = 0xA5000000 | v | (255 - v) << 8 | (v ^ 0x5A) << 16 };
+			RGB_t s = COLOR_scale(c, f);
+			if (s.R != (v * (f + 1)) >> 8 || s.G != ((255 - v) * (f + 1)) >> 8 ||
+				s.B != ((v ^ 0x5A) * (f + 1)) >> 8 || s.packed >> 24) scale_bad++;
+
+			RGB_t o = MAKE_COLOR_RGB(f, 255 - f, f ^ 0xC3);
+			RGB_t b = COLOR_blend(c, o, f);
+			if (b.R != (c.R * (256 - f) + o.R * f) >> 8 || b.G != (c.G * (256 - f) + o.G * f) >> 8 ||
+				b.B != (c.B * (256 - f) + o.B * f) >> 8 || b.packed >> 24) blend_bad++;
+		}
+	}
+	BENCH_CHECK(scale_bad == 0 && blend_bad == 0);
+	BENCH_CHECK(COLOR_EQUAL(COLOR_scale(COLOR_YELLOW_HIGH, 255), COLOR_YELLOW_HIGH));
+	BENCH_CHECK(COLOR_scale(COLOR_YELLOW_HIGH, 0).packed == 0);
+
+	u32 percent_bad = 0;
+	for (u32 p = 0; p <= 100; p++) percent_bad += COLOR_PERCENT(p) != p * 255 / 100;
+	BENCH_CHECK(percent_bad == 0 && COLOR_PERCENT(102) == 255);
+
+	//# brightness and the colorFade steps against the old macros
+	u32 bright_off = 0, fade_off = 0;
+	for (u32 i = 0; i < PIXELS; i++) {
+		RGB_t c = src[i];
+		c.packed &= 0xFFFFFF;
+		for (u32 p = 0; p < 100; p++) {
+			bright_off += !near(COLOR_brightness(c, COLOR_PERCENT(p)), OLD_COLOR_SET_BRIGHTNESS(c, p), 1);
+		}
+		// the colorFade tail: diff * 49 % before, diff * 125 / 255 now
+		for (u8 diff = 0; diff < 4; diff++) {
+			u16 amount = diff * 125;
+			RGB_t now = COLOR_dim(c, amount > 255 ? 255 : amount);
+			fade_off += !near(now, OLD_COLOR_DECREMENT(c, (int)diff * 49), 3);
+		}
+	}
+	BENCH_CHECK(bright_off == 0 && fade_off == 0);
+
+	u32 buffer_bad = 0;
+	memcpy(dst, src, sizeof(dst));
+	COLOR_scale_buffer(dst, PIXELS, 77);
+	for (u32 i = 0; i < PIXELS; i++) buffer_bad += dst[i].packed != COLOR_scale(src[i], 77).packed;
+	BENCH_CHECK(buffer_bad == 0);
+
+	//# ns per pixel, the factor changes every pass so nothing is hoisted
+	volatile u8 level = 0;
+	u64 old_bright = BENCH_NS(REPS, {
+		u8 p = level++ % 100;
+		for (u32 i = 0; i < PIXELS; i++) dst[i] = OLD_COLOR_SET_BRIGHTNESS(src[i], p);
+	});
+	u64 new_bright = BENCH_NS(REPS, {
+		u8 p = COLOR_PERCENT(level++ % 100);
+		for (u32 i = 0; i < PIXELS; i++) dst[i] = COLOR_brightness(src[i], p);
+	});
+	u64 old_fade = BENCH_NS(REPS, {
+		u8 head = level++;
+		for (u32 i = 0; i < PIXELS; i++) dst[i] = OLD_COLOR_DECREMENT(src[i], (u8)(head - i) * 49);
+	});
+	u64 new_fade = BENCH_NS(REPS, {
+		u8 head = level++;
+		for (u32 i = 0; i < PIXELS; i++) {
+			u16 amount = (u8)(head - i) * 125;
+			dst[i] = COLOR_dim(src[i], amount > 255 ? 255 : amount);
+		}
+	});
+	memcpy(dst, src, sizeof(dst));
+	u64 new_buffer = BENCH_NS(REPS, COLOR_scale_buffer(dst, PIXELS, level++ | 0x80));
+
+	BENCH_REPORT("pixels", PIXELS, "");
+	BENCH_REPORT_F("brightness_old", (double)old_bright / PIXELS, "ns/pixel");
+	BENCH_REPORT_F("brightness_new", (double)new_bright / PIXELS, "ns/pixel");
+	BENCH_REPORT_F("fade_old", (double)old_fade / PIXELS, "ns/pixel");
+	BENCH_REPORT_F("fade_new", (double)new_fade / PIXELS, "ns/pixel");
+	BENCH_REPORT_F("scale_buffer", (double)new_buffer / PIXELS, "ns/pixel");
+	BENCH_REPORT_F("fade_speedup", (double)old_fade / new_fade, "x");
+
+	return bench_result();
+}
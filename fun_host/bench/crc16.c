@@ -0,0 +1,84 @@
+// CRC16-CCITT kernels: bitwise, nibble table, byte table and slice-by-4.
+// Checks every kernel against the bitwise reference, the streaming API over
+// uneven chunks and the u64 IR packet helpers, then reports host throughput
+// and the flash each variant's tables cost.
+
+#include "../../fun_modules/fun_base.h"
+
+#define CRC16_ALL_KERNELS
+#include "../../fun_modules/fun_crc.h"
+#include "../../fun_modules/util_rand32.h"
+
+#include "bench.h"
+
+#define BUF_LEN		1024
+
+static u8 buf[BUF_LEN];
+
+typedef uint16_t (*crc_kernel_t)(uint16_t, const uint8_t *, size_t);
+
+static const struct {
+	const char *name;
+	crc_kernel_t fn;
+	u32 table_bytes;
+} kernels[] = {
+	{ "bitwise", crc16_update_bitwise, 0 },
+	{ "nibble", crc16_update_nibble, sizeof(CRC16_NIBBLE_LUT) },
+	{ "byte", crc16_update_byte, sizeof(CRC16_BYTE_LUT) },
+	{ "slice4", crc16_update_slice4, sizeof(CRC16_BYTE_LUT) + sizeof(CRC16_SLICE_LUT) },
+};
+
+#define KERNELS		(sizeof(kernels) / sizeof(kernels[0]))
+
+int main() {
+	for (int i = 0; i < BUF_LEN; i++) buf[i] = rand_make_u32();
+
+	//# CRC-16/CCITT-FALSE check value
+	for (u32 k = 0; k < KERNELS; k++) {
+		BENCH_CHECK(kernels[k].fn(CRC16_CCITT_INIT, (const u8 *)"123456789", 9) == 0x29B1);
+	}
+
+	//# every length, every alignment, matches the bitwise reference
+	for (int len = 0; len <= 67; len++) {
+		for (int off = 0; off < 4; off++) {
+			u16 ref = crc16_update_bitwise(CRC16_CCITT_INIT, buf + off, len);
+			for (u32 k = 1; k < KERNELS; k++) {
+				BENCH_CHECK(kernels[k].fn(CRC16_CCITT_INIT, buf + off, len) == ref);
+			}
+		}
+	}
+
+	//# streaming in uneven chunks equals one pass
+	u16 whole = _crc16_ccitt(buf, BUF_LEN);
+	u16 crc = crc16_init();
+	for (int pos = 0, chunk = 1; pos < BUF_LEN; pos += chunk, chunk = chunk % 13 + 1) {
+		int n = pos + chunk > BUF_LEN ? BUF_LEN - pos : chunk;
+		crc = crc16_update(crc, buf + pos, n);
+	}
+	BENCH_CHECK(crc16_final(crc) == whole);
+	BENCH_CHECK(whole == crc16_update_bitwise(CRC16_CCITT_INIT, buf, BUF_LEN));
+
+	//# u64 IR packets: first 6 bytes MSB first, CRC in the low 16 bits
+	u64 data = combine_64(0x1234, 0x5678, 0x9ABC, 0x0000);
+	u8 bytes[6] = { 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC };
+	u64 packed = crc16_ccitt_make64(data), out = 0;
+	BENCH_CHECK((packed & 0xFFFF) == crc16_update_bitwise(CRC16_CCITT_INIT, bytes, 6));
+	BENCH_CHECK(crc16_ccitt_check64(packed, &out) && out == data);
+	BENCH_CHECK(!crc16_ccitt_check64(packed ^ 0x0100000000000000ULL, &out));
+
+	//# host throughput over 1 KB
+	volatile u16 sink;
+	u64 ns_bitwise = 0;
+	for (u32 k = 0; k < KERNELS; k++) {
+		crc_kernel_t fn = kernels[k].fn;
+		u64 ns = BENCH_NS(200, sink = fn(CRC16_CCITT_INIT, buf, BUF_LEN));
+		(void)sink;
+		if (k == 0) ns_bitwise = ns;
+
+		printf("%-28s %12.3f bytes/ns\n", kernels[k].name, (double)BUF_LEN / ns);
+		printf("%-28s %12.2f x\n", "  speedup:", (double)ns_bitwise / ns);
+		printf("%-28s %12u bytes\n", "  table_flash:", kernels[k].table_bytes);
+	}
+
+	return bench_result();
+}
@@ -0,0 +1,175 @@
+// Queued DMA I2C transactions: an SSD1306 frame push and a sensor register
+// read submitted back to back, while the main loop keeps running tasks.
+// A model of the panel RAM checks the frame, and the same frame is pushed
+// with the blocking i2c_write_raw() for comparison.
+
+#include "../../fun_modules/fun_base.h"
+#include "../../fun_modules/fun_i2c/lib/lib_i2c.h"
+
+#include "bench.h"
+
+#define OLED_ADDR		0x3C
+#define SENSOR_ADDR		0x23
+#define ABSENT_ADDR		0x50
+#define PAGES			8
+#define COLS			128
+
+i2c_device_t dev_oled   = { .clkr = I2C_CLK_400KHZ, .type = I2C_ADDR_7BIT, .addr = OLED_ADDR, .regb = 1 };
+i2c_device_t dev_sensor = { .clkr = I2C_CLK_400KHZ, .type = I2C_ADDR_7BIT, .addr = SENSOR_ADDR, .regb = 1 };
+i2c_device_t dev_absent = { .clkr = I2C_CLK_400KHZ, .type = I2C_ADDR_7BIT, .addr = ABSENT_ADDR, .regb = 1 };
+
+static u8 frame[PAGES * COLS];
+
+//# panel model: control byte, then commands or data in the COLUMNADDR/PAGEADDR window
+static u8 panel[PAGES * COLS];
+static struct {
+	int ctrl;
+	u8 cmd, args, arg[2];
+	u8 col0, col1, page0, page1, col, page;
+} lcd = { .col1 = COLS - 1, .page1 = PAGES - 1 };
+
+static u8 sensor_reg;
+static u8 sensor_next = 0xA0;
+
+static void bus_sink(u8 addr, u8 byte, int first) {
+	if (addr == SENSOR_ADDR) { if (!first) sensor_reg = byte; return; }
+	if (addr != OLED_ADDR) return;
+
+	if (first) { lcd.ctrl = -1; return; }
+	if (lcd.ctrl < 0) { lcd.ctrl = byte; return; }
+
+	if (lcd.ctrl == 0x40) {
+		panel[lcd.page * COLS + lcd.col] = byte;
+		if (lcd.col++ == lcd.col1) {
+			lcd.col = lcd.col0;
+			lcd.page = lcd.page == lcd.page1 ? lcd.page0 : lcd.page + 1;
+		}
+		return;
+	}
+
+	if (lcd.args) {
+		lcd.arg[2 - lcd.args--] = byte;
+		if (lcd.args) return;
+		if (lcd.cmd == 0x21) { lcd.col0 = lcd.arg[0]; lcd.col1 = lcd.arg[1]; lcd.col = lcd.col0; }
+		if (lcd.cmd == 0x22) { lcd.page0 = lcd.arg[0]; lcd.page1 = lcd.arg[1]; lcd.page = lcd.page0; }
+		return;
+	}
+
+	lcd.cmd = byte;
+	if (byte == 0x21 || byte == 0x22) lcd.args = 2;
+}
+
+static int bus_ack(u8 addr) { return addr != ABSENT_ADDR; }
+static u8 bus_read(u8 addr) { return sensor_next++; }
+
+static u8 done_order[16];
+static u8 done_count;
+static void on_done(i2c_xfer_t *xfer) { done_order[done_count++] = xfer->flags; }
+
+int main() {
+	SystemInit();
+	systick_init();
+	host_i2c_sink = bus_sink;
+	host_i2c_ack = bus_ack;
+	host_i2c_read = bus_read;
+
+	BENCH_CHECK(i2c_init(&dev_oled) == I2C_OK);
+	i2c_async_init();
+
+	for (int i = 0; i < sizeof(frame); i++) frame[i] = i * 7 + (i >> 7);
+
+	//# frame push + sensor read, queued
+	static u8 window[] = { 0x21, 0, COLS - 1, 0x22, 0, PAGES - 1 };
+	static i2c_xfer_t push[1 + PAGES];
+	static u8 reading[2];
+	static i2c_xfer_t poll = {
+		.dev = &dev_sensor, .reg = 0x10, .buf = reading, .len = 2,
+		.flags = I2C_XFER_REG | I2C_XFER_READ, .callback = on_done,
+	};
+
+	// the SSD1306 control byte goes out as the register byte
+	push[0] = (i2c_xfer_t){ .dev = &dev_oled, .reg = 0x00, .buf = window, .len = sizeof(window), .flags = I2C_XFER_REG };
+	for (int p = 0; p < PAGES; p++) {
+		push[1 + p] = (i2c_xfer_t){
+			.dev = &dev_oled, .reg = 0x40, .buf = &frame[p * COLS], .len = COLS,
+			.flags = I2C_XFER_REG, .callback = on_done,
+		};
+	}
+
+	u64 bytes = host_stats.i2c_bytes;
+	u64 cyc = host_cycles;
+	u32 ticks = 0;
+
+	BENCH_CHECK(i2c_async_submit(push, 1 + PAGES) == I2C_OK);
+	BENCH_CHECK(i2c_async_submit(&poll, 1) == I2C_OK);
+
+	// main loop keeps ticking in 100us slices while the bus works
+	while (i2c_async_busy()) {
+		ticks++;
+		host_run_us(100);
+	}
+	u64 async_cycles = host_cycles - cyc;
+	u64 async_bytes = host_stats.i2c_bytes - bytes;
+
+	u64 irq_cycles = host_stats.irq[I2C1_EV_IRQn].cycles_total +
+		host_stats.irq[I2C1_ER_IRQn].cycles_total +
+		host_stats.irq[DMA1_Channel7_IRQn].cycles_total;
+	u32 irqs = host_stats.irq[I2C1_EV_IRQn].count + host_stats.irq[DMA1_Channel7_IRQn].count;
+
+	BENCH_CHECK(memcmp(panel, frame, sizeof(frame)) == 0);
+	BENCH_CHECK(poll.done && poll.status == I2C_OK);
+	BENCH_CHECK(sensor_reg == 0x10 && reading[0] == 0xA0 && reading[1] == 0xA1);
+	BENCH_CHECK(done_count == PAGES + 1 && done_order[PAGES] == (I2C_XFER_REG | I2C_XFER_READ));
+	for (int p = 0; p <= PAGES; p++) BENCH_CHECK(push[p].done && push[p].status == I2C_OK);
+
+	BENCH_REPORT("async_bytes", async_bytes, "bytes");
+	BENCH_REPORT("async_bus_time", async_cycles / SYSTICK_ONE_MICROSECOND, "us");
+	BENCH_REPORT("async_irqs", irqs, "");
+	BENCH_REPORT("async_cpu_in_irq", irq_cycles / SYSTICK_ONE_MICROSECOND, "us");
+	BENCH_REPORT("main_loop_ticks", ticks, "x 100us");
+
+	//# a NACKed transfer reports the error and the queue moves on
+	u8 one = 0x55;
+	i2c_xfer_t pair[2] = {
+		{ .dev = &dev_absent, .buf = &one, .len = 1, .flags = I2C_XFER_WRITE },
+		{ .dev = &dev_sensor, .reg = 0x20, .buf = reading, .len = 1, .flags = I2C_XFER_REG | I2C_XFER_READ },
+	};
+	i2c_async_submit(pair, 2);
+	BENCH_CHECK(i2c_async_wait(&pair[0]) == I2C_ERR_NACK);
+	BENCH_CHECK(i2c_async_wait(&pair[1]) == I2C_OK);
+	BENCH_CHECK(sensor_reg == 0x20 && reading[0] == 0xA2);
+	while (i2c_async_busy()) host_wfi();
+
+	//# same frame, blocking: the CPU is held for the whole push
+	memset(panel, 0, sizeof(panel));
+	cyc = host_cycles;
+	u8 pkt[1 + COLS];
+	pkt[0] = 0x00;
+	memcpy(&pkt[1], window, sizeof(window));
+	BENCH_CHECK(i2c_write_raw(&dev_oled, pkt, 1 + sizeof(window)) == I2C_OK);
+	for (int p = 0; p < PAGES; p++) {
+		pkt[0] = 0x40;
+		memcpy(&pkt[1], &frame[p * COLS], COLS);
+		BENCH_CHECK(i2c_write_raw(&dev_oled, pkt, 1 + COLS) == I2C_OK);
+	}
+	BENCH_CHECK(memcmp(panel, frame, sizeof(frame)) == 0);
+	BENCH_REPORT("blocking_cpu_time", (host_cycles - cyc) / SYSTICK_ONE_MICROSECOND, "us");
+
+	//# a bus that never answers: the wait gives up and drops the queue
+	NVIC_DisableIRQ(I2C1_EV_IRQn);
+	NVIC_DisableIRQ(I2C1_ER_IRQn);
+	NVIC_DisableIRQ(DMA1_Channel7_IRQn);
+	i2c_xfer_t stuck[2] = {
+		{ .dev = &dev_oled, .buf = window, .len = sizeof(window), .flags = I2C_XFER_WRITE },
+		{ .dev = &dev_sensor, .reg = 0x30, .buf = reading, .len = 1, .flags = I2C_XFER_REG | I2C_XFER_READ },
+	};
+	u32 t0 = millis();
+	i2c_async_submit(stuck, 2);
+	BENCH_CHECK(i2c_async_wait(&stuck[0]) == I2C_ERR_TIMEOUT);
+	u32 waited = millis() - t0;
+	BENCH_CHECK(stuck[1].done && stuck[1].status == I2C_ERR_TIMEOUT && !i2c_async_busy());
+	BENCH_CHECK(waited >= I2C_ASYNC_TIMEOUT_MS && waited <= I2C_ASYNC_TIMEOUT_MS + 2);
+	BENCH_REPORT("timeout_wait", waited, "ms");
+
+	return bench_result();
+}
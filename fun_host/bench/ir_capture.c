@@ -0,0 +1,124 @@
+// IR receiver in capture mode (IR_RECEIVER_USE_DMA): NfS packets arrive on
+// PA1 while the main loop only calls fun_irReceiver_task() every 10 ms.
+// TIM1 + DMA timestamp every edge, so each packet must decode byte for byte.
+// Reports the CPU time the task costs and what a 10 ms pin poll would see.
+
+#include "../../fun_modules/fun_base.h"
+#include "../../fun_modules/fun_irReceiver.h"
+#include "../../fun_modules/util_rand32.h"
+
+#include "bench.h"
+
+#define PIN				PA1
+#define NFS_1_US		550
+#define NFS_0_US		300
+#define START_US		2000
+#define CALL_MS			10
+#define MAX_LEN			32
+
+static u8 receive_buf[MAX_LEN];
+static u8 got[MAX_LEN];
+static u16 got_len;
+static u32 packets;
+
+static void onData(u8 *data, u16 len) {
+	memcpy(got, data, len);
+	got_len = len;
+	packets++;
+}
+
+// receiver output is active low: start mark and space, then one level per
+// bit, then back to idle high. Returns the number of edges scheduled.
+static u32 send(const u8 *data, u16 len, u64 at) {
+	u64 t = at;
+	u32 edges = 0;
+	u8 level = 0;
+
+	#define EDGE(us) do { \
+		host_gpio_schedule(PIN, level, t); level ^= 1; edges++; \
+		t += (u64)(us) * SYSTICK_ONE_MICROSECOND; \
+	} while (0)
+
+	EDGE(START_US);
+	EDGE(START_US);
+	for (u32 i = 0; i < len * 8u; i++) {
+		EDGE((data[i / 8] >> (7 - i % 8)) & 1 ? NFS_1_US : NFS_0_US);
+	}
+	if (!level) EDGE(START_US);
+	EDGE(0);
+	#undef EDGE
+
+	return edges;
+}
+
+static IR_Receiver_t receiver = {
+	.pin = PIN,
+	.RECEIVE_MAX_LEN = MAX_LEN,
+	.RECEIVE_BUF = receive_buf,
+	.LOGICAL_1_US = NFS_1_US,
+	.LOGICAL_0_US = NFS_0_US,
+	.START_SIGNAL_THRESHOLD_US = 1000,
+	.onHandle_data = onData,
+};
+
+int main() {
+	SystemInit();
+	systick_init();
+	funGpioInitAll();
+	fun_irReceiver_init(&receiver);
+
+	u8 sent[MAX_LEN];
+	u64 task_cycles = 0, task_worst = 0;
+	u32 calls = 0, edges = 0, poll_changes = 0;
+	static const u16 lens[] = { 4, 8, 16, 24 };
+
+	for (u32 p = 0; p < sizeof(lens) / sizeof(lens[0]); p++) {
+		u16 len = lens[p];
+		for (int i = 0; i < len; i++) sent[i] = rand_make_u32();
+
+		got_len = 0;
+		u32 before = packets;
+		edges += send(sent, len, host_cycles + 50 * SYSTICK_ONE_MILLISECOND);
+
+		//# main loop: the task every 10 ms, the callback fires on the 300 ms timeout
+		u8 pin_prev = funDigitalRead(PIN);
+		for (u32 ms = 0; ms < 500; ms += CALL_MS) {
+			Delay_Ms(CALL_MS);
+
+			u8 pin = funDigitalRead(PIN);
+			poll_changes += pin != pin_prev;
+			pin_prev = pin;
+
+			u64 t = host_cycles;
+			fun_irReceiver_task(&receiver);
+			t = host_cycles - t;
+			task_cycles += t;
+			if (t > task_worst) task_worst = t;
+			calls++;
+		}
+
+		BENCH_CHECK(packets == before + 1);
+		BENCH_CHECK(got_len == len && !memcmp(got, sent, len));
+	}
+
+	//# another pin: capture refuses it and leaves TIM1 and the rings alone
+	IR_Receiver_t other = { .pin = PC1, .onHandle_data = onData };
+	u16 ccer = TIM1->CCER, rise_tail = ir_rise_ring.tail;
+	u32 before = packets;
+	fun_irReceiver_init(&other);
+	edges += send(sent, 4, host_cycles + SYSTICK_ONE_MILLISECOND);
+	Delay_Ms(400);
+	fun_irReceiver_task(&other);
+	BENCH_CHECK(TIM1->CCER == ccer && ir_rise_ring.tail == rise_tail && packets == before);
+
+	BENCH_REPORT("packets", packets, "");
+	BENCH_REPORT("edges", edges, "");
+	BENCH_REPORT("task_calls", calls, "");
+	BENCH_REPORT("task_avg", task_cycles / calls, "cycles");
+	BENCH_REPORT("task_worst", task_worst, "cycles");
+	BENCH_REPORT_F("cpu_load", 100.0 * task_cycles / (calls * CALL_MS * SYSTICK_ONE_MILLISECOND), "%");
+	// the GPIO mode only sees the level changes its poll catches
+	BENCH_REPORT("poll_10ms_edges_seen", poll_changes, "");
+
+	return bench_result();
+}
@@ -0,0 +1,155 @@
+// IR sender in DMA mode (IR_SENDER_USE_DMA): one NEC frame, then three NfS
+// frames queued back to back. The carrier on/off edges seen on TIM1->CCER
+// must match the mark/space schedule to the microsecond, onDone must fire
+// once per frame in order, and the CPU only runs the ring refill IRQ.
+
+#include "../../fun_modules/fun_base.h"
+#include "../../fun_modules/fun_irSender.h"
+#include "../../fun_modules/util_rand32.h"
+
+#include "bench.h"
+
+#define MAX_EDGES	1024
+
+//# carrier edges from the timer trace
+static u64 edge_cycle[MAX_EDGES];
+static u8 edge_on[MAX_EDGES];
+static u32 edges;
+
+static void tim_trace(int tim, uint16_t ccer, uint64_t cycle) {
+	if (tim != 1) return;
+	u8 on = (ccer & TIM_CC1NE) != 0;
+	if (edges && edge_on[edges - 1] == on) return;
+	if (edges < MAX_EDGES) {
+		edge_cycle[edges] = cycle;
+		edge_on[edges++] = on;
+	}
+}
+
+//# frames reported done
+static u8 *done_data[8];
+static u64 done_cycle[8];
+static u32 done_count;
+
+static void onDone(u8 *data, u16 len) {
+	done_data[done_count] = data;
+	done_cycle[done_count++] = host_cycles;
+}
+
+// reference schedule, in the order the protocol describes it
+static u32 expect[MAX_EDGES];
+static u32 expected;
+
+static void expect_frame(IR_Sender_t *s, const u8 *data, u16 len) {
+	u8 nec = s->LOGICAL_1_US == NEC_LOGICAL_1_US;
+	expect[expected++] = s->START_HI_US;
+	expect[expected++] = s->START_LO_US;
+	for (int i = 0; i < len * 8; i++) {
+		u8 bit = (data[i / 8] >> (7 - i % 8)) & 1;
+		if (nec) expect[expected++] = s->LOGICAL_0_US;
+		expect[expected++] = bit ? s->LOGICAL_1_US : s->LOGICAL_0_US;
+	}
+	expect[expected++] = s->LOGICAL_0_US;
+	expect[expected++] = IR_SENDER_GAP_US;
+}
+
+// trace intervals against the reference, the last frame has no edge after its gap
+static int schedule_matches() {
+	if (edges != expected) return 0;
+	for (u32 i = 0; i + 1 < edges; i++) {
+		if (edge_on[i] != !(i & 1)) return 0;
+		if (edge_cycle[i + 1] - edge_cycle[i] != (u64)expect[i] * SYSTICK_ONE_MICROSECOND) return 0;
+	}
+	return 1;
+}
+
+// the old asyncTask sat in Delay_Us for every data bit
+static u32 legacy_blocking_us(IR_Sender_t *s, const u8 *data, u16 len) {
+	u8 nec = s->LOGICAL_1_US == NEC_LOGICAL_1_US;
+	u32 us = s->LOGICAL_0_US;
+	for (int i = 0; i < len * 8; i++) {
+		u8 bit = (data[i / 8] >> (7 - i % 8)) & 1;
+		us += (nec ? s->LOGICAL_0_US : 0) + (bit ? s->LOGICAL_1_US : s->LOGICAL_0_US);
+	}
+	return us;
+}
+
+static void wait_idle() {
+	while (fun_irSender_busy()) __WFI();
+}
+
+int main() {
+	SystemInit();
+	systick_init();
+	funGpioInitAll();
+
+	//# NEC: one frame
+	IR_Sender_t nec = { .pin = PD0, .onDone = onDone };
+	fun_irSender_init(&nec);
+	host_tim_trace = tim_trace;
+
+	u8 nec_data[4] = { 0x00, 0xFF, 0x12, 0xED };
+	u64 cyc = host_cycles;
+	BENCH_CHECK(fun_irSender_asyncSend(&nec, nec_data, sizeof(nec_data)));
+	u64 submit_cycles = host_cycles - cyc;
+	expect_frame(&nec, nec_data, sizeof(nec_data));
+	wait_idle();
+
+	BENCH_CHECK(schedule_matches());
+	BENCH_CHECK(done_count == 1 && done_data[0] == nec_data);
+	BENCH_CHECK(done_cycle[0] >= edge_cycle[edges - 1]);
+	BENCH_CHECK(!(TIM1->CCER & TIM_CC1NE));
+	u32 nec_irqs = host_stats.irq[DMA1_Channel1_IRQn].count;
+	u64 nec_irq_cycles = host_stats.irq[DMA1_Channel1_IRQn].cycles_total;
+	u32 nec_legacy = legacy_blocking_us(&nec, nec_data, sizeof(nec_data));
+
+	//# NfS: three frames back to back, a fourth does not fit the queue
+	IR_Sender_t nfs = {
+		.pin = PD0,
+		.LOGICAL_1_US = 550,
+		.LOGICAL_0_US = 300,
+		.START_HI_US = 2500,
+		.START_LO_US = 2500,
+		.onDone = onDone,
+	};
+	fun_irSender_init(&nfs);
+
+	static u8 frames[3][20];
+	static const u16 lens[3] = { 16, 20, 4 };
+	edges = expected = done_count = 0;
+	memset(&host_stats, 0, sizeof(host_stats));
+
+	u32 legacy = 0;
+	for (int f = 0; f < 3; f++) {
+		for (int i = 0; i < lens[f]; i++) frames[f][i] = rand_make_u32();
+		BENCH_CHECK(fun_irSender_asyncSend(&nfs, frames[f], lens[f]));
+		expect_frame(&nfs, frames[f], lens[f]);
+		legacy += legacy_blocking_us(&nfs, frames[f], lens[f]);
+	}
+	BENCH_CHECK(!fun_irSender_asyncSend(&nfs, frames[0], 1));
+
+	cyc = host_cycles;
+	wait_idle();
+	u64 air_cycles = host_cycles - cyc;
+
+	BENCH_CHECK(schedule_matches());
+	BENCH_CHECK(done_count == 3);
+	for (int f = 0; f < 3; f++) BENCH_CHECK(done_data[f] == frames[f]);
+	BENCH_CHECK(!(TIM1->CCER & TIM_CC1NE));
+
+	u32 irqs = host_stats.irq[DMA1_Channel1_IRQn].count;
+	u64 irq_cycles = host_stats.irq[DMA1_Channel1_IRQn].cycles_total;
+
+	BENCH_REPORT("nec_submit", submit_cycles, "cycles");
+	BENCH_REPORT("nec_irqs", nec_irqs, "");
+	BENCH_REPORT("nec_irq_total", nec_irq_cycles, "cycles");
+	BENCH_REPORT("nec_legacy_blocking", nec_legacy, "us");
+	BENCH_REPORT("nfs_segments", expected, "");
+	BENCH_REPORT("nfs_air_time", air_cycles / SYSTICK_ONE_MICROSECOND, "us");
+	BENCH_REPORT("nfs_irqs", irqs, "");
+	BENCH_REPORT("nfs_irq_worst", host_stats.irq[DMA1_Channel1_IRQn].cycles_max, "cycles");
+	BENCH_REPORT_F("nfs_cpu_load", 100.0 * irq_cycles / air_cycles, "%");
+	BENCH_REPORT("nfs_legacy_blocking", legacy, "us");
+
+	return bench_result();
+}
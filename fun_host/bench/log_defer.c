@@ -0,0 +1,145 @@
+// Deferred logging (LOG_DEFERRED, see CFLAGS_log_defer): the same LOG_* calls
+// are made once as binary records and once through the text LOG(). The
+// records, decoded by log_decode.h against this program's own ELF, must give
+// the text byte for byte. Then the cost per call of both modes, ring overflow
+// accounting and decoder resync after garbage on the line.
+
+#include "../../fun_modules/fun_base.h"
+#include "../log_decode.h"
+
+#include "bench.h"
+
+#define MESSAGES	64
+
+//# LOG output capture
+static char out[64 * 1024];
+static size_t out_len;
+
+static uint16_t capture(const void *data, uint16_t len) {
+	memcpy(out + out_len, data, len);
+	out_len += len;
+	return len;
+}
+
+static uint16_t discard(const void *data, uint16_t len) {
+	return len;
+}
+
+// a deferred macro call or the text LOG() with the same arguments
+#define BOTH(deferred, mac, style, color, tag, f_, ...) do { \
+	if (deferred) mac(tag, f_, ##__VA_ARGS__); \
+	else LOG(style, color, tag, f_, ##__VA_ARGS__); \
+} while (0)
+
+static void emit(int deferred, u32 i) {
+	systick_millis = 1000 + i * 7;
+
+	switch (i % 7) {
+	case 0:
+		BOTH(deferred, LOG_Info, LOG_STYLE_NORMAL, LOG_COLOR_CYAN, "ir",
+			"frame %u bytes, addr 0x%02X cmd 0x%02x", i % 32, i * 3 & 0xFF, ~i & 0xFF);
+		break;
+	case 1:
+		BOTH(deferred, LOG_Warn, LOG_STYLE_ITALIC, LOG_COLOR_YELLOW, "i2c",
+			"dev %s nack at %d", i & 8 ? "sht3x" : "bh1750", -(int)i);
+		break;
+	case 2:
+		BOTH(deferred, LOG_Err, LOG_STYLE_BOLD, LOG_COLOR_RED, "nvs",
+			"crc %04x != %04x, 100%% wrong", i * 0x1234 & 0xFFFF, i * 0x4321 & 0xFFFF);
+		break;
+	case 3:
+		BOTH(deferred, LOG_Debug, LOG_STYLE_NORMAL, LOG_COLOR_NORMAL, "loop", "tick");
+		break;
+	case 4:
+		BOTH(deferred, LOG_Ok, LOG_STYLE_BOLD, LOG_COLOR_GREEN, "bh1750",
+			"%5d lx|%-4u|%c|%*d", (int)(i * 37) - 500, i, 'A' + i % 26, (int)(i % 6), (int)i);
+		break;
+	case 5:
+		BOTH(deferred, LOG_Notice, LOG_STYLE_NORMAL, LOG_COLOR_MAGENTA, "adc",
+			"%hhd %hu %ld", (int)(i * 50), (unsigned)(i * 3000), (long)i - 32);
+		break;
+	default:
+		BOTH(deferred, LOG_Info, LOG_STYLE_NORMAL, LOG_COLOR_CYAN, "eight",
+			"%u %u %u %u %u %u %u %u", i, i + 1, i + 2, i + 3, i + 4, i + 5, i + 6, i + 7);
+	}
+}
+
+static size_t decode(const u8 *data, size_t len, Log_Elf_t *elf, char *text, size_t size, size_t *skipped) {
+	FILE *f = fmemopen(text, size, "w");
+	size_t used = log_decode(data, len, log_elf_str, elf, f, skipped);
+	size_t n = ftell(f);
+	fclose(f);
+	BENCH_CHECK(used == len);
+	return n;
+}
+
+static char text[64 * 1024], decoded[64 * 1024];
+static u8 records[16 * 1024];
+
+int main() {
+	LOG_Init(&systick_millis);
+
+	Log_Elf_t elf;
+	BENCH_CHECK(log_elf_load(&elf, "/proc/self/exe"));
+
+	//# text reference
+	LOG_setOutput(capture);
+	for (u32 i = 0; i < MESSAGES; i++) emit(0, i);
+	size_t text_len = out_len;
+	memcpy(text, out, out_len);
+
+	//# deferred records, flushed after every call
+	out_len = 0;
+	for (u32 i = 0; i < MESSAGES; i++) {
+		emit(1, i);
+		BENCH_CHECK(LOG_flush());
+	}
+	size_t record_len = out_len;
+	memcpy(records, out, out_len);
+	BENCH_CHECK(LOG_dropped == 0);
+
+	size_t skipped = 0;
+	size_t n = decode(records, record_len, &elf, decoded, sizeof(decoded), &skipped);
+	BENCH_CHECK(skipped == 0);
+	BENCH_CHECK(n == text_len && !memcmp(decoded, text, n));
+
+	//# garbage in front: the decoder resyncs on the first known site
+	static u8 noisy[sizeof(records) + 3] = { 0x55, 0xAA, 0x13 };
+	memcpy(noisy + 3, records, record_len);
+	n = decode(noisy, record_len + 3, &elf, decoded, sizeof(decoded), &skipped);
+	BENCH_CHECK(skipped == 3);
+	BENCH_CHECK(n == text_len && !memcmp(decoded, text, n));
+
+	//# no flush: records that do not fit are dropped whole and counted
+	for (u32 i = 0; i < MESSAGES; i++) emit(1, i);
+	u32 dropped = LOG_dropped;
+	out_len = 0;
+	BENCH_CHECK(LOG_flush());
+	n = decode((const u8 *)out, out_len, &elf, decoded, sizeof(decoded), &skipped);
+	u32 lines = 0;
+	for (size_t i = 0; i < n; i++) lines += decoded[i] == '\n';
+	BENCH_CHECK(dropped > 0 && lines == MESSAGES - dropped);
+
+	//# cost per call, LOG output discarded
+	LOG_setOutput(discard);
+	u64 text_ns = BENCH_NS(50, for (u32 i = 0; i < MESSAGES; i++) emit(0, i));
+	// flushed every 4 calls so no record is dropped, the output write included
+	u64 defer_ns = BENCH_NS(50, {
+		for (u32 i = 0; i < MESSAGES; i++) {
+			emit(1, i);
+			if (i % 4 == 3) LOG_flush();
+		}
+	});
+	BENCH_CHECK(LOG_dropped == dropped);
+
+	BENCH_REPORT("messages", MESSAGES, "");
+	BENCH_REPORT("text_bytes", text_len, "bytes");
+	BENCH_REPORT("record_bytes", record_len, "bytes");
+	BENCH_REPORT_F("text_ns_per_call", (double)text_ns / MESSAGES, "ns");
+	BENCH_REPORT_F("defer_ns_per_call", (double)defer_ns / MESSAGES, "ns");
+	BENCH_REPORT_F("speedup", (double)text_ns / defer_ns, "x");
+	BENCH_REPORT("overflow_dropped", dropped, "");
+
+	log_elf_free(&elf);
+	return bench_result();
+}
@@ -0,0 +1,149 @@
+// WS2812 animation engine: keyframe timelines interpolate between their keys
+// and loop, layers stay inside their segments and blend by mode and
+// opacity, a crossfade starts on the old animation and ends on the new one,
+// and every built in animation lights the strip. Then host ns per pixel for
+// each animation, the flash its tables take and the RAM the engine keeps.
+
+#include "../../fun_modules/fun_base.h"
+
+#define DMALEDS 16
+#include "../../fun_modules/util_sine.h"
+#include "../../fun_modules/util_rand32.h"
+#include "../../fun_modules/fun_spi/fun_ws2812_spi.h"
+
+#include "bench.h"
+
+#define FRAMES_PER_S	(1000 / NEO_FRAME_MS)
+
+//# test tables
+static const Neo_Key_t ramp[] = { { 0, 0x00, 0x00, 0x00 }, { 100, 0xC8, 0x64, 0x00 } };
+static const Neo_Key_t red[] = { { 0, 0xF0, 0x00, 0x00 } };
+static const Neo_Key_t blue[] = { { 0, 0x00, 0x00, 0xF0 } };
+static const Neo_Key_t grey[] = { { 0, 0x40, 0x40, 0x40 } };
+
+static const Neo_Layer_t split_layers[] = {
+	{ NEO_FX_SOLID, NEO_BLEND_NORMAL, 255, .start = 0, .len = 8, NEO_KEYS(red) },
+	{ NEO_FX_SOLID, NEO_BLEND_NORMAL, 255, .start = 8, NEO_KEYS(blue) },
+	// added over the lower half only
+	{ NEO_FX_SOLID, NEO_BLEND_ADD, 255, .start = 4, .len = 8, NEO_KEYS(grey) },
+	// half way over one pixel
+	{ NEO_FX_SOLID, NEO_BLEND_NORMAL, 128, .start = 15, .len = 1, NEO_KEYS(grey) },
+};
+static const Neo_Anim_t split = NEO_ANIM(split_layers);
+
+static const Neo_Layer_t red_layers[] = { { NEO_FX_SOLID, NEO_BLEND_NORMAL, 255, NEO_KEYS(red) } };
+static const Neo_Layer_t blue_layers[] = { { NEO_FX_SOLID, NEO_BLEND_NORMAL, 255, NEO_KEYS(blue) } };
+static const Neo_Anim_t all_red = NEO_ANIM(red_layers), all_blue = NEO_ANIM(blue_layers);
+
+// degenerate layers draw nothing instead of dividing by zero or wrapping
+static const Neo_Layer_t broken_layers[] = {
+	{ NEO_FX_SOLID, NEO_BLEND_NORMAL, 255, NEO_KEYS(grey) },
+	{ NEO_FX_CHASE, NEO_BLEND_NORMAL, 255, .width = 0, .rate = 7, NEO_KEYS(red) },
+	{ NEO_FX_CHASE, NEO_BLEND_NORMAL, 255, .width = 3, .rate = 7, .key_count = 0, .keys = red },
+	{ NEO_FX_TWINKLE, NEO_BLEND_NORMAL, 255, .rate = 0, NEO_KEYS(red) },
+	{ NEO_FX_SOLID, NEO_BLEND_NORMAL, 255, .start = DMALEDS + 5, NEO_KEYS(blue) },
+};
+static const Neo_Anim_t broken = NEO_ANIM(broken_layers);
+
+static int is(RGB_t c, u32 hex) {
+	return (c.packed & 0xFFFFFF) == hex;
+}
+
+int main() {
+	SystemInit();
+	systick_init();
+	SPI_init(-1, -1);
+	SPI_DMA_WS2812_init(DMALEDS, DMA1_Channel3);
+
+	//# timelines: on the keys, between them, and back to the first at span
+	BENCH_CHECK(is(Neo_keys_at(ramp, 2, 0, 200), 0x000000));
+	BENCH_CHECK(is(Neo_keys_at(ramp, 2, 100, 200), 0x0064C8));
+	BENCH_CHECK(is(Neo_keys_at(ramp, 2, 50, 200), 0x003264));
+	BENCH_CHECK(is(Neo_keys_at(ramp, 2, 150, 200), 0x003264));
+	BENCH_CHECK(is(Neo_keys_at(red, 1, 77, 0), 0x0000F0));
+
+	// flashing ramps up to red, then cuts to black before green
+	const Neo_Layer_t *flash = &NEO_ANIMATIONS[NEO_COLOR_FLASHING].layers[0];
+	BENCH_CHECK(is(Neo_keys_at(flash->keys, flash->key_count, 990, flash->span), 0x000033));
+	BENCH_CHECK(is(Neo_keys_at(flash->keys, flash->key_count, 1000, flash->span), 0x000000));
+	BENCH_CHECK(is(Neo_keys_at(flash->keys, flash->key_count, 1990, flash->span), 0x003300));
+
+	//# segments and blending
+	Neo_play(&split, 0);
+	Neo_render(Neo_frame);
+	u32 seg_bad = 0;
+	for (int i = 0; i < DMALEDS; i++) {
+		u32 expect = i < 8 ? 0xF0 : 0xF00000;
+		if (i >= 4 && i < 12) expect = i < 8 ? 0x4040FF : 0xFF4040;	// saturated add
+		if (i == 15) expect = COLOR_blend(MAKE_COLOR_RGB(0, 0, 0xF0), MAKE_COLOR_RGB(0x40, 0x40, 0x40), 128).packed;
+		seg_bad += !is(WS2812_BUF[i], expect);
+	}
+	BENCH_CHECK(seg_bad == 0);
+
+	Neo_play(&broken, 0);
+	Neo_render(Neo_frame + 50);
+	u32 broken_bad = 0;
+	for (int i = 0; i < DMALEDS; i++) broken_bad += !is(WS2812_BUF[i], 0x404040);
+	BENCH_CHECK(broken_bad == 0);
+
+	//# crossfade: starts on the old animation, ends on the new one
+	Neo_play(&all_red, 0);
+	Neo_frame += 5;
+	Neo_play(&all_blue, 400);
+	u32 fade_frames = 400 / NEO_FRAME_MS;
+	BENCH_CHECK(is(Neo_pixel(3, Neo_frame), 0x0000F0));
+	RGB_t mid = Neo_pixel(3, Neo_frame + fade_frames / 2);
+	BENCH_CHECK(mid.R == 0x78 && mid.B == 0x78);
+	BENCH_CHECK(is(Neo_pixel(3, Neo_frame + fade_frames), 0xF00000));
+
+	u32 monotonic = 1;
+	for (u32 f = 1; f <= fade_frames; f++) monotonic &= Neo_pixel(3, Neo_frame + f).B >= Neo_pixel(3, Neo_frame + f - 1).B;
+	BENCH_CHECK(monotonic);
+
+	//# every built in animation lights the strip within 10 s, same pixel same color
+	u32 dark = 0, impure = 0;
+	u64 worst_ns = 0;
+	const char *worst = "";
+	static const char *names[] = {
+		"flashing", "chase", "solo_chase", "fade", "solo_fade", "random_fade",
+		"rainbow_wave", "rainbow_fast", "fire", "ice", "starry",
+	};
+
+	for (u8 cmd = 0; cmd < NEO_ANIMATION_COUNT; cmd++) {
+		Neo_play(&NEO_ANIMATIONS[cmd], 0);
+		u32 lit = 0;
+		for (u32 f = 0; f < 10 * FRAMES_PER_S && !lit; f += 7) {
+			Neo_render(Neo_frame + f);
+			for (int i = 0; i < DMALEDS; i++) lit |= WS2812_BUF[i].packed & 0xFFFFFF;
+			impure += Neo_pixel(5, Neo_frame + f).packed != WS2812_BUF[5].packed;
+		}
+		dark += !lit;
+
+		u32 f = Neo_frame + 123;
+		u64 ns = BENCH_NS(50, Neo_render(f++));
+		if (ns > worst_ns) {
+			worst_ns = ns;
+			worst = names[cmd];
+		}
+	}
+	BENCH_CHECK(dark == 0 && impure == 0);
+
+	//# through Neo_task with a crossfade between two of them
+	Neo_loadCommand(NEO_FIRE);
+	Neo_loadCommand(NEO_STARRY);
+	u32 frame0 = Neo_frame;
+	for (int i = 0; i < 100; i++) {
+		Neo_task(millis());
+		host_run_ms(1);
+	}
+	BENCH_CHECK(Neo_frame > frame0);
+
+	BENCH_REPORT("animations", NEO_ANIMATION_COUNT, "");
+	BENCH_REPORT("layer_bytes", sizeof(Neo_Layer_t), "bytes (host pointers)");
+	BENCH_REPORT("key_bytes", sizeof(Neo_Key_t), "bytes");
+	BENCH_REPORT("engine_ram", sizeof(Neo_engine) + sizeof(Neo_frame), "bytes (host pointers)");
+	BENCH_REPORT_F("worst_per_pixel", (double)worst_ns / DMALEDS, "ns");
+	printf("%-28s %12s\n", "worst_animation:", worst);
+
+	return bench_result();
+}
@@ -0,0 +1,196 @@
+// Wear-leveled nvs (fun_examples/flash_test/nvs.c) on the simulated flash.
+// Compares 1000 NVS_Save() calls against the old erase-and-rewrite page,
+// checks values across reboots, and cuts the power after every single
+// flash operation of a put that triggers garbage collection: after the
+// reboot each key must hold its old or its new value, never anything else.
+
+#include "../../fun_modules/fun_base.h"
+#include "../../fun_examples/flash_test/ch32v003_flash.h"
+#include "../../fun_examples/flash_test/nvs.h"
+
+#include "bench.h"
+
+#define SAVES		1000
+#define RING_PAGE0	(16128 / HOST_FLASH_PAGE)
+
+typedef struct {
+	u32 value1;
+	u32 value2;
+	u16 signature;
+} MyStruct_t;
+
+static void reboot() {
+	SystemInit();
+	NVS_Init();
+}
+
+static void wipe() {
+	flash_unlock();
+	for (int p = 0; p < NVS_PAGES; p++) flash_erase_page(flash_calculate_runtime_address(p * NVS_PAGE_SIZE));
+	flash_lock();
+	reboot();
+}
+
+static u32 max_page_erases() {
+	u32 max = 0;
+	for (int p = 0; p < NVS_PAGES; p++)
+		if (host_stats.flash_page_erases[RING_PAGE0 + p] > max) max = host_stats.flash_page_erases[RING_PAGE0 + p];
+	return max;
+}
+
+//# RAM model of what the store should hold
+static u8 model[NVS_MAX_KEYS][NVS_MAX_VALUE];
+static u8 model_len[NVS_MAX_KEYS];
+static u8 model_set[NVS_MAX_KEYS];
+
+static void fill(u8 *buf, u8 key, u32 gen, u8 len) {
+	for (int i = 0; i < len; i++) buf[i] = key * 31 + gen * 7 + i;
+}
+
+static void put(u8 key, u32 gen, u8 len) {
+	fill(model[key], key, gen, len);
+	model_len[key] = len;
+	model_set[key] = 1;
+	BENCH_CHECK(NVS_Put(key, model[key], len) == NVS_OK);
+}
+
+static int holds(u8 key, const u8 *value, u8 len) {
+	u8 buf[NVS_MAX_VALUE];
+	size_t got = 0;
+	if (NVS_Get(key, buf, 0, sizeof(buf), &got) != NVS_OK) return 0;
+	return got == len && memcmp(buf, value, len) == 0;
+}
+
+static int model_matches() {
+	for (int k = 0; k < NVS_MAX_KEYS; k++) {
+		if (model_set[k] && !holds(k, model[k], model_len[k])) return 0;
+		if (!model_set[k] && NVS_Get(k, NULL, 0, 0, NULL) != NVS_ERR_NOT_FOUND) return 0;
+	}
+	return 1;
+}
+
+// keys 2 and 3 written once, so they are still live in the oldest page
+// when key 1 updates wrap the ring onto it
+static void prefix() {
+	memset(model_set, 0, sizeof(model_set));
+	put(2, 0, 3);
+	put(3, 0, 16);
+	put(1, 0, 10);
+}
+
+int main() {
+	SystemInit();
+	wipe();
+
+	//# basic put/get/delete, unchanged values cost no flash
+	u8 out[8];
+	size_t len;
+	BENCH_CHECK(NVS_Put(5, "hello", 5) == NVS_OK);
+	BENCH_CHECK(NVS_Get(5, out, 0, sizeof(out), &len) == NVS_OK && len == 5 && !memcmp(out, "hello", 5));
+	BENCH_CHECK(NVS_Get(5, out, 3, sizeof(out), &len) == NVS_OK && !memcmp(out, "lo", 2));
+	u64 programs = host_stats.flash_programs;
+	BENCH_CHECK(NVS_Put(5, "hello", 5) == NVS_OK && host_stats.flash_programs == programs);
+	BENCH_CHECK(NVS_Delete(5) == NVS_OK);
+	BENCH_CHECK(NVS_Get(5, out, 0, sizeof(out), &len) == NVS_ERR_NOT_FOUND);
+	BENCH_CHECK(NVS_Put(NVS_MAX_KEYS, "x", 1) == NVS_ERR_KEY);
+	BENCH_CHECK(NVS_Put(1, model, NVS_MAX_VALUE + 1) == NVS_ERR_SIZE);
+	BENCH_CHECK(NVS_Save((u8 *)model, NVS_PAGE_SIZE) == NVS_ERR_SIZE);
+	reboot();
+	BENCH_CHECK(NVS_Get(5, out, 0, sizeof(out), &len) == NVS_ERR_NOT_FOUND);
+
+	//# 1000 saves of the flash_test struct
+	wipe();
+	memset(&host_stats, 0, sizeof(host_stats));
+	MyStruct_t s = { .value1 = 111, .value2 = 222, .signature = 0xBEEF };
+	u64 cyc = host_cycles, worst = 0;
+	for (int i = 0; i < SAVES; i++) {
+		s.value1++;
+		u64 t = host_cycles;
+		NVS_Save((u8 *)&s, sizeof(s));
+		if (host_cycles - t > worst) worst = host_cycles - t;
+	}
+	u64 save_us = (host_cycles - cyc) / SYSTICK_ONE_MICROSECOND;
+	u32 page_erases = max_page_erases();
+	host_stats_t stats = host_stats;
+
+	MyStruct_t back = { 0 };
+	reboot();
+	BENCH_CHECK(NVS_Load((u8 *)&back, 0, sizeof(back)) == NVS_OK);
+	BENCH_CHECK(back.value1 == 111 + SAVES && back.value2 == 222 && back.signature == 0xBEEF);
+	BENCH_CHECK(page_erases * 3 < SAVES);
+	BENCH_CHECK(stats.flash_overwrites == 0);
+
+	// the old NVS_Save: one page erase and size/2 programs per save
+	BENCH_REPORT("legacy_page_erases", SAVES, "");
+	BENCH_REPORT("legacy_save_avg", HOST_FLASH_ERASE_CYCLES / SYSTICK_ONE_MICROSECOND
+		+ sizeof(s) / 2 * HOST_FLASH_PROGRAM_CYCLES / SYSTICK_ONE_MICROSECOND, "us");
+	BENCH_REPORT("ring_max_page_erases", page_erases, "");
+	BENCH_REPORT("ring_total_erases", stats.flash_erases, "");
+	BENCH_REPORT("ring_programs", stats.flash_programs, "");
+	BENCH_REPORT("ring_save_avg", save_us / SAVES, "us");
+	BENCH_REPORT("ring_save_worst", worst / SYSTICK_ONE_MICROSECOND, "us");
+
+	//# many keys across reboots
+	wipe();
+	memset(model_set, 0, sizeof(model_set));
+	for (u32 gen = 0; gen < 200; gen++) {
+		u8 key = (gen * 7) % 6;
+		if (gen % 11 == 10 && model_set[key]) {
+			model_set[key] = 0;
+			BENCH_CHECK(NVS_Delete(key) == NVS_OK);
+		} else {
+			put(key, gen, 1 + gen % 12);
+		}
+		if (gen % 17 == 0) reboot();
+	}
+	BENCH_CHECK(model_matches());
+	BENCH_CHECK(host_stats.flash_overwrites == 0);
+	reboot();
+	BENCH_CHECK(model_matches());
+
+	//# power cut after each flash operation of a put that has to collect
+	u8 next[NVS_MAX_VALUE];
+	fill(next, 1, 99, 10);
+
+	// fewest extra puts of key 1 after which the next one opens a page
+	u32 warmup = 0;
+	u64 ops = 0;
+	for (;; warmup++) {
+		wipe();
+		prefix();
+		for (u32 i = 0; i < warmup; i++) put(1, 50 + i, 10);
+
+		u64 erases = host_stats.flash_erases;
+		ops = host_stats.flash_programs + erases;
+		BENCH_CHECK(NVS_Put(1, next, 10) == NVS_OK);
+		ops = host_stats.flash_programs + host_stats.flash_erases - ops;
+		if (host_stats.flash_erases != erases) break;
+	}
+	BENCH_CHECK(ops > 10);
+
+	int survived = 0;
+	for (u64 cut = 0; cut <= ops; cut++) {
+		wipe();
+		prefix();
+		for (u32 i = 0; i < warmup; i++) put(1, 50 + i, 10);
+		host_flash_power_cut(cut);
+		NVS_Put(1, next, 10);
+		BENCH_CHECK(host_stats.flash_overwrites == 0);
+
+		reboot();
+		int is_new = holds(1, next, 10);
+		BENCH_CHECK(is_new || holds(1, model[1], 10));
+		BENCH_CHECK(holds(2, model[2], 3) && holds(3, model[3], 16));
+
+		// recovered store keeps working
+		put(4, cut, 8);
+		if (is_new) memcpy(model[1], next, 10);
+		reboot();
+		BENCH_CHECK(model_matches());
+		BENCH_CHECK(host_stats.flash_overwrites == 0);
+		survived++;
+	}
+	BENCH_REPORT("power_cut_points", survived, "");
+
+	return bench_result();
+}
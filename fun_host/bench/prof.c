@@ -0,0 +1,147 @@
+// Profiler zones (fun_utilities.h, FUN_PROFILE in CFLAGS_prof): a frame zone
+// runs a render and a flush zone plus some time of its own while SysTick
+// fires every millisecond. The frame's inclusive time must split exactly into
+// self, child and interrupt time, parents and log2 buckets must match the
+// delays, and the dump parsed back by prof_flame.h must give the same
+// numbers. Then the cost of one begin/end pair.
+
+#include "../../fun_modules/fun_base.h"
+#include "../prof_flame.h"
+
+#include <unistd.h>
+
+#include "bench.h"
+
+#define FRAMES		50
+#define RENDER_US	300
+#define FLUSH_US	1200
+#define OWN_US		100
+
+PROFILE_ZONE(frame);
+PROFILE_ZONE(render);
+PROFILE_ZONE(flush);
+PROFILE_ZONE(empty);
+
+static void run_frame(void) {
+	PROFILE_BEGIN(frame);
+	Delay_Us(OWN_US);
+
+	PROFILE_BEGIN(render);
+	Delay_Us(RENDER_US);
+	PROFILE_END(render);
+
+	PROFILE_BEGIN(flush);
+	Delay_Us(FLUSH_US);
+	PROFILE_END(flush);
+
+	PROFILE_END(frame);
+}
+
+static u32 hist_bucket(const Profile_Zone_t *z) {
+	u32 b = 0;
+	for (u32 i = 0; i < PROFILE_BUCKETS; i++) if (z->hist[i] > z->hist[b]) b = i;
+	return b;
+}
+
+// a dump zone against the live one
+static int same_zone(const Prof_Zone_t *p, const Profile_Zone_t *z) {
+	if (!p || p->count != z->count || p->total != PROFILE_CYCLES(z, total)) return 0;
+	if (p->self != PROFILE_CYCLES(z, self) || p->isr_cycles != PROFILE_CYCLES(z, isr_cycles)) return 0;
+	if (p->min != z->min || p->max != z->max) return 0;
+	if (strcmp(p->parent_name, z->parent ? z->parent->name : "-")) return 0;
+	for (u32 b = 0; b < PROFILE_BUCKETS; b++) if (p->hist[b] != z->hist[b]) return 0;
+	return 1;
+}
+
+int main() {
+	SystemInit();
+	systick_init();
+
+	u64 t0 = host_cycles;
+	u32 ms0 = systick_millis;
+	for (u32 i = 0; i < FRAMES; i++) run_frame();
+	u32 elapsed_ms = systick_millis - ms0;
+	u64 elapsed_cycles = host_cycles - t0;
+	u64 frame_self = profile_frame.self, frame_isr = profile_frame.isr_cycles;
+
+	//# the frame's time is accounted for exactly once
+	BENCH_CHECK(profile_frame.count == FRAMES);
+	BENCH_CHECK(profile_frame.total == profile_frame.self + profile_render.total +
+		profile_flush.total + profile_frame.isr_cycles);
+	BENCH_CHECK(profile_frame.total <= elapsed_cycles);
+	BENCH_CHECK(profile_render.total == profile_render.self + profile_render.isr_cycles);
+
+	//# parents: frame is a root, the others run inside it
+	BENCH_CHECK(profile_frame.parent == NULL);
+	BENCH_CHECK(profile_render.parent == &profile_frame && profile_flush.parent == &profile_frame);
+	BENCH_CHECK(profile_systick.parent == NULL);
+
+	//# buckets: 300 us is 14400 cycles, 1200 us is 57600
+	BENCH_CHECK(hist_bucket(&profile_render) == 13);
+	BENCH_CHECK(hist_bucket(&profile_flush) == 15);
+	BENCH_CHECK(profile_render.min >= RENDER_US * SYSTICK_ONE_MICROSECOND);
+	BENCH_CHECK(profile_flush.min >= FLUSH_US * SYSTICK_ONE_MICROSECOND);
+
+	//# SysTick ran once per ms and its time landed in the zones it interrupted
+	BENCH_CHECK(profile_systick.count >= elapsed_ms && profile_systick.count <= elapsed_ms + 1);
+	u64 charged = profile_frame.isr_cycles + profile_render.isr_cycles + profile_flush.isr_cycles;
+	BENCH_CHECK(charged > 0 && charged <= profile_systick.total + profile_systick.count * (HOST_IRQ_CYCLES + 64));
+
+	//# the dump parsed back by the host tool
+	char path[] = "/tmp/prof_dumpXXXXXX";
+	int fd = mkstemp(path);
+	fflush(stdout);
+	int saved = dup(1);
+	dup2(fd, 1);
+	UTIL_profile_dump(0);
+	fflush(stdout);
+	dup2(saved, 1);
+	close(saved);
+
+	static Prof_t prof;
+	FILE *f = fdopen(fd, "r");
+	rewind(f);
+	BENCH_CHECK(prof_read(&prof, f));
+	fclose(f);
+	unlink(path);
+
+	BENCH_CHECK(prof.clock == FUNCONF_SYSTEM_CORE_CLOCK && prof.count == 4);
+	BENCH_CHECK(same_zone(prof_find(&prof, "frame"), &profile_frame));
+	BENCH_CHECK(same_zone(prof_find(&prof, "render"), &profile_render));
+	BENCH_CHECK(same_zone(prof_find(&prof, "flush"), &profile_flush));
+	BENCH_CHECK(same_zone(prof_find(&prof, "systick"), &profile_systick));
+	BENCH_CHECK(prof_find(&prof, "empty") == NULL);
+
+	const Prof_Zone_t *render = prof_find(&prof, "render");
+	BENCH_CHECK(render && render->parent >= 0 && !strcmp(prof.zones[render->parent].name, "frame"));
+	u64 p50 = render ? prof_percentile(render, 0.5) : 0;
+	BENCH_CHECK(p50 >= 1 << 13 && p50 <= 1 << 14);
+
+	//# reset clears the numbers, the zones stay linked
+	UTIL_profile_reset();
+	BENCH_CHECK(profile_frame.count == 0 && profile_frame.linked && profile_frame.min == 0xFFFFFFFF);
+
+	//# counts carry into bits 32..39, a full bucket halves the whole histogram
+	static Profile_Zone_t wide = { .name = "wide" };
+	UTIL_profile_begin(&wide); Delay_Us(10); UTIL_profile_end(&wide);
+	u32 b = hist_bucket(&wide), run = wide.total;
+	wide.total = 0xFFFFFFFF;
+	wide.hist[b] = 0xFF;
+	wide.hist[b - 1] = 5;
+	UTIL_profile_begin(&wide); Delay_Us(10); UTIL_profile_end(&wide);
+	BENCH_CHECK(wide.total_hi == 1 && PROFILE_CYCLES(&wide, total) >= 0xFFFFFFFFull + run - 1);
+	BENCH_CHECK(wide.hist[b] == 0x80 && wide.hist[b - 1] == 2);
+
+	//# host cost of an empty zone, SysTick->CNT reads included
+	u64 pair_ns = BENCH_NS(50, for (u32 i = 0; i < 1000; i++) { PROFILE_BEGIN(empty); PROFILE_END(empty); });
+
+	BENCH_REPORT("frames", FRAMES, "");
+	BENCH_REPORT("frame_avg", elapsed_cycles / FRAMES, "cycles");
+	BENCH_REPORT("frame_self_avg", frame_self / FRAMES, "cycles");
+	BENCH_REPORT("frame_isr_cycles", frame_isr, "cycles");
+	BENCH_REPORT("systick_runs", elapsed_ms, "");
+	BENCH_REPORT("isr_cycles_charged", charged, "cycles");
+	BENCH_REPORT_F("zone_pair_ns", pair_ns / 1000.0, "ns");
+
+	return bench_result();
+}
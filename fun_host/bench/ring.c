@@ -0,0 +1,151 @@
+// SPSC ring (fun_utilities.h): a producer and a consumer thread hammer a
+// 64 slot ring with random chunk sizes through push/pop and the in-place
+// reserve/produce and peek/consume spans, every element must arrive once
+// and in order. Then the DMA head adapter behind uart_rx_task(): "toggle"
+// commands stream into the 64 byte RX ring, every eighth across its end.
+
+#include "../../fun_modules/fun_base.h"
+#include "../../fun_modules/fun_uart.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+#define RING_LEN	64
+#define ITEMS		2000000
+
+static u32 ring_buf[RING_LEN];
+static UTIL_Ring_t ring;
+
+static u32 xorshift(u32 *s) {
+	*s ^= *s << 13; *s ^= *s >> 17; *s ^= *s << 5;
+	return *s;
+}
+
+static void *producer(void *arg) {
+	u32 seed = 0x1234567, next = 0;
+
+	while (next < ITEMS) {
+		if (xorshift(&seed) & 1) {
+			if (UTIL_ring_push(&ring, &next)) next++;
+			else sched_yield();
+			continue;
+		}
+
+		// fill part of the free space in place, across the wrap when it is there
+		UTIL_RingSpan_t span;
+		u16 free = UTIL_ring_reserve(&ring, &span);
+		if (!free) sched_yield();
+		u16 n = free ? 1 + xorshift(&seed) % free : 0;
+		if (n > ITEMS - next) n = ITEMS - next;
+		for (u16 i = 0; i < n; i++) {
+			u32 *slot = i < span.len[0] ? (u32 *)span.ptr[0] + i : (u32 *)span.ptr[1] + (i - span.len[0]);
+			*slot = next + i;
+		}
+		UTIL_ring_produce(&ring, n);
+		next += n;
+	}
+	return NULL;
+}
+
+static u32 consumed, errors;
+
+static void *consumer(void *arg) {
+	u32 seed = 0x7654321;
+
+	while (consumed < ITEMS) {
+		if (xorshift(&seed) & 1) {
+			u32 v;
+			if (UTIL_ring_pop(&ring, &v)) errors += v != consumed++;
+			else sched_yield();
+			continue;
+		}
+
+		UTIL_RingSpan_t span;
+		u16 count = UTIL_ring_peek(&ring, &span);
+		if (!count) sched_yield();
+		u16 n = count ? 1 + xorshift(&seed) % count : 0;
+		for (u16 i = 0; i < n; i++) {
+			u32 v = i < span.len[0] ? ((u32 *)span.ptr[0])[i] : ((u32 *)span.ptr[1])[i - span.len[0]];
+			errors += v != consumed + i;
+		}
+		UTIL_ring_consume(&ring, n);
+		consumed += n;
+	}
+	return NULL;
+}
+
+//# PC7 toggles from the UART command handler
+static u32 toggles;
+static void gpio_trace(int port, uint32_t old_outdr, uint32_t new_outdr, uint64_t cycle) {
+	if (port == 2 && ((old_outdr ^ new_outdr) & (1 << 7))) toggles++;
+}
+
+int main() {
+	//# threads
+	UTIL_ring_init(&ring, ring_buf, RING_LEN, sizeof(u32));
+	pthread_t p, c;
+	u64 t0 = host_now_ns();
+	pthread_create(&p, NULL, producer, NULL);
+	pthread_create(&c, NULL, consumer, NULL);
+	pthread_join(p, NULL);
+	pthread_join(c, NULL);
+	u64 ns = host_now_ns() - t0;
+
+	BENCH_CHECK(consumed == ITEMS);
+	BENCH_CHECK(errors == 0);
+	BENCH_CHECK(UTIL_ring_count(&ring) == 0);
+
+	//# u16 counters wrap many times over, count stays exact
+	UTIL_ring_init(&ring, ring_buf, RING_LEN, sizeof(u32));
+	ring.head = ring.tail = 0xFFF0;
+	for (u32 i = 0; i < RING_LEN; i++) BENCH_CHECK(UTIL_ring_push(&ring, &i));
+	BENCH_CHECK(!UTIL_ring_push(&ring, &consumed) && UTIL_ring_space(&ring) == 0);
+	BENCH_CHECK(UTIL_ring_count(&ring) == RING_LEN);
+	u32 v;
+	for (u32 i = 0; i < RING_LEN; i++) BENCH_CHECK(UTIL_ring_pop(&ring, &v) && v == i);
+	BENCH_CHECK(!UTIL_ring_pop(&ring, &v));
+
+	//# DMA head adapter: UART RX
+	SystemInit();
+	systick_init();
+	funGpioInitAll();
+	funPinMode(PC7, GPIO_Speed_10MHz | GPIO_CNF_OUT_PP);
+	host_gpio_trace = gpio_trace;
+	uart_setup();
+	uart_rx_setup();
+
+	// the handler prints a line per command
+	fflush(stdout);
+	int out = dup(1);
+	freopen("/dev/null", "w", stdout);
+
+	// one stray byte first: the 8 byte commands then straddle the ring end
+	host_uart_inject((const u8 *)"\n", 1);
+	const u32 lines = 200;
+	u32 seed = 42;
+	for (u32 i = 0; i < lines; i++) {
+		host_uart_inject((const u8 *)"toggle\r\n", 8);
+		// polled anywhere from every byte to once per 14 bytes (1.2 ms)
+		for (u32 waited = 0; waited < 700; ) {
+			u32 us = 10 + xorshift(&seed) % 1200;
+			host_run_us(us);
+			waited += us;
+			uart_rx_task();
+		}
+	}
+	host_run_ms(2);
+	uart_rx_task();
+
+	fflush(stdout);
+	dup2(out, 1);
+	BENCH_CHECK(toggles == lines);
+
+	BENCH_REPORT("thread_items", ITEMS, "");
+	BENCH_REPORT_F("thread_ns_per_item", (double)ns / ITEMS, "ns");
+	BENCH_REPORT("uart_commands", toggles, "");
+
+	return bench_result();
+}
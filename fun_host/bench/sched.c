@@ -0,0 +1,105 @@
+// Deadline scheduler: a main loop of fun_sched_idle() with the usual module
+// periods (Neo refresh, button debounce, joystick, a 1 s sensor poll) plus a
+// self re-arming one-shot. Checks run counts and start latency against the
+// SysTick tick and reports how often the core woke up.
+
+#include "../../fun_modules/fun_base.h"
+
+#include "bench.h"
+
+#define RUN_MS			2000
+
+static u32 runs[4];
+static u32 last_ms[4];
+static u32 worst_gap[4];
+
+static void onTick(u32 time, void *arg) {
+	int id = (int)(intptr_t)arg;
+	if (runs[id] && time - last_ms[id] > worst_gap[id]) worst_gap[id] = time - last_ms[id];
+	last_ms[id] = time;
+	runs[id]++;
+}
+
+// a slow sensor read: holds the CPU for 3.3 ms, so the 5 ms button task
+// due behind it starts late
+static void onSensor(u32 time, void *arg) {
+	onTick(time, arg);
+	Delay_Us(3300);
+}
+
+// one-shot that re-arms itself 50, 100, 150 ... ms out and stops after 5 runs
+static u32 oneshot_times[8];
+static u32 oneshot_runs;
+static Sched_Task_t oneshot;
+
+static void onOneshot(u32 time, void *arg) {
+	oneshot_times[oneshot_runs++] = time;
+	if (oneshot_runs < 5) fun_sched_wakeIn(&oneshot, 50 * (oneshot_runs + 1));
+	else fun_sched_remove(&oneshot);
+}
+
+static Sched_Task_t tasks[4] = {
+	{ .handler = onTick, .arg = (void *)0, .period_ms = 12 },		// Neo refresh
+	{ .handler = onTick, .arg = (void *)1, .period_ms = 5 },		// button
+	{ .handler = onTick, .arg = (void *)2, .period_ms = 100 },		// joystick
+	{ .handler = onSensor, .arg = (void *)3, .period_ms = 1000 },	// sensor
+};
+
+int main() {
+	SystemInit();
+	systick_init();
+
+	for (int i = 0; i < 3; i++) fun_sched_add(&tasks[i], 0);
+	fun_sched_add(&tasks[3], 7);
+	oneshot.handler = onOneshot;
+	fun_sched_add(&oneshot, 50);
+
+	u32 start = millis();
+	u32 wakeups = 0;
+	while (millis() - start < RUN_MS) {
+		fun_sched_idle();
+		wakeups++;
+	}
+
+	//# every task ran at its period, the sensor read delays but does not drop them
+	BENCH_CHECK(runs[0] >= RUN_MS / 12 && runs[0] <= RUN_MS / 12 + 1);
+	BENCH_CHECK(runs[1] >= RUN_MS / 5 - 1 && runs[1] <= RUN_MS / 5 + 1);
+	BENCH_CHECK(runs[2] == RUN_MS / 100 || runs[2] == RUN_MS / 100 + 1);
+	BENCH_CHECK(runs[3] == RUN_MS / 1000 || runs[3] == RUN_MS / 1000 + 1);
+	for (int i = 0; i < 4; i++) BENCH_CHECK(tasks[i].info.count == runs[i]);
+	BENCH_CHECK(worst_gap[0] <= 12 + 4);
+
+	//# one-shot: 50, +100, +150, +200, +250 ms, then off the queue
+	BENCH_CHECK(oneshot_runs == 5);
+	BENCH_CHECK(!oneshot.queued);
+	for (int i = 1; i < 5; i++) {
+		u32 gap = oneshot_times[i] - oneshot_times[i - 1];
+		BENCH_CHECK(gap >= 50 * (i + 1) && gap <= 50 * (i + 1) + 1);
+	}
+
+	//# latency: within a SysTick tick, except behind the sensor read
+	BENCH_CHECK(tasks[1].info.time_max > 0 && tasks[1].info.time_max <= 1000 + 3300);
+	BENCH_CHECK(tasks[3].info.time_max <= 1000);
+
+	//# a period past SCHED_MAX_PERIOD_MS re-arms clamped, not wrapped into the past
+	for (int i = 0; i < 4; i++) fun_sched_remove(&tasks[i]);
+	static Sched_Task_t forever = { .handler = onTick, .arg = (void *)0, .period_ms = 0xFFFFFFFF };
+	u32 neo_runs = runs[0];
+	fun_sched_add(&forever, 0);
+	for (int i = 0; i < 3; i++) fun_sched_run();
+	BENCH_CHECK(runs[0] == neo_runs + 1);
+	BENCH_CHECK(forever.queued && _sched_until(&forever, SysTick->CNT) > 0);
+
+	u32 handler_calls = oneshot_runs;
+	for (int i = 0; i < 4; i++) handler_calls += runs[i];
+
+	BENCH_REPORT("handler_calls", handler_calls, "");
+	BENCH_REPORT("idle_returns", wakeups, "");
+	BENCH_REPORT("systick_wakeups", host_stats.irq[SysTicK_IRQn].count, "");
+	BENCH_REPORT("neo_latency_max", tasks[0].info.time_max, "us");
+	BENCH_REPORT("button_latency_max", tasks[1].info.time_max, "us");
+	BENCH_REPORT("sensor_latency_max", tasks[3].info.time_max, "us");
+	BENCH_REPORT("neo_worst_gap", worst_gap[0], "ms");
+
+	return bench_result();
+}
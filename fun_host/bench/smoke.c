@@ -0,0 +1,127 @@
+// Sanity run of the simulated peripherals with unmodified modules:
+// SysTick millis, WS2812 over SPI1 + DMA1_Channel3, SSD1306 over lib_i2c,
+// USART1 DMA TX/RX and flash erase/program.
+
+#include "../../fun_modules/fun_base.h"
+
+#define DMALEDS 16
+#include "../../fun_modules/util_sine.h"
+#include "../../fun_modules/util_rand32.h"
+#include "../../fun_modules/fun_spi/fun_ws2812_spi.h"
+
+#include "../../fun_modules/fun_i2c/lib/lib_i2c.h"
+#include "../../fun_modules/fun_i2c/fun_ssd1306.h"
+
+#include "../../fun_modules/fun_uart.h"
+#include "../../fun_examples/flash_test/ch32v003_flash.h"
+
+#include "bench.h"
+
+i2c_device_t dev_ssd1306 = {
+	.clkr = I2C_CLK_400KHZ,
+	.type = I2C_ADDR_7BIT,
+	.addr = 0x3C,
+	.regb = 1,
+};
+
+u8 SSD1306_CMD(u8 cmd) {
+	u8 pkt[2] = { 0, cmd };
+	return i2c_write_raw(&dev_ssd1306, pkt, 2);
+}
+
+u8 SSD1306_DATA(const u8 *data, int sz) {
+	u8 pkt[33];
+	pkt[0] = 0x40;
+	memcpy(&pkt[1], data, sz);
+	return i2c_write_raw(&dev_ssd1306, pkt, sz + 1);
+}
+
+static u32 ws_frames;
+static void ws_sink(u16 frame) { ws_frames++; }
+
+static char uart_out[64];
+static u32 uart_len;
+static void uart_sink(u8 c) { if (uart_len < sizeof(uart_out) - 1) uart_out[uart_len++] = c; }
+
+int main() {
+	SystemInit();
+	systick_init();
+
+	//# SysTick
+	host_run_ms(100);
+	BENCH_CHECK(millis() == 100);
+	BENCH_CHECK(micros() / 1000 == 100);
+
+	//# WS2812 over SPI DMA
+	host_spi_sink = ws_sink;
+	SPI_init(-1, -1);
+	SPI_DMA_WS2812_init(DMALEDS, DMA1_Channel3);
+	Neo_loadCommand(1);
+
+	ws_frames = 0;
+	u64 cyc = host_cycles;
+	SPI_DMA_WS2812_tick();
+	while (WS2812_strip.in_use || DMA1_Channel3->CNTR || (SPI1->STATR & SPI_STATR_BSY)) host_wfi();
+	u64 ws_cycles = host_cycles - cyc;
+
+	// 24 bits per LED, 4 SPI bits per LED bit, 16 bit frames: 6 frames per LED
+	BENCH_CHECK(ws_frames % 6 == 0);
+	BENCH_CHECK(ws_frames >= (WS2812B_RESET_PERIOD + DMALEDS) * 6);
+	BENCH_CHECK(!(DMA1_Channel3->CFGR & DMA_CFGR1_CIRC));
+	BENCH_REPORT("ws2812_frames", ws_frames, "spi frames");
+	BENCH_REPORT("ws2812_refresh", ws_cycles / SYSTICK_ONE_MICROSECOND, "us");
+	BENCH_REPORT("ws2812_irqs", host_stats.irq[DMA1_Channel3_IRQn].count, "");
+
+	//# SSD1306 over I2C
+	BENCH_CHECK(i2c_init(&dev_ssd1306) == I2C_OK);
+	BENCH_CHECK(i2c_ping(0x3C) == I2C_OK);
+	ssd1306_init();
+
+	u64 bytes = host_stats.i2c_bytes;
+	cyc = host_cycles;
+	ssd1306_draw_all();
+	bytes = host_stats.i2c_bytes - bytes;
+	u64 oled_cycles = host_cycles - cyc;
+
+	// 1024 data bytes + per chunk framing
+	BENCH_CHECK(bytes > 1024);
+	BENCH_REPORT("ssd1306_full_bytes", bytes, "bytes");
+	BENCH_REPORT("ssd1306_full_flush", oled_cycles / SYSTICK_ONE_MICROSECOND, "us");
+
+	//# USART1 DMA TX + circular DMA RX
+	host_uart_sink = uart_sink;
+	uart_setup();
+	dma_uart_setup();
+	uart_rx_setup();
+
+	cyc = host_cycles;
+	dma_uart_tx("hello\r\n", 7);
+	while (host_stats.uart_tx_bytes < 7) host_wfi();
+	BENCH_CHECK(strcmp(uart_out, "hello\r\n") == 0);
+	BENCH_CHECK(host_stats.irq[DMA1_Channel4_IRQn].count == 1);
+	BENCH_REPORT("uart_7_bytes", (host_cycles - cyc) / SYSTICK_ONE_MICROSECOND, "us");
+
+	funPinMode(PC7, GPIO_Speed_10MHz | GPIO_CNF_OUT_PP);
+	host_uart_inject((const u8 *)"toggle\r\n", 8);
+	host_run_ms(2);
+	uart_rx_task();
+	BENCH_CHECK(funDigitalRead(PC7) == 1);
+
+	//# Flash
+	u32 addr = flash_calculate_runtime_address(0);
+	flash_unlock();
+	flash_erase_page(addr);
+	flash_program_16(addr, 0x1234);
+	flash_lock();
+	flash_program_16(addr + 2, 0x5678);		// locked, ignored
+	*(volatile u16 *)(uintptr_t)(addr + 4) = 0xBEEF;
+	FLASH->STATR;							// stray write is reverted on the next flash access
+
+	BENCH_CHECK(flash_read_16_bits(addr) == 0x1234);
+	BENCH_CHECK(flash_read_16_bits(addr + 2) == HOST_FLASH_ERASED);
+	BENCH_CHECK(flash_read_16_bits(addr + 4) == HOST_FLASH_ERASED);
+	BENCH_CHECK(host_stats.flash_erases == 1 && host_stats.flash_programs == 1);
+	BENCH_CHECK(host_stats.flash_stray_writes == 1);
+
+	return bench_result();
+}
@@ -0,0 +1,199 @@
+// SSD1306 bitmaps: render_bitmap() writes page laid out bitmaps into
+// SSD1306_BUF a byte at a time, split across two pages when y is not a
+// multiple of 8. It must match a per pixel reference for random bitmaps on
+// and off every edge, for each raster op, with and without a sprite mask
+// and packed as RLE, and only touch bytes inside the dirty spans. The 16x16
+// icon timings show what the shift and the RLE reader cost over an aligned
+// copy.
+
+#include "../../fun_modules/fun_base.h"
+#include "../../fun_modules/fun_i2c/fun_ssd1306.h"
+#include "../../fun_modules/util_rand32.h"
+
+#include "bench.h"
+
+u8 SSD1306_CMD(u8 cmd) { return 0; }
+u8 SSD1306_DATA(const u8 *data, int sz) { return 0; }
+
+#define MAX_W		40
+#define MAX_H		40
+#define MAX_BYTES	(MAX_W * ((MAX_H + 7) / 8))
+
+//# per pixel reference
+static u8 bit_at(const u8 *bytes, u8 w, u8 i, u8 j) {
+	return bytes[(j >> 3) * w + i] >> (j & 7) & 1;
+}
+
+static void ref_bitmap(s16 x, s16 y, const u8 *data, const u8 *mask, u8 w, u8 h, u8 rop) {
+	for (u8 j = 0; j < h; j++) {
+		for (u8 i = 0; i < w; i++) {
+			s16 px = x + i, py = y + j;
+			if (px < 0 || py < 0 || px >= SSD1306_W || py >= SSD1306_H) continue;
+			if (mask && !bit_at(mask, w, i, j)) continue;
+
+			u8 on = bit_at(data, w, i, j);
+			u8 *dest = &SSD1306_BYTE(px, py), bit = SSD1306_BITMASK(py);
+			switch (rop) {
+				case SSD1306_ROP_OR:	if (on) *dest |= bit; break;
+				case SSD1306_ROP_AND:	if (!on) *dest &= ~bit; break;
+				case SSD1306_ROP_XOR:	if (on) *dest ^= bit; break;
+				default:				*dest = on ? *dest | bit : *dest & ~bit; break;
+			}
+		}
+	}
+}
+
+//# RLE packer, the format render_bitmap reads
+static u32 rle_pack(const u8 *src, u32 n, u8 *out) {
+	u32 o = 0, i = 0;
+	while (i < n) {
+		u32 run = 1;
+		while (i + run < n && run < 128 && src[i + run] == src[i]) run++;
+		if (run >= 3) {
+			out[o++] = 0x80 | (run - 1);
+			out[o++] = src[i];
+			i += run;
+			continue;
+		}
+
+		// literals up to the next run of 3
+		u32 lit = 0;
+		while (i + lit < n && lit < 128) {
+			if (i + lit + 2 < n && src[i + lit] == src[i + lit + 1] && src[i + lit] == src[i + lit + 2]) break;
+			lit++;
+		}
+		out[o++] = lit - 1;
+		memcpy(&out[o], &src[i], lit);
+		o += lit, i += lit;
+	}
+	return o;
+}
+
+static u8 ref[sizeof(SSD1306_BUF)], before[sizeof(SSD1306_BUF)];
+
+static void clear(void) {
+	for (u32 i = 0; i < sizeof(SSD1306_BUF); i++) SSD1306_BUF[i] = i * 37 ^ 0xA5;
+	for (u8 page = 0; page < SSD1306_PAGES; page++) _dirty_clear(page);
+}
+
+static void keep(void) {
+	memcpy(ref, SSD1306_BUF, sizeof(ref));
+	clear();
+}
+
+static int same(void) {
+	return !memcmp(ref, SSD1306_BUF, sizeof(ref));
+}
+
+// every changed byte inside its page's dirty span
+static u32 undirty(void) {
+	u32 n = 0;
+	for (u8 page = 0; page < SSD1306_PAGES; page++) {
+		for (u8 x = 0; x < SSD1306_W; x++) {
+			u32 i = page * SSD1306_W + x;
+			n += SSD1306_BUF[i] != before[i] && (x < SSD1306_DIRTY[page].x0 || x > SSD1306_DIRTY[page].x1);
+		}
+	}
+	return n;
+}
+
+//# a 16x16 icon: a ring with a dot, mostly empty like most icons
+static u8 icon[32], icon_mask[32], icon_rle[64];
+static u8 battery[48], battery_rle[96];
+
+static void make_icon(void) {
+	for (u8 j = 0; j < 16; j++) {
+		for (u8 i = 0; i < 16; i++) {
+			s16 dx = i * 2 - 15, dy = j * 2 - 15, d = dx * dx + dy * dy;
+			if ((d > 120 && d < 200) || d < 20) icon[(j >> 3) * 16 + i] |= 1 << (j & 7);
+			if (d < 200) icon_mask[(j >> 3) * 16 + i] |= 1 << (j & 7);
+		}
+	}
+}
+
+//# a 24x16 battery, two thirds full: long runs for the packer
+static void make_battery(void) {
+	for (u8 j = 0; j < 16; j++) {
+		for (u8 i = 0; i < 24; i++) {
+			u8 edge = i == 0 || i == 21 || j == 0 || j == 15;
+			u8 tip = i > 21 && j > 4 && j < 11;
+			u8 charge = i > 2 && i < 14 && j > 2 && j < 13;
+			if ((edge && i < 22) || tip || charge) battery[(j >> 3) * 24 + i] |= 1 << (j & 7);
+		}
+	}
+}
+
+int main() {
+	static u8 data[MAX_BYTES], mask[MAX_BYTES], packed[MAX_BYTES * 2];
+
+	//# same bytes as the reference, dirty around every change
+	u32 raw_bad = 0, rle_bad = 0, dirty_bad = 0, cases = 0;
+	for (int r = 0; r < 20000; r++) {
+		u8 w = 1 + rand_make_u32() % MAX_W, h = 1 + rand_make_u32() % MAX_H;
+		u32 n = w * ((h + 7) >> 3);
+		for (u32 i = 0; i < n; i++) {
+			// some runs for the packer
+			data[i] = r & 2 && rand_make_u32() & 1 ? 0x00 : rand_make_u32();
+			mask[i] = rand_make_u32() | rand_make_u32();
+		}
+		s16 x = (s16)(rand_make_u32() % (SSD1306_W + 2 * MAX_W)) - MAX_W;
+		s16 y = (s16)(rand_make_u32() % (SSD1306_H + 2 * MAX_H)) - MAX_H;
+		u8 rop = r % 4, masked = r >> 2 & 1;
+
+		SSD1306_Bitmap_t bmp = { data, masked ? mask : NULL, w, h };
+		clear(); ref_bitmap(x, y, data, bmp.mask, w, h, rop); keep();
+		memcpy(before, SSD1306_BUF, sizeof(before));
+		render_bitmap(x, y, &bmp, rop);
+		raw_bad += !same();
+		dirty_bad += undirty();
+
+		rle_pack(data, n, packed);
+		SSD1306_Bitmap_t rle = { packed, bmp.mask, w, h, 1 };
+		clear(); render_bitmap(x, y, &rle, rop);
+		rle_bad += !same();
+		cases++;
+	}
+	BENCH_CHECK(raw_bad == 0 && rle_bad == 0 && dirty_bad == 0);
+
+	//# the icon, masked on a lit screen: a clear disc with the ring and dot
+	make_icon();
+	u32 icon_rle_bytes = rle_pack(icon, sizeof(icon), icon_rle);
+	SSD1306_Bitmap_t sprite = { icon, icon_mask, 16, 16 };
+	SSD1306_Bitmap_t sprite_rle = { icon_rle, icon_mask, 16, 16, 1 };
+	memset(SSD1306_BUF, 0xFF, sizeof(SSD1306_BUF));
+	render_bitmap(40, 20, &sprite, SSD1306_ROP_COPY);
+	BENCH_CHECK(!(SSD1306_BYTE(40 + 3, 20 + 7) & SSD1306_BITMASK(20 + 7)));	// between ring and dot
+	BENCH_CHECK(SSD1306_BYTE(40 + 7, 20 + 7) & SSD1306_BITMASK(20 + 7));		// the dot
+	BENCH_CHECK(SSD1306_BYTE(40, 20) & SSD1306_BITMASK(20));					// outside the mask
+
+	make_battery();
+	u32 battery_rle_bytes = rle_pack(battery, sizeof(battery), battery_rle);
+	SSD1306_Bitmap_t bat = { battery, NULL, 24, 16 }, bat_rle = { battery_rle, NULL, 24, 16, 1 };
+	clear(); render_bitmap(100, 45, &bat, SSD1306_ROP_COPY); keep(); render_bitmap(100, 45, &bat_rle, SSD1306_ROP_COPY);
+	BENCH_CHECK(same() && battery_rle_bytes * 2 < sizeof(battery));
+
+	//# host ns per 16x16 icon
+	volatile s16 iy = 16;
+	u64 ns_ref = BENCH_NS(2000, ref_bitmap(40, iy, icon, icon_mask, 16, 16, SSD1306_ROP_COPY));
+	u64 ns_aligned = BENCH_NS(2000, render_bitmap(40, iy, &sprite, SSD1306_ROP_COPY));
+	iy = 19;
+	u64 ns_shifted = BENCH_NS(2000, render_bitmap(40, iy, &sprite, SSD1306_ROP_COPY));
+	u64 ns_rle = BENCH_NS(2000, render_bitmap(40, iy, &sprite_rle, SSD1306_ROP_COPY));
+	u64 ns_battery_rle = BENCH_NS(2000, render_bitmap(100, iy, &bat_rle, SSD1306_ROP_COPY));
+	u64 ns_xor = BENCH_NS(2000, render_bitmap(40, iy, &(SSD1306_Bitmap_t){ icon, NULL, 16, 16 }, SSD1306_ROP_XOR));
+
+	BENCH_REPORT("cases", cases, "");
+	BENCH_REPORT("icon_bytes", sizeof(icon), "bytes");
+	BENCH_REPORT("icon_rle_bytes", icon_rle_bytes, "bytes");
+	BENCH_REPORT("battery_bytes", sizeof(battery), "bytes");
+	BENCH_REPORT("battery_rle_bytes", battery_rle_bytes, "bytes");
+	BENCH_REPORT_F("icon_per_pixel", (double)ns_ref, "ns");
+	BENCH_REPORT_F("icon_aligned", (double)ns_aligned, "ns");
+	BENCH_REPORT_F("icon_shifted", (double)ns_shifted, "ns");
+	BENCH_REPORT_F("icon_shifted_rle", (double)ns_rle, "ns");
+	BENCH_REPORT_F("battery_shifted_rle", (double)ns_battery_rle, "ns");
+	BENCH_REPORT_F("icon_xor_unmasked", (double)ns_xor, "ns");
+	BENCH_REPORT_F("speedup", (double)ns_ref / ns_shifted, "x");
+
+	return bench_result();
+}
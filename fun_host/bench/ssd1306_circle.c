@@ -0,0 +1,325 @@
+// SSD1306 circles, rings and pies, all drawn by one span pass in
+// _render_conic(). Circles, outlines and rings must match the Bresenham
+// versions they replaced wherever those stayed on screen, and a signed per
+// pixel reference where they run off an edge or past the screen height.
+// Pies are filled sectors now instead of a fan of lines out to 0.91 of the
+// radius: the fan must lie inside the sector give or take two pixels at the
+// rays, and the sector inside the circle. Timed on the render test scene
+// and on a radius 30 ring and pie.
+
+#include "../../fun_modules/fun_base.h"
+#include "../../fun_modules/fun_i2c/fun_ssd1306.h"
+
+#include "bench.h"
+
+u8 SSD1306_CMD(u8 cmd) { return 0; }
+u8 SSD1306_DATA(const u8 *data, int sz) { return 0; }
+
+//# the versions before the span pass, as they were
+static void old_circle(u8 point[2], u8 radius, u8 fill) {
+	u8 px = point[0], py = point[1];
+	if (px >= SSD1306_W || py >= SSD1306_H) return;
+
+	s16 x = -radius;
+	s16 y = 0;
+	s16 err = 2 - 2 * radius;
+	s16 e2;
+
+	do {
+		u8 x_start 	= px + x;
+		u8 x_end   	= px - x;
+		u8 y_top   	= py - y;
+		u8 y_bottom = py + y;
+
+		if (fill) {
+			render_fastHorLine(y_top, x_start, x_end);
+			render_fastHorLine(y_bottom, x_start, x_end);
+		} else {
+			u8 xy_start 	= px + y;
+			u8 xy_end   	= px - y;
+			u8 yx_start 	= py + x;
+			u8 yx_end   	= py - x;
+
+			render_pixel(x_end		, y_bottom);
+			render_pixel(x_start	, y_bottom);
+			render_pixel(x_start	, y_top);
+			render_pixel(x_end		, y_top);
+			render_pixel(xy_end		, yx_start);
+			render_pixel(xy_start	, yx_start);
+			render_pixel(xy_start	, yx_end);
+			render_pixel(xy_end		, yx_end);
+		}
+
+		e2 = err;
+		if (e2 <= y) {
+			err += ++y * 2 + 1;
+			if (-x == y && e2 <= x) e2 = 0;
+		}
+		if (e2 > x) err += ++x * 2 + 1;
+	} while (x <= 0);
+}
+
+static void old_circle_with_func(u8 point[2], u8 radius, void (*func)(u8 y, u8 x_start, u8 x_end)) {
+	u8 px = point[0], py = point[1];
+	if (px >= SSD1306_W || py >= SSD1306_H) return;
+
+	s16 x = -radius;
+	s16 y = 0;
+	s16 err = 2 - 2 * radius;
+	s16 e2;
+
+	do {
+		u8 x_start  = px + x;
+		u8 x_end    = px - x;
+		u8 y_top    = py - y;
+		u8 y_bottom = py + y;
+
+		func(y_top, x_start, x_end);
+		func(y_bottom, x_start, x_end);
+
+		e2 = err;
+		if (e2 <= y) {
+			err += ++y * 2 + 1;
+			if (-x == y && e2 <= x) e2 = 0;
+		}
+		if (e2 > x) err += ++x * 2 + 1;
+	} while (x <= 0);
+}
+
+static void old_ring(u8 point[2], u8 radius, u8 thickness) {
+	if ((point[0] >= SSD1306_W) | (point[1] >= SSD1306_H) | (radius == 0)) return;
+
+	old_circle(point, radius, 1);
+	u8 inner_radius = (thickness >= radius) ? 0 : (radius - thickness);
+
+	if (inner_radius > 0) {
+		old_circle_with_func(point, inner_radius, render_fastHorLine_erase);
+	}
+}
+
+// x and y were u8 at the call, written through u16 pointers
+static void old_circle_point(u8 center[2], u8 radius, u16 angle, u16 *x, u16 *y) {
+	u8 quadrant = angle / 90;
+	u8 reduced_angle = angle % 90;
+	u8 sin_val = SIN_LUT[reduced_angle];
+	u8 cos_val = SIN_LUT[90 - reduced_angle];
+
+	switch (quadrant) {
+		case 0: *x = center[0] + (radius * cos_val) / 255;
+				*y = center[1] - (radius * sin_val) / 255;
+				break;
+		case 1: *x = center[0] - (radius * sin_val) / 255;
+				*y = center[1] - (radius * cos_val) / 255;
+				break;
+		case 2: *x = center[0] - (radius * cos_val) / 255;
+				*y = center[1] + (radius * sin_val) / 255;
+				break;
+		case 3: *x = center[0] + (radius * sin_val) / 255;
+				*y = center[1] + (radius * cos_val) / 255;
+				break;
+	}
+}
+
+static void old_pie(u8 center[2], u8 radius, u16 start_angle, u16 end_angle) {
+	if (start_angle == end_angle) {
+		old_circle(center, radius, 1);
+		return;
+	}
+
+	u16 angle = start_angle % 360;
+	u16 target_angle = end_angle % 360;
+	if (target_angle < angle) target_angle += 360;
+
+	while (angle <= target_angle) {
+		u16 x, y;
+		old_circle_point(center, radius, angle % 360, &x, &y);
+
+		u8 p0[] = { center[0], center[1] };
+		u8 p1[] = { x, y };
+		render_line(p0, p1, 1);
+		angle++;
+	}
+}
+
+//# per pixel reference, signed coordinates
+static void ref_pixel(s16 x, s16 y, u8 on) {
+	if (x < 0 || y < 0 || x >= SSD1306_W || y >= SSD1306_H) return;
+	if (on) SSD1306_BYTE(x, y) |= SSD1306_BITMASK(y);
+	else SSD1306_BYTE(x, y) &= ~SSD1306_BITMASK(y);
+}
+
+static void ref_circle(s16 px, s16 py, s16 radius, u8 fill, u8 on) {
+	s16 x = -radius, y = 0, err = 2 - 2 * radius, e2;
+
+	do {
+		if (fill) {
+			for (s16 i = px + x; i <= px - x; i++) {
+				ref_pixel(i, py - y, on);
+				ref_pixel(i, py + y, on);
+			}
+		} else {
+			ref_pixel(px - x, py + y, on); ref_pixel(px + x, py + y, on);
+			ref_pixel(px + x, py - y, on); ref_pixel(px - x, py - y, on);
+			ref_pixel(px - y, py + x, on); ref_pixel(px + y, py + x, on);
+			ref_pixel(px + y, py - x, on); ref_pixel(px - y, py - x, on);
+		}
+
+		e2 = err;
+		if (e2 <= y) {
+			err += ++y * 2 + 1;
+			if (-x == y && e2 <= x) e2 = 0;
+		}
+		if (e2 > x) err += ++x * 2 + 1;
+	} while (x <= 0);
+}
+
+static u8 ref[sizeof(SSD1306_BUF)], fan[sizeof(SSD1306_BUF)];
+
+static void clear(void) {
+	memset(SSD1306_BUF, 0, sizeof(SSD1306_BUF));
+}
+
+static void keep(void) {
+	memcpy(ref, SSD1306_BUF, sizeof(ref));
+	clear();
+}
+
+static int same(void) {
+	return !memcmp(ref, SSD1306_BUF, sizeof(ref));
+}
+
+static u8 is_set(s16 x, s16 y) {
+	if (x < 0 || y < 0 || x >= SSD1306_W || y >= SSD1306_H) return 0;
+	return !!(SSD1306_BYTE(x, y) & SSD1306_BITMASK(y));
+}
+
+static u32 lit(const u8 *buf) {
+	u32 n = 0;
+	for (u32 i = 0; i < sizeof(SSD1306_BUF); i++) n += __builtin_popcount(buf[i]);
+	return n;
+}
+
+// the circles of ssd1306_render_test
+#define SCENE(circle, ring, pie) do { \
+	for (u8 i = 0, y = 0; i < 4; i++, y += 14) { \
+		circle((u8[]){ 110, y }, 5, i > 1); \
+		if (i > 1) ring((u8[]){ 90, y + 12 }, 7, 3); \
+	} \
+	pie((u8[]){ 60, 55 }, 12, 0, 180); \
+} while (0)
+
+int main() {
+	//# on screen: the same bytes as before
+	u32 circle_bad = 0, outline_bad = 0, ring_bad = 0, cases = 0;
+	for (u8 r = 0; r <= 31; r++) {
+		for (u8 py = r; py + r < SSD1306_H; py += 5) {
+			for (u8 px = r; px + r < SSD1306_W; px += 13) {
+				u8 c[] = { px, py };
+				clear(); old_circle(c, r, 1); keep(); render_circle(c, r, 1);
+				circle_bad += !same();
+				clear(); old_circle(c, r, 0); keep(); render_circle(c, r, 0);
+				outline_bad += !same();
+				for (u8 t = 1; t <= r + 1; t += 2) {
+					clear(); old_ring(c, r, t); keep(); render_ring(c, r, t);
+					ring_bad += !same();
+				}
+				cases++;
+			}
+		}
+	}
+	BENCH_CHECK(circle_bad == 0 && outline_bad == 0 && ring_bad == 0);
+
+	//# off the edges: the per pixel reference
+	u32 edge_bad = 0;
+	for (u8 r = 1; r <= 40; r += 3) {
+		for (u8 py = 0; py < SSD1306_H; py += 7) {
+			for (u8 px = 0; px < SSD1306_W; px += 9) {
+				u8 c[] = { px, py }, t = 1 + r / 3;
+				clear(); ref_circle(px, py, r, 1, 1); keep(); render_circle(c, r, 1);
+				edge_bad += !same();
+				clear(); ref_circle(px, py, r, 0, 1); keep(); render_circle(c, r, 0);
+				edge_bad += !same();
+				clear(); ref_circle(px, py, r, 1, 1); ref_circle(px, py, r - t, 1, 0); keep(); render_ring(c, r, t);
+				edge_bad += r > t && !same();
+			}
+		}
+	}
+	BENCH_CHECK(edge_bad == 0);
+
+	// radii past the screen height, whose rows stop at SSD1306_H_LIMIT
+	u32 big_bad = 0;
+	const u8 big[] = { 62, 63, 64, 65, 100, 180, 255 };
+	const u8 centers[][2] = { { 0, 0 }, { 64, 32 }, { 127, 63 }, { 10, 50 } };
+	for (u8 i = 0; i < sizeof(big); i++) {
+		for (u8 k = 0; k < 4; k++) {
+			u8 r = big[i], t = r / 4, c[] = { centers[k][0], centers[k][1] };
+			clear(); ref_circle(c[0], c[1], r, 1, 1); keep(); render_circle(c, r, 1);
+			big_bad += !same();
+			clear(); ref_circle(c[0], c[1], r, 0, 1); keep(); render_circle(c, r, 0);
+			big_bad += !same();
+			clear(); ref_circle(c[0], c[1], r, 1, 1); ref_circle(c[0], c[1], r - t, 1, 0); keep(); render_ring(c, r, t);
+			big_bad += !same();
+		}
+	}
+	BENCH_CHECK(big_bad == 0);
+
+	//# pies: the old fan inside the new sector, the sector inside the circle
+	u32 fan_out = 0, fan_off = 0, fan_px = 0, pie_out = 0, half_bad = 0;
+	for (u16 start = 0; start < 360; start += 15) {
+		for (u16 sweep = 10; sweep < 360; sweep += 25) {
+			u8 c[] = { 64, 32 };
+			clear(); old_pie(c, 24, start, start + sweep);
+			memcpy(fan, SSD1306_BUF, sizeof(fan));
+			clear(); render_circle(c, 24, 1); keep(); render_pie(c, 24, start, start + sweep);
+
+			for (u32 i = 0; i < sizeof(SSD1306_BUF); i++) {
+				pie_out += __builtin_popcount(SSD1306_BUF[i] & ~ref[i]);
+			}
+			fan_px += lit(fan);
+
+			// the fan's rays are off where SIN_LUT flattens out near 90 degrees
+			// and where the endpoints truncate: two pixels at most
+			for (s16 y = 0; y < SSD1306_H; y++) {
+				for (s16 x = 0; x < SSD1306_W; x++) {
+					if (!(fan[x + (y >> 3) * SSD1306_W] & SSD1306_BITMASK(y)) || is_set(x, y)) continue;
+					fan_off++;
+					u8 near = 0;
+					for (s16 dy = -2; dy <= 2; dy++) for (s16 dx = -2; dx <= 2; dx++) near |= is_set(x + dx, y + dy);
+					fan_out += !near;
+				}
+			}
+		}
+	}
+	BENCH_CHECK(pie_out == 0 && fan_out == 0);
+
+	// 0 to 180 is the top half, center row included
+	u8 c[] = { 60, 40 };
+	clear(); ref_circle(60, 40, 12, 1, 1);
+	for (u8 y = 41; y < SSD1306_H; y++) for (u8 x = 0; x < SSD1306_W; x++) ref_pixel(x, y, 0);
+	keep(); render_pie(c, 12, 0, 180);
+	half_bad += !same();
+	clear(); render_circle(c, 12, 1); keep(); render_pie(c, 12, 30, 30);
+	half_bad += !same();
+	BENCH_CHECK(half_bad == 0);
+
+	//# host ns for the test scene circles
+	u64 ns_old = BENCH_NS(2000, { clear(); SCENE(old_circle, old_ring, old_pie); });
+	u64 ns_new = BENCH_NS(2000, { clear(); SCENE(render_circle, render_ring, render_pie); });
+	u64 ns_ring_old = BENCH_NS(2000, { clear(); old_ring((u8[]){ 64, 32 }, 30, 6); });
+	u64 ns_ring_new = BENCH_NS(2000, { clear(); render_ring((u8[]){ 64, 32 }, 30, 6); });
+	u64 ns_pie_old = BENCH_NS(2000, { clear(); old_pie((u8[]){ 64, 32 }, 30, 20, 250); });
+	u64 ns_pie_new = BENCH_NS(2000, { clear(); render_pie((u8[]){ 64, 32 }, 30, 20, 250); });
+
+	BENCH_REPORT("cases", cases, "");
+	BENCH_REPORT("pie_fan_pixels", fan_px, "px");
+	BENCH_REPORT("pie_fan_outside", fan_off, "px (within 2)");
+	BENCH_REPORT_F("scene_old", (double)ns_old, "ns");
+	BENCH_REPORT_F("scene_new", (double)ns_new, "ns");
+	BENCH_REPORT_F("scene_speedup", (double)ns_old / ns_new, "x");
+	BENCH_REPORT_F("ring_r30_old", (double)ns_ring_old, "ns");
+	BENCH_REPORT_F("ring_r30_new", (double)ns_ring_new, "ns");
+	BENCH_REPORT_F("pie_r30_old", (double)ns_pie_old, "ns");
+	BENCH_REPORT_F("pie_r30_new", (double)ns_pie_new, "ns");
+
+	return bench_result();
+}
@@ -0,0 +1,307 @@
+// SSD1306 column spans: render_colSpan() fills a block a page at a time,
+// a head mask, whole bytes, then a tail mask. Thick horizontal lines,
+// vertical lines, thick render_line, filled rects and the text background
+// used to set one row of a column at a time. They must leave the same
+// bytes and dirty spans for random blocks, every thickness and shapes off
+// the edges. The 100 x 50 rect gains most, as each page becomes a memset.
+
+#include "../../fun_modules/fun_base.h"
+#include "../../fun_modules/fun_i2c/fun_ssd1306.h"
+#include "../../fun_modules/util_rand32.h"
+
+#include "bench.h"
+
+u8 SSD1306_CMD(u8 cmd) { return 0; }
+u8 SSD1306_DATA(const u8 *data, int sz) { return 0; }
+
+//# the row by row versions, as they were
+static void old_clear_text_bounds(u8 x, u8 y, SSD1306_Text_Bounds_t *bounds, u8 fill) {    
+    u8 x_count = bounds->max_x - x + 1;
+	u8 max_y = bounds->max_y;
+    
+    // Build one bitmask per page for the rows inside it
+    for (u8 page = 0; page < SSD1306_PAGES; page++) {
+        u8 output_bitmask = 0;
+        u8 page_START = page * 8;
+        u8 page_END = page_START + 7;
+        
+        // Only process pages that overlap with our Y range
+        if (max_y < page_START || y > page_END) continue;
+        
+        // Combine all bitmasks for Y coordinates in this page's range
+        u8 start_y = (y > page_START) ? y : page_START;
+        u8 end_y = (max_y < page_END) ? max_y : page_END;
+        output_bitmask = SSD1306_RUN_MASK(start_y, end_y);
+        
+        // Apply to all X coordinates in range
+        u8 *dest = &SSD1306_BUF[page * SSD1306_W + x];
+		_dirty_mark(page, x, x + x_count - 1);
+
+		if (fill) {
+            for (u8 i = 0; i < x_count; i++) dest[i] |= output_bitmask;
+        } else {
+            for (u8 i = 0; i < x_count; i++) dest[i] &= ~output_bitmask;
+        }
+    }
+}
+
+static void old_horLine(u8 y, u8 x_limits[2], u8 thickness, u8 mirror) {
+	// Validate coordinates
+	if (y > SSD1306_H_LIMIT) return;
+
+	// Clamp to display bounds
+	CLAMP_VALUES(x_limits[0], x_limits[1], SSD1306_W_LIMIT);
+	
+	// Handle mirroring
+	if (mirror) {
+		MIRROR_VALUES(x_limits, SSD1306_W_LIMIT);
+	}
+
+	// Ensure x1 <= x2 (swap if needed)
+	SORT_LIMITS(x_limits);
+
+	// Handle thickness
+	u8 y_end  = y + thickness - 1;
+	CLAMP_VALUE(y_end, SSD1306_H_LIMIT);
+	if (y_end < y) return;  // Skip if thickness is 0 or overflowed
+
+	// Draw thick line
+	u8 width = x_limits[1] - x_limits[0] + 1;
+	_dirty_mark_rect(y, y_end, x_limits[0], x_limits[1]);
+
+	for (u8 y_pos = y; y_pos <= y_end ; y_pos++) {
+		u8* row_start = &SSD1306_BYTE(x_limits[0], y_pos);
+		u8 bitmask = SSD1306_BITMASK(y_pos);
+
+        for (u8 i = 0; i < width; i++) {
+            row_start[i] |= bitmask;
+        }
+	}
+}
+
+static void old_verLine(u8 x, u8 y_limits[2], u8 thickness, u8 mirror) {
+	// Validate coordinates
+	if (x > SSD1306_W_LIMIT) return;
+
+	// Clamp to display bounds
+	CLAMP_VALUES(y_limits[0], y_limits[1], SSD1306_H_LIMIT);
+
+	// Handle mirroring
+	if (mirror) {
+		MIRROR_VALUES(y_limits, SSD1306_H_LIMIT);
+	}
+
+	// Ensure y1 <= y2 (swap if needed)
+	SORT_LIMITS(y_limits);
+
+	// Handle thickness
+	u8 x_end = x + thickness - 1;
+	CLAMP_VALUE(x_end, SSD1306_W_LIMIT);
+	if (x_end < x) return;  // Skip if thickness causes overflow
+
+	//# Optimized: save 500-700 us
+	u8 x_len = x_end - x + 1;  // Prerender length
+	_dirty_mark_rect(y_limits[0], y_limits[1], x, x_end);
+
+	// one OR per column and page: the rows of the line inside a page share a byte
+	u8 y0 = y_limits[0], y1 = y_limits[1];
+	for (u8 page = SSD1306_PAGE(y0); page <= SSD1306_PAGE(y1); page++) {
+		u8 top = page == SSD1306_PAGE(y0) ? y0 : page << 3;
+		u8 bottom = page == SSD1306_PAGE(y1) ? y1 : (page << 3) + 7;
+		u8 bits = SSD1306_RUN_MASK(top, bottom);
+		u8* row_start = SSD1306_ROW(page) + x;
+
+		for (u8 i = 0; i < x_len; i++) {
+			row_start[i] |= bits;  					// Sequential access
+		}
+	}
+}
+
+static void old_line(u8 point_a[2], u8 point_b[2], u8 thickness) {
+	u8 x0 = point_a[0], y0 = point_a[1];
+    u8 x1 = point_b[0], y1 = point_b[1];
+
+	// Clamp coordinates to display bounds
+	CLAMP_VALUES(x0, x1, SSD1306_W_LIMIT);
+	CLAMP_VALUES(y0, y1, SSD1306_H_LIMIT);
+
+	// Mark the bounding box, thickness grows it right and down
+	{
+		u8 bx0 = x0 < x1 ? x0 : x1, bx1 = (x0 < x1 ? x1 : x0) + thickness - 1;
+		u8 by0 = y0 < y1 ? y0 : y1, by1 = (y0 < y1 ? y1 : y0) + thickness - 1;
+		CLAMP_VALUE(bx1, SSD1306_W_LIMIT);
+		CLAMP_VALUE(by1, SSD1306_H_LIMIT);
+		_dirty_mark_rect(by0, by1, bx0, bx1);
+	}
+
+	// Bresenham's line algorithm
+	s16 dx = ABS(x1 - x0);
+	s16 dy = -ABS(y1 - y0);
+	s16 sx = x0 < x1 ? 1 : -1;
+	s16 sy = y0 < y1 ? 1 : -1;
+	s16 err = dx + dy;
+	s16 e2;
+
+	while (1) {
+		// Draw the pixel(s)
+		if (thickness == 1) {
+			// Fast path for single-pixel
+			if (x0 < SSD1306_W && y0 < SSD1306_H) {
+				SSD1306_BYTE(x0, y0) |= SSD1306_BITMASK(y0);
+			}
+		} else {
+			// Calculate bounds (branchless min/max)
+			u8 x_start = x0;
+			u8 x_end = x0 + thickness - 1;
+			u8 y_start = y0;
+			u8 y_end = y0 + thickness - 1;
+			
+			CLAMP_VALUE(x_end, SSD1306_W_LIMIT);
+			CLAMP_VALUE(y_end, SSD1306_H_LIMIT);
+			u8 width = x_end - x_start + 1;
+
+			// Optimized row filling
+			for (u8 y = y_start; y <= y_end; y++) {
+				u8* row = &SSD1306_BYTE(x_start, y);
+				u8 pattern = SSD1306_BITMASK(y);
+
+				// Optimized filling based on width
+				if (width <= 4) {
+					// Fully unrolled for common cases
+					if (width > 0) row[0] |= pattern;
+					if (width > 1) row[1] |= pattern;
+					if (width > 2) row[2] |= pattern;
+					if (width > 3) row[3] |= pattern;
+				} else {
+					// For larger widths, use memset-style optimization
+					for (u8 i = 0; i < width; i++) {
+						row[i] |= pattern;
+					}
+				}
+			}
+		}
+
+		// Bresenham Advance
+		if (x0 == x1 && y0 == y1) break;
+		e2 = err << 1; // e2 = 2*err via bit shift
+		if (e2 >= dy) { err += dy; x0 += sx; }
+		if (e2 <= dx) { err += dx; y0 += sy; }
+	}
+}
+
+static void old_rect(u8 p0[2], u8 area[2], u8 fill) {
+	u8 x = p0[0], y = p0[1];
+	u8 w = area[0], h = area[1];
+
+	// validate and Clamp to display bounds
+	if (x >= SSD1306_W || y >= SSD1306_H) return;
+	u8 x_end = (x + w < SSD1306_W) ? (x + w) : SSD1306_W_LIMIT;
+	u8 y_end = (y + h < SSD1306_H) ? (y + h) : SSD1306_H_LIMIT;
+
+	// Draw rectangle with optional fill
+	u8 x_limit[] = { x, x_end };
+
+	if (fill) {
+		// Filled rectangle using horizontal lines (faster for row-major displays)
+		for (u8 y_pos = y; y_pos <= y_end; y_pos++) {
+			old_horLine(y_pos, x_limit, 1, 0);
+		}
+	} else {
+		u8 y_limit[] = { y + 1, y_end - 1 };
+
+		// Outline only
+		old_horLine(y, x_limit, 1, 0);	 	// Top edge
+		old_horLine(y_end, x_limit, 1, 0);	// Bottom edge
+		old_verLine(x, y_limit, 1, 0); 		// Left edge
+		old_verLine(x_end, y_limit, 1, 0); 	// Right edge
+	}
+}
+
+static u8 ref[sizeof(SSD1306_BUF)];
+static SSD1306_Span_t ref_dirty[SSD1306_PAGES];
+
+static void clear(void) {
+	memset(SSD1306_BUF, 0x5A, sizeof(SSD1306_BUF));
+	for (u8 page = 0; page < SSD1306_PAGES; page++) _dirty_clear(page);
+}
+
+static void keep(void) {
+	memcpy(ref, SSD1306_BUF, sizeof(ref));
+	memcpy(ref_dirty, SSD1306_DIRTY, sizeof(ref_dirty));
+	clear();
+}
+
+static int same(void) {
+	return !memcmp(ref, SSD1306_BUF, sizeof(ref)) && !memcmp(ref_dirty, SSD1306_DIRTY, sizeof(ref_dirty));
+}
+
+static u8 rnd(u8 n) {
+	return rand_make_u32() % n;
+}
+
+int main() {
+	//# same bytes and dirty spans as row by row
+	u32 hor_bad = 0, ver_bad = 0, line_bad = 0, rect_bad = 0, text_bad = 0;
+
+	for (int r = 0; r < 20000; r++) {
+		u8 x = rnd(SSD1306_W + 8), y = rnd(SSD1306_H + 8), t = 1 + rnd(12);
+		u8 a[2] = { rnd(SSD1306_W + 8), rnd(SSD1306_W + 8) }, b[2] = { a[0], a[1] };
+
+		clear(); old_horLine(y, a, t, r & 1); keep(); render_horLine(y, b, t, r & 1);
+		hor_bad += !same();
+
+		a[0] = b[0] = rnd(SSD1306_H + 8), a[1] = b[1] = rnd(SSD1306_H + 8);
+		clear(); old_verLine(x, a, t, r & 1); keep(); render_verLine(x, b, t, r & 1);
+		ver_bad += !same();
+
+		u8 p0[2] = { rnd(SSD1306_W), rnd(SSD1306_H) }, p1[2] = { rnd(SSD1306_W), rnd(SSD1306_H) };
+		clear(); old_line(p0, p1, t); keep(); render_line(p0, p1, t);
+		line_bad += !same();
+
+		u8 area[2] = { rnd(SSD1306_W), rnd(SSD1306_H) };
+		clear(); old_rect(p0, area, r & 1); keep(); render_rect(p0, area, r & 1);
+		rect_bad += !same();
+
+		// text bounds as _calc_text_bounds leaves them: on screen, past x and y
+		SSD1306_Text_Bounds_t bounds = { x % SSD1306_W + rnd(20), y % SSD1306_H + rnd(20) };
+		CLAMP_VALUE(bounds.max_x, SSD1306_W_LIMIT);
+		CLAMP_VALUE(bounds.max_y, SSD1306_H_LIMIT);
+		clear(); old_clear_text_bounds(x % SSD1306_W, y % SSD1306_H, &bounds, r & 1);
+		keep(); _clear_text_bounds(x % SSD1306_W, y % SSD1306_H, &bounds, r & 1);
+		text_bad += !same();
+	}
+	BENCH_CHECK(hor_bad == 0 && ver_bad == 0 && line_bad == 0);
+	BENCH_CHECK(rect_bad == 0 && text_bad == 0);
+
+	// render_colSpan takes its corners either way round and clips
+	clear(); render_colSpan(10, 20, 3, 30, 1); keep(); render_colSpan(20, 10, 30, 3, 1);
+	BENCH_CHECK(same());
+	clear(); render_colSpan(120, 200, 60, 90, 0);
+	BENCH_CHECK(SSD1306_BYTE(127, 63) == (0x5A & 0x0F) && SSD1306_DIRTY[7].x0 == 120);
+
+	//# host ns, old against new
+	u8 top[2] = { 20, 0 }, bottom[2] = { 24, SSD1306_H_LIMIT };
+	u8 corner[2] = { 4, 4 }, area[2] = { 100, 50 };
+	u8 limits[2] = { 0, SSD1306_W_LIMIT };
+	SSD1306_Text_Bounds_t bounds = { 100, 27 };
+
+	u64 ns_line_old = BENCH_NS(2000, old_line(top, bottom, 4));
+	u64 ns_line_new = BENCH_NS(2000, render_line(top, bottom, 4));
+	u64 ns_rect_old = BENCH_NS(2000, old_rect(corner, area, 1));
+	u64 ns_rect_new = BENCH_NS(2000, render_rect(corner, area, 1));
+	u64 ns_hor_old = BENCH_NS(2000, old_horLine(5, limits, 16, 0));
+	u64 ns_hor_new = BENCH_NS(2000, render_horLine(5, limits, 16, 0));
+	u64 ns_text_old = BENCH_NS(2000, old_clear_text_bounds(3, 5, &bounds, 0));
+	u64 ns_text_new = BENCH_NS(2000, _clear_text_bounds(3, 5, &bounds, 0));
+
+	BENCH_REPORT_F("thick_line_old", (double)ns_line_old, "ns (64 rows, 4 thick)");
+	BENCH_REPORT_F("thick_line_new", (double)ns_line_new, "ns");
+	BENCH_REPORT_F("rect_fill_old", (double)ns_rect_old, "ns (100 x 50)");
+	BENCH_REPORT_F("rect_fill_new", (double)ns_rect_new, "ns");
+	BENCH_REPORT_F("hor_line_old", (double)ns_hor_old, "ns (128 x 16)");
+	BENCH_REPORT_F("hor_line_new", (double)ns_hor_new, "ns");
+	BENCH_REPORT_F("text_bounds_old", (double)ns_text_old, "ns (98 x 23)");
+	BENCH_REPORT_F("text_bounds_new", (double)ns_text_new, "ns");
+
+	return bench_result();
+}
@@ -0,0 +1,179 @@
+// SSD1306 dirty spans: bytes on the I2C wire for a full ssd1306_draw_all()
+// against ssd1306_flush_dirty() for the module test scenes and a menu tick.
+// A model of the panel RAM is fed from the wire and compared with
+// SSD1306_BUF after every flush, the blocking one and the one queued on the
+// I2C DMA, which also reports how long the CPU is held.
+
+#include "../../fun_modules/fun_base.h"
+#include "../../fun_modules/fun_i2c/lib/lib_i2c.h"
+#include "../../fun_modules/fun_i2c/fun_ssd1306.h"
+
+#include "bench.h"
+
+i2c_device_t dev_ssd1306 = {
+	.clkr = I2C_CLK_400KHZ,
+	.type = I2C_ADDR_7BIT,
+	.addr = 0x3C,
+	.regb = 1,
+};
+
+u8 SSD1306_CMD(u8 cmd) {
+	u8 pkt[2] = { 0, cmd };
+	return i2c_write_raw(&dev_ssd1306, pkt, 2);
+}
+
+u8 SSD1306_DATA(const u8 *data, int sz) {
+	u8 pkt[33];
+	pkt[0] = 0x40;
+	memcpy(&pkt[1], data, sz);
+	return i2c_write_raw(&dev_ssd1306, pkt, sz + 1);
+}
+
+Str_Config_t MENU_STR_CONFIG = {
+	.FONT = (u8 *)FONT_7x5,
+	.WIDTH = 5,
+	.HEIGHT = 7,
+	.SPACE = 1,
+	.scale_mode = 3,
+	.color = 1,
+};
+
+//# panel model: horizontal addressing inside the COLUMNADDR/PAGEADDR window
+static u8 panel[SSD1306_PAGES * SSD1306_W];
+static struct {
+	int ctrl;				// -1 waiting for the control byte
+	u8 cmd, args, arg[2];
+	u8 col0, col1, page0, page1;
+	u8 col, page;
+} lcd = { .col1 = SSD1306_W_LIMIT, .page1 = SSD1306_PAGES - 1 };
+
+static void lcd_sink(u8 addr, u8 byte, int first) {
+	if (first) { lcd.ctrl = -1; return; }
+	if (lcd.ctrl < 0) { lcd.ctrl = byte; return; }
+
+	if (lcd.ctrl == 0x40) {
+		panel[lcd.page * SSD1306_W + lcd.col] = byte;
+		if (lcd.col++ == lcd.col1) {
+			lcd.col = lcd.col0;
+			lcd.page = lcd.page == lcd.page1 ? lcd.page0 : lcd.page + 1;
+		}
+		return;
+	}
+
+	if (lcd.args) {
+		lcd.arg[2 - lcd.args--] = byte;
+		if (lcd.args) return;
+		if (lcd.cmd == SSD1306_COLUMNADDR) { lcd.col0 = lcd.arg[0]; lcd.col1 = lcd.arg[1]; lcd.col = lcd.col0; }
+		if (lcd.cmd == SSD1306_PAGEADDR) { lcd.page0 = lcd.arg[0]; lcd.page1 = lcd.arg[1]; lcd.page = lcd.page0; }
+		return;
+	}
+
+	lcd.cmd = byte;
+	if (byte == SSD1306_COLUMNADDR || byte == SSD1306_PAGEADDR) lcd.args = 2;
+}
+
+static int panel_matches() { return memcmp(panel, SSD1306_BUF, sizeof(panel)) == 0; }
+
+static int all_clean() {
+	for (int p = 0; p < SSD1306_PAGES; p++)
+		if (SSD1306_DIRTY[p].x0 <= SSD1306_DIRTY[p].x1) return 0;
+	return 1;
+}
+
+static void blank() {
+	ssd1306_render_fill(0);
+	ssd1306_draw_all();
+}
+
+// bytes on the wire for a full redraw and a dirty flush of the same frame
+static void scene(const char *name, void (*render)(void)) {
+	char key[48];
+
+	blank();
+	render();
+	u64 bytes = host_stats.i2c_bytes;
+	ssd1306_draw_all();
+	u64 full = host_stats.i2c_bytes - bytes;
+
+	blank();
+	render();
+	bytes = host_stats.i2c_bytes;
+	u64 cyc = host_cycles;
+	ssd1306_flush_dirty();
+	u64 dirty = host_stats.i2c_bytes - bytes;
+
+	BENCH_CHECK(panel_matches());
+	BENCH_CHECK(all_clean());
+	BENCH_CHECK(dirty <= full);
+
+	snprintf(key, sizeof(key), "%s_full:", name);
+	printf("%-28s %12llu bytes\n", key, (unsigned long long)full);
+	snprintf(key, sizeof(key), "%s_dirty:", name);
+	printf("%-28s %12llu bytes\n", key, (unsigned long long)dirty);
+	snprintf(key, sizeof(key), "%s_dirty_flush:", name);
+	printf("%-28s %12llu us\n", key, (unsigned long long)((host_cycles - cyc) / SYSTICK_ONE_MICROSECOND));
+}
+
+static void render_polys() { test_polys(); }
+static void render_test() { ssd1306_render_test(); }
+
+// i2c_menu_period_tick(): clear, re-render a changing value, flush
+static u16 lux = 120;
+static void render_menu_tick() {
+	char str[SSD1306_MAX_STR_LEN];
+	ssd1306_render_fill(0);
+	sprintf(str, "LUX %d", lux);
+	ssd1306_render_scaled_txt(0, 0, str, &MENU_STR_CONFIG);
+	ssd1306_render_scaled_txt(0, 12, "TEMP 72, HUM 40", &MENU_STR_CONFIG);
+}
+
+int main() {
+	SystemInit();
+	systick_init();
+	host_i2c_sink = lcd_sink;
+
+	BENCH_CHECK(i2c_init(&dev_ssd1306) == I2C_OK);
+	ssd1306_init();
+
+	scene("test_polys", render_polys);
+	scene("draw_test", render_test);
+
+	//# menu tick, steady state: the text lines go out, the rest of the panel does not
+	blank();
+	render_menu_tick();
+	ssd1306_flush_dirty();
+	lux++;
+	render_menu_tick();
+
+	u64 bytes = host_stats.i2c_bytes;
+	ssd1306_flush_dirty();
+	u64 tick = host_stats.i2c_bytes - bytes;
+
+	BENCH_CHECK(panel_matches());
+	BENCH_CHECK(tick < 1024 / 2);
+	BENCH_REPORT("menu_tick_dirty", tick, "bytes");
+
+	//# nothing rendered since the last flush, nothing sent
+	bytes = host_stats.i2c_bytes;
+	ssd1306_flush_dirty();
+	BENCH_CHECK(host_stats.i2c_bytes == bytes);
+
+	//# the same tick queued on the DMA: same bytes, the CPU back at once
+	i2c_async_init();
+	lux++;
+	render_menu_tick();
+	bytes = host_stats.i2c_bytes;
+	u64 cyc = host_cycles;
+	BENCH_CHECK(ssd1306_flush_dirty_async(&dev_ssd1306) == I2C_OK);
+	u64 submit_cycles = host_cycles - cyc;
+	BENCH_CHECK(all_clean());
+	BENCH_CHECK(ssd1306_flush_wait() == I2C_OK);
+	u64 async_tick = host_stats.i2c_bytes - bytes;
+
+	BENCH_CHECK(panel_matches());
+	BENCH_CHECK(async_tick <= tick + 2 * SSD1306_PAGES);
+	BENCH_REPORT("menu_tick_async", async_tick, "bytes");
+	BENCH_REPORT("menu_tick_async_cpu", submit_cycles / SYSTICK_ONE_MICROSECOND, "us");
+
+	return bench_result();
+}
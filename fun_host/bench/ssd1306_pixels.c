@@ -0,0 +1,191 @@
+// SSD1306 pixel addressing: render_pixel, render_fastHorLine and the thin
+// render_line path compute page and bit inline, where they read the 128
+// byte page_masks[] table ssd1306_init() filled, and render_verLine ORs one
+// byte per column and page instead of one per row. Each must leave the same
+// bytes as the table version for every pixel, row and span, and so must the
+// test_polys scene. On the host the table sits in cache, so the rates only
+// show the inline code is no slower; the gain on the CH32V003 is the RAM.
+
+#include "../../fun_modules/fun_base.h"
+#include "../../fun_modules/fun_i2c/fun_ssd1306.h"
+
+#include "bench.h"
+
+u8 SSD1306_CMD(u8 cmd) { return 0; }
+u8 SSD1306_DATA(const u8 *data, int sz) { return 0; }
+
+//# the table version, as it was
+typedef struct {
+	u8 page;
+	u8 bitmask;
+} Page_Mask_t;
+
+static Page_Mask_t page_masks[SSD1306_H];
+
+static void old_pixel(u8 x, u8 y) {
+	if (x >= SSD1306_W || y >= SSD1306_H) return;
+	Page_Mask_t mask = page_masks[y];
+	SSD1306_BUF[mask.page * SSD1306_W + x] |= mask.bitmask;
+	_dirty_mark(mask.page, x, x);
+}
+
+static void old_fastHorLine(u8 y, u8 x0, u8 x1) {
+	if (y > SSD1306_H_LIMIT) return;
+	CLAMP_VALUES(x0, x1, SSD1306_W_LIMIT);
+
+	Page_Mask_t mask = page_masks[y];
+	u8* row_start = &SSD1306_BUF[mask.page * SSD1306_W];
+	if (x0 <= x1) _dirty_mark(mask.page, x0, x1);
+
+	for (u8 x = x0; x <= x1; x++) {
+		row_start[x] |= mask.bitmask;
+	}
+}
+
+// render_verLine without mirroring, y0 <= y1 on screen
+static void old_verLine(u8 x, u8 y0, u8 y1, u8 thickness) {
+	u8 x_end = x + thickness - 1;
+	CLAMP_VALUE(x_end, SSD1306_W_LIMIT);
+	u8 x_len = x_end - x + 1;
+	_dirty_mark_rect(y0, y1, x, x_end);
+
+	for (u8 y_pos = y0; y_pos <= y1; y_pos++) {
+		Page_Mask_t mask = page_masks[y_pos];
+		u8* row_start = &SSD1306_BUF[mask.page * SSD1306_W + x];
+
+		for (u8 i = 0; i < x_len; i++) {
+			row_start[i] |= mask.bitmask;
+		}
+	}
+}
+
+static void new_verLine(u8 x, u8 y0, u8 y1, u8 thickness) {
+	u8 limits[] = { y0, y1 };
+	render_verLine(x, limits, thickness, 0);
+}
+
+// render_rect and test_polys with the old outline, shapes unchanged
+static void old_rect(u8 x, u8 y, u8 w, u8 h, u8 fill) {
+	u8 x_end = x + w, y_end = y + h;
+	u8 x_limit[] = { x, x_end };
+
+	if (fill) {
+		render_colSpan(x, x_end, y, y_end, 1);
+	} else {
+		render_horLine(y, x_limit, 1, 0);
+		render_horLine(y_end, x_limit, 1, 0);
+		old_verLine(x, y + 1, y_end - 1, 1);
+		old_verLine(x_end, y + 1, y_end - 1, 1);
+	}
+}
+
+static void old_test_polys(void) {
+	for (u8 i = 0; i < 4; i++) old_rect(84, i * 7, 15, 5, i > 1);
+
+	u8 zigzag[][2] = { { 60, 8 }, { 50, 15 }, { 80, 8 }, { 70, 0 }, { 70, 20 } };
+	render_solid_poly(zigzag, 5);
+	for (int i = 0; i < 5; i++) zigzag[i][1] += 24;
+	render_poly(zigzag, 5, 1);
+
+	u8 star[][2] = {
+		{ 12, 0 }, { 16, 8 }, { 24, 8 }, { 18, 14 }, { 22, 22 },
+		{ 12, 16 }, { 2, 22 }, { 6, 14 }, { 0, 8 }, { 8, 8 },
+	};
+	render_solid_poly(star, 10);
+	for (int i = 0; i < 10; i++) star[i][0] += 25;
+	render_poly(star, 10, 1);
+
+	u8 quad[][2] = { { 6, 24 }, { 18, 24 }, { 22, 34 }, { 2, 34 } };
+	render_solid_poly(quad, 4);
+	for (int i = 0; i < 4; i++) quad[i][0] += 25;
+	render_poly(quad, 4, 1);
+
+	u8 hourglass[][2] = { { 6, 38 }, { 18, 38 }, { 6, 52 }, { 18, 52 } };
+	render_solid_poly(hourglass, 4);
+	for (int i = 0; i < 4; i++) hourglass[i][0] += 25;
+	render_poly(hourglass, 4, 1);
+}
+
+static u8 ref[sizeof(SSD1306_BUF)];
+
+static void clear(void) {
+	memset(SSD1306_BUF, 0, sizeof(SSD1306_BUF));
+}
+
+static void keep(void) {
+	memcpy(ref, SSD1306_BUF, sizeof(ref));
+	clear();
+}
+
+static int same(void) {
+	return !memcmp(ref, SSD1306_BUF, sizeof(ref));
+}
+
+static u32 lit(void) {
+	u32 n = 0;
+	for (u32 i = 0; i < sizeof(SSD1306_BUF); i++) n += __builtin_popcount(SSD1306_BUF[i]);
+	return n;
+}
+
+static double mpx_s(u32 pixels, u64 ns) {
+	return ns ? pixels * 1e3 / ns : 0;
+}
+
+int main() {
+	for (u8 y = 0; y < SSD1306_H; y++) {
+		page_masks[y].page = y >> 3;
+		page_masks[y].bitmask = 1 << (y & 0x07);
+	}
+
+	//# same bytes as the table version
+	u32 pixel_bad = 0, hline_bad = 0, vline_bad = 0;
+	for (u8 y = 0; y < SSD1306_H + 2; y++) {
+		for (u8 x = 0; x < SSD1306_W + 2; x += 3) {
+			clear(); old_pixel(x, y); keep(); render_pixel(x, y);
+			pixel_bad += !same();
+		}
+		for (u8 x0 = 0; x0 < SSD1306_W; x0 += 9) {
+			u8 x1 = x0 + y * 3;
+			clear(); old_fastHorLine(y, x0, x1); keep(); render_fastHorLine(y, x0, x1);
+			hline_bad += !same();
+		}
+	}
+	for (u8 y0 = 0; y0 < SSD1306_H; y0++) {
+		for (u8 y1 = y0; y1 < SSD1306_H; y1++) {
+			u8 x = (y0 * 7 + y1) % SSD1306_W, thick = 1 + (y1 & 3);
+			clear(); old_verLine(x, y0, y1, thick); keep(); new_verLine(x, y0, y1, thick);
+			vline_bad += !same();
+		}
+	}
+	BENCH_CHECK(pixel_bad == 0 && hline_bad == 0 && vline_bad == 0);
+
+	// a full page and a single row through SSD1306_RUN_MASK, then the scene
+	BENCH_CHECK(SSD1306_RUN_MASK(8, 15) == 0xFF && SSD1306_RUN_MASK(13, 13) == 0x20);
+	clear(); old_test_polys(); keep(); test_polys();
+	u32 scene_px = lit();
+	BENCH_CHECK(same() && scene_px > 500);
+
+	//# host pixels per second, whole screen each pass
+	const u32 screen = SSD1306_W * SSD1306_H;
+	u64 ns_pixel_old = BENCH_NS(50, for (u8 y = 0; y < SSD1306_H; y++) for (u8 x = 0; x < SSD1306_W; x++) old_pixel(x, y));
+	u64 ns_pixel_new = BENCH_NS(50, for (u8 y = 0; y < SSD1306_H; y++) for (u8 x = 0; x < SSD1306_W; x++) render_pixel(x, y));
+	u64 ns_hline_old = BENCH_NS(200, for (u8 y = 0; y < SSD1306_H; y++) old_fastHorLine(y, 0, SSD1306_W_LIMIT));
+	u64 ns_hline_new = BENCH_NS(200, for (u8 y = 0; y < SSD1306_H; y++) render_fastHorLine(y, 0, SSD1306_W_LIMIT));
+	u64 ns_vline_old = BENCH_NS(200, for (u8 x = 0; x < SSD1306_W; x++) old_verLine(x, 0, SSD1306_H_LIMIT, 1));
+	u64 ns_vline_new = BENCH_NS(200, for (u8 x = 0; x < SSD1306_W; x++) new_verLine(x, 0, SSD1306_H_LIMIT, 1));
+	u64 ns_scene_old = BENCH_NS(1000, (clear(), old_test_polys()));
+	u64 ns_scene_new = BENCH_NS(1000, (clear(), test_polys()));
+
+	BENCH_REPORT("ram_saved", sizeof(page_masks), "bytes");
+	BENCH_REPORT_F("pixel_old", mpx_s(screen, ns_pixel_old), "Mpx/s");
+	BENCH_REPORT_F("pixel_new", mpx_s(screen, ns_pixel_new), "Mpx/s");
+	BENCH_REPORT_F("hline_old", mpx_s(screen, ns_hline_old), "Mpx/s");
+	BENCH_REPORT_F("hline_new", mpx_s(screen, ns_hline_new), "Mpx/s");
+	BENCH_REPORT_F("vline_old", mpx_s(screen, ns_vline_old), "Mpx/s");
+	BENCH_REPORT_F("vline_new", mpx_s(screen, ns_vline_new), "Mpx/s");
+	BENCH_REPORT("scene_pixels", scene_px, "");
+	BENCH_REPORT_F("scene_old", mpx_s(scene_px, ns_scene_old), "Mpx/s");
+	BENCH_REPORT_F("scene_new", mpx_s(scene_px, ns_scene_new), "Mpx/s");
+
+	return bench_result();
+}
@@ -0,0 +1,251 @@
+// SSD1306 filled polygons: render_solid_poly() steps an active edge table
+// in 16.16 fixed point and ORs a byte per column and page. It must match a
+// per pixel reference with the same fill rules (even-odd pairs, both ends
+// included, x rounded, rows y0 up to y1 - 1 of an edge) on random polygons
+// partly off screen and of up to 48 points, three times the default
+// SSD1306_POLY_MAX_PTS, so most go a page at a time and some rows through
+// the sorted batches. A 30 tooth comb, 60 crossings a row, must too. The
+// anti aliased walk must cover the same pixels. Counts the divides the
+// test_polys shapes take, one per edge now against one per crossing in the
+// old scanline loop.
+
+#include <stdlib.h>
+
+#include "../../fun_modules/fun_base.h"
+
+#define SSD1306_POLY_AA
+#include "../../fun_modules/fun_i2c/fun_ssd1306.h"
+#include "../../fun_modules/util_rand32.h"
+
+#include "bench.h"
+
+u8 SSD1306_CMD(u8 cmd) { return 0; }
+u8 SSD1306_DATA(const u8 *data, int sz) { return 0; }
+
+#define MAX_PTS		48
+
+//# the divide per crossing version, as it was
+static u32 old_divides;
+
+static void old_solid_poly(u8 pts[][2], u8 num_pts) {
+	u8 y_min = SSD1306_H, y_max = 0;
+
+	for (u8 i = 0; i < num_pts; i++) {
+		if (pts[i][1] < y_min) y_min = pts[i][1];
+		if (pts[i][1] > y_max) y_max = pts[i][1];
+	}
+
+	for (u8 y = y_min; y <= y_max; y++) {
+		u8 intersections[8];
+		u8 count = 0;
+
+		for (u8 i = 0, j = num_pts-1; i < num_pts; j = i++) {
+			u8 y1 = pts[i][1], y2 = pts[j][1];
+
+			if ((y1 <= y && y < y2) || (y2 <= y && y < y1)) {
+				u8 x1 = pts[i][0], x2 = pts[j][0];
+				u8 x = x1 + ((x2 - x1) * (y - y1)) / (y2 - y1 + 1);
+				old_divides++;
+				intersections[count++] = x;
+			}
+		}
+
+		for (u8 i = 0; i < count-1; i++) {
+			for (u8 j = i+1; j < count; j++) {
+				if (intersections[i] > intersections[j]) {
+					u8 temp = intersections[i];
+					intersections[i] = intersections[j];
+					intersections[j] = temp;
+				}
+			}
+		}
+
+		for (u8 i = 0; i+1 < count; i += 2) {
+			render_fastHorLine(y, intersections[i], intersections[i+1]);
+		}
+	}
+}
+
+//# per pixel reference
+static int cmp_s32(const void *a, const void *b) {
+	s32 x = *(const s32 *)a, y = *(const s32 *)b;
+	return (x > y) - (x < y);
+}
+
+static void ref_solid_poly(u8 pts[][2], u8 num_pts) {
+	for (int y = 0; y < SSD1306_H; y++) {
+		s32 xs[256];
+		int n = 0;
+
+		for (int i = 0, j = num_pts - 1; i < num_pts; j = i++) {
+			u8 *a = pts[j], *b = pts[i];
+			if (a[1] == b[1]) continue;
+			if (a[1] > b[1]) { u8 *t = a; a = b; b = t; }
+			if (y < a[1] || y >= b[1]) continue;
+
+			s32 dx = ((s32)(b[0] - a[0]) << 16) / (b[1] - a[1]);
+			xs[n++] = ((s32)a[0] << 16) + (y - a[1]) * dx;
+		}
+		qsort(xs, n, sizeof(xs[0]), cmp_s32);
+
+		for (int i = 0; i + 1 < n; i += 2) {
+			s32 x0 = (xs[i] + 0x8000) >> 16, x1 = (xs[i + 1] + 0x8000) >> 16;
+			if (i && x0 <= (xs[i - 1] + 0x8000) >> 16) x0++;
+			for (s32 x = x0; x <= x1 && x < SSD1306_W; x++) SSD1306_BYTE(x, y) |= SSD1306_BITMASK(y);
+		}
+	}
+}
+
+//# anti-aliased coverage
+static u16 alpha_map[SSD1306_H][SSD1306_W];
+static void aa_pixel(u8 x, u8 y, u8 alpha) {
+	alpha_map[y][x] += alpha;
+}
+
+static u8 ref[sizeof(SSD1306_BUF)];
+
+static void clear(void) {
+	memset(SSD1306_BUF, 0, sizeof(SSD1306_BUF));
+}
+
+static void keep(void) {
+	memcpy(ref, SSD1306_BUF, sizeof(ref));
+	clear();
+}
+
+static int same(void) {
+	return !memcmp(ref, SSD1306_BUF, sizeof(ref));
+}
+
+static u32 lit(void) {
+	u32 n = 0;
+	for (u32 i = 0; i < sizeof(SSD1306_BUF); i++) n += __builtin_popcount(SSD1306_BUF[i]);
+	return n;
+}
+
+static u8 pts[MAX_PTS][2];
+
+static void random_poly(u8 n, u8 w, u8 h) {
+	for (u8 i = 0; i < n; i++) {
+		pts[i][0] = rand_make_u32() % w;
+		pts[i][1] = rand_make_u32() % h;
+	}
+}
+
+//# the filled shapes of test_polys
+static u8 zigzag[][2] = { { 60, 8 }, { 50, 15 }, { 80, 8 }, { 70, 0 }, { 70, 20 } };
+static u8 star[][2] = {
+	{ 12, 0 }, { 16, 8 }, { 24, 8 }, { 18, 14 }, { 22, 22 },
+	{ 12, 16 }, { 2, 22 }, { 6, 14 }, { 0, 8 }, { 8, 8 },
+};
+static u8 quad[][2] = { { 6, 24 }, { 18, 24 }, { 22, 34 }, { 2, 34 } };
+static u8 hourglass[][2] = { { 6, 38 }, { 18, 38 }, { 6, 52 }, { 18, 52 } };
+
+#define SHAPES(fn) \
+	(fn(zigzag, 5), fn(star, 10), fn(quad, 4), fn(hourglass, 4))
+
+int main() {
+	//# same bytes as the per pixel reference
+	u32 poly_bad = 0, offscreen_bad = 0, aa_bad = 0, many_crossings = 0;
+	u64 aa_sum = 0, mono_sum = 0, aa_partial = 0;
+	u32 batch_rows = 0;
+
+	for (int r = 0; r < 3000; r++) {
+		u8 n = 3 + r % (MAX_PTS - 2);
+		random_poly(n, SSD1306_W, SSD1306_H);
+		clear(); ref_solid_poly(pts, n); keep(); render_solid_poly(pts, n);
+		poly_bad += !same();
+		many_crossings += n > SSD1306_POLY_MAX_PTS;
+		for (u8 y = 0; y < SSD1306_H; y++) {
+			u8 crossings = 0;
+			for (u8 i = 0, j = n - 1; i < n; j = i++) {
+				u8 lo = pts[i][1] < pts[j][1] ? pts[i][1] : pts[j][1];
+				u8 hi = pts[i][1] ^ pts[j][1] ^ lo;
+				crossings += lo <= y && y < hi;
+			}
+			batch_rows += crossings > SSD1306_POLY_MAX_PTS;
+		}
+
+		//# anti-aliased: only filled pixels, at most 255 in all
+		memset(alpha_map, 0, sizeof(alpha_map));
+		render_solid_poly_aa(pts, n, aa_pixel);
+		for (u8 y = 0; y < SSD1306_H; y++) {
+			for (u8 x = 0; x < SSD1306_W; x++) {
+				u8 filled = !!(SSD1306_BYTE(x, y) & SSD1306_BITMASK(y));
+				u16 alpha = alpha_map[y][x];
+				aa_bad += (alpha && !filled) || alpha > 255;
+				aa_partial += alpha && alpha < 255;
+				aa_sum += alpha;
+				mono_sum += filled * 255;
+			}
+		}
+
+		// corners out to 255 on both axes
+		random_poly(n, 255, 255);
+		clear(); ref_solid_poly(pts, n); keep(); render_solid_poly(pts, n);
+		offscreen_bad += !same();
+	}
+	BENCH_CHECK(poly_bad == 0 && offscreen_bad == 0 && aa_bad == 0);
+	BENCH_CHECK(many_crossings > 1000 && batch_rows > 1000);
+	// the ends lose about half a pixel each
+	BENCH_CHECK(aa_partial > 0 && aa_sum < mono_sum && aa_sum > mono_sum * 3 / 4);
+
+	// the test shapes, and a triangle fills what the old loop did but the
+	// bottom row it dropped
+	clear(); SHAPES(ref_solid_poly); keep(); SHAPES(render_solid_poly);
+	BENCH_CHECK(same() && lit() > 300);
+
+	// a comb of 30 teeth, two crossings each on every row through them
+	static u8 comb[62][2];
+	for (u8 t = 0; t < 30; t++) {
+		comb[t * 2][0] = 4 + t * 4, comb[t * 2][1] = 2;
+		comb[t * 2 + 1][0] = 6 + t * 4, comb[t * 2 + 1][1] = 50 - (t & 3);
+	}
+	comb[60][0] = 124, comb[60][1] = 60;
+	comb[61][0] = 2, comb[61][1] = 60;
+	clear(); ref_solid_poly(comb, 62); keep(); render_solid_poly(comb, 62);
+	u32 comb_px = lit();
+	memset(alpha_map, 0, sizeof(alpha_map));
+	render_solid_poly_aa(comb, 62, aa_pixel);
+	u32 comb_aa_bad = 0;
+	for (u8 y = 0; y < SSD1306_H; y++) {
+		for (u8 x = 0; x < SSD1306_W; x++) {
+			comb_aa_bad += alpha_map[y][x] && !(SSD1306_BYTE(x, y) & SSD1306_BITMASK(y));
+		}
+	}
+	BENCH_CHECK(same() && comb_px > 1000 && comb_aa_bad == 0);
+
+	//# divides: one per crossing before, one per edge now
+	Poly_Edge_t edges[SSD1306_POLY_MAX_PTS];
+	u32 new_divides = 0;
+	u8 (*shapes[])[2] = { zigzag, star, quad, hourglass };
+	u8 counts[] = { 5, 10, 4, 4 };
+	for (u8 i = 0; i < 4; i++) new_divides += _poly_edge_table(edges, shapes[i], counts[i], 0, SSD1306_H_LIMIT);
+	old_divides = 0;
+	clear(); SHAPES(old_solid_poly);
+	u32 shape_divides = old_divides;
+	BENCH_CHECK(new_divides < shape_divides);
+
+	//# host ns for the test_polys shapes
+	u64 ns_old = BENCH_NS(2000, (clear(), SHAPES(old_solid_poly)));
+	u64 ns_new = BENCH_NS(2000, (clear(), SHAPES(render_solid_poly)));
+	u32 shape_px = lit();
+
+	// a full screen 48 point polygon, beyond the old loop, and the comb
+	random_poly(MAX_PTS, SSD1306_W, SSD1306_H);
+	u64 ns_big = BENCH_NS(500, (clear(), render_solid_poly(pts, MAX_PTS)));
+	u64 ns_comb = BENCH_NS(500, (clear(), render_solid_poly(comb, 62)));
+
+	BENCH_REPORT("shape_pixels", shape_px, "");
+	BENCH_REPORT("shape_divides_old", shape_divides, "");
+	BENCH_REPORT("shape_divides_new", new_divides, "");
+	BENCH_REPORT_F("shapes_old", (double)ns_old, "ns");
+	BENCH_REPORT_F("shapes_new", (double)ns_new, "ns");
+	BENCH_REPORT_F("speedup", (double)ns_old / ns_new, "x");
+	BENCH_REPORT_F("poly_48_points", (double)ns_big, "ns");
+	BENCH_REPORT_F("comb_62_points", (double)ns_comb, "ns");
+	BENCH_REPORT("table_bytes", SSD1306_POLY_MAX_PTS * (sizeof(Poly_Edge_t) + sizeof(Poly_Edge_t *)), "bytes (host pointers)");
+	BENCH_REPORT("spans_bytes", sizeof(Page_Spans_t), "bytes");
+
+	return bench_result();
+}
@@ -0,0 +1,185 @@
+// SSD1306 scaled text: ssd1306_render_scaled_txt() expands each glyph
+// column into a u32 of scaled rows and ORs it in a byte per page. It must
+// match the per pixel loop it replaced for every character, scale 1 to 4,
+// y offset within a page, both colors and text off the right and bottom
+// edges. Glyphs past 32 pixels or 8 font columns take the render_colSpan()
+// path and are checked up to scale 40. The old loop did four divides per
+// set font bit, in software on the CH32V003.
+
+#include "../../fun_modules/fun_base.h"
+#include "../../fun_modules/fun_i2c/fun_ssd1306.h"
+
+#include "bench.h"
+
+u8 SSD1306_CMD(u8 cmd) { return 0; }
+u8 SSD1306_DATA(const u8 *data, int sz) { return 0; }
+
+//# the pixel version, as it was
+static void old_scaled_txt(u8 x, u8 y, const char *str, Str_Config_t *config) {
+	if (x >= SSD1306_W || y >= SSD1306_H) return;
+
+	u8 char_width_scaled = SSD1306_TEXT_SCALED(config->WIDTH, config->scale_mode);
+	u8 space_offset = char_width_scaled + config->SPACE;
+	void (*pixel_func)(u8 x, u8 y) = config->color ? render_pixel : render_pixel_erase;
+
+	while (*str) {
+		u8 c = *str++;
+
+		if (c == ' ') {
+			x += space_offset;
+			if (x >= SSD1306_W) break;
+			continue;
+		}
+
+		if (c < 32 || c > 127) c = '?';
+		u16 char_pos = (c - 32) * config->WIDTH;
+
+		for (u8 col = 0; col < config->WIDTH; col++) {
+			u8 glyph = config->FONT[char_pos + col];
+
+			for (u8 row = 0; row < config->HEIGHT; row++) {
+				if (!(glyph & (1 << row))) continue;
+
+				for (u8 tc = SSD1306_TEXT_SCALED(col, config->scale_mode); tc < SSD1306_TEXT_SCALED(col + 1, config->scale_mode); tc++) {
+					for (u8 tr = SSD1306_TEXT_SCALED(row, config->scale_mode); tr < SSD1306_TEXT_SCALED(row + 1, config->scale_mode); tr++) {
+						pixel_func(x + tc, y + tr);
+					}
+				}
+			}
+		}
+
+		x += space_offset;
+		if (x >= SSD1306_W) break;
+	}
+}
+
+static Str_Config_t config = {
+	.FONT = (u8 *)FONT_7x5,
+	.WIDTH = 5,
+	.HEIGHT = 7,
+	.SPACE = 1,
+	.scale_mode = 3,
+	.color = 1,
+};
+
+// 10 columns by 8 rows, wider than a glyph column table holds
+static u8 wide_font[96 * 10];
+
+static u8 ref[sizeof(SSD1306_BUF)];
+
+// color 0 draws into a lit screen
+static void clear(void) {
+	memset(SSD1306_BUF, config.color ? 0x00 : 0xFF, sizeof(SSD1306_BUF));
+}
+
+static void keep(void) {
+	memcpy(ref, SSD1306_BUF, sizeof(ref));
+	clear();
+}
+
+static int same(void) {
+	return !memcmp(ref, SSD1306_BUF, sizeof(ref));
+}
+
+int main() {
+	//# every character at every scale, y offset and color
+	static char all[96];
+	for (int i = 0; i < 95; i++) all[i] = 33 + i;		// '!' to DEL, '?' for DEL
+
+	u32 glyph_bad = 0, edge_bad = 0, runs = 0;
+	for (u8 color = 0; color < 2; color++) {
+		config.color = color;
+		for (u8 mode = 1; mode <= 4; mode++) {
+			config.scale_mode = mode;
+			for (u8 y = 0; y < 10; y++) {
+				// one line per character so none runs off the edge
+				for (int i = 0; i < 95; i++) {
+					char one[4] = { all[i], ' ', all[94 - i], 0 };
+					clear(); old_scaled_txt(3, y, one, &config); keep(); ssd1306_render_scaled_txt(3, y, one, &config);
+					glyph_bad += !same();
+					runs++;
+				}
+			}
+
+			// off the right and the bottom edge
+			for (u8 x = SSD1306_W - 40; x < SSD1306_W; x += 7) {
+				for (u8 y = SSD1306_H - 20; y < SSD1306_H; y += 3) {
+					clear(); old_scaled_txt(x, y, "W@#8", &config); keep(); ssd1306_render_scaled_txt(x, y, "W@#8", &config);
+					edge_bad += !same();
+				}
+			}
+		}
+	}
+	BENCH_CHECK(glyph_bad == 0 && edge_bad == 0);
+
+	//# past the glyph table: scales up to 40, then a 10 column font
+	for (int i = 0; i < (int)sizeof(wide_font); i++) wide_font[i] = i * 37 + (i >> 3);
+	u32 large_bad = 0, wide_bad = 0;
+	for (u8 color = 0; color < 2; color++) {
+		config.color = color;
+		for (u8 mode = 5; mode <= 40; mode++) {
+			config.scale_mode = mode;
+			for (u8 x = 3; x < SSD1306_W; x += 31) {
+				for (u8 y = 0; y < SSD1306_H; y += 13) {
+					clear(); old_scaled_txt(x, y, "W@ g", &config); keep(); ssd1306_render_scaled_txt(x, y, "W@ g", &config);
+					large_bad += !same();
+				}
+			}
+		}
+
+		Str_Config_t wide = { .FONT = wide_font, .WIDTH = 10, .HEIGHT = 8, .SPACE = 2, .color = color };
+		for (u8 mode = 1; mode <= 12; mode++) {
+			wide.scale_mode = mode;
+			for (int i = 0; i < 95; i += 5) {
+				char one[3] = { all[i], all[94 - i], 0 };
+				clear(); old_scaled_txt(1, i % 9, one, &wide); keep(); ssd1306_render_scaled_txt(1, i % 9, one, &wide);
+				wide_bad += !same();
+			}
+		}
+	}
+	BENCH_CHECK(large_bad == 0 && wide_bad == 0);
+
+	// scale 40 draws rows and columns past 32, which were cut off
+	config.color = 1;
+	config.scale_mode = 40;
+	clear();
+	ssd1306_render_scaled_txt(0, 0, "W", &config);
+	u32 low = 0, right = 0;
+	for (u32 i = 4 * SSD1306_W; i < sizeof(SSD1306_BUF); i++) low += SSD1306_BUF[i] != 0;
+	for (u8 p = 0; p < SSD1306_PAGES; p++) right += SSD1306_BUF[p * SSD1306_W + 34] != 0;
+	BENCH_CHECK(low > 0 && right > 0);
+
+	// the new one must actually draw something
+	config.color = 1;
+	config.scale_mode = 3;
+	clear();
+	ssd1306_render_scaled_txt(0, 5, "MENU", &config);
+	u32 lit = 0;
+	for (u32 i = 0; i < sizeof(SSD1306_BUF); i++) lit += __builtin_popcount(SSD1306_BUF[i]);
+	BENCH_CHECK(lit > 50);
+
+	//# host ns for a scale 3 menu line
+	const char *line = "Temp 23.5C";
+	u64 ns_old = BENCH_NS(2000, old_scaled_txt(2, 13, line, &config));
+	u64 ns_new = BENCH_NS(2000, ssd1306_render_scaled_txt(2, 13, line, &config));
+	config.scale_mode = 4;
+	u64 ns_big_old = BENCH_NS(2000, old_scaled_txt(2, 13, line, &config));
+	u64 ns_big_new = BENCH_NS(2000, ssd1306_render_scaled_txt(2, 13, line, &config));
+	config.scale_mode = 25;
+	u64 ns_huge_old = BENCH_NS(2000, old_scaled_txt(2, 0, "42", &config));
+	u64 ns_huge_new = BENCH_NS(2000, ssd1306_render_scaled_txt(2, 0, "42", &config));
+
+	BENCH_REPORT("cases", runs, "");
+	BENCH_REPORT("scale_table", sizeof(SSD1306_Glyph_Scale_t), "bytes (stack)");
+	BENCH_REPORT_F("menu_line_old", (double)ns_old, "ns");
+	BENCH_REPORT_F("menu_line_new", (double)ns_new, "ns");
+	BENCH_REPORT_F("speedup", (double)ns_old / ns_new, "x");
+	BENCH_REPORT_F("scale4_line_old", (double)ns_big_old, "ns");
+	BENCH_REPORT_F("scale4_line_new", (double)ns_big_new, "ns");
+	BENCH_REPORT_F("scale4_speedup", (double)ns_big_old / ns_big_new, "x");
+	BENCH_REPORT_F("scale25_digits_old", (double)ns_huge_old, "ns");
+	BENCH_REPORT_F("scale25_digits_new", (double)ns_huge_new, "ns");
+	BENCH_REPORT_F("scale25_speedup", (double)ns_huge_old / ns_huge_new, "x");
+
+	return bench_result();
+}
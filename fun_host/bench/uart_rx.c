@@ -0,0 +1,208 @@
+// UART RX at 1 Mbaud (see CFLAGS_uart_rx): a replay of random command lines
+// streams back to back into the 128 byte DMA ring while the main loop sleeps
+// until the RX interrupts wake it, then stays busy up to 250 us before it
+// gets to uart_rx_task(). Every line must reach its handler with the same
+// arguments, nothing may be overrun. Then a stalled main loop and a line
+// longer than the ring are dropped and the parser picks up after them.
+
+#include "../../fun_modules/fun_base.h"
+#include "../../fun_modules/fun_uart.h"
+#include "../../fun_modules/util_rand32.h"
+
+#include <unistd.h>
+
+#include "bench.h"
+
+#define LINES		20000
+#define BUSY_US		250
+#define CHUNK		1024
+
+//# handlers fold their arguments into sums the generator predicts
+static u32 handled, sum_total, set_regs[16], echo_bytes, toggles;
+
+static void cmd_echo(UART_Token_t *argv, u8 argc) {
+	char text[16];
+	for (u8 i = 1; i < argc; i++) echo_bytes += uart_token_copy(&argv[i], text, sizeof(text));
+	handled++;
+}
+
+static void cmd_set(UART_Token_t *argv, u8 argc) {
+	u32 reg, value;
+	if (argc == 3 && uart_token_u32(&argv[1], &reg) && uart_token_u32(&argv[2], &value) && reg < 16) {
+		set_regs[reg] = value;
+	}
+	handled++;
+}
+
+static void cmd_sum(UART_Token_t *argv, u8 argc) {
+	for (u8 i = 1; i < argc; i++) {
+		u32 v;
+		if (uart_token_u32(&argv[i], &v)) sum_total += v;
+	}
+	handled++;
+}
+
+static void cmd_toggle(UART_Token_t *argv, u8 argc) {
+	toggles++;
+	handled++;
+}
+
+// sorted by name
+static const UART_Cmd_t cmds[] = {
+	{ "echo", cmd_echo },
+	{ "set", cmd_set },
+	{ "sum", cmd_sum },
+	{ "toggle", cmd_toggle },
+};
+
+//# replay stream
+static char stream[LINES * 32];
+static u32 stream_len;
+static u32 expect_sum, expect_regs[16], expect_echo, expect_toggles;
+
+static void gen_line(void) {
+	char *p = stream + stream_len;
+	u32 r = rand_make_u32();
+
+	switch (r % 4) {
+	case 0: {
+		u32 n = 1 + r / 4 % 3;
+		p += sprintf(p, "echo");
+		for (u32 i = 0; i < n; i++) {
+			u32 len = 1 + rand_make_u32() % 6;
+			*p++ = ' ';
+			for (u32 j = 0; j < len; j++) *p++ = 'a' + rand_make_u32() % 26;
+			expect_echo += len;
+		}
+		break;
+	}
+	case 1: {
+		u32 reg = r / 4 % 16, value = rand_make_u32() & 0xFFFFF;
+		p += sprintf(p, r & 0x100 ? "set %u 0x%x" : "set  %u\t%u", reg, value);
+		expect_regs[reg] = value;
+		break;
+	}
+	case 2: {
+		u32 n = 1 + r / 4 % 4;
+		p += sprintf(p, "sum");
+		for (u32 i = 0; i < n; i++) {
+			u32 v = rand_make_u32() % 1000;
+			p += sprintf(p, " %u", v);
+			expect_sum += v;
+		}
+		break;
+	}
+	default:
+		p += sprintf(p, "toggle");
+		expect_toggles++;
+	}
+
+	p += sprintf(p, r & 0x200 ? "\r\n" : "\n");
+	stream_len = p - stream;
+}
+
+int main() {
+	SystemInit();
+	systick_init();
+	funGpioInitAll();
+	funPinMode(PC7, GPIO_Speed_10MHz | GPIO_CNF_OUT_PP);
+	uart_setup();
+	uart_rx_setup();
+	uart_rx_commands(cmds, sizeof(cmds) / sizeof(cmds[0]));
+
+	u32 longest = 0;
+	for (u32 i = 0; i < LINES; i++) {
+		u32 start = stream_len;
+		gen_line();
+		if (stream_len - start > longest) longest = stream_len - start;
+	}
+	BENCH_CHECK(longest <= UART_RX_BUF_LEN / 2);
+
+	//# back to back at 1 Mbaud, the sim queue is kept topped up
+	u32 fed = 0, wakes = 0;
+	u64 parse_ns = 0, busy_us = 0;
+	u64 t0 = host_cycles;
+
+	while (handled < LINES && host_cycles - t0 < 2 * (u64)stream_len * 10 * SYSTICK_ONE_MICROSECOND) {
+		if (fed < stream_len && fed - host_stats.uart_rx_bytes < 2 * CHUNK) {
+			u32 n = stream_len - fed < CHUNK ? stream_len - fed : CHUNK;
+			host_uart_inject((const u8 *)stream + fed, n);
+			fed += n;
+		}
+
+		while (!uart_rx_wake) __WFI();
+		wakes++;
+
+		// whatever else the main loop has to do first
+		u32 us = rand_make_u32() % BUSY_US;
+		Delay_Us(us);
+		busy_us += us;
+
+		u64 t = host_now_ns();
+		uart_rx_task();
+		parse_ns += host_now_ns() - t;
+	}
+	u64 air_us = (host_cycles - t0) / SYSTICK_ONE_MICROSECOND;
+
+	BENCH_CHECK(handled == LINES);
+	BENCH_CHECK(host_stats.uart_rx_bytes == stream_len);
+	BENCH_CHECK(sum_total == expect_sum);
+	BENCH_CHECK(!memcmp(set_regs, expect_regs, sizeof(set_regs)));
+	BENCH_CHECK(echo_bytes == expect_echo);
+	BENCH_CHECK(toggles == expect_toggles);
+	BENCH_CHECK(uart_rx_overruns == 0 && uart_rx_dropped == 0);
+	BENCH_CHECK(UTIL_ring_count(&rx_ring) == 0);
+
+	u32 dma_irqs = host_stats.irq[DMA1_Channel5_IRQn].count;
+	u32 idle_irqs = host_stats.irq[USART1_IRQn].count;
+
+	//# main loop stalls for 15 ms: the DMA laps the tail, the next line still parses
+	handled = toggles = 0;
+	host_uart_inject((const u8 *)"sum 1 2 3\n", 10);
+	for (u32 i = 0; i < 200; i++) host_uart_inject((const u8 *)"sum 1\n", 6);
+	host_run_ms(15);
+	uart_rx_task();
+	BENCH_CHECK(uart_rx_overruns == 1 && handled == 0);
+
+	host_uart_inject((const u8 *)"toggle\n", 7);
+	host_run_us(200);
+	uart_rx_task();
+	BENCH_CHECK(handled == 1 && toggles == 1);
+
+	//# a line that does not fit the ring is dropped as a whole
+	host_uart_inject((const u8 *)"sum", 3);
+	for (u32 i = 0; i < 100; i++) host_uart_inject((const u8 *)" 1", 2);
+	host_uart_inject((const u8 *)"\ntoggle\n", 8);
+	for (u32 i = 0; i < 25; i++) {
+		host_run_us(100);
+		uart_rx_task();
+	}
+	BENCH_CHECK(uart_rx_dropped == 1 && handled == 2 && toggles == 2);
+
+	//# the built in table: "toggle" flips PC7, unknown commands are reported
+	fflush(stdout);
+	int out = dup(1);
+	freopen("/dev/null", "w", stdout);
+	uart_rx_setup();
+	host_uart_inject((const u8 *)"bogus 1\r\ntoggle\r\n", 17);
+	host_run_us(500);
+	uart_rx_task();
+	fflush(stdout);
+	dup2(out, 1);
+	BENCH_CHECK(funDigitalRead(PC7) == 1);
+
+	BENCH_REPORT("ring", UART_RX_BUF_LEN, "bytes");
+	BENCH_REPORT("lines", LINES, "");
+	BENCH_REPORT("bytes", stream_len, "");
+	BENCH_REPORT("longest_line", longest, "bytes");
+	BENCH_REPORT_F("throughput", 10.0 * stream_len / air_us, "Mbaud");
+	BENCH_REPORT("wakes", wakes, "");
+	BENCH_REPORT("dma_irqs", dma_irqs, "");
+	BENCH_REPORT("idle_irqs", idle_irqs, "");
+	BENCH_REPORT_F("avg_busy_before_task", (double)busy_us / wakes, "us");
+	// after a wake the task has the rest of the ring before the DMA laps it
+	BENCH_REPORT("task_deadline", (UART_RX_BUF_LEN / 2 - longest) * 10, "us");
+	BENCH_REPORT_F("parse_ns_per_byte", (double)parse_ns / stream_len, "ns");
+
+	return bench_result();
+}
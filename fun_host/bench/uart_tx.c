@@ -0,0 +1,109 @@
+// UART TX ring (fun_uart.h): two dma_uart_tx() calls back to back used to
+// reload the running transfer, now both arrive. LOG() lines at a rate the
+// 115200 baud line can carry must come out byte for byte while the caller
+// only pays for the copy; a burst beyond the ring drops whole lines and
+// counts every byte it drops. printf() reaches the ring through _write().
+
+#include "../../fun_modules/fun_base.h"
+#include "../../fun_modules/fun_uart.h"
+
+#include "bench.h"
+
+#define LINES		500
+#define BURST		50
+
+//# everything USART1 shifts out
+static char out[64 * 1024];
+static u32 out_len;
+
+static void uart_sink(uint8_t byte) {
+	if (out_len < sizeof(out)) out[out_len++] = byte;
+}
+
+//# everything the ring accepted, in order
+static char expect[64 * 1024];
+static u32 expect_len, rejected;
+
+static uint16_t capture_write(const void *data, uint16_t len) {
+	u16 n = uart_tx_write(data, len);
+	if (n) {
+		memcpy(expect + expect_len, data, n);
+		expect_len += n;
+	} else {
+		rejected += len;
+	}
+	return n;
+}
+
+static void drain() {
+	while (uart_tx_busy()) __WFI();
+	host_run_ms(1);
+}
+
+int main() {
+	SystemInit();
+	systick_init();
+	host_uart_sink = uart_sink;
+	uart_setup();
+	dma_uart_setup();
+	LOG_Init(&systick_millis);
+
+	//# a second write while the first is on the wire
+	dma_uart_tx("first line\r\n", 12);
+	dma_uart_tx("second line\r\n", 13);
+	drain();
+	BENCH_CHECK(out_len == 25 && !memcmp(out, "first line\r\nsecond line\r\n", 25));
+	BENCH_CHECK(uart_tx_dropped == 0);
+
+	//# LOG every 5 ms, the line drains in about 4 ms
+	out_len = 0;
+	LOG_setOutput(capture_write);
+	u64 log_cycles = 0, log_worst = 0;
+	memset(&host_stats, 0, sizeof(host_stats));
+
+	for (u32 i = 0; i < LINES; i++) {
+		u64 t = host_cycles;
+		LOG_Info("bench", "line %u of %u, value %d", i, LINES, (int)(i * 37) - 1000);
+		t = host_cycles - t;
+		log_cycles += t;
+		if (t > log_worst) log_worst = t;
+		Delay_Ms(5);
+	}
+	drain();
+
+	BENCH_CHECK(uart_tx_dropped == 0 && rejected == 0);
+	BENCH_CHECK(out_len == expect_len && !memcmp(out, expect, out_len));
+	u32 log_bytes = expect_len;
+	u32 log_irqs = host_stats.irq[DMA1_Channel4_IRQn].count;
+
+	//# a burst the ring cannot hold: whole lines are dropped and counted
+	out_len = expect_len = 0;
+	for (u32 i = 0; i < BURST; i++) LOG_Warn("bench", "burst %u", i);
+	drain();
+
+	BENCH_CHECK(rejected > 0 && uart_tx_dropped == rejected);
+	BENCH_CHECK(out_len == expect_len && !memcmp(out, expect, out_len));
+	u32 burst_lines = 0;
+	for (u32 i = 0; i < out_len; i++) burst_lines += out[i] == '\n';
+	BENCH_CHECK(burst_lines > 0 && burst_lines < BURST);
+
+	//# printf() on the target ends up in _write()
+	out_len = 0;
+	BENCH_CHECK(_write(1, "printf\r\n", 8) == 8);
+	drain();
+	BENCH_CHECK(out_len == 8 && !memcmp(out, "printf\r\n", 8));
+
+	// the old LOG printf()'d to a blocking UART: every byte waits for the line
+	u64 frame_cycles = (u64)USART1->BRR * 10;
+
+	BENCH_REPORT("log_lines", LINES, "");
+	BENCH_REPORT("log_bytes", log_bytes, "");
+	BENCH_REPORT("log_avg", log_cycles / LINES, "cycles");
+	BENCH_REPORT("log_worst", log_worst, "cycles");
+	BENCH_REPORT("log_blocking_avg", log_bytes * frame_cycles / LINES, "cycles");
+	BENCH_REPORT("log_dma_irqs", log_irqs, "");
+	BENCH_REPORT("burst_lines_sent", burst_lines, "");
+	BENCH_REPORT("burst_bytes_dropped", uart_tx_dropped, "bytes");
+
+	return bench_result();
+}
@@ -0,0 +1,106 @@
+// WS2812 bitstream: batch LUT encode (WS2812_PRECOMPUTED) vs the per-LED
+// callback fill that the legacy driver runs inside the DMA ISR.
+// Reports host ns per LED for both encoders and the worst-case DMA ISR cost
+// of the precomputed path, and checks the wire carries every LED bit.
+
+#include "../../fun_modules/fun_base.h"
+
+#define DMALEDS 64
+#define WS2812_PRECOMPUTED
+#include "../../fun_modules/util_sine.h"
+#include "../../fun_modules/util_rand32.h"
+#include "../../fun_modules/fun_spi/fun_ws2812_spi.h"
+
+#include "bench.h"
+
+#define FRAMES			20
+#define STREAM_FRAMES	((WS2812B_RESET_PERIOD + DMALEDS + 1) * 6)
+
+static u16 wire[STREAM_FRAMES * 2];
+static u32 wire_len;
+static void wire_sink(u16 frame) { if (wire_len < sizeof(wire) / 2) wire[wire_len++] = frame; }
+
+// reference: every LED bit is 4 SPI bits, 1110 for a one and 1000 for a zero
+static int wire_matches(const RGB_t *leds, int count) {
+	const u16 *p = wire + WS2812B_RESET_PERIOD * 6;
+
+	for (int i = 0; i < WS2812B_RESET_PERIOD * 6; i++)
+		if (wire[i]) return 0;
+
+	for (int led = 0; led < count; led++) {
+		u32 c = leds[led].packed;
+		u8 order[3] = { c >> 16, c >> 8, c };		// default order, see WS2812_encode()
+		u16 expect[6] = { 0 };
+
+		for (int bit = 0; bit < 24; bit++) {
+			int one = order[bit / 8] & (0x80 >> (bit % 8));
+			expect[bit / 4] |= (one ? 0xE : 0x8) << (12 - (bit % 4) * 4);
+		}
+		for (int k = 0; k < 6; k++)
+			if (*p++ != expect[k]) return 0;
+	}
+	return 1;
+}
+
+int main() {
+	SystemInit();
+	systick_init();
+	SPI_init(-1, -1);
+	SPI_DMA_WS2812_init(DMALEDS, DMA1_Channel3);
+	Neo_loadCommand(NEO_RAINBOW_WAVE);
+	host_spi_sink = wire_sink;
+
+	for (int i = 0; i < DMALEDS; i++) WS2812_BUF[i].packed = rand_make_u32() & 0xFFFFFF;
+
+	//# encoders agree
+	static u16 legacy[DMALEDS * 6];
+	static u32 batch[DMALEDS * 3];
+
+	WS2812_strip.place = 0;
+	WS2812FillBuffSec(&WS2812_strip, legacy, DMALEDS * 6, 0);
+	WS2812_encode(batch, WS2812_BUF, DMALEDS, WS2812_ORDER_DEFAULT);
+	BENCH_CHECK(memcmp(legacy, batch, sizeof(legacy)) == 0);
+
+	//# host cost per LED
+	u64 ns_batch = BENCH_NS(200, WS2812_encode(batch, WS2812_BUF, DMALEDS, WS2812_ORDER_DEFAULT));
+	u64 ns_legacy = BENCH_NS(200, (WS2812_strip.place = 0, WS2812FillBuffSec(&WS2812_strip, legacy, DMALEDS * 6, 0)));
+	u64 ns_render = BENCH_NS(200, Neo_render(Neo_frame));
+
+	BENCH_REPORT_F("encode_batch_per_led", (double)ns_batch / DMALEDS, "ns");
+	BENCH_REPORT_F("encode_legacy_per_led", (double)ns_legacy / DMALEDS, "ns");
+	// the legacy ISR runs a whole frame render from the callback when one is due
+	BENCH_REPORT("legacy_isr_render", ns_render, "ns");
+
+	//# every LED reaches the wire
+	wire_len = 0;
+	BENCH_CHECK(WS2812_stream_encode(WS2812_BUF, DMALEDS));
+	BENCH_CHECK(!WS2812_stream_encode(WS2812_BUF, DMALEDS));	// back half still queued
+	SPI_DMA_WS2812_tick();
+	while (WS2812_strip.in_use || (SPI1->STATR & SPI_STATR_BSY)) host_wfi();
+
+	BENCH_CHECK(wire_len == STREAM_FRAMES);
+	BENCH_CHECK(wire_matches(WS2812_BUF, DMALEDS));
+	BENCH_CHECK(host_stats.irq[DMA1_Channel3_IRQn].count == 1);
+
+	//# animation through Neo_task, one IRQ per frame
+	memset(&host_stats.irq[DMA1_Channel3_IRQn], 0, sizeof(host_irq_stat_t));
+	host_spi_sink = 0;
+	u32 sent = 0;
+	u64 spi = host_stats.spi_frames;
+
+	for (int i = 0; i < FRAMES * 40 && sent < FRAMES; i++) {
+		Neo_task(millis());
+		host_run_ms(1);
+		sent = host_stats.irq[DMA1_Channel3_IRQn].count;
+	}
+
+	host_irq_stat_t *irq = &host_stats.irq[DMA1_Channel3_IRQn];
+	BENCH_CHECK(sent == FRAMES);
+	BENCH_CHECK(host_stats.spi_frames - spi >= (u64)FRAMES * STREAM_FRAMES);
+	BENCH_REPORT("isr_per_frame", irq->count / sent, "irqs");
+	BENCH_REPORT("isr_worst_cycles", irq->cycles_max, "cycles");
+	BENCH_REPORT("isr_worst", irq->ns_max, "ns");
+	BENCH_REPORT("frame_on_wire", STREAM_FRAMES * 16 / 3, "us");
+
+	return bench_result();
+}
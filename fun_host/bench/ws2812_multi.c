@@ -0,0 +1,200 @@
+// Several WS2812 strips: color orders picked at runtime, a second strip
+// instance on SPI1 with its own buffer and callback, and four strips sent
+// at once on GPIOC pins 0-3 by WS2812_gpio_send(). The GPIO trace is
+// decoded per pin by high time, every strip must get its own bytes in its
+// own order and pin 7, not a strip, must keep its level. Then host ns per
+// LED to build the slot words, transpose against a bit by bit loop.
+
+#include "../../fun_modules/fun_base.h"
+
+#define DMALEDS 16
+// one sync per nop, so the trace sees every write
+#define WS2812_GPIO_NOP()	host_touch()
+#include "../../fun_modules/util_sine.h"
+#include "../../fun_modules/util_rand32.h"
+#include "../../fun_modules/fun_spi/fun_ws2812_spi.h"
+
+#include "bench.h"
+
+#define STRIPS		4
+#define STRIP_LEDS	24
+#define OTHER_LEDS	10
+
+// a zero is high for T0H nops, a one for T0H + T1H
+#define HIGH_SPLIT	((2 * WS2812_GPIO_T0H_NOPS + WS2812_GPIO_T1H_NOPS) * HOST_IO_CYCLES / 2)
+
+static const u8 orders[] = {
+	WS2812_ORDER_RGB, WS2812_ORDER_RBG, WS2812_ORDER_GRB,
+	WS2812_ORDER_GBR, WS2812_ORDER_BRG, WS2812_ORDER_BGR,
+};
+
+static RGB_t strips[STRIPS][STRIP_LEDS];
+
+//# per pin decode of the GPIOC trace
+static u64 rise_at[8];
+static u8 rx[8][STRIP_LEDS * 3];
+static u32 rx_bits[8], rx_bad_width;
+
+static void gpio_trace(int port, u32 old_outdr, u32 new_outdr, u64 cycle) {
+	if (port != 2) return;
+	for (int pin = 0; pin < 8; pin++) {
+		u32 bit = 1u << pin;
+		if (!((old_outdr ^ new_outdr) & bit)) continue;
+		if (new_outdr & bit) {
+			rise_at[pin] = cycle;
+			continue;
+		}
+
+		u64 high = cycle - rise_at[pin];
+		if (high < WS2812_GPIO_T0H_NOPS * HOST_IO_CYCLES) rx_bad_width++;
+		u32 n = rx_bits[pin]++;
+		if (n < sizeof(rx[pin]) * 8 && high > HIGH_SPLIT) rx[pin][n / 8] |= 0x80 >> (n % 8);
+	}
+}
+
+//# the SPI wire
+static u16 wire[(WS2812B_RESET_PERIOD + OTHER_LEDS + DMALEDS) * 6];
+static u32 wire_len;
+static void wire_sink(u16 frame) { if (wire_len < sizeof(wire) / 2) wire[wire_len++] = frame; }
+
+static u16 quartet(u32 nibble) {
+	u16 q = 0;
+	for (int b = 3; b >= 0; b--) q = q << 4 | (nibble >> b & 1 ? 0xE : 0x8);
+	return q;
+}
+
+// byte k of c as the strip sends it, k = 0 first
+static u8 wire_byte(u32 c, u8 order, int k) {
+	return c >> (8 * (order >> (2 * k) & 3));
+}
+
+static u32 other_color(int ledIdx) {
+	return 0x010203 * (ledIdx + 1);
+}
+
+static void transpose_naive(const u8 *in, u8 *out) {
+	for (int i = 0; i < 8; i++) {
+		out[i] = 0;
+		for (int n = 0; n < 8; n++) out[i] |= (in[n] >> (7 - i) & 1) << n;
+	}
+}
+
+int main() {
+	SystemInit();
+	systick_init();
+	funGpioInitAll();
+	SPI_init(-1, -1);
+	SPI_DMA_WS2812_init(DMALEDS, DMA1_Channel3);
+	// keep the callback from rendering over WS2812_BUF
+	leds_frame.ref_time = millis();
+	leds_frame.frame_duration_ms = 0xFFFFFFFF;
+
+	//# the transpose against the bit loop
+	u32 transpose_bad = 0;
+	for (int r = 0; r < 2000; r++) {
+		u8 in[8], fast[8], slow[8];
+		for (int n = 0; n < 8; n++) in[n] = rand_make_u32();
+		_ws2812_transpose8(in, fast);
+		transpose_naive(in, slow);
+		transpose_bad += memcmp(fast, slow, 8) != 0;
+	}
+	BENCH_CHECK(transpose_bad == 0);
+
+	//# every order puts the right byte first, second and third
+	u32 order_bad = 0;
+	for (u32 o = 0; o < sizeof(orders); o++) {
+		u32 c = 0xA5000000 | rand_make_u32() >> 8;
+		u32 w = WS2812_color_order(c, orders[o]);
+		for (int k = 0; k < 3; k++) order_bad += (u8)(w >> (16 - 8 * k)) != wire_byte(c, orders[o], k);
+		order_bad += w >> 24 != 0;
+	}
+	BENCH_CHECK(order_bad == 0);
+	BENCH_CHECK(WS2812_color_order(0x00112233, WS2812_ORDER_GRB) == 0x223311);
+
+	//# the default strip, order switched at runtime
+	static u16 fill[DMALEDS * 6];
+	u32 fill_bad = 0;
+	for (int i = 0; i < DMALEDS; i++) WS2812_BUF[i].packed = rand_make_u32() & 0xFFFFFF;
+	for (u32 o = 0; o < sizeof(orders); o++) {
+		WS2812_strip.order = orders[o];
+		WS2812_strip.place = 0;
+		WS2812FillBuffSec(&WS2812_strip, fill, DMALEDS * 6, 0);
+		for (int i = 0; i < DMALEDS; i++) {
+			for (int k = 0; k < 3; k++) {
+				u8 b = wire_byte(WS2812_BUF[i].packed, orders[o], k);
+				fill_bad += fill[i * 6 + 2 * k] != quartet(b >> 4) || fill[i * 6 + 2 * k + 1] != quartet(b & 15);
+			}
+		}
+	}
+	WS2812_strip.order = WS2812_ORDER_DEFAULT;
+	BENCH_CHECK(fill_bad == 0);
+
+	//# a second instance on SPI1: own buffer, length, order and colors
+	static u16 other_buf[8 * 6];
+	static WS2812_Strip_t other;
+	WS2812_strip_init(&other, SPI1, DMA1_Channel3, other_buf, 8 * 6, OTHER_LEDS, WS2812_ORDER_RGB, other_color);
+	host_spi_sink = wire_sink;
+	WS2812_strip_tick(&other);
+	while (other.in_use || DMA1_Channel3->CNTR || (SPI1->STATR & SPI_STATR_BSY)) host_wfi();
+	host_spi_sink = NULL;
+
+	u32 other_bad = wire_len < (WS2812B_RESET_PERIOD + OTHER_LEDS) * 6;
+	for (int i = 0; i < WS2812B_RESET_PERIOD * 6; i++) other_bad += wire[i] != 0;
+	for (int i = 0; i < OTHER_LEDS; i++) {
+		const u16 *p = wire + (WS2812B_RESET_PERIOD + i) * 6;
+		for (int k = 0; k < 3; k++) {
+			u8 b = wire_byte(other_color(i), WS2812_ORDER_RGB, k);
+			other_bad += p[2 * k] != quartet(b >> 4) || p[2 * k + 1] != quartet(b & 15);
+		}
+	}
+	BENCH_CHECK(other_bad == 0 && WS2812_strip.in_use == 0);
+	SPI_DMA_WS2812_init(DMALEDS, DMA1_Channel3);
+
+	//# four strips on GPIOC, pin 7 high and not a strip
+	static WS2812_Gpio_t par;
+	WS2812_gpio_init(&par, GPIOC, STRIPS, STRIP_LEDS);
+	funPinMode(PC7, GPIO_Speed_10MHz | GPIO_CNF_OUT_PP);
+	funDigitalWrite(PC7, 1);
+	for (int n = 0; n < STRIPS; n++) {
+		for (int i = 0; i < STRIP_LEDS; i++) strips[n][i].packed = rand_make_u32() & 0xFFFFFF;
+		par.bufs[n] = strips[n];
+		par.order[n] = orders[n + 1];
+	}
+
+	host_gpio_trace = gpio_trace;
+	u64 t0 = host_cycles;
+	WS2812_gpio_send(&par);
+	u64 send_cycles = host_cycles - t0;
+	host_gpio_trace = NULL;
+
+	u32 gpio_bad = 0;
+	for (int n = 0; n < STRIPS; n++) {
+		gpio_bad += rx_bits[n] != STRIP_LEDS * 24;
+		for (int i = 0; i < STRIP_LEDS; i++) {
+			for (int k = 0; k < 3; k++) gpio_bad += rx[n][i * 3 + k] != wire_byte(strips[n][i].packed, par.order[n], k);
+		}
+	}
+	for (int pin = STRIPS; pin < 8; pin++) gpio_bad += rx_bits[pin] != 0;
+	BENCH_CHECK(gpio_bad == 0 && rx_bad_width == 0);
+	BENCH_CHECK(funDigitalRead(PC7) && (GPIOC->OUTDR & 0xF) == 0);
+
+	//# host ns per LED for 8 strips: slot words by transpose and bit by bit
+	u8 bytes[8], slots[8];
+	volatile u8 sink = 0;
+	for (int n = 0; n < 8; n++) bytes[n] = rand_make_u32();
+	u64 ns_transpose = BENCH_NS(2000, {
+		for (int b = 0; b < 3; b++) { bytes[b]++; _ws2812_transpose8(bytes, slots); sink += slots[b]; }
+	});
+	u64 ns_naive = BENCH_NS(2000, {
+		for (int b = 0; b < 3; b++) { bytes[b]++; transpose_naive(bytes, slots); sink += slots[b]; }
+	});
+
+	BENCH_REPORT("gpio_strips", STRIPS, "");
+	BENCH_REPORT("gpio_bits_decoded", rx_bits[0] + rx_bits[1] + rx_bits[2] + rx_bits[3], "");
+	BENCH_REPORT("gpio_send_host_cycles", send_cycles, "cycles (a sync per nop)");
+	BENCH_REPORT_F("slots_transpose_per_led", (double)ns_transpose, "ns");
+	BENCH_REPORT_F("slots_naive_per_led", (double)ns_naive, "ns");
+	BENCH_REPORT("strip_struct", sizeof(WS2812_Strip_t), "bytes (host pointers)");
+
+	return bench_result();
+}
@@ -0,0 +1,130 @@
+// WS2812 output stage (WS2812_OUTPUT_STAGE): gamma LUT, global brightness
+// and temporal dithering between WS2812_BUF and the DMA fill. Over 256
+// frames from a clean error the outputs of a pixel must add up to exactly
+// its 8.8 gamma value, at any brightness. The DMA half-buffer fill must put
+// the staged colors on the wire. Then the host cost per LED of the stage
+// and of a fill with it, against the time one LED takes on the wire.
+
+#include "../../fun_modules/fun_base.h"
+
+#define DMALEDS 16
+#define WS2812_OUTPUT_STAGE
+#include "../../fun_modules/util_sine.h"
+#include "../../fun_modules/util_rand32.h"
+#include "../../fun_modules/fun_spi/fun_ws2812_spi.h"
+
+#include "bench.h"
+
+#define FRAMES		256
+
+// 4 SPI bits per LED bit, 1110 for a one and 1000 for a zero
+static u16 quartet(u32 nibble) {
+	u16 q = 0;
+	for (int b = 3; b >= 0; b--) q = q << 4 | (nibble >> b & 1 ? 0xE : 0x8);
+	return q;
+}
+
+// expected outputs for one frame without touching the dither state
+static void stage_frame(u32 *out, const RGB_t *src) {
+	static u8 saved[sizeof(WS2812_dither_err)];
+	memcpy(saved, WS2812_dither_err, sizeof(saved));
+	for (int i = 0; i < DMALEDS; i++) out[i] = WS2812_output(i, src[i].packed);
+	memcpy(WS2812_dither_err, saved, sizeof(saved));
+}
+
+int main() {
+	SystemInit();
+	systick_init();
+	SPI_init(-1, -1);
+	SPI_DMA_WS2812_init(DMALEDS, DMA1_Channel3);
+	Neo_loadCommand(NEO_COLOR_FLASHING);
+	// keep the callback from rendering over WS2812_BUF
+	leds_frame.ref_time = millis();
+	leds_frame.frame_duration_ms = 0xFFFFFFFF;
+
+	//# the LUT
+	u32 monotonic = 1;
+	for (int i = 1; i < 256; i++) monotonic &= LUT_GAMMA16[i] >= LUT_GAMMA16[i - 1];
+	BENCH_CHECK(monotonic && LUT_GAMMA16[0] == 0 && LUT_GAMMA16[255] == 0xFF00);
+
+	//# 256 frames add up to the 8.8 value, every level on every channel
+	u32 sum_bad = 0, ends_bad = 0;
+	const u8 levels[] = { 255, 200, 77, 1 };
+	for (u32 l = 0; l < sizeof(levels); l++) {
+		WS2812_brightness = levels[l];
+		for (u32 v = 0; v < 256; v++) {
+			memset(WS2812_dither_err, 0, sizeof(WS2812_dither_err));
+			u32 color = v | (255 - v) << 8 | (v ^ 0x5A) << 16;
+			u32 sum[3] = { 0 };
+			for (int f = 0; f < FRAMES; f++) {
+				u32 out = WS2812_output(0, color);
+				for (int ch = 0; ch < 3; ch++) sum[ch] += out >> (ch * 8) & 0xFF;
+			}
+			for (int ch = 0; ch < 3; ch++) {
+				u32 v16 = (u32)LUT_GAMMA16[color >> (ch * 8) & 0xFF] * (levels[l] + 1) >> 8;
+				sum_bad += sum[ch] != v16;
+			}
+		}
+		ends_bad += WS2812_output(0, 0) != 0;
+	}
+	WS2812_brightness = 255;
+	memset(WS2812_dither_err, 0, sizeof(WS2812_dither_err));
+	for (int f = 0; f < 8; f++) ends_bad += WS2812_output(1, 0xFFFFFF) != 0xFFFFFF;
+	BENCH_CHECK(sum_bad == 0 && ends_bad == 0);
+
+	//# a dim ramp, 0 to COLOR_RED_LOW: distinct levels rounded vs dithered
+	u32 rounded_levels = 0, dithered_levels = 0, last_rounded = ~0u, last_mean = ~0u;
+	for (u32 v = 0; v <= 0x33; v++) {
+		u32 rounded = (LUT_GAMMA16[v] + 0x80) >> 8;
+		rounded_levels += rounded != last_rounded;
+		last_rounded = rounded;
+
+		memset(WS2812_dither_err, 0, sizeof(WS2812_dither_err));
+		u32 mean = 0;
+		for (int f = 0; f < FRAMES; f++) mean += WS2812_output(0, v) & 0xFF;
+		dithered_levels += mean != last_mean;
+		last_mean = mean;
+	}
+	BENCH_CHECK(dithered_levels > rounded_levels);
+
+	//# the DMA fill puts the staged colors on the wire, frame after frame
+	static u16 fill[DMALEDS * 6];
+	static u32 expect[DMALEDS];
+	u32 wire_bad = 0;
+	for (int i = 0; i < DMALEDS; i++) WS2812_BUF[i].packed = rand_make_u32() & 0x3F3F3F;
+	WS2812_brightness = 180;
+
+	for (int f = 0; f < 8; f++) {
+		stage_frame(expect, WS2812_BUF);
+		WS2812_strip.place = 0;
+		WS2812FillBuffSec(&WS2812_strip, fill, DMALEDS * 6, 0);
+
+		for (int i = 0; i < DMALEDS; i++) {
+			for (int k = 0; k < 6; k++) wire_bad += fill[i * 6 + k] != quartet(expect[i] >> (20 - 4 * k) & 0xF);
+		}
+	}
+	BENCH_CHECK(wire_bad == 0);
+
+	//# host cost per LED, the legacy fill runs in the DMA ISR
+	volatile u32 sink = 0;
+	u64 ns_stage = BENCH_NS(200, for (int i = 0; i < DMALEDS; i++) sink += WS2812_output(i, WS2812_BUF[i].packed));
+	u64 ns_fill = BENCH_NS(200, (WS2812_strip.place = 0, WS2812FillBuffSec(&WS2812_strip, fill, DMALEDS * 6, 0)));
+
+	//# a refresh through the DMA, one half filled per IRQ
+	memset(&host_stats.irq[DMA1_Channel3_IRQn], 0, sizeof(host_irq_stat_t));
+	SPI_DMA_WS2812_tick();
+	while (WS2812_strip.in_use || (SPI1->STATR & SPI_STATR_BSY)) host_wfi();
+	host_irq_stat_t *irq = &host_stats.irq[DMA1_Channel3_IRQn];
+	BENCH_CHECK(irq->count > 0);
+
+	BENCH_REPORT("ram_dither", sizeof(WS2812_dither_err), "bytes");
+	BENCH_REPORT("ramp_levels_rounded", rounded_levels, "");
+	BENCH_REPORT("ramp_levels_dithered", dithered_levels, "");
+	BENCH_REPORT_F("stage_per_led", (double)ns_stage / DMALEDS, "ns");
+	BENCH_REPORT_F("fill_per_led", (double)ns_fill / DMALEDS, "ns");
+	BENCH_REPORT("isr_worst", irq->ns_max, "ns");
+	// 6 SPI halfwords per LED at 3 MHz
+	BENCH_REPORT("led_on_wire", 6 * 16 / 3, "us");
+
+	return bench_result();
+}
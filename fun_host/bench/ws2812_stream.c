@@ -0,0 +1,87 @@
+// WS2812 streaming renderer: a 300 pixel strip driven through a 16 LED DMA
+// buffer. Neo_task() prepares the frame before it arms the refresh, so the
+// DMA ISR only evaluates pixels. Checks every pixel reaches the wire and
+// reports the ISR cost per half buffer against the time the other half
+// takes on the wire.
+
+#include "../../fun_modules/fun_base.h"
+
+#define DMALEDS 16
+#define WS2812_STREAMING
+#include "../../fun_modules/util_sine.h"
+#include "../../fun_modules/util_rand32.h"
+#include "../../fun_modules/fun_spi/fun_ws2812_spi.h"
+
+#include "bench.h"
+
+#define STRIP_LEDS		300
+#define FRAMES			10
+
+static u16 wire[(WS2812B_RESET_PERIOD + STRIP_LEDS + DMALEDS) * 6];
+static u32 wire_len;
+static void wire_sink(u16 frame) { if (wire_len < sizeof(wire) / 2) wire[wire_len++] = frame; }
+
+// reference: every LED bit is 4 SPI bits, 1110 for a one and 1000 for a zero
+static int wire_matches(u32 frame) {
+	const u16 *p = wire + WS2812B_RESET_PERIOD * 6;
+
+	for (int led = 0; led < STRIP_LEDS; led++) {
+		u32 c = Neo_pixel(led, frame).packed;
+		u8 order[3] = { c >> 16, c >> 8, c };
+		u16 expect[6] = { 0 };
+
+		for (int bit = 0; bit < 24; bit++) {
+			int one = order[bit / 8] & (0x80 >> (bit % 8));
+			expect[bit / 4] |= (one ? 0xE : 0x8) << (12 - (bit % 4) * 4);
+		}
+		for (int k = 0; k < 6; k++)
+			if (*p++ != expect[k]) return 0;
+	}
+	return 1;
+}
+
+int main() {
+	SystemInit();
+	systick_init();
+	SPI_init(-1, -1);
+	SPI_DMA_WS2812_init(STRIP_LEDS, DMA1_Channel3);
+	Neo_loadCommand(NEO_RAINBOW_WAVE);
+	host_spi_sink = wire_sink;
+
+	//# one refresh, every pixel on the wire
+	host_run_ms(40);
+	u64 cyc = host_cycles;
+	Neo_task(millis());
+	u32 frame = Neo_frame;
+	int prepared = Neo_engine.ready && Neo_engine.frame == frame;
+	while (WS2812_strip.in_use || DMA1_Channel3->CNTR || (SPI1->STATR & SPI_STATR_BSY)) host_wfi();
+	// each IRQ refills one half while the other half is on the wire
+	u64 half_cycles = (host_cycles - cyc) / host_stats.irq[DMA1_Channel3_IRQn].count;
+
+	BENCH_CHECK(frame == 1 && prepared);
+	BENCH_CHECK(wire_len >= (WS2812B_RESET_PERIOD + STRIP_LEDS) * 6);
+	BENCH_CHECK(wire_matches(frame));
+	BENCH_REPORT("strip_leds", STRIP_LEDS, "leds");
+	BENCH_REPORT("ram_dma_buffer", sizeof(WS2812_DMA_BUF), "bytes");
+
+	//# ISR deadline
+	host_spi_sink = 0;
+	memset(&host_stats.irq[DMA1_Channel3_IRQn], 0, sizeof(host_irq_stat_t));
+	for (int i = 0; i < FRAMES; i++) {
+		host_run_ms(40);
+		Neo_task(millis());
+		while (WS2812_strip.in_use) host_wfi();
+	}
+
+	host_irq_stat_t *irq = &host_stats.irq[DMA1_Channel3_IRQn];
+	u64 ns_pixel = BENCH_NS(200, Neo_pixel(rand_make_u32() % STRIP_LEDS, frame));
+
+	BENCH_CHECK(irq->count >= FRAMES * (STRIP_LEDS / (DMALEDS / 2)));
+	BENCH_REPORT("isr_per_refresh", irq->count / FRAMES, "irqs");
+	BENCH_REPORT("pixel_eval", ns_pixel, "ns");
+	BENCH_REPORT("isr_mean", irq->ns_total / irq->count, "ns");
+	BENCH_REPORT("isr_worst", irq->ns_max, "ns");
+	BENCH_REPORT("half_buffer_deadline", half_cycles / SYSTICK_ONE_MICROSECOND, "us");
+
+	return bench_result();
+}
@@ -0,0 +1,727 @@
+// MIT License
+// Copyright (c) 2025 UniTheCat
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Host (Linux) stand-in for ch32fun.h
+// The fun_modules headers include "ch32fun.h" and poke CH32V003 registers
+// directly. Putting this directory first on the include path lets the same
+// headers compile for the host against simulated peripherals driven by a
+// virtual cycle clock (see host_sim.h / host_sim.c).
+//
+// Every peripheral macro (SysTick, GPIOC, DMA1_Channel3, SPI1, I2C1, ...)
+// expands to `(host_touch(), &host_XXX)` (host_touch_id() for peripherals
+// with read side effects): the access costs HOST_IO_CYCLES and
+// brings the simulated peripherals up to date before the register is read or
+// written, so busy-waits on status flags and micros() make progress.
+//
+//! NOTE: build with -no-pie. The modules store buffer addresses in 32-bit
+//! DMA registers, (u32)&buf only round-trips when globals live below 4 GB.
+
+#ifndef _CH32FUN_H
+#define _CH32FUN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__has_include)
+	#if __has_include("funconfig.h")
+		#include "funconfig.h"
+	#endif
+#endif
+
+#ifndef CH32V003
+	#define CH32V003 1
+#endif
+
+#ifndef FUNCONF_SYSTEM_CORE_CLOCK
+	#define FUNCONF_SYSTEM_CORE_CLOCK 48000000
+#endif
+
+#define DELAY_US_TIME (FUNCONF_SYSTEM_CORE_CLOCK / 1000000)
+#define DELAY_MS_TIME (FUNCONF_SYSTEM_CORE_CLOCK / 1000)
+
+// riscv interrupt attribute has no meaning on the host: handlers are plain
+// functions called by the simulated interrupt controller.
+#define interrupt
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t   s8;
+typedef int16_t  s16;
+typedef int32_t  s32;
+typedef int64_t  s64;
+
+//! ####################################
+//! REGISTER LAYOUTS
+//! ####################################
+
+typedef struct {
+	volatile u32 CTLR;
+	volatile u32 SR;
+	volatile u32 CNT;
+	volatile u32 RESERVED0;
+	volatile u32 CMP;
+	volatile u32 RESERVED1;
+} SysTick_Type;
+
+typedef struct {
+	volatile u32 CFGLR;
+	volatile u32 CFGHR;
+	volatile u32 INDR;
+	volatile u32 OUTDR;
+	volatile u32 BSHR;
+	volatile u32 BCR;
+	volatile u32 LCKR;
+} GPIO_TypeDef;
+
+typedef struct {
+	volatile u32 ECR;
+	volatile u32 PCFR1;
+	volatile u32 EXTICR;
+} AFIO_TypeDef;
+
+typedef struct {
+	volatile u32 CTLR;
+	volatile u32 CFGR0;
+	volatile u32 INTR;
+	volatile u32 APB2PRSTR;
+	volatile u32 APB1PRSTR;
+	volatile u32 AHBPCENR;
+	volatile u32 APB2PCENR;
+	volatile u32 APB1PCENR;
+	volatile u32 BDCTLR;
+	volatile u32 RSTSCKR;
+} RCC_TypeDef;
+
+typedef struct {
+	volatile u32 INTFR;
+	volatile u32 INTFCR;
+} DMA_TypeDef;
+
+typedef struct {
+	volatile u32 CFGR;
+	volatile u32 CNTR;
+	volatile u32 PADDR;
+	volatile u32 MADDR;
+} DMA_Channel_TypeDef;
+
+// DATAR is widened to 32 bits so the simulator can tell CPU writes apart
+// from an idle register (HOST_DATAR_IDLE is never a valid 8/16-bit frame).
+typedef struct {
+	volatile u16 CTLR1;
+	volatile u16 CTLR2;
+	volatile u16 STATR;
+	volatile u32 DATAR;
+	volatile u16 CRCR;
+	volatile u16 RCRCR;
+	volatile u16 TCRCR;
+	volatile u16 HSCR;
+} SPI_TypeDef;
+
+typedef struct {
+	volatile u16 CTLR1;
+	volatile u16 CTLR2;
+	volatile u16 OADDR1;
+	volatile u16 OADDR2;
+	volatile u32 DATAR;
+	volatile u16 STAR1;
+	volatile u16 STAR2;
+	volatile u16 CKCFGR;
+	volatile u16 RTR;
+} I2C_TypeDef;
+
+typedef struct {
+	volatile u32 STATR;
+	volatile u32 DATAR;
+	volatile u32 BRR;
+	volatile u32 CTLR1;
+	volatile u32 CTLR2;
+	volatile u32 CTLR3;
+	volatile u32 GPR;
+} USART_TypeDef;
+
+typedef struct {
+	volatile u16 CTLR1;
+	volatile u16 CTLR2;
+	volatile u16 SMCFGR;
+	volatile u16 DMAINTENR;
+	volatile u16 INTFR;
+	volatile u16 SWEVGR;
+	volatile u16 CHCTLR1;
+	volatile u16 CHCTLR2;
+	volatile u16 CCER;
+	volatile u16 CNT;
+	volatile u16 PSC;
+	volatile u16 ATRLR;
+	volatile u16 RPTCR;
+	volatile u32 CH1CVR;
+	volatile u32 CH2CVR;
+	volatile u32 CH3CVR;
+	volatile u32 CH4CVR;
+	volatile u16 BDTR;
+	volatile u16 DMACFGR;
+	volatile u16 DMAADR;
+} TIM_TypeDef;
+
+typedef struct {
+	volatile u32 ACTLR;
+	volatile u32 KEYR;
+	volatile u32 OBKEYR;
+	volatile u32 STATR;
+	volatile u32 CTLR;
+	volatile u32 ADDR;
+	volatile u32 RESERVED;
+	volatile u32 OBR;
+	volatile u32 WPR;
+	volatile u32 MODEKEYR;
+} FLASH_TypeDef;
+
+typedef struct {
+	volatile u16 RDPR;
+	volatile u16 USER;
+	volatile u16 Data0;
+	volatile u16 Data1;
+	volatile u16 WRPR0;
+	volatile u16 WRPR1;
+} OB_TypeDef;
+
+typedef struct {
+	volatile u32 STATR;
+	volatile u32 CTLR1;
+	volatile u32 CTLR2;
+	volatile u32 SAMPTR1;
+	volatile u32 SAMPTR2;
+	volatile u32 IOFR[4];
+	volatile u32 WDHTR;
+	volatile u32 WDLTR;
+	volatile u32 RSQR1;
+	volatile u32 RSQR2;
+	volatile u32 RSQR3;
+	volatile u32 ISQR;
+	volatile u32 IDATAR[4];
+	volatile u32 RDATAR;
+} ADC_TypeDef;
+
+#include "host_sim.h"
+
+//! ####################################
+//! PERIPHERAL INSTANCES
+//! ####################################
+
+#define SysTick			(host_touch(), &host_SysTick)
+#define RCC				(host_touch(), &host_RCC)
+#define AFIO			(host_touch(), &host_AFIO)
+#define GPIOA			(host_touch(), &host_GPIO[0])
+#define GPIOB			(host_touch(), &host_GPIO[1])
+#define GPIOC			(host_touch(), &host_GPIO[2])
+#define GPIOD			(host_touch(), &host_GPIO[3])
+#define DMA1			(host_touch(), &host_DMA1)
+#define DMA1_Channel1	(host_touch(), &host_DMA1_Channel[0])
+#define DMA1_Channel2	(host_touch(), &host_DMA1_Channel[1])
+#define DMA1_Channel3	(host_touch(), &host_DMA1_Channel[2])
+#define DMA1_Channel4	(host_touch(), &host_DMA1_Channel[3])
+#define DMA1_Channel5	(host_touch(), &host_DMA1_Channel[4])
+#define DMA1_Channel6	(host_touch(), &host_DMA1_Channel[5])
+#define DMA1_Channel7	(host_touch(), &host_DMA1_Channel[6])
+#define SPI1			(host_touch(), &host_SPI1)
+#define I2C1			(host_touch_id(HOST_ACCESS_I2C1), &host_I2C1)
+#define USART1			(host_touch_id(HOST_ACCESS_USART1), &host_USART1)
+#define TIM1			(host_touch(), &host_TIM1)
+#define TIM2			(host_touch(), &host_TIM2)
+#define FLASH			(host_touch_id(HOST_ACCESS_FLASH), &host_FLASH)
+#define OB				(host_touch(), &host_OB)
+#define ADC1			(host_touch(), &host_ADC1)
+
+#define FLASH_BASE		((u32)0x08000000)
+#define SRAM_BASE		((u32)0x20000000)
+
+//! ####################################
+//! INTERRUPTS
+//! ####################################
+
+typedef enum {
+	SysTicK_IRQn			= 12,
+	SW_Handler_IRQn			= 14,
+	WWDG_IRQn				= 16,
+	PVD_IRQn				= 17,
+	FLASH_IRQn				= 18,
+	RCC_IRQn				= 19,
+	EXTI7_0_IRQn			= 20,
+	AWU_IRQn				= 21,
+	DMA1_Channel1_IRQn		= 22,
+	DMA1_Channel2_IRQn		= 23,
+	DMA1_Channel3_IRQn		= 24,
+	DMA1_Channel4_IRQn		= 25,
+	DMA1_Channel5_IRQn		= 26,
+	DMA1_Channel6_IRQn		= 27,
+	DMA1_Channel7_IRQn		= 28,
+	ADC_IRQn				= 29,
+	I2C1_EV_IRQn			= 30,
+	I2C1_ER_IRQn			= 31,
+	USART1_IRQn				= 32,
+	SPI1_IRQn				= 33,
+	TIM1_BRK_IRQn			= 34,
+	TIM1_UP_IRQn			= 35,
+	TIM1_TRG_COM_IRQn		= 36,
+	TIM1_CC_IRQn			= 37,
+	TIM2_IRQn				= 38,
+} IRQn_Type;
+
+#define NVIC_EnableIRQ(irq)		host_nvic_enable((irq), 1)
+#define NVIC_DisableIRQ(irq)	host_nvic_enable((irq), 0)
+#define NVIC_SetPriority(irq, prio)	((void)(irq), (void)(prio))
+#define __disable_irq()			host_irq_global(0)
+#define __enable_irq()			host_irq_global(1)
+#define __WFI()					host_wfi()
+#define __NOP()					host_cycles_add(1)
+
+//! ####################################
+//! CORE FUNCTIONS
+//! ####################################
+
+static inline void SystemInit(void) { host_reset(); }
+static inline void Delay_Us(u32 n) { host_delay(n * DELAY_US_TIME); }
+static inline void Delay_Ms(u32 n) { host_delay(n * DELAY_MS_TIME); }
+static inline void Delay_Tiny(u32 n) { host_delay(n); }
+
+//! ####################################
+//! GPIO
+//! ####################################
+
+enum GPIOports { GPIO_port_A = 0, GPIO_port_B = 1, GPIO_port_C = 2, GPIO_port_D = 3 };
+
+enum GPIOpins {
+	PA0 = 0,  PA1, PA2, PA3, PA4, PA5, PA6, PA7,
+	PC0 = 32, PC1, PC2, PC3, PC4, PC5, PC6, PC7,
+	PD0 = 48, PD1, PD2, PD3, PD4, PD5, PD6, PD7,
+};
+
+#define GPIO_Speed_In			0
+#define GPIO_Speed_10MHz		1
+#define GPIO_Speed_2MHz			2
+#define GPIO_Speed_50MHz		3
+
+#define GPIO_CNF_IN_ANALOG		0
+#define GPIO_CNF_IN_FLOATING	4
+#define GPIO_CNF_IN_PUPD		8
+#define GPIO_CNF_OUT_PP			0
+#define GPIO_CNF_OUT_OD			4
+#define GPIO_CNF_OUT_PP_AF		8
+#define GPIO_CNF_OUT_OD_AF		12
+
+#define GPIO_CFGLR_IN_ANALOG		0
+#define GPIO_CFGLR_IN_FLOAT			4
+#define GPIO_CFGLR_IN_PUPD			8
+#define GPIO_CFGLR_OUT_10Mhz_PP		1
+#define GPIO_CFGLR_OUT_2Mhz_PP		2
+#define GPIO_CFGLR_OUT_50Mhz_PP		3
+#define GPIO_CFGLR_OUT_10Mhz_OD		5
+#define GPIO_CFGLR_OUT_2Mhz_OD		6
+#define GPIO_CFGLR_OUT_50Mhz_OD		7
+#define GPIO_CFGLR_OUT_10Mhz_AF_PP	9
+#define GPIO_CFGLR_OUT_2Mhz_AF_PP	10
+#define GPIO_CFGLR_OUT_50Mhz_AF_PP	11
+
+#define GPIO_BSHR_BS0	((u32)0x00000001)
+#define GPIO_BSHR_BS1	((u32)0x00000002)
+#define GPIO_BSHR_BS2	((u32)0x00000004)
+#define GPIO_BSHR_BS3	((u32)0x00000008)
+#define GPIO_BSHR_BS4	((u32)0x00000010)
+#define GPIO_BSHR_BS5	((u32)0x00000020)
+#define GPIO_BSHR_BS6	((u32)0x00000040)
+#define GPIO_BSHR_BS7	((u32)0x00000080)
+#define GPIO_BSHR_BR0	((u32)0x00010000)
+#define GPIO_BSHR_BR1	((u32)0x00020000)
+#define GPIO_BSHR_BR2	((u32)0x00040000)
+#define GPIO_BSHR_BR3	((u32)0x00080000)
+#define GPIO_BSHR_BR4	((u32)0x00100000)
+#define GPIO_BSHR_BR5	((u32)0x00200000)
+#define GPIO_BSHR_BR6	((u32)0x00400000)
+#define GPIO_BSHR_BR7	((u32)0x00800000)
+
+#define funGpioInitAll()			host_gpio_init_all()
+#define funPinMode(pin, mode)		host_gpio_mode((pin), (mode))
+#define funDigitalWrite(pin, value)	host_gpio_write((pin), (value))
+#define funDigitalRead(pin)			host_gpio_read(pin)
+
+#define AFIO_PCFR1_TIM1_REMAP_NOREMAP			((u32)0x00000000)
+#define AFIO_PCFR1_TIM1_REMAP_PARTIALREMAP1		((u32)0x00000040)
+#define AFIO_PCFR1_TIM1_REMAP_PARTIALREMAP2		((u32)0x00000080)
+#define AFIO_PCFR1_TIM1_REMAP_FULLREMAP			((u32)0x000000C0)
+#define AFIO_PCFR1_TIM2_REMAP_NOREMAP			((u32)0x00000000)
+#define AFIO_PCFR1_TIM2_REMAP_PARTIALREMAP1		((u32)0x00000100)
+#define AFIO_PCFR1_TIM2_REMAP_PARTIALREMAP2		((u32)0x00000200)
+#define AFIO_PCFR1_TIM2_REMAP_FULLREMAP			((u32)0x00000300)
+
+//! ####################################
+//! RCC
+//! ####################################
+
+#define RCC_ADCPRE				((u32)0x0000F800)
+
+#define RCC_AHBPeriph_DMA1			((u32)0x00000001)
+#define RCC_AHBPeriph_SRAM			((u32)0x00000004)
+#define RCC_DMA1EN					RCC_AHBPeriph_DMA1
+
+#define RCC_APB2Periph_AFIO			((u32)0x00000001)
+#define RCC_APB2Periph_GPIOA		((u32)0x00000004)
+#define RCC_APB2Periph_GPIOC		((u32)0x00000010)
+#define RCC_APB2Periph_GPIOD		((u32)0x00000020)
+#define RCC_APB2Periph_ADC1			((u32)0x00000200)
+#define RCC_APB2Periph_TIM1			((u32)0x00000800)
+#define RCC_APB2Periph_SPI1			((u32)0x00001000)
+#define RCC_APB2Periph_USART1		((u32)0x00004000)
+
+#define RCC_APB1Periph_TIM2			((u32)0x00000001)
+#define RCC_APB1Periph_WWDG			((u32)0x00000800)
+#define RCC_APB1Periph_I2C1			((u32)0x00200000)
+#define RCC_APB1Periph_PWR			((u32)0x10000000)
+
+//! ####################################
+//! SYSTICK
+//! ####################################
+
+#define SYSTICK_CTLR_STE		(1<<0)
+#define SYSTICK_CTLR_STIE		(1<<1)
+#define SYSTICK_CTLR_STCLK		(1<<2)
+#define SYSTICK_CTLR_STRE		(1<<3)
+#define SYSTICK_CTLR_SWIE		(1u<<31)
+#define SYSTICK_SR_CNTIF		(1<<0)
+
+//! ####################################
+//! DMA
+//! ####################################
+
+#define DMA_CFGR1_EN			((u32)0x0001)
+#define DMA_CFGR1_TCIE			((u32)0x0002)
+#define DMA_CFGR1_HTIE			((u32)0x0004)
+#define DMA_CFGR1_TEIE			((u32)0x0008)
+#define DMA_CFGR1_DIR			((u32)0x0010)
+#define DMA_CFGR1_CIRC			((u32)0x0020)
+#define DMA_CFGR1_PINC			((u32)0x0040)
+#define DMA_CFGR1_MINC			((u32)0x0080)
+#define DMA_CFGR1_PSIZE_0		((u32)0x0100)
+#define DMA_CFGR1_PSIZE_1		((u32)0x0200)
+#define DMA_CFGR1_MSIZE_0		((u32)0x0400)
+#define DMA_CFGR1_MSIZE_1		((u32)0x0800)
+#define DMA_CFGR1_PL_0			((u32)0x1000)
+#define DMA_CFGR1_PL_1			((u32)0x2000)
+#define DMA_CFGR1_MEM2MEM		((u32)0x4000)
+
+#define DMA_DIR_PeripheralDST			DMA_CFGR1_DIR
+#define DMA_DIR_PeripheralSRC			((u32)0x0000)
+#define DMA_Mode_Circular				DMA_CFGR1_CIRC
+#define DMA_Mode_Normal					((u32)0x0000)
+#define DMA_PeripheralInc_Enable		DMA_CFGR1_PINC
+#define DMA_PeripheralInc_Disable		((u32)0x0000)
+#define DMA_MemoryInc_Enable			DMA_CFGR1_MINC
+#define DMA_MemoryInc_Disable			((u32)0x0000)
+#define DMA_PeripheralDataSize_Byte		((u32)0x0000)
+#define DMA_PeripheralDataSize_HalfWord	((u32)0x0100)
+#define DMA_PeripheralDataSize_Word		((u32)0x0200)
+#define DMA_MemoryDataSize_Byte			((u32)0x0000)
+#define DMA_MemoryDataSize_HalfWord		((u32)0x0400)
+#define DMA_MemoryDataSize_Word			((u32)0x0800)
+#define DMA_Priority_Low				((u32)0x0000)
+#define DMA_Priority_Medium				((u32)0x1000)
+#define DMA_Priority_High				((u32)0x2000)
+#define DMA_Priority_VeryHigh			((u32)0x3000)
+#define DMA_M2M_Enable					DMA_CFGR1_MEM2MEM
+#define DMA_M2M_Disable					((u32)0x0000)
+
+#define DMA_IT_TC		((u32)0x0002)
+#define DMA_IT_HT		((u32)0x0004)
+#define DMA_IT_TE		((u32)0x0008)
+
+// INTFR / INTFCR: 4 flags (GIF, TCIF, HTIF, TEIF) per channel
+#define DMA1_IT_GL(ch)	((u32)0x1 << (((ch) - 1) * 4))
+#define DMA1_IT_TC(ch)	((u32)0x2 << (((ch) - 1) * 4))
+#define DMA1_IT_HT(ch)	((u32)0x4 << (((ch) - 1) * 4))
+#define DMA1_IT_TE(ch)	((u32)0x8 << (((ch) - 1) * 4))
+
+#define DMA1_IT_GL1		DMA1_IT_GL(1)
+#define DMA1_IT_TC1		DMA1_IT_TC(1)
+#define DMA1_IT_HT1		DMA1_IT_HT(1)
+#define DMA1_IT_GL2		DMA1_IT_GL(2)
+#define DMA1_IT_TC2		DMA1_IT_TC(2)
+#define DMA1_IT_HT2		DMA1_IT_HT(2)
+#define DMA1_IT_GL3		DMA1_IT_GL(3)
+#define DMA1_IT_TC3		DMA1_IT_TC(3)
+#define DMA1_IT_HT3		DMA1_IT_HT(3)
+#define DMA1_IT_GL4		DMA1_IT_GL(4)
+#define DMA1_IT_TC4		DMA1_IT_TC(4)
+#define DMA1_IT_HT4		DMA1_IT_HT(4)
+#define DMA1_IT_GL5		DMA1_IT_GL(5)
+#define DMA1_IT_TC5		DMA1_IT_TC(5)
+#define DMA1_IT_HT5		DMA1_IT_HT(5)
+#define DMA1_IT_GL6		DMA1_IT_GL(6)
+#define DMA1_IT_TC6		DMA1_IT_TC(6)
+#define DMA1_IT_HT6		DMA1_IT_HT(6)
+#define DMA1_IT_GL7		DMA1_IT_GL(7)
+#define DMA1_IT_TC7		DMA1_IT_TC(7)
+#define DMA1_IT_HT7		DMA1_IT_HT(7)
+
+#define DMA1_FLAG_TC3	DMA1_IT_TC3
+#define DMA1_FLAG_HT3	DMA1_IT_HT3
+#define DMA1_FLAG_TC4	DMA1_IT_TC4
+#define DMA1_FLAG_TC6	DMA1_IT_TC6
+#define DMA1_FLAG_TC7	DMA1_IT_TC7
+
+#define DMA_CGIF4		DMA1_IT_GL4
+#define DMA_CTCIF4		DMA1_IT_TC4
+#define DMA_CHTIF4		DMA1_IT_HT4
+
+//! ####################################
+//! SPI
+//! ####################################
+
+#define SPI_CPHA_1Edge					((u16)0x0000)
+#define SPI_CPHA_2Edge					((u16)0x0001)
+#define SPI_CPOL_Low					((u16)0x0000)
+#define SPI_CPOL_High					((u16)0x0002)
+#define SPI_Mode_Master					((u16)0x0104)
+#define SPI_Mode_Slave					((u16)0x0000)
+#define SPI_BaudRatePrescaler_2			((u16)0x0000)
+#define SPI_BaudRatePrescaler_4			((u16)0x0008)
+#define SPI_BaudRatePrescaler_8			((u16)0x0010)
+#define SPI_BaudRatePrescaler_16		((u16)0x0018)
+#define SPI_NSS_Soft					((u16)0x0200)
+#define SPI_DataSize_8b					((u16)0x0000)
+#define SPI_DataSize_16b				((u16)0x0800)
+#define SPI_Direction_2Lines_FullDuplex	((u16)0x0000)
+#define SPI_Direction_1Line_Tx			((u16)0xC000)
+
+#define SPI_CTLR1_BR					((u16)0x0038)
+#define SPI_CTLR1_SPE					((u16)0x0040)
+#define SPI_CTLR1_DFF					((u16)0x0800)
+#define CTLR1_SPE_Set					SPI_CTLR1_SPE
+#define CTLR1_SPE_Reset					((u16)0xFFBF)
+
+#define SPI_CTLR2_RXDMAEN				((u16)0x0001)
+#define SPI_CTLR2_TXDMAEN				((u16)0x0002)
+#define SPI_I2S_DMAReq_Rx				SPI_CTLR2_RXDMAEN
+#define SPI_I2S_DMAReq_Tx				SPI_CTLR2_TXDMAEN
+
+#define SPI_STATR_RXNE					((u16)0x0001)
+#define SPI_STATR_TXE					((u16)0x0002)
+#define SPI_STATR_BSY					((u16)0x0080)
+
+//! ####################################
+//! I2C
+//! ####################################
+
+#define I2C_CTLR1_PE			((u16)0x0001)
+#define I2C_CTLR1_START			((u16)0x0100)
+#define I2C_CTLR1_STOP			((u16)0x0200)
+#define I2C_CTLR1_ACK			((u16)0x0400)
+#define I2C_CTLR1_SWRST			((u16)0x8000)
+
+#define I2C_CTLR2_FREQ			((u16)0x003F)
+#define I2C_CTLR2_ITERREN		((u16)0x0100)
+#define I2C_CTLR2_ITEVTEN		((u16)0x0200)
+#define I2C_CTLR2_ITBUFEN		((u16)0x0400)
+#define I2C_CTLR2_DMAEN			((u16)0x0800)
+#define I2C_CTLR2_LAST			((u16)0x1000)
+
+#define I2C_STAR1_SB			((u16)0x0001)
+#define I2C_STAR1_ADDR			((u16)0x0002)
+#define I2C_STAR1_BTF			((u16)0x0004)
+#define I2C_STAR1_STOPF			((u16)0x0010)
+#define I2C_STAR1_RXNE			((u16)0x0040)
+#define I2C_STAR1_TXE			((u16)0x0080)
+#define I2C_STAR1_BERR			((u16)0x0100)
+#define I2C_STAR1_ARLO			((u16)0x0200)
+#define I2C_STAR1_AF			((u16)0x0400)
+#define I2C_STAR1_OVR			((u16)0x0800)
+
+#define I2C_STAR2_MSL			((u16)0x0001)
+#define I2C_STAR2_BUSY			((u16)0x0002)
+#define I2C_STAR2_TRA			((u16)0x0004)
+
+#define I2C_STAR2_DUALF			((u16)0x0080)
+
+#define I2C_CKCFGR_DUTY			((u16)0x4000)
+#define I2C_CKCFGR_CCR			((u16)0x0FFF)
+#define I2C_CKCFGR_FS			((u16)0x8000)
+
+// STAR2 << 16 | STAR1
+#define I2C_EVENT_MASTER_MODE_SELECT					((u32)0x00030001)
+#define I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED		((u32)0x00070082)
+#define I2C_EVENT_MASTER_RECEIVER_MODE_SELECTED			((u32)0x00030002)
+#define I2C_EVENT_MASTER_BYTE_TRANSMITTED				((u32)0x00070084)
+#define I2C_EVENT_MASTER_BYTE_RECEIVED					((u32)0x00030040)
+
+//! ####################################
+//! USART
+//! ####################################
+
+#define USART_STATR_ORE			((u32)0x0008)
+#define USART_STATR_IDLE		((u32)0x0010)
+#define USART_STATR_RXNE		((u32)0x0020)
+#define USART_STATR_TC			((u32)0x0040)
+#define USART_STATR_TXE			((u32)0x0080)
+
+#define USART_CTLR1_RE			((u32)0x0004)
+#define USART_CTLR1_TE			((u32)0x0008)
+#define USART_CTLR1_IDLEIE		((u32)0x0010)
+#define USART_CTLR1_RXNEIE		((u32)0x0020)
+#define USART_CTLR1_TCIE		((u32)0x0040)
+#define USART_CTLR1_TXEIE		((u32)0x0080)
+#define USART_CTLR1_UE			((u32)0x2000)
+#define CTLR1_UE_Set			USART_CTLR1_UE
+
+#define USART_CTLR3_DMAR		((u32)0x0040)
+#define USART_CTLR3_DMAT		((u32)0x0080)
+
+#define USART_WordLength_8b		((u32)0x0000)
+#define USART_Parity_No			((u32)0x0000)
+#define USART_Mode_Rx			USART_CTLR1_RE
+#define USART_Mode_Tx			USART_CTLR1_TE
+#define USART_StopBits_1		((u32)0x0000)
+#define USART_DMAReq_Rx			USART_CTLR3_DMAR
+#define USART_DMAReq_Tx			USART_CTLR3_DMAT
+
+//! ####################################
+//! TIMERS
+//! ####################################
+
+#define TIM_CEN			((u16)0x0001)
+#define TIM_UDIS		((u16)0x0002)
+#define TIM_URS			((u16)0x0004)
+#define TIM_OPM			((u16)0x0008)
+#define TIM_DIR			((u16)0x0010)
+#define TIM_ARPE		((u16)0x0080)
+
+#define TIM_UIE			((u16)0x0001)
+#define TIM_CC1IE		((u16)0x0002)
+#define TIM_CC2IE		((u16)0x0004)
+#define TIM_CC3IE		((u16)0x0008)
+#define TIM_CC4IE		((u16)0x0010)
+#define TIM_UDE			((u16)0x0100)
+#define TIM_CC1DE		((u16)0x0200)
+#define TIM_CC2DE		((u16)0x0400)
+#define TIM_CC3DE		((u16)0x0800)
+#define TIM_CC4DE		((u16)0x1000)
+
+#define TIM_UIF			((u16)0x0001)
+#define TIM_CC1IF		((u16)0x0002)
+#define TIM_CC2IF		((u16)0x0004)
+#define TIM_CC3IF		((u16)0x0008)
+#define TIM_CC4IF		((u16)0x0010)
+
+#define TIM_UG			((u16)0x0001)
+#define TIM_CC1G		((u16)0x0002)
+
+#define TIM_CC1S_0		((u16)0x0001)
+#define TIM_CC1S_1		((u16)0x0002)
+#define TIM_OC1FE		((u16)0x0004)
+#define TIM_OC1PE		((u16)0x0008)
+#define TIM_OC1M_0		((u16)0x0010)
+#define TIM_OC1M_1		((u16)0x0020)
+#define TIM_OC1M_2		((u16)0x0040)
+#define TIM_CC2S_0		((u16)0x0100)
+#define TIM_CC2S_1		((u16)0x0200)
+#define TIM_OC2PE		((u16)0x0800)
+#define TIM_OC2M_0		((u16)0x1000)
+#define TIM_OC2M_1		((u16)0x2000)
+#define TIM_OC2M_2		((u16)0x4000)
+#define TIM_CC3S_0		((u16)0x0001)
+#define TIM_OC3PE		((u16)0x0008)
+#define TIM_OC3M_0		((u16)0x0010)
+#define TIM_OC3M_1		((u16)0x0020)
+#define TIM_OC3M_2		((u16)0x0040)
+#define TIM_CC4S_0		((u16)0x0100)
+#define TIM_OC4PE		((u16)0x0800)
+#define TIM_OC4M_0		((u16)0x1000)
+#define TIM_OC4M_1		((u16)0x2000)
+#define TIM_OC4M_2		((u16)0x4000)
+
+#define TIM_CC1E		((u16)0x0001)
+#define TIM_CC1P		((u16)0x0002)
+#define TIM_CC1NE		((u16)0x0004)
+#define TIM_CC1NP		((u16)0x0008)
+#define TIM_CC2E		((u16)0x0010)
+#define TIM_CC2P		((u16)0x0020)
+#define TIM_CC2NE		((u16)0x0040)
+#define TIM_CC2NP		((u16)0x0080)
+#define TIM_CC3E		((u16)0x0100)
+#define TIM_CC3P		((u16)0x0200)
+#define TIM_CC3NE		((u16)0x0400)
+#define TIM_CC3NP		((u16)0x0800)
+#define TIM_CC4E		((u16)0x1000)
+#define TIM_CC4P		((u16)0x2000)
+
+#define TIM_MOE			((u16)0x8000)
+
+//! ####################################
+//! FLASH
+//! ####################################
+
+#define FLASH_KEY1				((u32)0x45670123)
+#define FLASH_KEY2				((u32)0xCDEF89AB)
+
+#define FLASH_ACTLR_LATENCY		((u32)0x00000003)
+#define FLASH_ACTLR_LATENCY_0	((u32)0x00000001)
+#define FLASH_ACTLR_LATENCY_1	((u32)0x00000002)
+
+#define FLASH_Latency_0			((u32)0x00000000)
+#define FLASH_Latency_1			((u32)0x00000001)
+
+#define FLASH_STATR_BSY			((u32)0x00000001)
+#define FLASH_STATR_WRPRTERR	((u32)0x00000010)
+#define FLASH_STATR_EOP			((u32)0x00000020)
+
+#define FLASH_CTLR_PG			((u32)0x00000001)
+#define FLASH_CTLR_PER			((u32)0x00000002)
+#define FLASH_CTLR_MER			((u32)0x00000004)
+#define FLASH_CTLR_OPTPG		((u32)0x00000010)
+#define FLASH_CTLR_OPTER		((u32)0x00000020)
+#define FLASH_CTLR_STRT			((u32)0x00000040)
+#define FLASH_CTLR_LOCK			((u32)0x00000080)
+
+#define CR_PG_Set				FLASH_CTLR_PG
+#define CR_PG_Reset				(~FLASH_CTLR_PG)
+#define CR_PER_Set				FLASH_CTLR_PER
+#define CR_PER_Reset			(~FLASH_CTLR_PER)
+#define CR_OPTPG_Set			FLASH_CTLR_OPTPG
+#define CR_OPTPG_Reset			(~FLASH_CTLR_OPTPG)
+#define CR_OPTER_Set			FLASH_CTLR_OPTER
+#define CR_OPTER_Reset			(~FLASH_CTLR_OPTER)
+#define CR_STRT_Set				FLASH_CTLR_STRT
+#define CR_LOCK_Set				FLASH_CTLR_LOCK
+
+//! ####################################
+//! ADC
+//! ####################################
+
+#define ADC_SCAN		((u32)0x00000100)
+#define ADC_ADON		((u32)0x00000001)
+#define ADC_CONT		((u32)0x00000002)
+#define ADC_CAL			((u32)0x00000004)
+#define ADC_RSTCAL		((u32)0x00000008)
+#define ADC_DMA			((u32)0x00000100)
+#define ADC_EXTSEL		((u32)0x000E0000)
+#define ADC_SWSTART		((u32)0x00400000)
+
+#endif
@@ -0,0 +1,1419 @@
+// MIT License
+// Copyright (c) 2025 UniTheCat
+// See ch32fun.h in this directory for the full license text.
+
+// Simulated CH32V003 peripherals, see host_sim.h for the model.
+
+#define _GNU_SOURCE
+#include "ch32fun.h"
+
+#include <stdlib.h>
+#include <time.h>
+#include <sys/mman.h>
+
+volatile u64 host_cycles;
+int host_access;
+host_stats_t host_stats;
+
+SysTick_Type		host_SysTick;
+RCC_TypeDef			host_RCC;
+AFIO_TypeDef		host_AFIO;
+GPIO_TypeDef		host_GPIO[4];
+DMA_TypeDef			host_DMA1;
+DMA_Channel_TypeDef	host_DMA1_Channel[7];
+SPI_TypeDef			host_SPI1;
+I2C_TypeDef			host_I2C1;
+USART_TypeDef		host_USART1;
+TIM_TypeDef			host_TIM1;
+TIM_TypeDef			host_TIM2;
+FLASH_TypeDef		host_FLASH;
+OB_TypeDef			host_OB;
+ADC_TypeDef			host_ADC1;
+
+void (*host_spi_sink)(u16 frame);
+void (*host_i2c_sink)(u8 addr, u8 byte, int first);
+int (*host_i2c_ack)(u8 addr);
+u8 (*host_i2c_read)(u8 addr);
+void (*host_uart_sink)(u8 byte);
+void (*host_gpio_trace)(int port, u32 old_outdr, u32 new_outdr, u64 cycle);
+void (*host_tim_trace)(int tim, u16 ccer, u64 cycle);
+u16 (*host_adc_sample)(int channel);
+
+static u64 sim_time;			// peripherals are up to date until here
+static int irq_global = 1;
+static int irq_depth;
+static u8 nvic_enabled[HOST_IRQ_COUNT];
+
+uint64_t host_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+//! ####################################
+//! IRQ VECTORS
+//! ####################################
+
+// weak references: a handler that the program does not define resolves to 0
+#define HOST_VECTOR(name) extern void name(void) __attribute__((weak));
+HOST_VECTOR(SysTick_Handler)
+HOST_VECTOR(DMA1_Channel1_IRQHandler)
+HOST_VECTOR(DMA1_Channel2_IRQHandler)
+HOST_VECTOR(DMA1_Channel3_IRQHandler)
+HOST_VECTOR(DMA1_Channel4_IRQHandler)
+HOST_VECTOR(DMA1_Channel5_IRQHandler)
+HOST_VECTOR(DMA1_Channel6_IRQHandler)
+HOST_VECTOR(DMA1_Channel7_IRQHandler)
+HOST_VECTOR(ADC1_IRQHandler)
+HOST_VECTOR(I2C1_EV_IRQHandler)
+HOST_VECTOR(I2C1_ER_IRQHandler)
+HOST_VECTOR(USART1_IRQHandler)
+HOST_VECTOR(SPI1_IRQHandler)
+HOST_VECTOR(TIM1_UP_IRQHandler)
+HOST_VECTOR(TIM1_CC_IRQHandler)
+HOST_VECTOR(TIM2_IRQHandler)
+
+static void (*vector(int irq))(void) {
+	switch (irq) {
+		case SysTicK_IRQn:			return SysTick_Handler;
+		case DMA1_Channel1_IRQn:	return DMA1_Channel1_IRQHandler;
+		case DMA1_Channel2_IRQn:	return DMA1_Channel2_IRQHandler;
+		case DMA1_Channel3_IRQn:	return DMA1_Channel3_IRQHandler;
+		case DMA1_Channel4_IRQn:	return DMA1_Channel4_IRQHandler;
+		case DMA1_Channel5_IRQn:	return DMA1_Channel5_IRQHandler;
+		case DMA1_Channel6_IRQn:	return DMA1_Channel6_IRQHandler;
+		case DMA1_Channel7_IRQn:	return DMA1_Channel7_IRQHandler;
+		case ADC_IRQn:				return ADC1_IRQHandler;
+		case I2C1_EV_IRQn:			return I2C1_EV_IRQHandler;
+		case I2C1_ER_IRQn:			return I2C1_ER_IRQHandler;
+		case USART1_IRQn:			return USART1_IRQHandler;
+		case SPI1_IRQn:				return SPI1_IRQHandler;
+		case TIM1_UP_IRQn:			return TIM1_UP_IRQHandler;
+		case TIM1_CC_IRQn:			return TIM1_CC_IRQHandler;
+		case TIM2_IRQn:				return TIM2_IRQHandler;
+		default:					return 0;
+	}
+}
+
+//! ####################################
+//! DMA
+//! ####################################
+
+typedef struct {
+	u32 last_cntr;
+	u32 last_maddr;
+	u32 last_cfgr;
+	u32 reload;
+	u32 pos;
+} DMA_State_t;
+
+static DMA_State_t dma_st[7];
+
+static int dma_ready(int ch) {
+	DMA_Channel_TypeDef *c = &host_DMA1_Channel[ch];
+	return (c->CFGR & DMA_CFGR1_EN) && c->CNTR;
+}
+
+static u32 dma_mem_addr(int ch, u32 width) {
+	DMA_Channel_TypeDef *c = &host_DMA1_Channel[ch];
+	return c->MADDR + ((c->CFGR & DMA_CFGR1_MINC) ? dma_st[ch].pos * width : 0);
+}
+
+static u32 size_bytes(u32 bits) {
+	return bits == 0 ? 1 : bits == 1 ? 2 : 4;
+}
+
+static u32 mem_read(u32 addr, u32 width) {
+	switch (width) {
+		case 1:		return *(volatile u8 *)(uintptr_t)addr;
+		case 2:		return *(volatile u16 *)(uintptr_t)addr;
+		default:	return *(volatile u32 *)(uintptr_t)addr;
+	}
+}
+
+static void mem_write(u32 addr, u32 width, u32 value) {
+	switch (width) {
+		case 1:		*(volatile u8 *)(uintptr_t)addr = value; break;
+		case 2:		*(volatile u16 *)(uintptr_t)addr = value; break;
+		default:	*(volatile u32 *)(uintptr_t)addr = value; break;
+	}
+}
+
+static void gpio_update(void);
+
+static void dma_step(int ch) {
+	DMA_Channel_TypeDef *c = &host_DMA1_Channel[ch];
+	DMA_State_t *s = &dma_st[ch];
+	u32 shift = ch * 4;
+
+	host_stats.dma_items[ch]++;
+	s->pos++;
+	c->CNTR--;
+
+	if (s->reload >= 2 && s->pos == s->reload / 2) {
+		host_DMA1.INTFR |= (DMA_IT_HT | 1) << shift;
+	}
+	if (c->CNTR == 0) {
+		host_DMA1.INTFR |= (DMA_IT_TC | 1) << shift;
+		if (c->CFGR & DMA_CFGR1_CIRC) {
+			c->CNTR = s->reload;
+			s->pos = 0;
+		}
+	}
+	s->last_cntr = c->CNTR;
+}
+
+// memory -> peripheral request. The item is returned to the requesting
+// peripheral; register targets other than the data registers it consumes
+// itself (timer ATRLR/CHxCVR, GPIO BSHR, ...) receive the write.
+static int dma_m2p(int ch, u32 *out) {
+	if (!dma_ready(ch)) return 0;
+	DMA_Channel_TypeDef *c = &host_DMA1_Channel[ch];
+	u32 msize = size_bytes((c->CFGR >> 10) & 3);
+	u32 psize = size_bytes((c->CFGR >> 8) & 3);
+	u32 value = mem_read(dma_mem_addr(ch, msize), msize);
+	u32 paddr = c->PADDR;
+
+	if (paddr != (u32)(uintptr_t)&host_SPI1.DATAR &&
+		paddr != (u32)(uintptr_t)&host_I2C1.DATAR &&
+		paddr != (u32)(uintptr_t)&host_USART1.DATAR && paddr) {
+		mem_write(paddr, psize, value);
+		if (paddr >= (u32)(uintptr_t)&host_GPIO[0] && paddr < (u32)(uintptr_t)&host_GPIO[4]) {
+			gpio_update();
+		}
+	}
+
+	if (out) *out = value;
+	dma_step(ch);
+	return 1;
+}
+
+// peripheral -> memory request
+static int dma_p2m(int ch, u32 value) {
+	if (!dma_ready(ch)) return 0;
+	DMA_Channel_TypeDef *c = &host_DMA1_Channel[ch];
+	u32 msize = size_bytes((c->CFGR >> 10) & 3);
+	mem_write(dma_mem_addr(ch, msize), msize, value);
+	dma_step(ch);
+	return 1;
+}
+
+// request from a peripheral that can run either direction (timers, ADC)
+static void dma_request(int ch, u32 periph_value) {
+	if (host_DMA1_Channel[ch].CFGR & DMA_CFGR1_DIR) dma_m2p(ch, 0);
+	else dma_p2m(ch, periph_value);
+}
+
+static void dma_pre(void) {
+	if (host_DMA1.INTFCR) {
+		u32 clr = host_DMA1.INTFCR;
+		for (int ch = 0; ch < 7; ch++) {
+			if (clr & (1u << (ch * 4))) clr |= 0xFu << (ch * 4);
+		}
+		host_DMA1.INTFR &= ~clr;
+		host_DMA1.INTFCR = 0;
+	}
+
+	for (int ch = 0; ch < 7; ch++) {
+		DMA_Channel_TypeDef *c = &host_DMA1_Channel[ch];
+		DMA_State_t *s = &dma_st[ch];
+
+		if (c->MADDR != s->last_maddr) {
+			s->last_maddr = c->MADDR;
+			s->pos = 0;
+		}
+		if (c->CNTR != s->last_cntr) {
+			s->last_cntr = c->CNTR;
+			s->reload = c->CNTR;
+			s->pos = 0;
+		}
+		if ((c->CFGR & DMA_CFGR1_EN) && !(s->last_cfgr & DMA_CFGR1_EN)) {
+			s->reload = c->CNTR;
+			s->pos = 0;
+		}
+		s->last_cfgr = c->CFGR;
+
+		// memory to memory runs unpaced
+		if ((c->CFGR & DMA_CFGR1_MEM2MEM) && dma_ready(ch)) {
+			u32 msize = size_bytes((c->CFGR >> 10) & 3);
+			u32 psize = size_bytes((c->CFGR >> 8) & 3);
+			while (c->CNTR) {
+				u32 src = c->PADDR + ((c->CFGR & DMA_CFGR1_PINC) ? s->pos * psize : 0);
+				u32 value = mem_read(src, psize);
+				mem_write(dma_mem_addr(ch, msize), msize, value);
+				dma_step(ch);
+				if (s->pos == 0) break;		// circular memory to memory makes no sense
+			}
+		}
+	}
+}
+
+static int dma_irq_pending(int ch) {
+	u32 flags = (host_DMA1.INTFR >> (ch * 4)) & 0xE;
+	return flags & host_DMA1_Channel[ch].CFGR & (DMA_CFGR1_TCIE | DMA_CFGR1_HTIE | DMA_CFGR1_TEIE);
+}
+
+//! ####################################
+//! SYSTICK
+//! ####################################
+
+static u32 st_last_cnt;
+static u32 st_frac;
+
+static void systick_pre(void) {
+	if (host_SysTick.CNT != st_last_cnt) {
+		st_last_cnt = host_SysTick.CNT;
+		st_frac = 0;
+	}
+}
+
+static u32 systick_div(void) {
+	return (host_SysTick.CTLR & SYSTICK_CTLR_STCLK) ? 1 : 8;
+}
+
+static u64 systick_next(void) {
+	if (!(host_SysTick.CTLR & SYSTICK_CTLR_STE)) return HOST_NEVER;
+	u64 d = (u32)(host_SysTick.CMP - host_SysTick.CNT);
+	if (d == 0) d = 1ull << 32;
+	return sim_time + d * systick_div() - st_frac;
+}
+
+static void systick_advance(u64 dt) {
+	if (!(host_SysTick.CTLR & SYSTICK_CTLR_STE)) return;
+	u32 div = systick_div();
+	u64 total = st_frac + dt;
+	u64 steps = total / div;
+	st_frac = total % div;
+
+	u32 cnt = host_SysTick.CNT;
+	u64 d = (u32)(host_SysTick.CMP - cnt);
+	if (d == 0) d = 1ull << 32;
+
+	if (steps >= d) {
+		host_SysTick.SR |= SYSTICK_SR_CNTIF;
+		if (host_SysTick.CTLR & SYSTICK_CTLR_STRE) {
+			u64 period = (u64)host_SysTick.CMP + 1;
+			host_SysTick.CNT = (u32)((steps - d) % period);
+		} else {
+			host_SysTick.CNT = cnt + (u32)steps;
+		}
+	} else {
+		host_SysTick.CNT = cnt + (u32)steps;
+	}
+	st_last_cnt = host_SysTick.CNT;
+}
+
+//! ####################################
+//! GPIO
+//! ####################################
+
+typedef struct {
+	u32 last_out;
+	u32 ext_level;
+	u32 ext_driven;
+} GPIO_State_t;
+
+static GPIO_State_t gpio_st[4];
+
+typedef struct {
+	u64 cycle;
+	u8 pin;
+	u8 level;
+} GPIO_Edge_t;
+
+#define GPIO_EDGE_QUEUE 256
+static GPIO_Edge_t gpio_edges[GPIO_EDGE_QUEUE];
+static int gpio_edge_count;
+
+static void tim_capture_edge(int pin, int level);
+
+static void gpio_recompute_input(int port) {
+	GPIO_TypeDef *g = &host_GPIO[port];
+	GPIO_State_t *s = &gpio_st[port];
+	u32 in = 0;
+
+	for (int pin = 0; pin < 8; pin++) {
+		u32 cfg = (g->CFGLR >> (pin * 4)) & 0xF;
+		u32 bit = 1u << pin;
+		int level;
+
+		if (cfg & 0x3) {
+			level = (g->OUTDR & bit) != 0;				// output: reads back the driven level
+		} else if (s->ext_driven & bit) {
+			level = (s->ext_level & bit) != 0;
+		} else if ((cfg & 0xC) == GPIO_CNF_IN_PUPD) {
+			level = (g->OUTDR & bit) != 0;				// pull-up / pull-down from OUTDR
+		} else {
+			level = 0;
+		}
+		if (level) in |= bit;
+	}
+	g->INDR = in;
+}
+
+static void gpio_update(void) {
+	for (int port = 0; port < 4; port++) {
+		GPIO_TypeDef *g = &host_GPIO[port];
+		GPIO_State_t *s = &gpio_st[port];
+
+		if (g->BSHR) {
+			u32 bshr = g->BSHR;
+			g->OUTDR = (g->OUTDR & ~(bshr >> 16)) | (bshr & 0xFFFF);
+			g->BSHR = 0;
+		}
+		if (g->BCR) {
+			g->OUTDR &= ~g->BCR;
+			g->BCR = 0;
+		}
+		if (g->OUTDR != s->last_out) {
+			host_stats.gpio_edges += __builtin_popcount(g->OUTDR ^ s->last_out);
+			if (host_gpio_trace) host_gpio_trace(port, s->last_out, g->OUTDR, sim_time);
+			s->last_out = g->OUTDR;
+		}
+		gpio_recompute_input(port);
+	}
+}
+
+static void gpio_drive(int pin, int level) {
+	int port = pin >> 4;
+	u32 bit = 1u << (pin & 0xF);
+	GPIO_State_t *s = &gpio_st[port];
+	int prev = (host_GPIO[port].INDR & bit) != 0;
+
+	s->ext_driven |= bit;
+	if (level) s->ext_level |= bit;
+	else s->ext_level &= ~bit;
+	gpio_recompute_input(port);
+
+	int now = (host_GPIO[port].INDR & bit) != 0;
+	if (now != prev) tim_capture_edge(pin, now);
+}
+
+static u64 gpio_next(void) {
+	return gpio_edge_count ? gpio_edges[0].cycle : HOST_NEVER;
+}
+
+static void gpio_events(void) {
+	while (gpio_edge_count && gpio_edges[0].cycle <= sim_time) {
+		GPIO_Edge_t e = gpio_edges[0];
+		memmove(gpio_edges, gpio_edges + 1, --gpio_edge_count * sizeof(GPIO_Edge_t));
+		gpio_drive(e.pin, e.level);
+	}
+}
+
+void host_gpio_init_all(void) {
+	host_touch();
+	host_RCC.APB2PCENR |= RCC_APB2Periph_GPIOA | RCC_APB2Periph_GPIOC | RCC_APB2Periph_GPIOD;
+}
+
+void host_gpio_mode(int pin, uint32_t mode) {
+	GPIO_TypeDef *g = (host_touch(), &host_GPIO[pin >> 4]);
+	int n = pin & 0xF;
+	g->CFGLR = (g->CFGLR & ~(0xFu << (4 * n))) | (mode << (4 * n));
+	gpio_recompute_input(pin >> 4);
+}
+
+void host_gpio_write(int pin, int value) {
+	GPIO_TypeDef *g = (host_touch(), &host_GPIO[pin >> 4]);
+	g->BSHR = 1u << ((pin & 0xF) + (value ? 0 : 16));
+	gpio_update();
+}
+
+int host_gpio_read(int pin) {
+	GPIO_TypeDef *g = (host_touch(), &host_GPIO[pin >> 4]);
+	return (g->INDR >> (pin & 0xF)) & 1;
+}
+
+void host_gpio_input(int pin, int level) {
+	host_sync();
+	gpio_drive(pin, level);
+	host_sync();
+}
+
+int host_gpio_schedule(int pin, int level, uint64_t cycle) {
+	if (gpio_edge_count == GPIO_EDGE_QUEUE) return 0;
+	int i = gpio_edge_count++;
+	while (i > 0 && gpio_edges[i - 1].cycle > cycle) {
+		gpio_edges[i] = gpio_edges[i - 1];
+		i--;
+	}
+	gpio_edges[i] = (GPIO_Edge_t){ cycle, (u8)pin, (u8)level };
+	return 1;
+}
+
+//! ####################################
+//! SPI1
+//! ####################################
+
+static struct {
+	int shifting;
+	u64 shift_end;
+	u16 shift;
+	int buf_full;
+	u16 buf;
+} spi;
+
+static u64 spi_frame_cycles(void) {
+	u32 br = (host_SPI1.CTLR1 >> 3) & 7;
+	u32 bits = (host_SPI1.CTLR1 & SPI_CTLR1_DFF) ? 16 : 8;
+	return (2ull << br) * bits;
+}
+
+static void spi_status(void) {
+	u16 st = host_SPI1.STATR & ~(SPI_STATR_TXE | SPI_STATR_BSY);
+	if (!spi.buf_full) st |= SPI_STATR_TXE;
+	if (spi.shifting || spi.buf_full) st |= SPI_STATR_BSY;
+	host_SPI1.STATR = st;
+}
+
+static void spi_kick(void) {
+	if (!(host_SPI1.CTLR1 & SPI_CTLR1_SPE)) return;
+
+	if (!spi.buf_full && (host_SPI1.CTLR2 & SPI_CTLR2_TXDMAEN)) {
+		u32 v;
+		if (dma_m2p(2, &v)) {
+			spi.buf = v;
+			spi.buf_full = 1;
+		}
+	}
+	if (!spi.shifting && spi.buf_full) {
+		spi.shift = spi.buf;
+		spi.buf_full = 0;
+		spi.shifting = 1;
+		spi.shift_end = sim_time + spi_frame_cycles();
+		if (host_SPI1.CTLR2 & SPI_CTLR2_TXDMAEN) {
+			u32 v;
+			if (dma_m2p(2, &v)) {
+				spi.buf = v;
+				spi.buf_full = 1;
+			}
+		}
+	}
+	spi_status();
+}
+
+static void spi_pre(void) {
+	if (host_SPI1.DATAR != HOST_DATAR_IDLE) {
+		u32 v = host_SPI1.DATAR;
+		host_SPI1.DATAR = HOST_DATAR_IDLE;
+		if (host_SPI1.CTLR1 & SPI_CTLR1_SPE) {
+			spi.buf = v;
+			spi.buf_full = 1;
+		}
+	}
+	spi_kick();
+}
+
+static u64 spi_next(void) {
+	return spi.shifting ? spi.shift_end : HOST_NEVER;
+}
+
+static void spi_events(void) {
+	while (spi.shifting && spi.shift_end <= sim_time) {
+		spi.shifting = 0;
+		host_stats.spi_frames++;
+		host_SPI1.STATR |= SPI_STATR_RXNE;
+		if (host_spi_sink) host_spi_sink(spi.shift);
+
+		u64 end = spi.shift_end;
+		spi_kick();
+		// back-to-back frames start exactly when the previous one ends
+		if (spi.shifting) spi.shift_end = end + spi_frame_cycles();
+	}
+}
+
+//! ####################################
+//! I2C1
+//! ####################################
+
+enum {
+	I2C_ST_IDLE,
+	I2C_ST_SB,			// START sent, waiting for the address byte
+	I2C_ST_ADDR,		// shifting the address byte
+	I2C_ST_TX,
+	I2C_ST_RX,
+	I2C_ST_NACKED,		// waiting for STOP / repeated START
+};
+
+static struct {
+	int state;
+	u8 addr;
+	u64 start_at;		// START condition completes
+	u64 stop_at;		// STOP condition completes
+	u64 shift_at;		// current byte completes
+	int shifting;
+	u8 shift;
+	int buf_full;
+	u8 buf;
+	int rxne_seen;
+	int rx_done;
+} i2c;
+
+static u64 i2c_bit_cycles(void) {
+	u32 ccr = host_I2C1.CKCFGR & I2C_CKCFGR_CCR;
+	if (!ccr) return FUNCONF_SYSTEM_CORE_CLOCK / 100000;
+	if (!(host_I2C1.CKCFGR & I2C_CKCFGR_FS)) return ccr * 2;
+	return (host_I2C1.CKCFGR & I2C_CKCFGR_DUTY) ? ccr * 25 : ccr * 3;
+}
+
+static void i2c_shift_byte(u8 v) {
+	i2c.shift = v;
+	i2c.shifting = 1;
+	i2c.shift_at = sim_time + 9 * i2c_bit_cycles();
+}
+
+static void i2c_tx_write(u8 v) {
+	host_I2C1.STAR1 &= ~(I2C_STAR1_ADDR | I2C_STAR1_BTF);
+	if (!i2c.shifting) {
+		i2c_shift_byte(v);
+		host_I2C1.STAR1 |= I2C_STAR1_TXE;
+	} else {
+		i2c.buf = v;
+		i2c.buf_full = 1;
+		host_I2C1.STAR1 &= ~I2C_STAR1_TXE;
+	}
+}
+
+static void i2c_tx_dma(void) {
+	u32 v;
+	if (i2c.state == I2C_ST_TX && !i2c.buf_full && (host_I2C1.CTLR2 & I2C_CTLR2_DMAEN) && dma_m2p(5, &v)) {
+		i2c_tx_write(v);
+	}
+}
+
+static void i2c_pre(int accessed) {
+	if (!(host_I2C1.CTLR1 & I2C_CTLR1_PE)) {
+		host_I2C1.DATAR = HOST_DATAR_IDLE;
+		return;
+	}
+
+	// RXNE is cleared by the data read that follows the status read
+	if (accessed && (host_I2C1.STAR1 & I2C_STAR1_RXNE)) {
+		if (i2c.rxne_seen) {
+			host_I2C1.STAR1 &= ~I2C_STAR1_RXNE;
+			i2c.rxne_seen = 0;
+			if (i2c.state == I2C_ST_RX && !i2c.rx_done && !i2c.shifting) {
+				i2c.shifting = 1;
+				i2c.shift_at = sim_time + 9 * i2c_bit_cycles();
+			}
+		} else {
+			i2c.rxne_seen = 1;
+		}
+	}
+
+	if ((host_I2C1.CTLR1 & I2C_CTLR1_START) && !i2c.start_at) {
+		u64 at = i2c.shifting ? i2c.shift_at : sim_time;
+		i2c.start_at = at + i2c_bit_cycles();
+	}
+	if ((host_I2C1.CTLR1 & I2C_CTLR1_STOP) && !i2c.stop_at) {
+		u64 at = (i2c.shifting && i2c.state != I2C_ST_RX) ? i2c.shift_at : sim_time;
+		i2c.stop_at = at + i2c_bit_cycles();
+	}
+
+	if (host_I2C1.DATAR != HOST_DATAR_IDLE && i2c.state != I2C_ST_RX) {
+		u8 v = host_I2C1.DATAR;
+		host_I2C1.DATAR = HOST_DATAR_IDLE;
+
+		if (i2c.state == I2C_ST_SB) {
+			host_I2C1.STAR1 &= ~I2C_STAR1_SB;
+			i2c.addr = v;
+			i2c.state = I2C_ST_ADDR;
+			i2c_shift_byte(v);
+		} else if (i2c.state == I2C_ST_TX) {
+			i2c_tx_write(v);
+		}
+	}
+
+	// TX DMA requests follow TXE: a channel armed while the shifter is idle starts now
+	if (i2c.state == I2C_ST_TX && !i2c.shifting && !i2c.start_at && !i2c.stop_at) i2c_tx_dma();
+}
+
+static u64 i2c_next(void) {
+	u64 t = HOST_NEVER;
+	if (i2c.start_at && i2c.start_at < t) t = i2c.start_at;
+	if (i2c.stop_at && i2c.stop_at < t) t = i2c.stop_at;
+	if (i2c.shifting && i2c.shift_at < t) t = i2c.shift_at;
+	return t;
+}
+
+static void i2c_byte_done(void) {
+	i2c.shifting = 0;
+	host_stats.i2c_bytes++;
+
+	switch (i2c.state) {
+		case I2C_ST_ADDR: {
+			u8 addr7 = i2c.addr >> 1;
+			if (host_i2c_sink) host_i2c_sink(addr7, i2c.addr, 1);
+			if (host_i2c_ack && !host_i2c_ack(addr7)) {
+				host_I2C1.STAR1 |= I2C_STAR1_AF;
+				i2c.state = I2C_ST_NACKED;
+				break;
+			}
+			host_I2C1.STAR1 |= I2C_STAR1_ADDR;
+			if (i2c.addr & 1) {
+				host_I2C1.STAR2 &= ~I2C_STAR2_TRA;
+				i2c.state = I2C_ST_RX;
+				i2c.rx_done = 0;
+				i2c_shift_byte(0);
+			} else {
+				host_I2C1.STAR2 |= I2C_STAR2_TRA;
+				host_I2C1.STAR1 |= I2C_STAR1_TXE;
+				i2c.state = I2C_ST_TX;
+				i2c_tx_dma();
+			}
+			break;
+		}
+
+		case I2C_ST_TX:
+			if (host_i2c_sink) host_i2c_sink(i2c.addr >> 1, i2c.shift, 0);
+			if (i2c.buf_full) {
+				i2c.buf_full = 0;
+				host_I2C1.STAR1 |= I2C_STAR1_TXE;
+				i2c_shift_byte(i2c.buf);
+				// shift continues from the exact end of the previous byte
+				i2c.shift_at = sim_time + 9 * i2c_bit_cycles();
+			} else {
+				host_I2C1.STAR1 |= I2C_STAR1_BTF | I2C_STAR1_TXE;
+			}
+			i2c_tx_dma();
+			break;
+
+		case I2C_ST_RX: {
+			u8 v = host_i2c_read ? host_i2c_read(i2c.addr >> 1) : 0xFF;
+			int acked = (host_I2C1.CTLR1 & I2C_CTLR1_ACK) != 0;
+			host_I2C1.STAR1 &= ~I2C_STAR1_ADDR;
+
+			if (host_I2C1.CTLR2 & I2C_CTLR2_DMAEN) {
+				dma_p2m(6, v);
+				if ((host_I2C1.CTLR2 & I2C_CTLR2_LAST) && !dma_ready(6)) acked = 0;
+				if (acked) i2c_shift_byte(0);
+			} else {
+				if (host_I2C1.STAR1 & I2C_STAR1_RXNE) host_I2C1.STAR1 |= I2C_STAR1_BTF;
+				host_I2C1.DATAR = v;
+				host_I2C1.STAR1 |= I2C_STAR1_RXNE;
+				i2c.rxne_seen = 0;
+			}
+			if (!acked) i2c.rx_done = 1;
+			break;
+		}
+	}
+}
+
+static void i2c_events(void) {
+	if (i2c.shifting && i2c.shift_at <= sim_time) i2c_byte_done();
+
+	if (i2c.start_at && i2c.start_at <= sim_time) {
+		i2c.start_at = 0;
+		i2c.shifting = 0;
+		i2c.buf_full = 0;
+		host_I2C1.CTLR1 &= ~I2C_CTLR1_START;
+		host_I2C1.STAR1 &= ~(I2C_STAR1_ADDR | I2C_STAR1_BTF | I2C_STAR1_TXE | I2C_STAR1_RXNE);
+		host_I2C1.STAR1 |= I2C_STAR1_SB;
+		host_I2C1.STAR2 |= I2C_STAR2_MSL | I2C_STAR2_BUSY;
+		host_I2C1.DATAR = HOST_DATAR_IDLE;
+		host_stats.i2c_transactions++;
+		i2c.state = I2C_ST_SB;
+	}
+
+	if (i2c.stop_at && i2c.stop_at <= sim_time) {
+		i2c.stop_at = 0;
+		i2c.shifting = 0;
+		i2c.buf_full = 0;
+		host_I2C1.CTLR1 &= ~I2C_CTLR1_STOP;
+		host_I2C1.STAR1 &= ~(I2C_STAR1_SB | I2C_STAR1_ADDR | I2C_STAR1_BTF | I2C_STAR1_TXE | I2C_STAR1_RXNE);
+		host_I2C1.STAR2 &= ~(I2C_STAR2_MSL | I2C_STAR2_BUSY | I2C_STAR2_TRA);
+		host_I2C1.DATAR = HOST_DATAR_IDLE;
+		i2c.state = I2C_ST_IDLE;
+	}
+}
+
+static int i2c_ev_pending(void) {
+	u16 cr2 = host_I2C1.CTLR2, sr = host_I2C1.STAR1;
+	if ((cr2 & I2C_CTLR2_ITEVTEN) && (sr & (I2C_STAR1_SB | I2C_STAR1_ADDR | I2C_STAR1_BTF))) return 1;
+	if ((cr2 & I2C_CTLR2_ITEVTEN) && (cr2 & I2C_CTLR2_ITBUFEN) && (sr & (I2C_STAR1_TXE | I2C_STAR1_RXNE))) {
+		return i2c.state == I2C_ST_TX || i2c.state == I2C_ST_RX;
+	}
+	return 0;
+}
+
+static int i2c_er_pending(void) {
+	return (host_I2C1.CTLR2 & I2C_CTLR2_ITERREN) &&
+		(host_I2C1.STAR1 & (I2C_STAR1_BERR | I2C_STAR1_ARLO | I2C_STAR1_AF | I2C_STAR1_OVR));
+}
+
+//! ####################################
+//! USART1
+//! ####################################
+
+#define UART_RX_QUEUE 4096
+
+static struct {
+	int shifting;
+	u64 shift_end;
+	u8 shift;
+	int buf_full;
+	u8 buf;
+
+	u8 rxq[UART_RX_QUEUE];
+	u32 rx_head, rx_tail;
+	u64 rx_at;				// next byte lands, 0 when the line is quiet
+	u64 idle_at;			// IDLE flag raises, 0 when not armed
+	int rx_holds;			// DATAR holds a received byte, not a TX write
+	u8 rx_value;
+	int rxne_seen, idle_seen;
+} uart;
+
+static u64 uart_frame_cycles(void) {
+	return host_USART1.BRR ? (u64)host_USART1.BRR * 10 : FUNCONF_SYSTEM_CORE_CLOCK / 11520;
+}
+
+static void uart_kick(void) {
+	if (!(host_USART1.CTLR1 & USART_CTLR1_UE)) return;
+
+	if (!uart.buf_full && (host_USART1.CTLR3 & USART_CTLR3_DMAT)) {
+		u32 v;
+		if (dma_m2p(3, &v)) {
+			uart.buf = v;
+			uart.buf_full = 1;
+		}
+	}
+	if (!uart.shifting && uart.buf_full) {
+		uart.shift = uart.buf;
+		uart.buf_full = 0;
+		uart.shifting = 1;
+		uart.shift_end = sim_time + uart_frame_cycles();
+		host_USART1.STATR &= ~USART_STATR_TC;
+		if (host_USART1.CTLR3 & USART_CTLR3_DMAT) {
+			u32 v;
+			if (dma_m2p(3, &v)) {
+				uart.buf = v;
+				uart.buf_full = 1;
+			}
+		}
+	}
+	if (uart.buf_full) host_USART1.STATR &= ~USART_STATR_TXE;
+	else host_USART1.STATR |= USART_STATR_TXE;
+}
+
+static void uart_pre(int accessed) {
+	if (accessed) {
+		// status read followed by a data read clears RXNE / IDLE
+		u32 st = host_USART1.STATR;
+		if (st & USART_STATR_RXNE) {
+			if (uart.rxne_seen) {
+				host_USART1.STATR &= ~(USART_STATR_RXNE | USART_STATR_ORE);
+				uart.rxne_seen = 0;
+			} else {
+				uart.rxne_seen = 1;
+			}
+		} else if (uart.rx_holds && host_USART1.DATAR == uart.rx_value) {
+			// received byte was read, free DATAR for writes
+			host_USART1.DATAR = HOST_DATAR_IDLE;
+			uart.rx_holds = 0;
+		}
+		if (st & USART_STATR_IDLE) {
+			if (uart.idle_seen) {
+				host_USART1.STATR &= ~USART_STATR_IDLE;
+				uart.idle_seen = 0;
+			} else {
+				uart.idle_seen = 1;
+			}
+		}
+	}
+
+	u32 d = host_USART1.DATAR;
+	if (d != HOST_DATAR_IDLE && !(uart.rx_holds && d == uart.rx_value)) {
+		host_USART1.DATAR = HOST_DATAR_IDLE;
+		uart.rx_holds = 0;
+		if ((host_USART1.CTLR1 & USART_CTLR1_UE) && (host_USART1.CTLR1 & USART_CTLR1_TE)) {
+			uart.buf = d;
+			uart.buf_full = 1;
+		}
+	}
+	uart_kick();
+}
+
+static u64 uart_next(void) {
+	u64 t = HOST_NEVER;
+	if (uart.shifting) t = uart.shift_end;
+	if (uart.rx_at && uart.rx_at < t) t = uart.rx_at;
+	if (uart.idle_at && uart.idle_at < t) t = uart.idle_at;
+	return t;
+}
+
+static void uart_events(void) {
+	while (uart.shifting && uart.shift_end <= sim_time) {
+		uart.shifting = 0;
+		host_stats.uart_tx_bytes++;
+		if (host_uart_sink) host_uart_sink(uart.shift);
+		u64 end = uart.shift_end;
+		uart_kick();
+		if (uart.shifting) uart.shift_end = end + uart_frame_cycles();
+		else host_USART1.STATR |= USART_STATR_TC;
+	}
+
+	while (uart.rx_at && uart.rx_at <= sim_time) {
+		u8 b = uart.rxq[uart.rx_tail++ % UART_RX_QUEUE];
+		u32 cr1 = host_USART1.CTLR1;
+
+		if ((cr1 & USART_CTLR1_UE) && (cr1 & USART_CTLR1_RE)) {
+			host_stats.uart_rx_bytes++;
+			if (host_USART1.CTLR3 & USART_CTLR3_DMAR) {
+				if (!dma_p2m(4, b)) host_stats.uart_rx_overruns++;
+			} else {
+				if (host_USART1.STATR & USART_STATR_RXNE) {
+					host_USART1.STATR |= USART_STATR_ORE;
+					host_stats.uart_rx_overruns++;
+				}
+				host_USART1.DATAR = b;
+				host_USART1.STATR |= USART_STATR_RXNE;
+				uart.rx_holds = 1;
+				uart.rx_value = b;
+				uart.rxne_seen = 0;
+			}
+		}
+
+		u64 at = uart.rx_at;
+		if (uart.rx_tail != uart.rx_head) {
+			uart.rx_at = at + uart_frame_cycles();
+		} else {
+			uart.rx_at = 0;
+			uart.idle_at = at + uart_frame_cycles();
+		}
+	}
+
+	if (uart.idle_at && uart.idle_at <= sim_time) {
+		uart.idle_at = 0;
+		host_USART1.STATR |= USART_STATR_IDLE;
+		uart.idle_seen = 0;
+	}
+}
+
+static int uart_irq_pending(void) {
+	u32 cr1 = host_USART1.CTLR1, st = host_USART1.STATR;
+	return ((cr1 & USART_CTLR1_RXNEIE) && (st & (USART_STATR_RXNE | USART_STATR_ORE))) ||
+		((cr1 & USART_CTLR1_IDLEIE) && (st & USART_STATR_IDLE)) ||
+		((cr1 & USART_CTLR1_TXEIE) && (st & USART_STATR_TXE)) ||
+		((cr1 & USART_CTLR1_TCIE) && (st & USART_STATR_TC));
+}
+
+void host_uart_inject(const uint8_t *data, uint32_t len) {
+	host_sync();
+	for (u32 i = 0; i < len; i++) {
+		if (uart.rx_head - uart.rx_tail >= UART_RX_QUEUE) break;
+		uart.rxq[uart.rx_head++ % UART_RX_QUEUE] = data[i];
+	}
+	if (!uart.rx_at && uart.rx_head != uart.rx_tail) {
+		uart.rx_at = sim_time + uart_frame_cycles();
+		uart.idle_at = 0;
+	}
+}
+
+//! ####################################
+//! TIM1 / TIM2
+//! ####################################
+
+typedef struct {
+	TIM_TypeDef *regs;
+	u16 last_cnt;
+	u16 last_ccer;
+	u64 frac;
+	int up_dma;			// DMA channel index for the update request
+	int cc_dma[4];		// DMA channel index per capture/compare channel
+	int cc_pin[4];		// default (no remap) channel pins
+} TIM_State_t;
+
+static TIM_State_t tim_st[2] = {
+	{ &host_TIM1, 0, 0, 0, 4, { 1, 2, 5, 3 }, { PD2, PA1, PC3, PC4 } },
+	{ &host_TIM2, 0, 0, 0, 1, { 4, 6, 0, 6 }, { PD4, PD3, PC0, PD7 } },
+};
+
+static volatile u32 *tim_ccr(TIM_TypeDef *t, int ch) {
+	switch (ch) {
+		case 0:		return &t->CH1CVR;
+		case 1:		return &t->CH2CVR;
+		case 2:		return &t->CH3CVR;
+		default:	return &t->CH4CVR;
+	}
+}
+
+static u32 tim_ccs(TIM_TypeDef *t, int ch) {
+	u16 reg = ch < 2 ? t->CHCTLR1 : t->CHCTLR2;
+	return (reg >> ((ch & 1) * 8)) & 3;
+}
+
+static u32 tim_counts_to_update(TIM_TypeDef *t) {
+	u32 cnt = t->CNT, arr = t->ATRLR;
+	return cnt <= arr ? arr - cnt + 1 : 0x10000 - cnt + arr + 1;
+}
+
+// counts until the next update or enabled compare match
+static u32 tim_counts_to_event(TIM_TypeDef *t) {
+	u32 cnt = t->CNT, arr = t->ATRLR;
+	u32 n = tim_counts_to_update(t);
+
+	for (int ch = 0; ch < 4; ch++) {
+		u16 en = (TIM_CC1IE | TIM_CC1DE) << ch;
+		if (!(t->DMAINTENR & en) || tim_ccs(t, ch) != 0) continue;
+		u32 ccr = *tim_ccr(t, ch) & 0xFFFF;
+		if (ccr > cnt && ccr <= arr && ccr - cnt < n) n = ccr - cnt;
+	}
+	return n;
+}
+
+static void tim_pre(int idx) {
+	TIM_State_t *s = &tim_st[idx];
+	TIM_TypeDef *t = s->regs;
+
+	if (t->SWEVGR & TIM_UG) {
+		t->CNT = 0;
+		s->frac = 0;
+		if (!(t->CTLR1 & TIM_URS)) t->INTFR |= TIM_UIF;
+	}
+	t->SWEVGR = 0;
+
+	if (t->CNT != s->last_cnt) {
+		s->last_cnt = t->CNT;
+		s->frac = 0;
+	}
+	if (t->CCER != s->last_ccer) {
+		s->last_ccer = t->CCER;
+		if (host_tim_trace) host_tim_trace(idx + 1, t->CCER, sim_time);
+	}
+}
+
+static u64 tim_next(int idx) {
+	TIM_State_t *s = &tim_st[idx];
+	TIM_TypeDef *t = s->regs;
+	if (!(t->CTLR1 & TIM_CEN)) return HOST_NEVER;
+	u64 psc = (u64)t->PSC + 1;
+	return sim_time + tim_counts_to_event(t) * psc - s->frac;
+}
+
+static void tim_advance(int idx, u64 dt) {
+	TIM_State_t *s = &tim_st[idx];
+	TIM_TypeDef *t = s->regs;
+	if (!(t->CTLR1 & TIM_CEN)) return;
+
+	u64 psc = (u64)t->PSC + 1;
+	u64 total = s->frac + dt;
+	u64 counts = total / psc;
+	s->frac = total % psc;
+
+	while (counts) {
+		u32 n = tim_counts_to_event(t);
+		if (counts < n) {
+			t->CNT += counts;
+			break;
+		}
+		counts -= n;
+
+		if (n == tim_counts_to_update(t)) {
+			t->CNT = 0;
+			t->INTFR |= TIM_UIF;
+			if (t->DMAINTENR & TIM_UDE) dma_request(s->up_dma, 0);
+		} else {
+			t->CNT += n;
+		}
+
+		for (int ch = 0; ch < 4; ch++) {
+			if (tim_ccs(t, ch) != 0) continue;
+			if ((*tim_ccr(t, ch) & 0xFFFF) != t->CNT) continue;
+			t->INTFR |= TIM_CC1IF << ch;
+			if (t->DMAINTENR & (TIM_CC1DE << ch)) dma_request(s->cc_dma[ch], t->CNT);
+		}
+	}
+	s->last_cnt = t->CNT;
+}
+
+static void tim_capture_edge(int pin, int level) {
+	for (int idx = 0; idx < 2; idx++) {
+		TIM_State_t *s = &tim_st[idx];
+		TIM_TypeDef *t = s->regs;
+
+		for (int ch = 0; ch < 4; ch++) {
+			// CCxS 01 captures the channel's own pin, 10 the pin of its pair
+			u32 ccs = tim_ccs(t, ch);
+			if (ccs == 1 && s->cc_pin[ch] != pin) continue;
+			if (ccs == 2 && s->cc_pin[ch ^ 1] != pin) continue;
+			if (ccs != 1 && ccs != 2) continue;
+			if (!(t->CCER & (TIM_CC1E << (ch * 4)))) continue;
+			int falling = (t->CCER & (TIM_CC1P << (ch * 4))) != 0;
+			if (falling == level) continue;
+
+			if (t->INTFR & (TIM_CC1IF << ch)) t->INTFR |= 0x200 << ch;	// overcapture
+			*tim_ccr(t, ch) = t->CNT;
+			t->INTFR |= TIM_CC1IF << ch;
+			if (t->DMAINTENR & (TIM_CC1DE << ch)) dma_request(s->cc_dma[ch], t->CNT);
+		}
+	}
+}
+
+static int tim_up_pending(TIM_TypeDef *t) {
+	return (t->DMAINTENR & TIM_UIE) && (t->INTFR & TIM_UIF);
+}
+
+static int tim_cc_pending(TIM_TypeDef *t) {
+	return (t->DMAINTENR & t->INTFR & 0x1E) != 0;
+}
+
+//! ####################################
+//! ADC1
+//! ####################################
+
+#define ADC_CONV_CYCLES (FUNCONF_SYSTEM_CORE_CLOCK / 1000000 * 4)
+
+static struct {
+	u64 conv_at;
+	u32 seq_idx;
+} adc;
+
+static void adc_pre(void) {
+	u32 cr2 = host_ADC1.CTLR2;
+	if (!(cr2 & ADC_ADON)) {
+		adc.conv_at = 0;
+		return;
+	}
+	host_ADC1.CTLR2 &= ~(ADC_CAL | ADC_RSTCAL);
+	if (!adc.conv_at && ((cr2 & ADC_CONT) || (cr2 & ADC_SWSTART))) {
+		host_ADC1.CTLR2 &= ~ADC_SWSTART;
+		adc.conv_at = sim_time + ADC_CONV_CYCLES;
+	}
+}
+
+static u64 adc_next(void) {
+	return adc.conv_at ? adc.conv_at : HOST_NEVER;
+}
+
+static void adc_events(void) {
+	while (adc.conv_at && adc.conv_at <= sim_time) {
+		u32 len = ((host_ADC1.RSQR1 >> 20) & 0xF) + 1;
+		if (!(host_ADC1.CTLR1 & ADC_SCAN)) len = 1;
+		u32 channel = (host_ADC1.RSQR3 >> (5 * (adc.seq_idx % 6))) & 0x1F;
+		u16 v = host_adc_sample ? host_adc_sample(channel) : 512;
+
+		host_ADC1.RDATAR = v;
+		host_ADC1.STATR |= 0x2;		// EOC
+		if (host_ADC1.CTLR2 & ADC_DMA) dma_p2m(0, v);
+
+		u64 at = adc.conv_at;
+		adc.conv_at = 0;
+		if (++adc.seq_idx >= len) {
+			adc.seq_idx = 0;
+			if (host_ADC1.CTLR2 & ADC_CONT) adc.conv_at = at + ADC_CONV_CYCLES;
+		} else {
+			adc.conv_at = at + ADC_CONV_CYCLES;
+		}
+	}
+}
+
+//! ####################################
+//! FLASH
+//! ####################################
+
+static u16 *flash_mem;
+static u16 flash_shadow[HOST_FLASH_SIZE / 2];
+
+static struct {
+	int key_state;
+	u64 busy_until;
+	s64 ops_left;		// -1 no power cut pending
+} flash = { .ops_left = -1 };
+
+static void flash_map(void) {
+	void *p = mmap((void *)(uintptr_t)FLASH_BASE, HOST_FLASH_SIZE, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	if (p != (void *)(uintptr_t)FLASH_BASE) {
+		fprintf(stderr, "host_sim: cannot map flash at 0x%08X\n", FLASH_BASE);
+		exit(1);
+	}
+	flash_mem = p;
+	for (u32 i = 0; i < HOST_FLASH_SIZE / 2; i++) {
+		flash_mem[i] = flash_shadow[i] = HOST_FLASH_ERASED;
+	}
+}
+
+uint8_t *host_flash_mem(void) {
+	return (u8 *)flash_mem;
+}
+
+void host_flash_power_cut(int64_t ops) {
+	flash.ops_left = ops;
+}
+
+// one erase or program operation; 0 when the power is already gone
+static int flash_powered(void) {
+	if (flash.ops_left == 0) {
+		host_stats.flash_lost_ops++;
+		return 0;
+	}
+	if (flash.ops_left > 0) flash.ops_left--;
+	return 1;
+}
+
+static void flash_pre(void) {
+	FLASH_TypeDef *f = &host_FLASH;
+
+	if (f->KEYR) {
+		if (f->KEYR == FLASH_KEY1) flash.key_state = 1;
+		else if (f->KEYR == FLASH_KEY2 && flash.key_state == 1) {
+			f->CTLR &= ~FLASH_CTLR_LOCK;
+			flash.key_state = 0;
+		} else flash.key_state = 0;
+		f->KEYR = 0;
+	}
+	f->OBKEYR = 0;
+
+	// the core stalls on flash while it is busy
+	if (flash.busy_until > host_cycles) host_cycles = flash.busy_until;
+
+	int unlocked = !(f->CTLR & FLASH_CTLR_LOCK);
+
+	if (unlocked && (f->CTLR & FLASH_CTLR_PER) && (f->CTLR & FLASH_CTLR_STRT)) {
+		u32 addr = (f->ADDR - FLASH_BASE) & ~(HOST_FLASH_PAGE - 1);
+		if (addr < HOST_FLASH_SIZE && flash_powered()) {
+			for (u32 i = 0; i < HOST_FLASH_PAGE / 2; i++) {
+				flash_mem[addr / 2 + i] = flash_shadow[addr / 2 + i] = HOST_FLASH_ERASED;
+			}
+			host_stats.flash_erases++;
+			host_stats.flash_page_erases[addr / HOST_FLASH_PAGE]++;
+			flash.busy_until = sim_time + HOST_FLASH_ERASE_CYCLES;
+			f->STATR |= FLASH_STATR_BSY;
+		}
+		f->CTLR &= ~FLASH_CTLR_STRT;
+	}
+
+	if (memcmp(flash_mem, flash_shadow, HOST_FLASH_SIZE)) {
+		int programming = unlocked && (f->CTLR & FLASH_CTLR_PG);
+		for (u32 i = 0; i < HOST_FLASH_SIZE / 2; i++) {
+			if (flash_mem[i] == flash_shadow[i]) continue;
+			if (programming && !flash_powered()) {
+				flash_mem[i] = flash_shadow[i];
+			} else if (programming) {
+				host_stats.flash_programs++;
+				if (flash_shadow[i] != HOST_FLASH_ERASED) host_stats.flash_overwrites++;
+				flash_shadow[i] = flash_mem[i];
+				flash.busy_until = sim_time + HOST_FLASH_PROGRAM_CYCLES;
+				f->STATR |= FLASH_STATR_BSY;
+			} else {
+				host_stats.flash_stray_writes++;
+				flash_mem[i] = flash_shadow[i];
+			}
+		}
+	}
+}
+
+static void flash_events(void) {
+	if ((host_FLASH.STATR & FLASH_STATR_BSY) && flash.busy_until <= sim_time) {
+		host_FLASH.STATR = (host_FLASH.STATR & ~FLASH_STATR_BSY) | FLASH_STATR_EOP;
+	}
+}
+
+static u64 flash_next(void) {
+	return (host_FLASH.STATR & FLASH_STATR_BSY) ? flash.busy_until : HOST_NEVER;
+}
+
+//! ####################################
+//! SCHEDULER
+//! ####################################
+
+static int irq_pending(int irq) {
+	switch (irq) {
+		case SysTicK_IRQn:
+			return (host_SysTick.CTLR & SYSTICK_CTLR_STIE) && (host_SysTick.SR & SYSTICK_SR_CNTIF);
+		case DMA1_Channel1_IRQn: case DMA1_Channel2_IRQn: case DMA1_Channel3_IRQn:
+		case DMA1_Channel4_IRQn: case DMA1_Channel5_IRQn: case DMA1_Channel6_IRQn:
+		case DMA1_Channel7_IRQn:
+			return dma_irq_pending(irq - DMA1_Channel1_IRQn);
+		case I2C1_EV_IRQn:	return i2c_ev_pending();
+		case I2C1_ER_IRQn:	return i2c_er_pending();
+		case USART1_IRQn:	return uart_irq_pending();
+		case TIM1_UP_IRQn:	return tim_up_pending(&host_TIM1);
+		case TIM1_CC_IRQn:	return tim_cc_pending(&host_TIM1);
+		case TIM2_IRQn:		return tim_up_pending(&host_TIM2) || tim_cc_pending(&host_TIM2);
+		default:			return 0;
+	}
+}
+
+static void pre_all(int access) {
+	systick_pre();
+	gpio_update();
+	dma_pre();
+	spi_pre();
+	i2c_pre(access == HOST_ACCESS_I2C1);
+	uart_pre(access == HOST_ACCESS_USART1);
+	tim_pre(0);
+	tim_pre(1);
+	adc_pre();
+	if (access == HOST_ACCESS_FLASH) flash_pre();
+}
+
+uint64_t host_next_event(void) {
+	u64 t = systick_next(), n;
+	if ((n = gpio_next()) < t) t = n;
+	if ((n = spi_next()) < t) t = n;
+	if ((n = i2c_next()) < t) t = n;
+	if ((n = uart_next()) < t) t = n;
+	if ((n = tim_next(0)) < t) t = n;
+	if ((n = tim_next(1)) < t) t = n;
+	if ((n = adc_next()) < t) t = n;
+	if ((n = flash_next()) < t) t = n;
+	return t;
+}
+
+static void advance_to(u64 t) {
+	if (t < sim_time) t = sim_time;
+	u64 dt = t - sim_time;
+	sim_time = t;
+
+	systick_advance(dt);
+	tim_advance(0, dt);
+	tim_advance(1, dt);
+	gpio_events();
+	spi_events();
+	i2c_events();
+	uart_events();
+	adc_events();
+	flash_events();
+}
+
+static void dispatch(void) {
+	if (!irq_global || irq_depth) return;
+
+	// lowest IRQ number first, re-scan after every handler. A source that
+	// stays pending after its handler is retried a bounded number of times
+	// so a handler that never clears its flag cannot hang the host.
+	u8 runs[HOST_IRQ_COUNT] = { 0 };
+	for (int irq = 0; irq < HOST_IRQ_COUNT; irq++) {
+		if (!nvic_enabled[irq] || runs[irq] >= 8 || !irq_pending(irq)) continue;
+		void (*handler)(void) = vector(irq);
+		if (!handler) continue;
+
+		runs[irq]++;
+		irq_depth++;
+		host_cycles += HOST_IRQ_CYCLES;
+		u64 c0 = host_cycles;
+		u64 t0 = host_now_ns();
+		handler();
+		u64 ns = host_now_ns() - t0;
+		u64 cyc = host_cycles - c0;
+		irq_depth--;
+
+		host_irq_stat_t *st = &host_stats.irq[irq];
+		st->count++;
+		st->cycles_total += cyc;
+		if (cyc > st->cycles_max) st->cycles_max = cyc;
+		st->ns_total += ns;
+		if (ns > st->ns_max) st->ns_max = ns;
+
+		pre_all(HOST_ACCESS_ANY);
+		irq = -1;
+	}
+}
+
+void host_sync(void) {
+	int access = host_access;
+	host_access = HOST_ACCESS_ANY;
+
+	pre_all(access);
+	for (;;) {
+		u64 t = host_next_event();
+		if (t > host_cycles) break;
+		advance_to(t);
+		pre_all(HOST_ACCESS_ANY);
+		dispatch();
+	}
+	advance_to(host_cycles);
+	dispatch();
+}
+
+void host_delay(uint64_t cycles) {
+	u64 target = host_cycles + cycles;
+	// writes through cached peripheral pointers land before the clock moves
+	host_sync();
+	while (host_cycles < target) {
+		u64 t = host_next_event();
+		host_cycles = t < target ? t : target;
+		host_sync();
+	}
+}
+
+void host_wfi(void) {
+	host_sync();
+	u64 t = host_next_event();
+	if (t == HOST_NEVER) return;
+	if (t > host_cycles) host_cycles = t;
+	host_sync();
+}
+
+void host_nvic_enable(int irq, int enable) {
+	if (irq < 0 || irq >= HOST_IRQ_COUNT) return;
+	nvic_enabled[irq] = enable;
+	host_sync();
+}
+
+void host_irq_global(int enable) {
+	irq_global = enable;
+	if (enable) host_sync();
+}
+
+//! ####################################
+//! RESET
+//! ####################################
+
+void host_reset(void) {
+	host_cycles = 0;
+	sim_time = 0;
+	irq_global = 1;
+	irq_depth = 0;
+	host_access = HOST_ACCESS_ANY;
+	memset(nvic_enabled, 0, sizeof(nvic_enabled));
+	memset(&host_stats, 0, sizeof(host_stats));
+
+	memset(&host_SysTick, 0, sizeof(host_SysTick));
+	memset(&host_RCC, 0, sizeof(host_RCC));
+	memset(&host_AFIO, 0, sizeof(host_AFIO));
+	memset(host_GPIO, 0, sizeof(host_GPIO));
+	memset(&host_DMA1, 0, sizeof(host_DMA1));
+	memset(host_DMA1_Channel, 0, sizeof(host_DMA1_Channel));
+	memset(&host_SPI1, 0, sizeof(host_SPI1));
+	memset(&host_I2C1, 0, sizeof(host_I2C1));
+	memset(&host_USART1, 0, sizeof(host_USART1));
+	memset(&host_TIM1, 0, sizeof(host_TIM1));
+	memset(&host_TIM2, 0, sizeof(host_TIM2));
+	memset(&host_FLASH, 0, sizeof(host_FLASH));
+	memset(&host_ADC1, 0, sizeof(host_ADC1));
+
+	for (int p = 0; p < 4; p++) host_GPIO[p].CFGLR = 0x44444444;
+	host_SPI1.DATAR = HOST_DATAR_IDLE;
+	host_SPI1.STATR = SPI_STATR_TXE;
+	host_I2C1.DATAR = HOST_DATAR_IDLE;
+	host_USART1.DATAR = HOST_DATAR_IDLE;
+	host_USART1.STATR = USART_STATR_TXE | USART_STATR_TC;
+	host_TIM1.ATRLR = host_TIM2.ATRLR = 0xFFFF;
+	host_FLASH.CTLR = FLASH_CTLR_LOCK;
+	host_OB = (OB_TypeDef){ 0x5AA5, 0x00FF, 0x00FF, 0x00FF, 0x00FF, 0x00FF };
+
+	st_last_cnt = st_frac = 0;
+	memset(dma_st, 0, sizeof(dma_st));
+	memset(gpio_st, 0, sizeof(gpio_st));
+	gpio_edge_count = 0;
+	memset(&spi, 0, sizeof(spi));
+	memset(&i2c, 0, sizeof(i2c));
+	memset(&uart, 0, sizeof(uart));
+	memset(&adc, 0, sizeof(adc));
+	for (int i = 0; i < 2; i++) {
+		tim_st[i].last_cnt = tim_st[i].last_ccer = 0;
+		tim_st[i].frac = 0;
+	}
+	flash.key_state = 0;
+	flash.busy_until = 0;
+	flash.ops_left = -1;
+	for (int p = 0; p < 4; p++) gpio_recompute_input(p);
+}
+
+// flash contents survive host_reset(), like a power cycle
+__attribute__((constructor)) static void host_boot(void) {
+	flash_map();
+	host_reset();
+}
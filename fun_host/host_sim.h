@@ -0,0 +1,190 @@
+// MIT License
+// Copyright (c) 2025 UniTheCat
+// See ch32fun.h in this directory for the full license text.
+
+// Simulated CH32V003 peripherals for host builds
+// All peripherals are advanced against one virtual clock (host_cycles, in
+// HCLK cycles). Time only moves when firmware touches a register, calls
+// Delay_Us/Ms, or when a bench calls host_run/host_delay; pure computation is
+// free. This keeps runs deterministic: the same program produces the same
+// register traffic, IRQ order and counters on every machine, while the wall
+// clock (host_now_ns) is left for measuring the host cost of hot paths.
+//
+// Register writes are picked up on the next access to any peripheral:
+//   - DMA:    CNTR/MADDR differing from the last value the engine left there
+//             reloads the channel; EN 0->1 does the same
+//   - SPI/I2C/USART: DATAR != HOST_DATAR_IDLE is a CPU write
+//   - flags:  write-to-clear registers (DMA INTFCR, TIM SWEVGR, GPIO BSHR/BCR)
+//             are consumed and zeroed
+// Reads cannot be observed. Flags that hardware clears with a status-then-data
+// read (I2C RXNE, USART RXNE/IDLE) are cleared on the second access to the
+// same peripheral after the flag was seen; DATAR keeps its value for that read.
+
+#ifndef _HOST_SIM_H
+#define _HOST_SIM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// cycles charged for every peripheral register access
+#ifndef HOST_IO_CYCLES
+	#define HOST_IO_CYCLES			4
+#endif
+
+// cycles charged for IRQ entry + exit
+#ifndef HOST_IRQ_CYCLES
+	#define HOST_IRQ_CYCLES			24
+#endif
+
+#define HOST_DATAR_IDLE				0xFFFF0000u
+#define HOST_IRQ_COUNT				40
+#define HOST_NEVER					UINT64_MAX
+
+#define HOST_FLASH_SIZE				(16 * 1024)
+#define HOST_FLASH_PAGE				64
+#define HOST_FLASH_ERASED			0xE339
+#define HOST_FLASH_ERASE_CYCLES		(FUNCONF_SYSTEM_CORE_CLOCK / 1000 * 3)		// 3 ms
+#define HOST_FLASH_PROGRAM_CYCLES	(FUNCONF_SYSTEM_CORE_CLOCK / 1000000 * 50)	// 50 us
+
+//! ####################################
+//! STATE
+//! ####################################
+
+extern volatile uint64_t host_cycles;
+
+extern SysTick_Type			host_SysTick;
+extern RCC_TypeDef			host_RCC;
+extern AFIO_TypeDef			host_AFIO;
+extern GPIO_TypeDef			host_GPIO[4];
+extern DMA_TypeDef			host_DMA1;
+extern DMA_Channel_TypeDef	host_DMA1_Channel[7];
+extern SPI_TypeDef			host_SPI1;
+extern I2C_TypeDef			host_I2C1;
+extern USART_TypeDef		host_USART1;
+extern TIM_TypeDef			host_TIM1;
+extern TIM_TypeDef			host_TIM2;
+extern FLASH_TypeDef		host_FLASH;
+extern OB_TypeDef			host_OB;
+extern ADC_TypeDef			host_ADC1;
+
+typedef struct {
+	uint32_t count;
+	uint64_t cycles_total;		// virtual cycles spent inside the handler
+	uint32_t cycles_max;
+	uint64_t ns_total;			// host wall clock spent inside the handler
+	uint64_t ns_max;
+} host_irq_stat_t;
+
+typedef struct {
+	uint64_t spi_frames;
+	uint64_t i2c_bytes;			// address + data bytes on the wire
+	uint64_t i2c_transactions;	// START conditions
+	uint64_t uart_tx_bytes;
+	uint64_t uart_rx_bytes;
+	uint64_t uart_rx_overruns;
+	uint64_t dma_items[7];
+	uint64_t gpio_edges;
+	uint64_t flash_erases;
+	uint64_t flash_programs;	// 16-bit program operations
+	uint64_t flash_stray_writes;// writes to flash without PG, reverted
+	uint64_t flash_overwrites;	// programs on a non-erased halfword
+	uint64_t flash_lost_ops;	// erases/programs dropped after a power cut
+	uint32_t flash_page_erases[HOST_FLASH_SIZE / HOST_FLASH_PAGE];
+	host_irq_stat_t irq[HOST_IRQ_COUNT];
+} host_stats_t;
+
+extern host_stats_t host_stats;
+
+//! ####################################
+//! HOOKS
+//! ####################################
+
+// every SPI1 frame shifted out (8 or 16 bits)
+extern void (*host_spi_sink)(uint16_t frame);
+// every I2C byte written by the master: addr is the 7-bit address, first is 1 for the address byte
+extern void (*host_i2c_sink)(uint8_t addr, uint8_t byte, int first);
+// return 0 to NACK the address byte, default ACKs every address
+extern int (*host_i2c_ack)(uint8_t addr);
+// byte returned for master reads, default 0xFF
+extern uint8_t (*host_i2c_read)(uint8_t addr);
+// every byte leaving USART1 TX
+extern void (*host_uart_sink)(uint8_t byte);
+// GPIO output data changes: port 0..3 (A, B, C, D)
+extern void (*host_gpio_trace)(int port, uint32_t old_outdr, uint32_t new_outdr, uint64_t cycle);
+// timer channel enable changes (CCER), e.g. IR carrier on/off
+extern void (*host_tim_trace)(int tim, uint16_t ccer, uint64_t cycle);
+// ADC conversion result for a channel, default 512
+extern uint16_t (*host_adc_sample)(int channel);
+
+//! ####################################
+//! API
+//! ####################################
+
+// peripherals whose flags are cleared by a read sequence (status then data)
+// are told which register block is being accessed
+enum {
+	HOST_ACCESS_ANY = 0,
+	HOST_ACCESS_I2C1,
+	HOST_ACCESS_USART1,
+	HOST_ACCESS_FLASH,
+};
+
+extern int host_access;
+
+void host_reset(void);
+void host_sync(void);
+uint64_t host_next_event(void);
+
+static inline void host_touch(void) {
+	host_cycles += HOST_IO_CYCLES;
+	host_sync();
+}
+
+static inline void host_touch_id(int id) {
+	host_cycles += HOST_IO_CYCLES;
+	host_access = id;
+	host_sync();
+}
+
+static inline void host_cycles_add(uint32_t n) {
+	host_cycles += n;
+}
+
+// advance the virtual clock, stepping exactly onto every peripheral event
+void host_delay(uint64_t cycles);
+static inline void host_run_us(uint32_t us) { host_delay((uint64_t)us * (FUNCONF_SYSTEM_CORE_CLOCK / 1000000)); }
+static inline void host_run_ms(uint32_t ms) { host_delay((uint64_t)ms * (FUNCONF_SYSTEM_CORE_CLOCK / 1000)); }
+void host_wfi(void);
+
+void host_nvic_enable(int irq, int enable);
+void host_irq_global(int enable);
+
+// GPIO, pin numbering matches ch32fun: port * 16 + pin
+void host_gpio_init_all(void);
+void host_gpio_mode(int pin, uint32_t mode);
+void host_gpio_write(int pin, int value);
+int  host_gpio_read(int pin);
+// drive an input pin from outside (e.g. an IR receiver output)
+void host_gpio_input(int pin, int level);
+// schedule an input edge at an absolute virtual cycle, returns 0 when the queue is full
+int  host_gpio_schedule(int pin, int level, uint64_t cycle);
+
+// queue bytes on the USART1 RX line, they arrive one frame time apart
+void host_uart_inject(const uint8_t *data, uint32_t len);
+
+uint8_t *host_flash_mem(void);
+// power cut: let [ops] more flash erases/programs complete, drop every one
+// after that until host_reset(). -1 never cuts.
+void host_flash_power_cut(int64_t ops);
+
+// wall clock for benchmarks
+uint64_t host_now_ns(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,40 @@
+// Rebuild LOG_DEFERRED output (fun_log.h) as text:
+//   log_decode firmware.elf [capture.bin]
+// The capture is the raw byte stream LOG_flush() sent, stdin by default.
+// Reading stops at end of input, so a live UART can be piped in.
+
+#include "log_decode.h"
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s firmware.elf [capture.bin]\n", argv[0]);
+		return 2;
+	}
+
+	Log_Elf_t elf;
+	if (!log_elf_load(&elf, argv[1])) {
+		fprintf(stderr, "%s: not a little endian ELF\n", argv[1]);
+		return 1;
+	}
+
+	FILE *in = argc > 2 ? fopen(argv[2], "rb") : stdin;
+	if (!in) {
+		perror(argv[2]);
+		return 1;
+	}
+
+	// decode as data arrives, keep the unfinished record
+	static uint8_t buf[4096];
+	size_t len = 0, n, skipped = 0;
+	while ((n = fread(buf + len, 1, sizeof(buf) - len, in)) > 0) {
+		len += n;
+		size_t used = log_decode(buf, len, log_elf_str, &elf, stdout, &skipped);
+		memmove(buf, buf + used, len - used);
+		len -= used;
+		fflush(stdout);
+	}
+
+	if (skipped) fprintf(stderr, "%zu bytes skipped\n", skipped);
+	log_elf_free(&elf);
+	return 0;
+}
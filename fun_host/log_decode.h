@@ -0,0 +1,198 @@
+// Decoder for LOG_DEFERRED records (fun_log.h). A record is little endian
+// 32-bit words [nargs << 28 | site][timestamp][arg]..., where site is the
+// firmware address (low 28 bits) of "<ESC>[style;colorm[tag] \0format".
+// Strings are looked up in the firmware ELF, the output is the text LOG()
+// prints in its normal mode.
+
+#ifndef _LOG_DECODE_H
+#define _LOG_DECODE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_DECODE_MAX_ARGS	8
+#define LOG_DECODE_ADDR(a)	((uint32_t)(a) & 0x0FFFFFFF)
+
+//! ####################################
+//! ELF STRING TABLE
+//! ####################################
+
+// ELF32 (firmware) or ELF64 (host bench) image, strings are read from the
+// file contents of its allocated sections
+typedef struct {
+	uint8_t *data;
+	size_t size;
+	int is64;
+	uint32_t shoff_count;
+	uint64_t shoff;
+	uint32_t shentsize;
+} Log_Elf_t;
+
+static uint64_t _log_elf_rd(const uint8_t *p, int n) {
+	uint64_t v = 0;
+	for (int i = n - 1; i >= 0; i--) v = v << 8 | p[i];
+	return v;
+}
+
+// returns 0 when the file is not a little endian ELF
+static int log_elf_load(Log_Elf_t *elf, const char *path) {
+	memset(elf, 0, sizeof(*elf));
+	FILE *f = fopen(path, "rb");
+	if (!f) return 0;
+
+	fseek(f, 0, SEEK_END);
+	elf->size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	elf->data = malloc(elf->size);
+	if (!elf->data || fread(elf->data, 1, elf->size, f) != elf->size) elf->size = 0;
+	fclose(f);
+
+	const uint8_t *d = elf->data;
+	if (elf->size < 64 || memcmp(d, "\177ELF", 4) || d[5] != 1) return 0;
+
+	elf->is64 = d[4] == 2;
+	elf->shoff = elf->is64 ? _log_elf_rd(d + 0x28, 8) : _log_elf_rd(d + 0x20, 4);
+	elf->shentsize = _log_elf_rd(d + (elf->is64 ? 0x3A : 0x2E), 2);
+	elf->shoff_count = _log_elf_rd(d + (elf->is64 ? 0x3C : 0x30), 2);
+	return elf->shoff + (uint64_t)elf->shentsize * elf->shoff_count <= elf->size;
+}
+
+// NUL terminated string at a firmware address, NULL when no section holds one
+static const char *log_elf_str(uint32_t addr, void *ctx) {
+	Log_Elf_t *elf = ctx;
+
+	for (uint32_t i = 0; i < elf->shoff_count; i++) {
+		const uint8_t *sh = elf->data + elf->shoff + (uint64_t)i * elf->shentsize;
+		uint32_t type = _log_elf_rd(sh + 4, 4);
+		uint64_t flags, addr0, off, size;
+		if (elf->is64) {
+			flags = _log_elf_rd(sh + 8, 8);
+			addr0 = _log_elf_rd(sh + 16, 8);
+			off = _log_elf_rd(sh + 24, 8);
+			size = _log_elf_rd(sh + 32, 8);
+		} else {
+			flags = _log_elf_rd(sh + 8, 4);
+			addr0 = _log_elf_rd(sh + 12, 4);
+			off = _log_elf_rd(sh + 16, 4);
+			size = _log_elf_rd(sh + 20, 4);
+		}
+
+		// SHF_ALLOC with file contents (not SHT_NOBITS)
+		if (!(flags & 2) || type == 8 || off + size > elf->size) continue;
+		uint32_t base = LOG_DECODE_ADDR(addr0);
+		if (addr < base || addr - base >= size) continue;
+
+		const char *s = (const char *)elf->data + off + (addr - base);
+		return memchr(s, 0, size - (addr - base)) ? s : NULL;
+	}
+	return NULL;
+}
+
+static void log_elf_free(Log_Elf_t *elf) {
+	free(elf->data);
+	elf->data = NULL;
+}
+
+//! ####################################
+//! RECORDS
+//! ####################################
+
+typedef const char *(*log_decode_str_t)(uint32_t addr, void *ctx);
+
+// printf one argument with the conversion spec the firmware format has
+static void _log_decode_message(FILE *out, const char *fmt, const uint32_t *args, int nargs,
+	log_decode_str_t str, void *ctx)
+{
+	int a = 0;
+	#define NEXT_ARG() (a < nargs ? args[a++] : 0)
+
+	for (const char *p = fmt; *p; p++) {
+		if (*p != '%') {
+			fputc(*p, out);
+			continue;
+		}
+		if (p[1] == '%') {
+			fputc('%', out);
+			p++;
+			continue;
+		}
+
+		// flags, width and precision are kept, * takes an argument word
+		char spec[32];
+		int n = 0;
+		spec[n++] = *p++;
+		while (*p && strchr("-+ #0123456789.*", *p) && n < 20) {
+			if (*p == '*') n += snprintf(spec + n, sizeof(spec) - n, "%d", (int32_t)NEXT_ARG());
+			else spec[n++] = *p;
+			p++;
+		}
+
+		// every argument is one 32-bit word, h and hh narrow it
+		int narrow = 0;
+		while (*p && strchr("hlzjt", *p)) narrow += *p++ == 'h';
+		if (!*p) break;
+
+		uint32_t v = NEXT_ARG();
+		if (narrow == 1) v = strchr("di", *p) ? (uint32_t)(int16_t)v : (uint16_t)v;
+		if (narrow >= 2) v = strchr("di", *p) ? (uint32_t)(int8_t)v : (uint8_t)v;
+
+		spec[n++] = *p;
+		spec[n] = 0;
+		switch (*p) {
+		case 'd': case 'i':
+			fprintf(out, spec, (int32_t)v);
+			break;
+		case 'u': case 'x': case 'X': case 'o': case 'c':
+			fprintf(out, spec, v);
+			break;
+		case 's': {
+			const char *s = str(LOG_DECODE_ADDR(v), ctx);
+			fprintf(out, spec, s ? s : "(?)");
+			break;
+		}
+		case 'p':
+			fprintf(out, "0x%08x", v);
+			break;
+		default:
+			fputs(spec, out);
+		}
+	}
+	#undef NEXT_ARG
+}
+
+// Decode complete records from data to out. Returns the bytes consumed, an
+// incomplete record at the end is left for the next call. Bytes that do not
+// start a record with a known site are skipped and counted in skipped.
+static size_t log_decode(const uint8_t *data, size_t len, log_decode_str_t str, void *ctx,
+	FILE *out, size_t *skipped)
+{
+	size_t pos = 0;
+
+	while (len - pos >= 8) {
+		uint32_t hdr = _log_elf_rd(data + pos, 4);
+		uint32_t nargs = hdr >> 28;
+		const char *prefix = nargs <= LOG_DECODE_MAX_ARGS ? str(hdr & 0x0FFFFFFF, ctx) : NULL;
+		const char *fmt = prefix ? str((hdr & 0x0FFFFFFF) + strlen(prefix) + 1, ctx) : NULL;
+
+		// not a record boundary: resync one byte later
+		if (!fmt || strncmp(prefix, "\033[", 2)) {
+			if (skipped) (*skipped)++;
+			pos++;
+			continue;
+		}
+		if (len - pos < 8 + 4 * nargs) break;
+
+		uint32_t args[LOG_DECODE_MAX_ARGS];
+		for (uint32_t i = 0; i < nargs; i++) args[i] = _log_elf_rd(data + pos + 8 + 4 * i, 4);
+
+		fprintf(out, "%s%u: ", prefix, (uint32_t)_log_elf_rd(data + pos + 4, 4));
+		_log_decode_message(out, fmt, args, nargs, str, ctx);
+		fputs("\033[0;39m\n", out);
+		pos += 8 + 4 * nargs;
+	}
+	return pos;
+}
+
+#endif
@@ -0,0 +1,43 @@
+// Summarize UTIL_profile_dump() output (fun_utilities.h, FUN_PROFILE):
+//   prof_flame [-c] [capture.txt]
+// Every complete dump in the input is printed as a zone tree, -c prints
+// collapsed stacks for flamegraph tools instead. Reads stdin when no
+// capture is given, so a serial port sending "prof" replies can be piped in.
+
+#include "prof_flame.h"
+
+int main(int argc, char **argv) {
+	int collapsed = 0;
+	const char *path = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-c")) collapsed = 1;
+		else if (!path && argv[i][0] != '-') path = argv[i];
+		else {
+			fprintf(stderr, "usage: %s [-c] [capture.txt]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	FILE *in = path ? fopen(path, "r") : stdin;
+	if (!in) {
+		perror(path);
+		return 1;
+	}
+
+	static Prof_t prof;
+	int dumps = 0;
+	while (prof_read(&prof, in)) {
+		if (collapsed) prof_collapsed(&prof, stdout);
+		else {
+			if (dumps) putchar('\n');
+			printf("# dump %d, %d zones, clock %u Hz\n", dumps, prof.count, prof.clock);
+			prof_render(&prof, stdout);
+		}
+		dumps++;
+		fflush(stdout);
+	}
+
+	if (!dumps) fprintf(stderr, "no #prof-end found\n");
+	return dumps ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+// Reader and renderer for UTIL_profile_dump() output (fun_utilities.h). A
+// dump is "#prof-clock <Hz>", one "#prof ..." line per zone and "#prof-end",
+// any other line on the serial port is skipped. Zones are put back into the
+// tree their parent links describe and printed as a flame-style summary, or
+// as collapsed stacks ("a;b;c <cycles>") for flamegraph tools.
+
+#ifndef _PROF_FLAME_H
+#define _PROF_FLAME_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROF_MAX_ZONES		64
+#define PROF_MAX_BUCKETS	32
+#define PROF_NAME_LEN		32
+
+typedef struct {
+	char name[PROF_NAME_LEN];
+	char parent_name[PROF_NAME_LEN];
+	int parent;				// index, -1 for a root
+	int isr;
+	uint32_t count;
+	uint64_t total, self, isr_cycles;
+	uint32_t min, max;
+	uint32_t hist[PROF_MAX_BUCKETS];
+} Prof_Zone_t;
+
+typedef struct {
+	uint32_t clock;
+	int count;
+	Prof_Zone_t zones[PROF_MAX_ZONES];
+} Prof_t;
+
+//! ####################################
+//! PARSER
+//! ####################################
+
+static int _prof_parse_zone(Prof_Zone_t *z, const char *line) {
+	memset(z, 0, sizeof(*z));
+	char hist[512] = "";
+	unsigned long long total, self, isr_cycles;
+	unsigned count, min, max;
+
+	int n = sscanf(line, "#prof %31s %31s %d %x %llx %llx %llx %x %x %511s",
+		z->name, z->parent_name, &z->isr, &count, &total, &self, &isr_cycles, &min, &max, hist);
+	if (n < 9) return 0;
+
+	z->count = count;
+	z->total = total;
+	z->self = self;
+	z->isr_cycles = isr_cycles;
+	z->min = min;
+	z->max = max;
+
+	// b=n,b=n,...
+	for (char *p = hist; *p; ) {
+		unsigned b, v;
+		if (sscanf(p, "%x=%x", &b, &v) != 2) break;
+		if (b < PROF_MAX_BUCKETS) z->hist[b] = v;
+		p = strchr(p, ',');
+		if (!p) break;
+		p++;
+	}
+	return 1;
+}
+
+static void _prof_link(Prof_t *prof) {
+	for (int i = 0; i < prof->count; i++) {
+		Prof_Zone_t *z = &prof->zones[i];
+		z->parent = -1;
+		for (int j = 0; j < prof->count; j++) {
+			if (j != i && !strcmp(prof->zones[j].name, z->parent_name)) z->parent = j;
+		}
+	}
+}
+
+// Read up to the next "#prof-end". Returns 1 with a complete dump in prof,
+// 0 at end of input.
+static inline int prof_read(Prof_t *prof, FILE *in) {
+	char line[1024];
+	int started = 0;
+
+	while (fgets(line, sizeof(line), in)) {
+		unsigned long clock;
+		if (sscanf(line, "#prof-clock %lu", &clock) == 1) {
+			memset(prof, 0, sizeof(*prof));
+			prof->clock = clock;
+			started = 1;
+		}
+		else if (!started) continue;
+		else if (!strncmp(line, "#prof-end", 9)) {
+			_prof_link(prof);
+			return 1;
+		}
+		else if (!strncmp(line, "#prof ", 6) && prof->count < PROF_MAX_ZONES) {
+			if (_prof_parse_zone(&prof->zones[prof->count], line)) prof->count++;
+		}
+	}
+	return 0;
+}
+
+static inline const Prof_Zone_t *prof_find(const Prof_t *prof, const char *name) {
+	for (int i = 0; i < prof->count; i++) {
+		if (!strcmp(prof->zones[i].name, name)) return &prof->zones[i];
+	}
+	return NULL;
+}
+
+// upper edge in cycles of the bucket holding the q-th fraction of the runs,
+// never above the longest run. The device halves its byte buckets when one
+// fills, so the fraction is of the histogram's own sum, not of count
+static inline uint64_t prof_percentile(const Prof_Zone_t *z, double q) {
+	uint64_t runs = 0;
+	for (int b = 0; b < PROF_MAX_BUCKETS; b++) runs += z->hist[b];
+	uint64_t seen = 0, want = (uint64_t)(q * runs + 0.5);
+	if (want < 1) want = 1;
+	for (int b = 0; b < PROF_MAX_BUCKETS; b++) {
+		seen += z->hist[b];
+		if (seen >= want) return (2ull << b) < z->max ? 2ull << b : z->max;
+	}
+	return z->max;
+}
+
+//! ####################################
+//! RENDER
+//! ####################################
+
+#define PROF_BAR_WIDTH		24
+
+static double _prof_us(const Prof_t *prof, uint64_t cycles) {
+	return prof->clock ? cycles * 1e6 / prof->clock : (double)cycles;
+}
+
+static void _prof_render_zone(const Prof_t *prof, int i, int depth, uint64_t wall, FILE *out) {
+	const Prof_Zone_t *z = &prof->zones[i];
+	double share = wall ? (double)z->total / wall : 0;
+
+	char bar[PROF_BAR_WIDTH + 1];
+	int fill = (int)(share * PROF_BAR_WIDTH + 0.5);
+	if (fill > PROF_BAR_WIDTH) fill = PROF_BAR_WIDTH;
+	memset(bar, '#', fill);
+	memset(bar + fill, '.', PROF_BAR_WIDTH - fill);
+	bar[PROF_BAR_WIDTH] = 0;
+
+	char label[64];
+	snprintf(label, sizeof(label), "%*s%s%s", depth * 2, "", z->name, z->isr ? " (isr)" : "");
+
+	fprintf(out, "%s %5.1f%%  %-24s %8u %10.1f %10.1f %8.1f %9.1f %9.1f %9.1f %9.1f\n",
+		bar, share * 100, label, z->count,
+		_prof_us(prof, z->total), _prof_us(prof, z->self), _prof_us(prof, z->isr_cycles),
+		_prof_us(prof, z->total / (z->count ? z->count : 1)),
+		_prof_us(prof, prof_percentile(z, 0.5)), _prof_us(prof, prof_percentile(z, 0.9)),
+		_prof_us(prof, z->max));
+
+	for (int c = 0; c < prof->count; c++) {
+		if (prof->zones[c].parent == i) _prof_render_zone(prof, c, depth + 1, wall, out);
+	}
+}
+
+// One row per zone under its parent, bars are inclusive time as a share of
+// all root zones. Times in us, percentiles are log2 bucket upper edges.
+static inline void prof_render(const Prof_t *prof, FILE *out) {
+	uint64_t wall = 0;
+	for (int i = 0; i < prof->count; i++) {
+		if (prof->zones[i].parent < 0) wall += prof->zones[i].total;
+	}
+
+	fprintf(out, "%-*s %6s  %-24s %8s %10s %10s %8s %9s %9s %9s %9s\n",
+		PROF_BAR_WIDTH, "inclusive", "", "zone", "count",
+		"total_us", "self_us", "isr_us", "avg_us", "p50_us", "p90_us", "max_us");
+
+	// regular zones first, interrupts after them
+	for (int isr = 0; isr < 2; isr++) {
+		for (int i = 0; i < prof->count; i++) {
+			const Prof_Zone_t *z = &prof->zones[i];
+			if (z->parent < 0 && z->isr == isr) _prof_render_zone(prof, i, 0, wall, out);
+		}
+	}
+}
+
+// "root;child;zone <self cycles>" per zone, interrupts under "[isr]"
+static inline void prof_collapsed(const Prof_t *prof, FILE *out) {
+	for (int i = 0; i < prof->count; i++) {
+		const Prof_Zone_t *z = &prof->zones[i];
+		if (!z->self) continue;
+
+		// walk up to the root, then print top down
+		int path[PROF_MAX_ZONES], n = 0;
+		for (int p = i; p >= 0 && n < PROF_MAX_ZONES; p = prof->zones[p].parent) path[n++] = p;
+
+		if (prof->zones[path[n - 1]].isr) fputs("[isr];", out);
+		while (n--) fprintf(out, "%s%c", prof->zones[path[n]].name, n ? ';' : ' ');
+		fprintf(out, "%llu\n", (unsigned long long)z->self);
+	}
+}
+
+#endif
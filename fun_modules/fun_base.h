@@ -1,3 +1,6 @@
+#ifndef FUN_BASE_H
+#define FUN_BASE_H
+
 #include "ch32fun.h"
 #include <stdint.h>
 #include <stdio.h>
@@ -6,4 +9,130 @@
 #include "util_basic.h"
 
 #include "fun_log.h"
-#include "fun_utilities.h"
\ No newline at end of file
+#include "fun_utilities.h"
+
+
+//! ####################################
+//! TASK SCHEDULER
+//! ####################################
+
+// Deadline ordered cooperative scheduler. Tasks are caller owned and kept in
+// a list sorted by deadline, so the head is always the next one due. Deadlines
+// are SysTick->CNT values: start latency is measured in HCLK cycles, and a
+// period may not exceed SCHED_MAX_PERIOD_MS (half the counter range).
+//
+//	static Sched_Task_t neo = { .handler = onNeo_step, .period_ms = NEO_TASK_PERIOD_MS };
+//	fun_sched_add(&neo, 0);
+//	while(1) fun_sched_idle();
+
+#define SCHED_MAX_PERIOD_MS		(0x7FFFFFFF / SYSTICK_ONE_MILLISECOND)
+
+typedef struct Sched_Task {
+	void (*handler)(u32 time, void *arg);
+	void *arg;
+	u32 period_ms;			// 0: due on every pass, the loop never sleeps
+	Cycle_Info_t info;		// run count, min/max start latency in us
+
+	//# internal
+	u32 due;				// SysTick->CNT
+	u8 queued;				// 0 idle, 1 queued, 2 running
+	struct Sched_Task *next;
+} Sched_Task_t;
+
+Sched_Task_t *sched_head = NULL;
+
+static inline s32 _sched_until(Sched_Task_t *task, u32 now) {
+	return (s32)(task->due - now);
+}
+
+// [ms] in SysTick cycles, clamped so a deadline stays in the signed range
+static inline u32 _sched_cycles(u32 ms) {
+	if (ms > SCHED_MAX_PERIOD_MS) ms = SCHED_MAX_PERIOD_MS;
+	return ms * SYSTICK_ONE_MILLISECOND;
+}
+
+void _sched_unlink(Sched_Task_t *task) {
+	Sched_Task_t **link = &sched_head;
+	while (*link && *link != task) link = &(*link)->next;
+	if (*link) *link = task->next;
+	task->queued = 0;
+}
+
+// insert after every task with the same or an earlier deadline
+void _sched_insert(Sched_Task_t *task, u32 now) {
+	Sched_Task_t **link = &sched_head;
+	s32 until = _sched_until(task, now);
+	while (*link && _sched_until(*link, now) <= until) link = &(*link)->next;
+
+	task->next = *link;
+	*link = task;
+	task->queued = 1;
+}
+
+//# (re)arm [task] to run [delay_ms] from now, also from inside its own handler
+void fun_sched_wakeIn(Sched_Task_t *task, u32 delay_ms) {
+	u32 now = SysTick->CNT;
+	if (task->queued == 1) _sched_unlink(task);
+
+	task->due = now + _sched_cycles(delay_ms);
+	_sched_insert(task, now);
+}
+
+void fun_sched_add(Sched_Task_t *task, u32 first_delay_ms) {
+	UTIL_cycleInfo_clear(&task->info);
+	fun_sched_wakeIn(task, first_delay_ms);
+}
+
+void fun_sched_remove(Sched_Task_t *task) {
+	if (task->queued == 1) _sched_unlink(task);
+	task->queued = 0;
+}
+
+// Run every task that was due on entry. A re-armed task is due after
+// the entry time, so each one runs at most once per call.
+// Returns cycles until the next deadline, 0 if one is already due
+// and 0xFFFFFFFF when nothing is queued.
+u32 fun_sched_run(void) {
+	u32 now = SysTick->CNT;
+	while (sched_head && _sched_until(sched_head, now) <= 0) {
+		Sched_Task_t *task = sched_head;
+		sched_head = task->next;
+		task->queued = 2;
+
+		u32 start = SysTick->CNT;
+		UTIL_cycleInfo_update(&task->info, (start - task->due) / SYSTICK_ONE_MICROSECOND);
+		task->handler(millis(), task->arg);
+
+		// the handler may have re-armed or removed itself
+		if (task->queued != 2) continue;
+
+		if (task->period_ms == 0) {
+			task->due = SysTick->CNT;
+		} else {
+			// keep the cadence, but skip the periods already missed
+			u32 period = _sched_cycles(task->period_ms);
+			task->due += period;
+			if (_sched_until(task, SysTick->CNT) < 0) {
+				task->due = SysTick->CNT + period;
+			}
+		}
+		_sched_insert(task, now);
+	}
+
+	if (!sched_head) return 0xFFFFFFFF;
+	s32 until = _sched_until(sched_head, SysTick->CNT);
+	return until > 0 ? until : 0;
+}
+
+// Run what is due, then sleep until the next deadline. SysTick wakes the core
+// every millisecond, so deadlines are met to within one tick.
+void fun_sched_idle(void) {
+	fun_sched_run();
+	while (sched_head && _sched_until(sched_head, SysTick->CNT) > 0) __WFI();
+}
+
+void fun_sched_flush(Sched_Task_t *task) {
+	UTIL_cycleInfo_flush(&task->info);
+}
+
+#endif
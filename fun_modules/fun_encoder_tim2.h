@@ -1,6 +1,12 @@
 #include "ch32fun.h"
 #include <stdio.h>
 
+// The encoder counts in TIM2's encoder mode
+#ifdef FUN_USES_TIM2
+	#error "fun_encoder_tim2.h counts on TIM2, another module already uses it"
+#endif
+#define FUN_USES_TIM2
+
 typedef struct {
 	u16 INITIAL_timer_count;		// initial count
 	u16 LAST_timer_count;			// previous count
@@ -26,6 +26,7 @@
 
 #include "ch32fun.h"
 #include "word_font.h"
+#include "../fun_utilities.h"
 
 // enable 0.25 scale for text string
 #define SSD1306_TEXT_SCALE_NUMERATOR 5
@@ -90,7 +91,7 @@
 u8 SSD1306_CMD(u8 cmd);
 
 /* send OLED data packet (up to 32 bytes) */
-u8 SSD1306_DATA(u8 *data, int sz);
+u8 SSD1306_DATA(const u8 *data, int sz);
 
 
 //! ####################################
@@ -164,14 +165,52 @@ const u8 ssd1306_init_array[] = {
 #define SSD1306_W_LIMIT	SSD1306_W - 1
 #define SSD1306_H_LIMIT	SSD1306_H - 1
 
+u8 SSD1306_BUF[SSD1306_PAGES * SSD1306_W] = { 0 };
+
+//# Pixel addressing
+// Pixel (x, y) is bit y & 7 of SSD1306_BUF[(y >> 3) * SSD1306_W + x].
+// SSD1306_W is a constant, so the page stride folds into a shift and the
+// bit is a shift of 1: no table in RAM and no load per pixel.
+#define SSD1306_PAGE(y)			((y) >> 3)
+#define SSD1306_BITMASK(y)		((u8)(1 << ((y) & 7)))
+#define SSD1306_ROW(page)		(&SSD1306_BUF[(page) * SSD1306_W])
+#define SSD1306_BYTE(x, y)		SSD1306_ROW(SSD1306_PAGE(y))[x]
+
+// bits of rows y0..y1 inside their page, both inclusive and on the same page
+#define SSD1306_RUN_MASK(y0, y1)	((u8)((0xFF << ((y0) & 7)) & (0xFF >> (7 - ((y1) & 7)))))
+
+//# Dirty spans
+// render_* functions mark the columns they touch on each page, and
+// ssd1306_flush_dirty() sends only those windows. x0 > x1 marks a clean page.
 typedef struct {
-	u8 page;
-	u8 bitmask;
-} Page_Mask_t;
+	u8 x0, x1;
+} SSD1306_Span_t;
 
-Page_Mask_t page_masks[SSD1306_H];
+SSD1306_Span_t SSD1306_DIRTY[SSD1306_PAGES] = {
+	[0 ... SSD1306_PAGES - 1] = { 0xFF, 0 }
+};
 
-u8 SSD1306_BUF[SSD1306_PAGES * SSD1306_W] = { 0 };
+// bytes on the wire for ssd1306_setwindow(): 6 commands of addr + ctrl + cmd
+#ifndef SSD1306_WINDOW_COST
+	#define SSD1306_WINDOW_COST 18
+#endif
+
+static inline void _dirty_mark(u8 page, u8 x0, u8 x1) {
+	SSD1306_Span_t *span = &SSD1306_DIRTY[page];
+	if (x0 < span->x0) span->x0 = x0;
+	if (x1 > span->x1) span->x1 = x1;
+}
+
+// mark rows y0..y1 and columns x0..x1, both inclusive and on screen
+static void _dirty_mark_rect(u8 y0, u8 y1, u8 x0, u8 x1) {
+	for (u8 page = y0 >> 3; page <= (y1 >> 3); page++) {
+		_dirty_mark(page, x0, x1);
+	}
+}
+
+static inline void _dirty_clear(u8 page) {
+	SSD1306_DIRTY[page] = (SSD1306_Span_t){ 0xFF, 0 };
+}
 
 //# Init function
 u8 ssd1306_init() {
@@ -182,12 +221,6 @@ u8 ssd1306_init() {
 			return 1;
 	}
 
-	// Prerender page masks
-	for (u8 y = 0; y < SSD1306_H; y++) {
-		page_masks[y].page	   = y >> 3;			 // (y / 8)
-		page_masks[y].bitmask	= 1 << (y & 0x07);	// (y % 8)
-	}
-
 	return 0;
 }
 
@@ -251,6 +284,10 @@ void ssd1306_draw_area(
             if (chunk_end > page_data_length) chunk_end = page_data_length;
             SSD1306_DATA(&page_base[chunk], chunk_end - chunk);
         }
+
+		// the page is clean if its dirty span was inside this window
+		SSD1306_Span_t span = SSD1306_DIRTY[page];
+		if (span.x0 >= col_start && span.x1 < col_end) _dirty_clear(page);
     }
 }
 
@@ -259,8 +296,117 @@ void ssd1306_draw_all() {
 	ssd1306_draw_area(0, 7, 0, SSD1306_W);
 }
 
+// Consecutive dirty pages share one window when the extra columns cost less
+// than the window commands a separate page would need. Widens win over the
+// pages it takes and returns the last of them.
+static u8 _dirty_window(u8 page, SSD1306_Span_t *win) {
+	u8 end = page;
+
+	while (end + 1 < SSD1306_PAGES) {
+		SSD1306_Span_t next = SSD1306_DIRTY[end + 1];
+		if (next.x0 > next.x1) break;
+
+		u8 x0 = next.x0 < win->x0 ? next.x0 : win->x0;
+		u8 x1 = next.x1 > win->x1 ? next.x1 : win->x1;
+		u16 pages = end - page + 1;
+		u16 merged = (pages + 1) * (x1 - x0 + 1);
+		u16 split = pages * (win->x1 - win->x0 + 1) + (next.x1 - next.x0 + 1) + SSD1306_WINDOW_COST;
+		if (merged > split) break;
+
+		win->x0 = x0;
+		win->x1 = x1;
+		end++;
+	}
+
+	return end;
+}
+
+//# Draw only the dirty windows
+void ssd1306_flush_dirty() {
+	u8 page = 0;
+
+	while (page < SSD1306_PAGES) {
+		SSD1306_Span_t win = SSD1306_DIRTY[page];
+		if (win.x0 > win.x1) { page++; continue; }
+
+		u8 end = _dirty_window(page, &win);
+		ssd1306_draw_area(page, end, win.x0, win.x1 + 1);
+		page = end + 1;
+	}
+}
+
+#ifdef I2C_ASYNC
+#include "lib/lib_i2c.h"
+
+//# Draw the dirty windows on the I2C DMA
+// Queues a command transfer per window and a data transfer per page, read
+// straight from SSD1306_BUF, and returns while they go out. Don't render
+// until ssd1306_flush_wait() returns. The queue costs 16 i2c_xfer_t and the
+// window commands, ~560 bytes of RAM on the CH32V003.
+static i2c_xfer_t _flush_xfers[2 * SSD1306_PAGES];
+static u8 _flush_cmds[SSD1306_PAGES][6];
+static u8 _flush_count = 0;
+
+// waits for the queued flush, returns its first error
+i2c_err_t ssd1306_flush_wait() {
+	i2c_err_t err = I2C_OK;
+
+	for (u8 i = 0; i < _flush_count; i++) {
+		i2c_err_t xfer_err = i2c_async_wait(&_flush_xfers[i]);
+		if (err == I2C_OK) err = xfer_err;
+	}
+
+	_flush_count = 0;
+	return err;
+}
+
+i2c_err_t ssd1306_flush_dirty_async(const i2c_device_t *dev) {
+	ssd1306_flush_wait();
+
+	u8 page = 0, n = 0, windows = 0;
+
+	while (page < SSD1306_PAGES) {
+		SSD1306_Span_t win = SSD1306_DIRTY[page];
+		if (win.x0 > win.x1) { page++; continue; }
+
+		u8 end = _dirty_window(page, &win);
+		u8 *cmd = _flush_cmds[windows++];
+		cmd[0] = SSD1306_COLUMNADDR; cmd[1] = win.x0; cmd[2] = win.x1;
+		cmd[3] = SSD1306_PAGEADDR;   cmd[4] = page;   cmd[5] = end;
+
+		// control byte 0x00: a command stream, 0x40: data
+		_flush_xfers[n++] = (i2c_xfer_t){
+			.dev = dev, .reg = 0x00, .buf = cmd, .len = 6, .flags = I2C_XFER_REG,
+		};
+
+		for (; page <= end; page++) {
+			_flush_xfers[n++] = (i2c_xfer_t){
+				.dev = dev, .reg = 0x40, .buf = &SSD1306_ROW(page)[win.x0],
+				.len = win.x1 - win.x0 + 1, .flags = I2C_XFER_REG,
+			};
+			_dirty_clear(page);
+		}
+	}
+
+	_flush_count = n;
+	return i2c_async_submit(_flush_xfers, n);
+}
+#endif
+
+// only bytes that change value are marked dirty, so clear + re-render
+// flushes the union of the old and the new content
 void ssd1306_render_fill(u8 value) {
-	memset(SSD1306_BUF, value, sizeof(SSD1306_BUF));
+	for (u8 page = 0; page < SSD1306_PAGES; page++) {
+		u8 *row = &SSD1306_BUF[page * SSD1306_W];
+		u8 x0 = 0, x1 = SSD1306_W_LIMIT;
+
+		while (x0 < SSD1306_W && row[x0] == value) x0++;
+		if (x0 == SSD1306_W) continue;
+		while (row[x1] == value) x1--;
+
+		_dirty_mark(page, x0, x1);
+		memset(&row[x0], value, x1 - x0 + 1);
+	}
 }
 
 void ssd1306_draw_fill(u8 value) {
@@ -271,14 +417,48 @@ void ssd1306_draw_fill(u8 value) {
 //# render pixel
 void render_pixel(u8 x, u8 y) {
 	if (x >= SSD1306_W || y >= SSD1306_H) return; // Skip if out of bounds
-	Page_Mask_t mask = page_masks[y];
-	SSD1306_BUF[mask.page * SSD1306_W + x] |= mask.bitmask;
+	SSD1306_BYTE(x, y) |= SSD1306_BITMASK(y);
+	_dirty_mark(SSD1306_PAGE(y), x, x);
 }
 
 void render_pixel_erase(u8 x, u8 y) {
 	if (x >= SSD1306_W || y >= SSD1306_H) return; // Skip if out of bounds
-	Page_Mask_t mask = page_masks[y];
-	SSD1306_BUF[mask.page * SSD1306_W + x] &= ~mask.bitmask;
+	SSD1306_BYTE(x, y) &= ~SSD1306_BITMASK(y);
+	_dirty_mark(SSD1306_PAGE(y), x, x);
+}
+
+//# render column span
+// Columns x0..x1, rows y0..y1 set (fill) or cleared, on screen and in order.
+// A page takes a head mask, whole bytes in the middle and a tail mask, so 8
+// rows of a column are one read-modify-write, or one store when full.
+static void _render_colSpan(u8 x0, u8 x1, u8 y0, u8 y1, u8 fill) {
+	u8 page0 = SSD1306_PAGE(y0), page1 = SSD1306_PAGE(y1);
+	u8 width = x1 - x0 + 1;
+
+	for (u8 page = page0; page <= page1; page++) {
+		u8 top = page == page0 ? y0 : 0, bottom = page == page1 ? y1 : 7;
+		u8 bits = SSD1306_RUN_MASK(top, bottom);
+		u8 *dest = SSD1306_ROW(page) + x0;
+
+		if (bits == 0xFF) {
+			memset(dest, fill ? 0xFF : 0x00, width);
+		} else if (fill) {
+			for (u8 i = 0; i < width; i++) dest[i] |= bits;
+		} else {
+			for (u8 i = 0; i < width; i++) dest[i] &= ~bits;
+		}
+	}
+}
+
+void render_colSpan(u8 x0, u8 x1, u8 y0, u8 y1, u8 fill) {
+	if (x0 > x1) { u8 t = x0; x0 = x1; x1 = t; }
+	if (y0 > y1) { u8 t = y0; y0 = y1; y1 = t; }
+	if (x0 > SSD1306_W_LIMIT || y0 > SSD1306_H_LIMIT) return;
+	CLAMP_VALUE(x1, SSD1306_W_LIMIT);
+	CLAMP_VALUE(y1, SSD1306_H_LIMIT);
+
+	_dirty_mark_rect(y0, y1, x0, x1);
+	_render_colSpan(x0, x1, y0, y1, fill);
 }
 
 
@@ -301,38 +481,18 @@ typedef struct {
 
 
 //* Clear text bounds
-void _clear_text_bounds(u8 x, u8 y, SSD1306_Text_Bounds_t *bounds, u8 fill) {    
-    u8 x_count = bounds->max_x - x + 1;
-	u8 max_y = bounds->max_y;
-    
-    // Use page_masks to build combined bitmasks per page
-    for (u8 page = 0; page < SSD1306_PAGES; page++) {
-        u8 output_bitmask = 0;
-        u8 page_START = page * 8;
-        u8 page_END = page_START + 7;
-        
-        // Only process pages that overlap with our Y range
-        if (max_y < page_START || y > page_END) continue;
-        
-        // Combine all bitmasks for Y coordinates in this page's range
-        u8 start_y = (y > page_START) ? y : page_START;
-        u8 end_y = (max_y < page_END) ? max_y : page_END;
-        
-        for (u8 py = start_y; py <= end_y; py++) {
-            output_bitmask |= page_masks[py].bitmask;
-        }
-        
-        // Apply to all X coordinates in range
-        u8 *dest = &SSD1306_BUF[page * SSD1306_W + x];
-
-		if (fill) {
-            for (u8 i = 0; i < x_count; i++) dest[i] |= output_bitmask;
-        } else {
-            for (u8 i = 0; i < x_count; i++) dest[i] &= ~output_bitmask;
-        }
-    }
+void _clear_text_bounds(u8 x, u8 y, SSD1306_Text_Bounds_t *bounds, u8 fill) {
+	render_colSpan(x, bounds->max_x, y, bounds->max_y, fill);
 }
 
+// font pixels n at scale_mode
+#ifdef SSD1306_TEXT_SCALE
+	#define SSD1306_TEXT_SCALED(n, mode) \
+		((n) * ((mode) + SSD1306_TEXT_SCALE_NUMERATOR) / SSD1306_TEXT_SCALE_DENOMINATOR)
+#else
+	#define SSD1306_TEXT_SCALED(n, mode)	((n) * (mode))
+#endif
+
 //* Calculate text bounds
 SSD1306_Text_Bounds_t _calc_text_bounds(
 	u8 char_count, u8 x, u8 y, Str_Config_t *config
@@ -340,18 +500,8 @@ SSD1306_Text_Bounds_t _calc_text_bounds(
 	SSD1306_Text_Bounds_t bounds = {0};
     if (!config || char_count < 1) return bounds;
 
-	u16 scaled_width, scaled_height;
-
-	#ifdef SSD1306_TEXT_SCALE
-		scaled_width = config->WIDTH * 
-			(config->scale_mode + SSD1306_TEXT_SCALE_NUMERATOR) / SSD1306_TEXT_SCALE_DENOMINATOR;
-		scaled_height = config->HEIGHT *
-			(config->scale_mode + SSD1306_TEXT_SCALE_NUMERATOR) / SSD1306_TEXT_SCALE_DENOMINATOR;
-	#else
-		// Calculate total width: (chars * width * scale) + (spaces between chars)
-		scaled_width = config->WIDTH * config->scale_mode;
-		scaled_height = config->HEIGHT * config->scale_mode;
-	#endif
+	u16 scaled_width = SSD1306_TEXT_SCALED(config->WIDTH, config->scale_mode);
+	u16 scaled_height = SSD1306_TEXT_SCALED(config->HEIGHT, config->scale_mode);
 
     u8 width = (char_count * scaled_width) + ((char_count - 1) * config->SPACE);
     u8 height = scaled_height;
@@ -367,6 +517,119 @@ SSD1306_Text_Bounds_t _calc_text_bounds(
 	return bounds;
 }
 
+//# Scaled glyphs
+// Scaling is the same for every glyph of a string, so it is worked out once
+// per string: the rows of the scaled glyph each font row covers, as a mask,
+// and the font column of each scaled column. A glyph column then expands
+// with one OR per set font bit into a u32 of scaled rows, which goes into
+// SSD1306_BUF shifted by y & 7 as whole bytes, one per page it spans.
+// That covers glyphs up to SSD1306_GLYPH_MAX_W x 32 pixels from fonts up to
+// 8 columns wide. Anything larger is drawn a render_colSpan() block per set
+// font bit instead, slower but not cut off.
+
+#ifndef SSD1306_GLYPH_MAX_W
+	#define SSD1306_GLYPH_MAX_W		32
+#endif
+
+#define SSD1306_GLYPH_MAX_SRC_W		8		// font columns
+#define SSD1306_GLYPH_MAX_H			32
+
+typedef struct {
+	u32 rows[8];						// scaled rows covered by font row r
+	u8 src[SSD1306_GLYPH_MAX_W];		// font column of each scaled column
+	u8 width, height;					// scaled
+	u8 fits;							// 0: too large, drawn in blocks
+} SSD1306_Glyph_Scale_t;
+
+static void _glyph_scale(SSD1306_Glyph_Scale_t *gs, const Str_Config_t *config) {
+	u8 mode = config->scale_mode;
+	u16 width = SSD1306_TEXT_SCALED(config->WIDTH, mode);
+	u16 height = SSD1306_TEXT_SCALED(config->HEIGHT, mode);
+	gs->fits = config->WIDTH <= SSD1306_GLYPH_MAX_SRC_W &&
+		width <= SSD1306_GLYPH_MAX_W && height <= SSD1306_GLYPH_MAX_H;
+	gs->width = gs->fits ? width : 0;
+	gs->height = gs->fits ? height : 0;
+	if (!gs->fits) return;
+
+	for (u8 col = 0; col < config->WIDTH; col++) {
+		u8 end = SSD1306_TEXT_SCALED(col + 1, mode);
+		for (u8 tc = SSD1306_TEXT_SCALED(col, mode); tc < end && tc < gs->width; tc++) gs->src[tc] = col;
+	}
+
+	for (u8 row = 0; row < 8; row++) {
+		u8 start = SSD1306_TEXT_SCALED(row, mode);
+		u8 end = SSD1306_TEXT_SCALED(row + 1, mode);
+		if (row >= config->HEIGHT || start >= SSD1306_GLYPH_MAX_H) { gs->rows[row] = 0; continue; }
+		u32 below_end = end >= SSD1306_GLYPH_MAX_H ? 0xFFFFFFFF : (1u << end) - 1;
+		gs->rows[row] = below_end & ~((1u << start) - 1);
+	}
+}
+
+// one glyph at (x, y), x and y on screen. color 0 clears the set bits.
+static void _glyph_blit(u8 x, u8 y, const u8 *glyph, u8 font_width, const SSD1306_Glyph_Scale_t *gs, u8 color) {
+	u32 expanded[SSD1306_GLYPH_MAX_SRC_W];
+
+	for (u8 col = 0; col < font_width; col++) {
+		u8 bits = glyph[col];
+		u32 rows = 0;
+		for (u8 row = 0; bits; row++, bits >>= 1) {
+			if (bits & 1) rows |= gs->rows[row];
+		}
+		expanded[col] = rows;
+	}
+
+	u8 cols = gs->width;
+	if (cols > SSD1306_W - x) cols = SSD1306_W - x;
+	u8 page0 = SSD1306_PAGE(y), shift = y & 7;
+
+	for (u8 tc = 0; tc < cols; tc++) {
+		u32 bits = expanded[gs->src[tc]];
+		u8 *dest = SSD1306_ROW(page0) + x + tc;
+
+		// the first page takes the low 8 - shift rows, then 8 rows a page
+		u8 byte = bits << shift;
+		bits >>= 8 - shift;
+
+		for (u8 page = page0;;) {
+			if (color) *dest |= byte;
+			else *dest &= ~byte;
+
+			if (!bits || ++page >= SSD1306_PAGES) break;
+			dest += SSD1306_W;
+			byte = bits;
+			bits >>= 8;
+		}
+	}
+
+	u8 y_end = y + gs->height - 1;
+	CLAMP_VALUE(y_end, SSD1306_H_LIMIT);
+	if (cols) _dirty_mark_rect(y, y_end, x, x + cols - 1);
+}
+
+// one glyph at (x, y) too large for _glyph_blit: a block per set font bit
+static void _glyph_blocks(u8 x, u8 y, const u8 *glyph, const Str_Config_t *config) {
+	u8 mode = config->scale_mode;
+
+	for (u8 col = 0; col < config->WIDTH; col++) {
+		u16 x0 = x + SSD1306_TEXT_SCALED(col, mode);
+		u16 x1 = x + SSD1306_TEXT_SCALED(col + 1, mode);
+		if (x0 >= SSD1306_W) break;
+		if (x0 == x1) continue;
+		if (x1 > SSD1306_W) x1 = SSD1306_W;
+
+		u8 bits = glyph[col];
+		for (u8 row = 0; bits && row < config->HEIGHT; row++, bits >>= 1) {
+			u16 y0 = y + SSD1306_TEXT_SCALED(row, mode);
+			u16 y1 = y + SSD1306_TEXT_SCALED(row + 1, mode);
+			if (y0 >= SSD1306_H) break;
+			if (!(bits & 1) || y0 == y1) continue;
+			if (y1 > SSD1306_H) y1 = SSD1306_H;
+
+			render_colSpan(x0, x1 - 1, y0, y1 - 1, config->color);
+		}
+	}
+}
+
 //# Render string with size
 void ssd1306_render_scaled_txt(
 	u8 x, u8 y, const char *str, Str_Config_t *config
@@ -374,23 +637,19 @@ void ssd1306_render_scaled_txt(
 	// Early exit if starting position is off-screen
     if (x >= SSD1306_W || y >= SSD1306_H) return;
 
-	#ifdef SSD1306_TEXT_SCALE
-		u8 char_width_scaled = config->WIDTH *
-			(config->scale_mode + SSD1306_TEXT_SCALE_NUMERATOR) / SSD1306_TEXT_SCALE_DENOMINATOR;
-	#else
-		u8 char_width_scaled = config->WIDTH * config->scale_mode;
-    #endif
+	SSD1306_Glyph_Scale_t gs;
+	_glyph_scale(&gs, config);
 
-	u8 space_offset = char_width_scaled + config->SPACE;
-	void (*pixel_func)(u8 x, u8 y) = config->color ? render_pixel : render_pixel_erase;
+	u16 char_width_scaled = SSD1306_TEXT_SCALED(config->WIDTH, config->scale_mode);
+	u16 space_offset = char_width_scaled + config->SPACE;
 
     while (*str) {
         u8 c = *str++;
 
 		//# Efficient spacebar handling - skip rendering entirely
         if (c == ' ') {
+            if (x + space_offset >= SSD1306_W) break;
             x += space_offset;
-            if (x >= SSD1306_W) break;
             continue;
         }
 
@@ -398,80 +657,50 @@ void ssd1306_render_scaled_txt(
         u8 char_index = c - 32;
         u16 char_pos = char_index * config->WIDTH;
 
-		//# loop by Width and Height
-        for (u8 col = 0; col < config->WIDTH; col++) {
-            u8 glyph = config->FONT[char_pos + col];
-
-            for (u8 row = 0; row < config->HEIGHT; row++) {
-                if (glyph & (1 << row)) {
-					//# draw the glyth bit - expand by scale
-
-					#ifdef SSD1306_TEXT_SCALE
-						// Calculate start and end positions using the full scaling formula
-						u8 factor = config->scale_mode + SSD1306_TEXT_SCALE_NUMERATOR;
-						u8 start_col = (col * factor) / SSD1306_TEXT_SCALE_DENOMINATOR;
-						u8 end_col = ((col + 1) * factor) / SSD1306_TEXT_SCALE_DENOMINATOR;
-						u8 start_row = (row * factor) / SSD1306_TEXT_SCALE_DENOMINATOR;
-						u8 end_row = ((row + 1) * factor) / SSD1306_TEXT_SCALE_DENOMINATOR;
-						
-						// Fill the rectangular block
-						for (u8 tc = start_col; tc < end_col; tc++) {
-							for (u8 tr = start_row; tr < end_row; tr++) {
-								pixel_func(x + tc, y + tr);
-							}
-						}
-					#else
-						u8 col_value = col * config->scale_mode;
-						u8 row_value = row * config->scale_mode;
-
-						for (u8 dx = 0; dx < config->scale_mode; dx++) {
-							for (u8 dy = 0; dy < config->scale_mode; dy++) {
-								pixel_func(x + dx + col_value, y + dy + row_value);
-							}
-						}
-					#endif
-                }
-            }
-        }
+		if (gs.fits) _glyph_blit(x, y, &config->FONT[char_pos], config->WIDTH, &gs, config->color);
+		else _glyph_blocks(x, y, &config->FONT[char_pos], config);
 
 		//# update x and early exit for next char
+		if (x + space_offset >= SSD1306_W) break;
         x += space_offset;
-		if (x >= SSD1306_W) break;
     }
 }
 
-// #define SSD1306_DRAW_TEXT_LOG
+// clear, render and draw are profiled as zones under ssd1306_text when
+// FUN_PROFILE is on
+PROFILE_ZONE(ssd1306_text);
+PROFILE_ZONE(ssd1306_clear);
+PROFILE_ZONE(ssd1306_render);
+PROFILE_ZONE(ssd1306_draw);
 
 //# Draw string with size
 void ssd1306_draw_scaled_text(
 	u8 x, u8 y, const char *str, Str_Config_t *config
 ) {
+	PROFILE_BEGIN(ssd1306_text);
 	// SSD1306_Text_Bounds_t bounds = _calc_text_bound05(strlen(str), x, y, config);
 	SSD1306_Text_Bounds_t bounds = _calc_text_bounds(strlen(str), x, y, config);
 	// printf("mx: %d, my: %d, page: %d\n", bounds.max_x, bounds.max_y, bounds.max_page);
 
 	//# clear text bounds
 	// Pre-fill the entire text area background
-	u32 moment = micros();
+	PROFILE_BEGIN(ssd1306_clear);
 	_clear_text_bounds(x, y, &bounds, !(config->color));
-	u32 clear_elapsed = micros() - moment;
+	PROFILE_END(ssd1306_clear);
 	
 	//# render text
-	moment = micros();
+	PROFILE_BEGIN(ssd1306_render);
 	ssd1306_render_scaled_txt(x, y, str, config);
-	u32 render_elapsed = micros() - moment;
+	PROFILE_END(ssd1306_render);
 	
 	// //# draw text
-	moment = micros();
+	PROFILE_BEGIN(ssd1306_draw);
 	u8 min_page = y>>3;
 	u8 max_page = bounds.max_y>>3;
 	ssd1306_draw_area(min_page, max_page, x, bounds.max_x);
-	u32 draw_elapsed = micros() - moment;
+	PROFILE_END(ssd1306_draw);
 
-	#ifdef SSD1306_DRAW_TEXT_LOG
-		printf("\nclear (%d), render (%d), draw (%d) in us\n", 
-				clear_elapsed, render_elapsed, draw_elapsed);
-	#endif
+	PROFILE_END(ssd1306_text);
 }
 
 
@@ -486,11 +715,12 @@ void render_fastHorLine(u8 y, u8 x0, u8 x1) {
 	// Clamp x-coordinates
 	CLAMP_VALUES(x0, x1, SSD1306_W_LIMIT);
 
-	Page_Mask_t mask = page_masks[y];
-	u8* row_start = &SSD1306_BUF[mask.page * SSD1306_W];
+	u8* row_start = SSD1306_ROW(SSD1306_PAGE(y));
+	u8 bitmask = SSD1306_BITMASK(y);
+	if (x0 <= x1) _dirty_mark(SSD1306_PAGE(y), x0, x1);
 
 	for (u8 x = x0; x <= x1; x++) {
-		row_start[x] |= mask.bitmask;
+		row_start[x] |= bitmask;
 	}
 }
 
@@ -501,11 +731,12 @@ void render_fastHorLine_erase(u8 y, u8 x0, u8 x1) {
 	// Clamp x-coordinates
 	CLAMP_VALUES(x0, x1, SSD1306_W_LIMIT);
 
-    Page_Mask_t mask = page_masks[y];
-    u8* row = &SSD1306_BUF[mask.page * SSD1306_W];
+    u8* row = SSD1306_ROW(SSD1306_PAGE(y));
+    u8 bitmask = SSD1306_BITMASK(y);
+	if (x0 <= x1) _dirty_mark(SSD1306_PAGE(y), x0, x1);
     
     for (u8 x = x0; x <= x1; x++) {
-        row[x] &= ~mask.bitmask;  // CLEAR pixels instead of setting them
+        row[x] &= ~bitmask;  // CLEAR pixels instead of setting them
     }
 }
 
@@ -531,16 +762,8 @@ void render_horLine(u8 y, u8 x_limits[2], u8 thickness, u8 mirror) {
 	if (y_end < y) return;  // Skip if thickness is 0 or overflowed
 
 	// Draw thick line
-	u8 width = x_limits[1] - x_limits[0] + 1;
-
-	for (u8 y_pos = y; y_pos <= y_end ; y_pos++) {
-		Page_Mask_t mask = page_masks[y_pos];
-		u8* row_start = &SSD1306_BUF[mask.page * SSD1306_W + x_limits[0]];
-
-        for (u8 i = 0; i < width; i++) {
-            row_start[i] |= mask.bitmask;
-        }
-	}
+	_dirty_mark_rect(y, y_end, x_limits[0], x_limits[1]);
+	_render_colSpan(x_limits[0], x_limits[1], y, y_end, 1);
 }
 
 //# render vertical line
@@ -564,17 +787,9 @@ void render_verLine(u8 x, u8 y_limits[2], u8 thickness, u8 mirror) {
 	CLAMP_VALUE(x_end, SSD1306_W_LIMIT);
 	if (x_end < x) return;  // Skip if thickness causes overflow
 
-	//# Optimized: save 500-700 us
-	u8 x_len = x_end - x + 1;  // Prerender length
-
-	for (u8 y_pos = y_limits[0]; y_pos <= y_limits[1]; y_pos++) {
-		Page_Mask_t mask = page_masks[y_pos];
-		u8* row_start = &SSD1306_BUF[mask.page * SSD1306_W + x];
-
-		for (u8 i = 0; i < x_len; i++) {
-			row_start[i] |= mask.bitmask;  					// Sequential access
-		}
-	}
+	// one OR per column and page: the rows of the line inside a page share a byte
+	_dirty_mark_rect(y_limits[0], y_limits[1], x, x_end);
+	_render_colSpan(x, x_end, y_limits[0], y_limits[1], 1);
 }
 
 //# render line (Bresenham's algorithm)
@@ -586,6 +801,15 @@ void render_line(u8 point_a[2], u8 point_b[2], u8 thickness) {
 	CLAMP_VALUES(x0, x1, SSD1306_W_LIMIT);
 	CLAMP_VALUES(y0, y1, SSD1306_H_LIMIT);
 
+	// Mark the bounding box, thickness grows it right and down
+	{
+		u8 bx0 = x0 < x1 ? x0 : x1, bx1 = (x0 < x1 ? x1 : x0) + thickness - 1;
+		u8 by0 = y0 < y1 ? y0 : y1, by1 = (y0 < y1 ? y1 : y0) + thickness - 1;
+		CLAMP_VALUE(bx1, SSD1306_W_LIMIT);
+		CLAMP_VALUE(by1, SSD1306_H_LIMIT);
+		_dirty_mark_rect(by0, by1, bx0, bx1);
+	}
+
 	// Bresenham's line algorithm
 	s16 dx = ABS(x1 - x0);
 	s16 dy = -ABS(y1 - y0);
@@ -599,40 +823,16 @@ void render_line(u8 point_a[2], u8 point_b[2], u8 thickness) {
 		if (thickness == 1) {
 			// Fast path for single-pixel
 			if (x0 < SSD1306_W && y0 < SSD1306_H) {
-				Page_Mask_t mask = page_masks[y0];
-				SSD1306_BUF[mask.page * SSD1306_W + x0] |= mask.bitmask;
+				SSD1306_BYTE(x0, y0) |= SSD1306_BITMASK(y0);
 			}
 		} else {
-			// Calculate bounds (branchless min/max)
-			u8 x_start = x0;
+			// thickness x thickness square, right and down, a byte per page
 			u8 x_end = x0 + thickness - 1;
-			u8 y_start = y0;
 			u8 y_end = y0 + thickness - 1;
-			
+
 			CLAMP_VALUE(x_end, SSD1306_W_LIMIT);
 			CLAMP_VALUE(y_end, SSD1306_H_LIMIT);
-			u8 width = x_end - x_start + 1;
-
-			// Optimized row filling
-			for (u8 y = y_start; y <= y_end; y++) {
-				Page_Mask_t mask = page_masks[y];
-				u8* row = &SSD1306_BUF[mask.page * SSD1306_W + x_start];
-				u8 pattern = mask.bitmask;
-
-				// Optimized filling based on width
-				if (width <= 4) {
-					// Fully unrolled for common cases
-					if (width > 0) row[0] |= pattern;
-					if (width > 1) row[1] |= pattern;
-					if (width > 2) row[2] |= pattern;
-					if (width > 3) row[3] |= pattern;
-				} else {
-					// For larger widths, use memset-style optimization
-					for (u8 i = 0; i < width; i++) {
-						row[i] |= pattern;
-					}
-				}
-			}
+			_render_colSpan(x0, x_end, y0, y_end, 1);
 		}
 
 		// Bresenham Advance
@@ -660,49 +860,272 @@ void render_poly(u8 pts[][2], u8 num_pts, u8 thickness) {
     render_line(pts[num_pts-1], pts[0], thickness);
 }
 
+//# page spans
+// Filled shapes hand their row spans to a toggle row: the row's bit at the
+// first column and at the one past the last. Spans of a row must not
+// overlap. Once the rows of a page are in, one XOR pass over the columns
+// gives each column's byte for the page, ORed into SSD1306_BUF once.
+
+typedef struct {
+	u8 toggles[SSD1306_W + 1];
+	u8 x_min, x_max;
+} Page_Spans_t;
+
+#define PAGE_SPANS_INIT		{ .toggles = {0}, .x_min = SSD1306_W, .x_max = 0 }
+
+static void _spans_add(Page_Spans_t *ps, u8 y, s16 x0, s16 x1) {
+	if (x0 > x1 || x1 < 0 || x0 > SSD1306_W_LIMIT) return;
+	if (x0 < 0) x0 = 0;
+	if (x1 > SSD1306_W_LIMIT) x1 = SSD1306_W_LIMIT;
+
+	u8 bit = SSD1306_BITMASK(y);
+	ps->toggles[x0] ^= bit;
+	ps->toggles[x1 + 1] ^= bit;
+	if (x0 < ps->x_min) ps->x_min = x0;
+	if (x1 > ps->x_max) ps->x_max = x1;
+}
+
+static void _spans_flush(Page_Spans_t *ps, u8 page) {
+	if (ps->x_min > ps->x_max) return;
+
+	u8 *row = SSD1306_ROW(page);
+	u8 bits = 0;
+	_dirty_mark(page, ps->x_min, ps->x_max);
+
+	for (u8 x = ps->x_min; x <= ps->x_max; x++) {
+		bits ^= ps->toggles[x];
+		ps->toggles[x] = 0;
+		row[x] |= bits;
+	}
+	ps->toggles[ps->x_max + 1] = 0;
+	ps->x_min = SSD1306_W, ps->x_max = 0;
+}
+
+//# polygon edge tables
+// render_solid_poly keeps an edge table sorted by first row and an active
+// edge table sorted by x. Each edge steps its x in 16.16 fixed point, one
+// add per row, after a single divide for its slope. Rows y0 up to y1 - 1
+// of an edge cross the row, so a vertex between two edges counts once.
+// Spans are even-odd pairs, both ends included, x rounded to the nearest
+// pixel.
+// The tables hold SSD1306_POLY_MAX_PTS edges, 16 bytes each (a 12 byte edge
+// and a pointer to it): 256 bytes of stack by default, next to the 131 byte
+// Page_Spans_t, on a part whose framebuffer already takes 1 KB of its 2 KB.
+// When more edges cross the screen, the rows go a page at a time with only
+// the edges crossing that page, then half a page and so on. A row with more
+// crossings than that takes them in sorted batches of the table size, a
+// divide per edge and batch, slow but drawn the same.
+
+#ifndef SSD1306_POLY_MAX_PTS
+	#define SSD1306_POLY_MAX_PTS	16
+#endif
+
+typedef struct {
+	s32 x, dx;			// at the current row and per row, 16.16
+	u8 y0, y1;			// rows y0 up to y1 - 1
+} Poly_Edge_t;
+
+// non horizontal edges crossing rows y_first..y_last, sorted by the first
+// of those rows they cross, x at that row. SSD1306_POLY_MAX_PTS + 1 when
+// they do not fit.
+static u8 _poly_edge_table(Poly_Edge_t *edges, u8 pts[][2], u8 num_pts, u8 y_first, u8 y_last) {
+	u8 count = 0;
+
+	for (u8 i = 0, j = num_pts - 1; i < num_pts; j = i++) {
+		u8 *a = pts[j], *b = pts[i];
+		if (a[1] == b[1]) continue;
+		if (a[1] > b[1]) { u8 *t = a; a = b; b = t; }
+		if (a[1] > y_last || b[1] <= y_first) continue;
+		if (count == SSD1306_POLY_MAX_PTS) return SSD1306_POLY_MAX_PTS + 1;
+
+		Poly_Edge_t e = {
+			.x = (s32)a[0] << 16,
+			.dx = ((s32)(b[0] - a[0]) << 16) / (b[1] - a[1]),
+			.y0 = a[1], .y1 = b[1],
+		};
+
+		// started above the band: where the adds would have taken it
+		if (e.y0 < y_first) {
+			e.x += e.dx * (y_first - e.y0);
+			e.y0 = y_first;
+		}
+
+		// insertion sort, the table is built once per band
+		u8 k = count++;
+		for (; k && edges[k - 1].y0 > e.y0; k--) edges[k] = edges[k - 1];
+		edges[k] = e;
+	}
+	return count;
+}
+
+// bring the active edges to row y: drop the finished ones, take the ones
+// starting on y and keep them sorted by x. Between rows the order barely
+// changes, so the insertion sort is close to one pass.
+static u8 _poly_active_row(
+	Poly_Edge_t *edges, u8 count, u8 *next, Poly_Edge_t **active, u8 n_active, u8 y
+) {
+	u8 kept = 0;
+	for (u8 i = 0; i < n_active; i++) {
+		if (active[i]->y1 > y) active[kept++] = active[i];
+	}
+	while (*next < count && edges[*next].y0 == y) active[kept++] = &edges[(*next)++];
+
+	for (u8 i = 1; i < kept; i++) {
+		Poly_Edge_t *e = active[i];
+		u8 k = i;
+		for (; k && active[k - 1]->x > e->x; k--) active[k] = active[k - 1];
+		active[k] = e;
+	}
+	return kept;
+}
+
+// the next crossings of row y past (last_x, last_i), at most a table of
+// them, sorted by x then edge into active. Pairs only: an odd one left
+// over comes first in the next batch. 0 when the row is done.
+static u8 _poly_row_batch(
+	Poly_Edge_t *edges, Poly_Edge_t **active, u8 pts[][2], u8 num_pts, u8 y,
+	s32 *last_x, u8 *last_i
+) {
+	u8 count = 0;
+
+	for (u8 i = 0, j = num_pts - 1; i < num_pts; j = i++) {
+		u8 *a = pts[j], *b = pts[i];
+		if (a[1] > b[1]) { u8 *t = a; a = b; b = t; }
+		if (y < a[1] || y >= b[1]) continue;
+
+		// the same x the edge table steps to
+		s32 dx = ((s32)(b[0] - a[0]) << 16) / (b[1] - a[1]);
+		s32 x = ((s32)a[0] << 16) + dx * (y - a[1]);
+		if (x < *last_x || (x == *last_x && i <= *last_i)) continue;
+
+		Poly_Edge_t *tail = &edges[SSD1306_POLY_MAX_PTS - 1];
+		if (count == SSD1306_POLY_MAX_PTS && (x > tail->x || (x == tail->x && i > tail->y0))) continue;
+
+		// keep the smallest, the edge index in y0 breaks ties
+		u8 k = count < SSD1306_POLY_MAX_PTS ? count++ : SSD1306_POLY_MAX_PTS - 1;
+		for (; k && (edges[k - 1].x > x || (edges[k - 1].x == x && edges[k - 1].y0 > i)); k--) {
+			edges[k] = edges[k - 1];
+		}
+		edges[k] = (Poly_Edge_t){ .x = x, .y0 = i };
+	}
+
+	count &= ~1;
+	if (count) {
+		*last_x = edges[count - 1].x;
+		*last_i = edges[count - 1].y0;
+	}
+	for (u8 k = 0; k < count; k++) active[k] = &edges[k];
+	return count;
+}
+
+// even-odd spans of row y from edges sorted by x, after the span ending at
+// prev_x1 (-1: none). Returns the end of the last span.
+static s16 _poly_row(
+	Page_Spans_t *spans, u8 y, Poly_Edge_t **active, u8 n_active, s16 prev_x1,
+	void (*pixel)(u8 x, u8 y, u8 alpha)
+) {
+	for (u8 i = 0; i + 1 < n_active; i += 2) {
+#ifdef SSD1306_POLY_AA
+		if (pixel) {
+			s32 a = active[i]->x + 0x8000, b = active[i + 1]->x + 0x8000;
+			s32 xa = a >> 16, xb = b >> 16;
+			if (xa > SSD1306_W_LIMIT || a == b) continue;
+
+			if (xa == xb) {
+				pixel(xa, y, (b - a) >> 8);
+				continue;
+			}
+
+			pixel(xa, y, (0xFFFF - (a & 0xFFFF)) >> 8);
+			for (s32 x = xa + 1; x < xb && x < SSD1306_W; x++) pixel(x, y, 255);
+			if ((b & 0xFFFF) >> 8 && xb < SSD1306_W) pixel(xb, y, (b & 0xFFFF) >> 8);
+			continue;
+		}
+#endif
+		s16 x0 = (active[i]->x + 0x8000) >> 16;
+		s16 x1 = (active[i + 1]->x + 0x8000) >> 16;
+
+		// rounding can touch the previous span, a column toggled twice
+		// would be a hole
+		if (x0 <= prev_x1) x0++;
+		_spans_add(spans, y, x0, x1);
+		prev_x1 = x1;
+	}
+	return prev_x1;
+}
+
+// pixel NULL: into SSD1306_BUF, a byte per column and page
+static void _poly_fill(u8 pts[][2], u8 num_pts, void (*pixel)(u8 x, u8 y, u8 alpha)) {
+	if (num_pts < 3) return;
+
+	// rows any edge crosses, on screen
+	u8 y_top = 0xFF, y_end = 0;
+	for (u8 i = 0; i < num_pts; i++) {
+		if (pts[i][1] < y_top) y_top = pts[i][1];
+		if (pts[i][1] > y_end) y_end = pts[i][1];
+	}
+	if (y_end > SSD1306_H) y_end = SSD1306_H;
+	if (y_top >= y_end) return;
+	u8 y_last = y_end - 1;
+
+	Poly_Edge_t edges[SSD1306_POLY_MAX_PTS];
+	Poly_Edge_t *active[SSD1306_POLY_MAX_PTS];
+	Page_Spans_t spans = PAGE_SPANS_INIT;
+	u8 band_last = y_last;
+
+	for (u8 y = y_top; y <= y_last;) {
+		//# band: every row at once if the edges fit, else a page or less
+		u8 count;
+		while ((count = _poly_edge_table(edges, pts, num_pts, y, band_last)) > SSD1306_POLY_MAX_PTS) {
+			if (band_last > (y | 7)) band_last = y | 7;
+			else if (band_last > y) band_last = y + (band_last - y) / 2;
+			else break;
+		}
+
+		if (count > SSD1306_POLY_MAX_PTS) {
+			//# one row, too many crossings for the table
+			s32 last_x = -1;
+			u8 last_i = 0, n;
+			s16 prev_x1 = -1;
+			while ((n = _poly_row_batch(edges, active, pts, num_pts, y, &last_x, &last_i))) {
+				prev_x1 = _poly_row(&spans, y, active, n, prev_x1, pixel);
+			}
+			if (!pixel && ((y & 7) == 7 || y == y_last)) _spans_flush(&spans, SSD1306_PAGE(y));
+			y++;
+		} else {
+			u8 n_active = 0, next = 0;
+			for (; y <= band_last; y++) {
+				n_active = _poly_active_row(edges, count, &next, active, n_active, y);
+				_poly_row(&spans, y, active, n_active, -1, pixel);
+				for (u8 i = 0; i < n_active; i++) active[i]->x += active[i]->dx;
+
+				//# page done: one byte per column
+				if (!pixel && ((y & 7) == 7 || y == y_last)) _spans_flush(&spans, SSD1306_PAGE(y));
+			}
+		}
+
+		// the rest a page at a time once the whole did not fit
+		band_last = band_last == y_last || (y | 7) > y_last ? y_last : (y | 7);
+	}
+}
+
 //# render filled polygon
 void render_solid_poly(u8 pts[][2], u8 num_pts) {
-    // Find bounding box
-    u8 y_min = SSD1306_H, y_max = 0;
+	_poly_fill(pts, num_pts, NULL);
+}
 
-    for (u8 i = 0; i < num_pts; i++) {
-        if (pts[i][1] < y_min) y_min = pts[i][1];
-        if (pts[i][1] > y_max) y_max = pts[i][1];
-    }
-    
-    for (u8 y = y_min; y <= y_max; y++) {
-        u8 intersections[8];
-        u8 count = 0;
-        
-        // Simple intersection detection
-        for (u8 i = 0, j = num_pts-1; i < num_pts; j = i++) {
-            u8 y1 = pts[i][1], y2 = pts[j][1];
-            
-            if ((y1 <= y && y < y2) || (y2 <= y && y < y1)) {
-                u8 x1 = pts[i][0], x2 = pts[j][0];
-                // Simple interpolation (good enough for small polygons)
-                u8 x = x1 + ((x2 - x1) * (y - y1)) / (y2 - y1 + 1);
-                intersections[count++] = x;
-            }
-        }
-        
-        // Simple bubble sort
-        for (u8 i = 0; i < count-1; i++) {
-            for (u8 j = i+1; j < count; j++) {
-                if (intersections[i] > intersections[j]) {
-                    u8 temp = intersections[i];
-                    intersections[i] = intersections[j];
-                    intersections[j] = temp;
-                }
-            }
-        }
-        
-        // Fill between pairs
-        for (u8 i = 0; i+1 < count; i += 2) {
-            render_fastHorLine(y, intersections[i], intersections[i+1]);
-        }
-    }
+#ifdef SSD1306_POLY_AA
+//# render filled polygon, anti-aliased
+// For panels with gray levels: the same edges and spans, handed to a pixel
+// callback with the part of each pixel the span covers, 255 inside. Pixel
+// x spans x - 0.5 up to x + 0.5, so the ends are the pixels render_solid_poly
+// fills and nothing outside them gets drawn. Only span ends are partial:
+// steep edges blend well, flat ones less. Two spans can end in the same
+// pixel, their alphas add up.
+void render_solid_poly_aa(u8 pts[][2], u8 num_pts, void (*pixel)(u8 x, u8 y, u8 alpha)) {
+	_poly_fill(pts, num_pts, pixel);
 }
+#endif
 
 //# render rectangle
 void render_rect(u8 p0[2], u8 area[2], u8 fill) {
@@ -718,10 +1141,8 @@ void render_rect(u8 p0[2], u8 area[2], u8 fill) {
 	u8 x_limit[] = { x, x_end };
 
 	if (fill) {
-		// Filled rectangle using horizontal lines (faster for row-major displays)
-		for (u8 y_pos = y; y_pos <= y_end; y_pos++) {
-			render_horLine(y_pos, x_limit, 1, 0);
-		}
+		// whole bytes down the columns of each page
+		render_colSpan(x, x_end, y, y_end, 1);
 	} else {
 		u8 y_limit[] = { y + 1, y_end - 1 };
 
@@ -756,156 +1177,345 @@ const u8 SIN_LUT[] = {
 #define COS_LUT(angle) SIN_LUT[(angle + 90) % 360]
 #define M_PI 3.14
 
-//# render circle (Bresenham's algorithm)
-void render_circle(
-	u8 point[2], u8 radius, u8 fill
+//# circle rows (Bresenham's algorithm)
+// Circles, rings and pies share one pass: a walker per circle gives the
+// half width of each row from the middle out, and the rows go top to bottom
+// into page spans. A ring leaves out the rows of its inner circle, an
+// outline the rows of its own circle shrunk by one pixel on every side,
+// which are exactly the pixels the 8 way symmetric outline plots.
+
+typedef struct {
+	s16 x, y, err;
+} Circle_Walk_t;
+
+#define CIRCLE_WALK(radius)		{ .x = -(s16)(radius), .y = 0, .err = 2 - 2 * (s16)(radius) }
+
+// half width of row w->y, then on to the next row. -1 past the top.
+static s16 _circle_row(Circle_Walk_t *w) {
+	if (w->x > 0) return -1;
+
+	s16 half = -w->x, row = w->y;
+
+	do {
+		s16 e2 = w->err;
+		if (e2 <= w->y) {
+			w->err += ++w->y * 2 + 1;
+			if (-w->x == w->y && e2 <= w->x) e2 = 0;
+		}
+		if (e2 > w->x) w->err += ++w->x * 2 + 1;
+	} while (w->y == row && w->x <= 0);
+
+	return half;
+}
+
+//# pie half planes
+// A pie is cut by the rays at its start and end angle. Each ray keeps the
+// side of a line through the center, cx * v - cy * u >= 0 with u right and
+// v up from the center, which on a row is u <= or >= cx * v / cy. That
+// bound is stepped row by row as a quotient and a remainder, so there is
+// one divide per ray and none per row.
+
+typedef struct {
+	s16 f, rem;			// floor(cx * v / d) and what is left of it
+	s16 q, rq;			// floor(cx / d) and what is left of it
+	s16 d;				// |cy|, 0 for a horizontal ray
+	s16 cx, v;
+	s8 side;			// 1 keeps u <= f, -1 keeps u >= -f
+} Half_Plane_t;
+
+#define CONIC_FAR		0x3FFF
+
+// ray direction in the SIN_LUT scale, angle in degrees counterclockwise
+static void _pie_direction(u16 angle, s16 *cx, s16 *cy) {
+	angle %= 360;
+	u8 a = angle % 90;
+	s16 sin_val = SIN_LUT[a], cos_val = SIN_LUT[90 - a];
+
+	switch (angle / 90) {
+		case 0: *cx = cos_val; *cy = sin_val; break;
+		case 1: *cx = -sin_val; *cy = cos_val; break;
+		case 2: *cx = -cos_val; *cy = -sin_val; break;
+		default: *cx = sin_val; *cy = -cos_val; break;
+	}
+}
+
+static void _half_plane_init(Half_Plane_t *h, s16 cx, s16 cy, s16 v) {
+	h->cx = cx, h->v = v;
+	h->side = cy > 0 ? 1 : cy < 0 ? -1 : 0;
+	h->d = cy < 0 ? -cy : cy;
+	if (!h->d) return;
+
+	s32 n = (s32)cx * v;
+	h->f = n / h->d, h->rem = n % h->d;
+	if (h->rem < 0) h->rem += h->d, h->f--;
+	h->q = cx / h->d, h->rq = cx % h->d;
+	if (h->rq < 0) h->rq += h->d, h->q--;
+}
+
+// the kept part of the current row as lo..hi
+static void _half_plane_row(const Half_Plane_t *h, s16 *lo, s16 *hi) {
+	*lo = -CONIC_FAR, *hi = CONIC_FAR;
+
+	if (h->side > 0) *hi = h->f;
+	else if (h->side < 0) *lo = -h->f;
+	else if (h->v && h->cx && (h->v > 0) != (h->cx > 0)) *lo = CONIC_FAR;
+}
+
+static void _half_plane_next(Half_Plane_t *h) {
+	h->v--;
+	if (!h->d) return;
+
+	h->f -= h->q;
+	h->rem -= h->rq;
+	if (h->rem < 0) h->rem += h->d, h->f--;
+}
+
+typedef struct {
+	s16 cx[2], cy[2];			// start ray, end ray turned around
+	u8 wide;					// more than 180 degrees: either side, not both
+	Half_Plane_t start, end;	// from the first row on
+} Pie_Clip_t;
+
+// u0..u1 of a row, cut by the pie
+static void _pie_spans(Page_Spans_t *ps, u8 y, u8 px, s16 u0, s16 u1, const Pie_Clip_t *pie) {
+	if (!pie) {
+		_spans_add(ps, y, px + u0, px + u1);
+		return;
+	}
+
+	s16 lo_a, hi_a, lo_b, hi_b;
+	_half_plane_row(&pie->start, &lo_a, &hi_a);
+	_half_plane_row(&pie->end, &lo_b, &hi_b);
+
+	// both sides: one span
+	if (!pie->wide) {
+		s16 lo = u0, hi = u1;
+		if (lo_a > lo) lo = lo_a;
+		if (lo_b > lo) lo = lo_b;
+		if (hi_a < hi) hi = hi_a;
+		if (hi_b < hi) hi = hi_b;
+		_spans_add(ps, y, px + lo, px + hi);
+		return;
+	}
+
+	// either side: two spans, one if they meet
+	if (lo_a < u0) lo_a = u0;
+	if (hi_a > u1) hi_a = u1;
+	if (lo_b < u0) lo_b = u0;
+	if (hi_b > u1) hi_b = u1;
+
+	if (lo_a > hi_a) { lo_a = lo_b, hi_a = hi_b; }
+	else if (lo_b <= hi_b) {
+		if (lo_b <= hi_a + 1 && lo_a <= hi_b + 1) {
+			if (lo_b < lo_a) lo_a = lo_b;
+			if (hi_b > hi_a) hi_a = hi_b;
+		} else {
+			_spans_add(ps, y, px + lo_b, px + hi_b);
+		}
+	}
+	_spans_add(ps, y, px + lo_a, px + hi_a);
+}
+
+//# render conic
+// Disk of radius around point, less the disk of hole_radius (0: none) or,
+// with outline, less its inside. pie, when given, cuts the rows.
+static void _render_conic(
+	u8 point[2], u8 radius, u8 hole_radius, u8 outline, Pie_Clip_t *pie
 ) {
-	// Validate center coordinates
 	u8 px = point[0], py = point[1];
 	if (px >= SSD1306_W || py >= SSD1306_H) return;
 
-	s16 x = -radius;
-	s16 y = 0;
-	s16 err = 2 - 2 * radius;
-	s16 e2;
+	//# one pass for the half widths of both circles
+	// py is on screen, so no row past SSD1306_H_LIMIT from it is drawn
+	u8 rows = radius < SSD1306_H_LIMIT ? radius : SSD1306_H_LIMIT;
+	s16 outer[SSD1306_H + 1], hole[SSD1306_H];
+	Circle_Walk_t walk_outer = CIRCLE_WALK(radius), walk_hole = CIRCLE_WALK(hole_radius);
 
-	do {
-		// Calculate endpoints with clamping
-		u8 x_start 	= px + x;
-		u8 x_end   	= px - x;
-		u8 y_top   	= py - y;
-		u8 y_bottom = py + y;
-
-		if (fill) {
-			// Draw filled horizontal lines (top and bottom halves)
-			render_fastHorLine(y_top, x_start, x_end);	 	// Top half
-			render_fastHorLine(y_bottom, x_start, x_end);  	// Bottom half
-		} else {
-			u8 xy_start 	= px + y;
-			u8 xy_end   	= px - y;
-			u8 yx_start 	= py + x;
-			u8 yx_end   	= py - x;
-
-			// Draw all 8 symmetric points (using prerenderd page_masks)
-			render_pixel(x_end		, y_bottom); 	// Octant 1
-			render_pixel(x_start	, y_bottom); 	// Octant 2
-			render_pixel(x_start	, y_top); 		// Octant 3
-			render_pixel(x_end		, y_top); 		// Octant 4
-			render_pixel(xy_end		, yx_start); 	// Octant 5
-			render_pixel(xy_start	, yx_start); 	// Octant 6
-			render_pixel(xy_start	, yx_end); 		// Octant 7
-			render_pixel(xy_end		, yx_end); 		// Octant 8
+	for (u8 row = 0; row <= rows; row++) {
+		outer[row] = _circle_row(&walk_outer);
+		hole[row] = hole_radius ? _circle_row(&walk_hole) : -1;
+	}
+	outer[rows + 1] = rows < radius ? _circle_row(&walk_outer) : -1;
+
+	// an outline pixel has a neighbour outside, the rest is the hole
+	if (outline) {
+		for (u8 row = 0; row <= rows; row++) {
+			hole[row] = outer[row] - 1 < outer[row + 1] ? outer[row] - 1 : outer[row + 1];
+		}
+	}
+
+	//# rows top to bottom, a page at a time
+	s16 y0 = py - radius, y1 = py + radius;
+	if (y0 < 0) y0 = 0;
+	if (y1 > SSD1306_H_LIMIT) y1 = SSD1306_H_LIMIT;
+
+	if (pie) {
+		_half_plane_init(&pie->start, pie->cx[0], pie->cy[0], py - y0);
+		_half_plane_init(&pie->end, pie->cx[1], pie->cy[1], py - y0);
+	}
+
+	Page_Spans_t spans = PAGE_SPANS_INIT;
+
+	for (s16 y = y0; y <= y1; y++) {
+		s16 row = y < py ? py - y : y - py;
+		s16 half = outer[row], inner = hole[row];
+
+		if (inner < 0) {
+			_pie_spans(&spans, y, px, -half, half, pie);
+		} else if (inner < half) {
+			_pie_spans(&spans, y, px, -half, -inner - 1, pie);
+			_pie_spans(&spans, y, px, inner + 1, half, pie);
 		}
 
-		// Update Bresenham error
-		e2 = err;
-		if (e2 <= y) {
-			err += ++y * 2 + 1;
-			if (-x == y && e2 <= x) e2 = 0;
+		if (pie) {
+			_half_plane_next(&pie->start);
+			_half_plane_next(&pie->end);
 		}
-		if (e2 > x) err += ++x * 2 + 1;
-	} while (x <= 0);
+		if ((y & 7) == 7 || y == y1) _spans_flush(&spans, SSD1306_PAGE(y));
+	}
 }
 
-//# render ring (Bresenham's algorithm)
-void _render_circle_with_func(u8 point[2], u8 radius, void (*func)(u8 y, u8 x_start, u8 x_end)) {
-	// Validate center coordinates
-	u8 px = point[0], py = point[1];
-    if (px >= SSD1306_W || py >= SSD1306_H) return;
-
-    s16 x = -radius;
-    s16 y = 0;
-    s16 err = 2 - 2 * radius;
-    s16 e2;
-
-    do {
-        u8 x_start  = px + x;
-        u8 x_end    = px - x;
-        u8 y_top    = py - y;
-        u8 y_bottom = py + y;
-
-        // handle callbacks
-		func(y_top, x_start, x_end);		// Top half
-		func(y_bottom, x_start, x_end);		// Bottom half
-
-        e2 = err;
-        if (e2 <= y) {
-            err += ++y * 2 + 1;
-            if (-x == y && e2 <= x) e2 = 0;
-        }
-        if (e2 > x) err += ++x * 2 + 1;
-    } while (x <= 0);
+//# render circle
+void render_circle(u8 point[2], u8 radius, u8 fill) {
+	_render_conic(point, radius, 0, !fill, NULL);
 }
 
+//# render ring
 void render_ring(u8 point[2], u8 radius, u8 thickness) {
-    if ((point[0] >= SSD1306_W) | (point[1] >= SSD1306_H) | (radius == 0)) return;
-    
-    // Draw filled outer circle
-    render_circle(point, radius, 1);
-    
-    // Erase the inner circle
-	u8 inner_radius = (thickness >= radius) ? 0 : (radius - thickness);
+	if (radius == 0) return;
 
-    if (inner_radius > 0) {
-		_render_circle_with_func(point, inner_radius, render_fastHorLine_erase);
-    }
+	u8 inner_radius = (thickness >= radius) ? 0 : (radius - thickness);
+	_render_conic(point, radius, inner_radius, 0, NULL);
 }
 
 //# render pie
-// Helper function to get circle point using SIN_LUT
-static void get_circle_point(
-	u8 center[2], u8 radius, u16 angle, 
-	u16 *x, u16 *y
-) {
-	u8 quadrant = angle / 90;
-	u8 reduced_angle = angle % 90;
-	u8 sin_val = SIN_LUT[reduced_angle];
-	u8 cos_val = SIN_LUT[90 - reduced_angle];
-	
-	switch (quadrant) {
-		case 0: *x = center[0] + (radius * cos_val) / 255;
-				*y = center[1] - (radius * sin_val) / 255;
-				break;
-		case 1: *x = center[0] - (radius * sin_val) / 255;
-				*y = center[1] - (radius * cos_val) / 255;
-				break;
-		case 2: *x = center[0] - (radius * cos_val) / 255;
-				*y = center[1] + (radius * sin_val) / 255;
-				break;
-		case 3: *x = center[0] + (radius * sin_val) / 255;
-				*y = center[1] + (radius * cos_val) / 255;
-				break;
+// Filled from start_angle counterclockwise to end_angle, in degrees from
+// the right. The same angle twice is the whole circle.
+void render_pie(u8 center[2], u8 radius, u16 start_angle, u16 end_angle) {
+	u16 angle = start_angle % 360;
+	u16 target_angle = end_angle % 360;
+
+	if (angle == target_angle) {
+		render_circle(center, radius, 1);
+		return;
 	}
+	if (target_angle < angle) target_angle += 360;
+
+	// keep the left of the start ray and the right of the end ray
+	Pie_Clip_t pie = { .wide = target_angle - angle > 180 };
+	_pie_direction(angle, &pie.cx[0], &pie.cy[0]);
+	_pie_direction(target_angle, &pie.cx[1], &pie.cy[1]);
+	pie.cx[1] = -pie.cx[1], pie.cy[1] = -pie.cy[1];
+
+	_render_conic(center, radius, 0, 0, &pie);
 }
 
-// Simplified pie rendering
-void render_pie(u8 center[2], u8 radius, u16 start_angle, u16 end_angle) {	
-    // Handle full circle case
-    if (start_angle == end_angle) {
-        render_circle(center, radius, 1);  // Fill entire circle
-        return;
-    }
-    
-    // Normalize angles and determine direction
-    u16 angle = start_angle % 360;
-    u16 target_angle = end_angle % 360;
-    
-    // Ensure we always draw in positive direction
-    if (target_angle < angle) target_angle += 360;
-    u8 step = 1;
-    
-    // Draw radial lines
-    while (angle <= target_angle) {
-        u8 x, y;
-        get_circle_point(center, radius, angle, &x, &y);
-        
-        // Draw line from center to edge
-        u8 p0[] = { center[0], center[1] };
-        u8 p1[] = { x, y };
-        render_line(p0, p1, 1);
-        
-        angle += step;
-    }
+//! ####################################
+//! BITMAP FUNCTIONS
+//! ####################################
+
+//# bitmaps
+// Bitmaps are laid out like SSD1306_BUF: a page of 8 rows at a time, one
+// byte per column, top row in bit 0, pages of width bytes one after the
+// other. const arrays stay in flash. A mask in the same layout makes a
+// sprite: only its set bits are drawn. An RLE bitmap packs the data as
+// control bytes: 0x80 | (n - 1) then one byte n times, or n - 1 then n
+// bytes as they are, n up to 128. Its mask, if any, is not packed.
+
+typedef enum {
+	SSD1306_ROP_OR,			// set where the bitmap is set
+	SSD1306_ROP_AND,		// clear where the bitmap is clear
+	SSD1306_ROP_XOR,		// flip where the bitmap is set
+	SSD1306_ROP_COPY,		// the bitmap as it is, set and clear
+} SSD1306_Rop_e;
+
+typedef struct {
+	const u8 *data;
+	const u8 *mask;			// NULL draws the whole rectangle
+	u8 width, height;
+	u8 rle;					// data is RLE packed
+} SSD1306_Bitmap_t;
+
+typedef struct {
+	const u8 *src;
+	u8 left, value, run;
+} Rle_Reader_t;
+
+static inline u8 _rle_next(Rle_Reader_t *rd) {
+	if (!rd->left) {
+		u8 ctrl = *rd->src++;
+		rd->left = (ctrl & 0x7F) + 1;
+		rd->run = ctrl & 0x80;
+		if (rd->run) rd->value = *rd->src++;
+	}
+	rd->left--;
+	return rd->run ? rd->value : *rd->src++;
+}
+
+// bits of src under mask onto dest
+static inline void _rop_apply(u8 *dest, u8 src, u8 mask, u8 rop) {
+	switch (rop) {
+		case SSD1306_ROP_OR:	*dest |= src & mask; break;
+		case SSD1306_ROP_AND:	*dest &= src | ~mask; break;
+		case SSD1306_ROP_XOR:	*dest ^= src & mask; break;
+		default:				*dest = (*dest & ~mask) | (src & mask); break;
+	}
+}
+
+//# render bitmap
+// Top left corner at x, y, either may be off screen. A source page lands
+// across two buffer pages when y is not a multiple of 8: shifted up by
+// y & 7 into the first and down by 8 - (y & 7) into the second, each under
+// its part of the mask: at most two read-modify-writes per source byte.
+void render_bitmap(s16 x, s16 y, const SSD1306_Bitmap_t *bmp, u8 rop) {
+	u8 w = bmp->width, h = bmp->height;
+	if (!w || !h) return;
+	if (x >= SSD1306_W || y >= SSD1306_H || x + w <= 0 || y + h <= 0) return;
+
+	//# on screen columns c0 up to c1 - 1 of the bitmap
+	u8 c0 = x < 0 ? -x : 0;
+	u8 c1 = x + w > SSD1306_W ? SSD1306_W - x : w;
+	s16 y0 = y < 0 ? 0 : y, y1 = y + h - 1;
+	if (y1 > SSD1306_H_LIMIT) y1 = SSD1306_H_LIMIT;
+	_dirty_mark_rect(y0, y1, x + c0, x + c1 - 1);
+
+	u8 shift = y & 7;
+	s16 page0 = y >> 3;			// floor, also above the screen
+	u8 pages = (h + 7) >> 3;
+	Rle_Reader_t rd = { .src = bmp->data };
+	const u8 *data = bmp->data, *mask = bmp->mask;
+
+	for (u8 p = 0; p < pages; p++) {
+		// rows past the height in the last page stay as they are
+		u8 cover = p + 1 < pages || !(h & 7) ? 0xFF : 0xFF >> (8 - (h & 7));
+		s16 top = page0 + p, bottom = top + 1;
+		u8 spills = shift && cover >> (8 - shift);
+
+		// indexed by x + c, which is on screen
+		u8 *row_top = top >= 0 && top < SSD1306_PAGES ? SSD1306_ROW(top) : NULL;
+		u8 *row_bottom = spills && bottom >= 0 && bottom < SSD1306_PAGES ? SSD1306_ROW(bottom) : NULL;
+		u16 at = p * w;
+
+		if (bmp->rle) {
+			// columns before, on and after the screen: decoded all the same
+			for (u8 c = 0; c < w; c++) {
+				u8 bits = _rle_next(&rd);
+				if (c < c0 || c >= c1) continue;
+
+				u8 m = mask ? mask[at + c] & cover : cover;
+				if (row_top) _rop_apply(&row_top[x + c], bits << shift, m << shift, rop);
+				if (row_bottom) _rop_apply(&row_bottom[x + c], bits >> (8 - shift), m >> (8 - shift), rop);
+			}
+			continue;
+		}
+
+		for (u8 c = c0; c < c1; c++) {
+			u8 bits = data[at + c];
+			u8 m = mask ? mask[at + c] & cover : cover;
+			if (row_top) _rop_apply(&row_top[x + c], bits << shift, m << shift, rop);
+			if (row_bottom) _rop_apply(&row_bottom[x + c], bits >> (8 - shift), m >> (8 - shift), rop);
+		}
+	}
 }
 
 //! ####################################
@@ -1017,7 +1627,7 @@ int y = 0;
 #define SSD1306_TEST_POLYGONS
 #define SSD1306_TEST_CIRCLES
 
-void ssd1306_draw_test() {
+void ssd1306_render_test() {
 	#ifdef SSD1306_TEST_LINES
 		//# Test hor lines
 		for(int8_t i = 0; i<sizeof(myvalues); i++) {
@@ -1079,6 +1689,9 @@ void ssd1306_draw_test() {
 	#ifdef SSD1306_TEST_POLYGONS
 		test_polys();
 	#endif
+}
 
+void ssd1306_draw_test() {
+	ssd1306_render_test();
 	ssd1306_draw_all();
 }
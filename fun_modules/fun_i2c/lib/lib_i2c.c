@@ -438,4 +438,279 @@ i2c_err_t i2c_write_reg(const i2c_device_t *dev,    const uint32_t reg,
 	i2c_stop();
 
 	return i2c_ret;
-}
\ No newline at end of file
+}
+
+
+
+/*** Asynchronous DMA API ****************************************************/
+#ifdef I2C_ASYNC
+
+/// @brief Queue of transfers, head is the one on the bus
+static i2c_xfer_t *volatile _async_head = NULL;
+static i2c_xfer_t *_async_tail = NULL;
+
+/// @brief Register bytes of the current transfer, MSB First, for the TX DMA
+static uint8_t _async_reg[4];
+
+/// @brief Stage of the current transfer
+static volatile uint8_t _async_phase;
+enum {
+	ASYNC_PHASE_REG = 0,   // Sending the register bytes
+	ASYNC_PHASE_WRITE,     // Sending the data bytes
+	ASYNC_PHASE_READ,      // Receiving into buf
+};
+
+
+/// @brief Points the TX DMA Channel at [len] bytes of [src]
+/// @param src, bytes to send
+/// @param len, number of bytes
+/// @return None
+static inline void _async_tx_dma(const uint8_t *src, const uint16_t len)
+{
+	DMA1_Channel6->CFGR &= ~DMA_CFGR1_EN;
+	DMA1_Channel6->MADDR = (uint32_t)(uintptr_t)src;
+	DMA1_Channel6->CNTR  = len;
+	DMA1_Channel6->CFGR |= DMA_CFGR1_EN;
+}
+
+
+/// @brief Sends a START for the transfer at the head of the queue
+/// @param None
+/// @return None
+static void _async_start(void)
+{
+	i2c_xfer_t *xfer = _async_head;
+
+	if(xfer->flags & I2C_XFER_REG)
+	{
+		uint8_t regb = xfer->dev->regb;
+		for(uint8_t b = 0; b < regb; b++)
+			_async_reg[b] = (xfer->reg >> (8 * (regb - 1 - b))) & 0xFF;
+		_async_phase = ASYNC_PHASE_REG;
+	} else {
+		_async_phase = (xfer->flags & I2C_XFER_READ) ? ASYNC_PHASE_READ
+		                                             : ASYNC_PHASE_WRITE;
+	}
+
+	I2C1->CTLR2 |= I2C_CTLR2_ITEVTEN | I2C_CTLR2_ITERREN;
+	I2C1->CTLR1 |= I2C_CTLR1_START;
+}
+
+
+/// @brief Ends the transfer at the head of the queue, reports [err] and
+/// starts the next one. Queued transfers are joined with a repeated START
+/// from this same event, so nothing waits on a STOP in interrupt context;
+/// the STOP only goes out once the queue runs dry
+/// @param err, result of the transfer
+/// @return None
+static void _async_finish(const i2c_err_t err)
+{
+	I2C1->CTLR2 &= ~(I2C_CTLR2_ITEVTEN | I2C_CTLR2_ITERREN |
+	                 I2C_CTLR2_DMAEN   | I2C_CTLR2_LAST);
+	DMA1_Channel6->CFGR &= ~DMA_CFGR1_EN;
+	DMA1_Channel7->CFGR &= ~DMA_CFGR1_EN;
+
+	i2c_xfer_t *xfer = _async_head;
+	_async_head = xfer->_next;
+
+	xfer->status = err;
+	xfer->done   = 1;
+	if(xfer->callback) xfer->callback(xfer);
+
+	if(_async_head) _async_start();
+	else            I2C1->CTLR1 |= I2C_CTLR1_STOP;
+}
+
+
+/// @brief Ends every queued transfer with [err] and stops the bus, for a
+/// transfer that never finished. Call with interrupts disabled
+/// @param err, result for the dropped transfers
+/// @return None
+static void _async_abort(const i2c_err_t err)
+{
+	I2C1->CTLR2 &= ~(I2C_CTLR2_ITEVTEN | I2C_CTLR2_ITERREN |
+	                 I2C_CTLR2_DMAEN   | I2C_CTLR2_LAST);
+	DMA1_Channel6->CFGR &= ~DMA_CFGR1_EN;
+	DMA1_Channel7->CFGR &= ~DMA_CFGR1_EN;
+
+	while(_async_head)
+	{
+		i2c_xfer_t *xfer = _async_head;
+		_async_head = xfer->_next;
+
+		xfer->status = err;
+		xfer->done   = 1;
+		if(xfer->callback) xfer->callback(xfer);
+	}
+	I2C1->CTLR1 |= I2C_CTLR1_STOP;
+}
+
+
+void I2C1_EV_IRQHandler(void) __attribute__((interrupt));
+void I2C1_EV_IRQHandler(void)
+{
+	i2c_xfer_t *xfer = _async_head;
+	uint16_t star1 = I2C1->STAR1;
+	if(xfer == NULL) return;
+
+	// START sent: arm the DMA for this phase, then send the address
+	if(star1 & I2C_STAR1_SB)
+	{
+		uint8_t addr = (xfer->dev->addr << 1) & 0xFE;
+
+		if(_async_phase == ASYNC_PHASE_READ)
+		{
+			addr |= 0x01;
+
+			DMA1_Channel7->CFGR &= ~DMA_CFGR1_EN;
+			DMA1_Channel7->MADDR = (uint32_t)(uintptr_t)xfer->buf;
+			DMA1_Channel7->CNTR  = xfer->len;
+			DMA1_Channel7->CFGR |= DMA_CFGR1_EN;
+
+			// LAST NACKs the final byte when the DMA runs out
+			if(xfer->len > 1) I2C1->CTLR1 |=  I2C_CTLR1_ACK;
+			else              I2C1->CTLR1 &= ~I2C_CTLR1_ACK;
+			I2C1->CTLR2 |= I2C_CTLR2_DMAEN | I2C_CTLR2_LAST;
+		} else {
+			if(_async_phase == ASYNC_PHASE_REG)
+				_async_tx_dma(_async_reg, xfer->dev->regb);
+			else
+				_async_tx_dma(xfer->buf, xfer->len);
+			I2C1->CTLR2 |= I2C_CTLR2_DMAEN;
+		}
+
+		I2C1->DATAR = addr;
+		return;
+	}
+
+	// Address ACKed: reading STAR2 clears ADDR and hands the bus to the DMA
+	if(star1 & I2C_STAR1_ADDR)
+	{
+		(void)I2C1->STAR2;
+
+		// Reads complete on the RX DMA interrupt
+		if(_async_phase == ASYNC_PHASE_READ)
+			I2C1->CTLR2 &= ~I2C_CTLR2_ITEVTEN;
+		else if(_async_phase == ASYNC_PHASE_WRITE && xfer->len == 0)
+			_async_finish(I2C_OK);
+		return;
+	}
+
+	// TX DMA drained and the last byte is out. BTF stays up until the
+	// START that follows it goes out, so ignore it while one is pending
+	if((star1 & I2C_STAR1_BTF) && !(I2C1->CTLR1 & I2C_CTLR1_START))
+	{
+		if(_async_phase == ASYNC_PHASE_REG && (xfer->flags & I2C_XFER_READ))
+		{
+			// Repeated START for the read
+			_async_phase = ASYNC_PHASE_READ;
+			I2C1->CTLR2 &= ~I2C_CTLR2_DMAEN;
+			I2C1->CTLR1 |= I2C_CTLR1_START;
+		}
+		else if(_async_phase == ASYNC_PHASE_REG && xfer->len > 0)
+		{
+			_async_phase = ASYNC_PHASE_WRITE;
+			_async_tx_dma(xfer->buf, xfer->len);
+		}
+		else
+		{
+			_async_finish(I2C_OK);
+		}
+	}
+}
+
+
+void I2C1_ER_IRQHandler(void) __attribute__((interrupt));
+void I2C1_ER_IRQHandler(void)
+{
+	// Report the first error, but clear them all so none re-fires the IRQ
+	i2c_err_t i2c_err = i2c_get_busy_error();
+	I2C1->STAR1 &= ~(I2C_STAR1_BERR | I2C_STAR1_AF |
+	                 I2C_STAR1_ARLO | I2C_STAR1_OVR);
+	if(_async_head) _async_finish(i2c_err);
+}
+
+
+void DMA1_Channel7_IRQHandler(void) __attribute__((interrupt));
+void DMA1_Channel7_IRQHandler(void)
+{
+	DMA1->INTFCR = DMA1_IT_GL7;
+	if(_async_head) _async_finish(I2C_OK);
+}
+
+
+void i2c_async_init(void)
+{
+	RCC->AHBPCENR |= RCC_AHBPeriph_DMA1;
+
+	// TX: memory to DATAR, RX: DATAR to memory with a completion interrupt
+	DMA1_Channel6->PADDR = (uint32_t)(uintptr_t)&I2C1->DATAR;
+	DMA1_Channel6->CFGR  = DMA_CFGR1_MINC | DMA_CFGR1_DIR;
+	DMA1_Channel7->PADDR = (uint32_t)(uintptr_t)&I2C1->DATAR;
+	DMA1_Channel7->CFGR  = DMA_CFGR1_MINC | DMA_CFGR1_TCIE;
+
+	NVIC_EnableIRQ(I2C1_EV_IRQn);
+	NVIC_EnableIRQ(I2C1_ER_IRQn);
+	NVIC_EnableIRQ(DMA1_Channel7_IRQn);
+}
+
+
+i2c_err_t i2c_async_submit(i2c_xfer_t *xfers, const size_t count)
+{
+	if(xfers == NULL || count == 0) return I2C_OK;
+
+	// Link the array into a chain before it becomes visible to the IRQs
+	for(size_t x = 0; x < count; x++)
+	{
+		xfers[x].done   = 0;
+		xfers[x].status = I2C_ERR_BUSY;
+		xfers[x]._next  = (x + 1 < count) ? &xfers[x + 1] : NULL;
+	}
+
+	__disable_irq();
+	uint8_t idle = (_async_head == NULL);
+	if(idle) _async_head = xfers;
+	else     _async_tail->_next = xfers;
+	_async_tail = &xfers[count - 1];
+	__enable_irq();
+
+	// A STOP from the last queue takes one bit time to go out
+	if(idle)
+	{
+		_i2c_timeout = I2C_TIMEOUT;
+		while((I2C1->CTLR1 & I2C_CTLR1_STOP) && --_i2c_timeout > 0);
+		_async_start();
+	}
+	return I2C_OK;
+}
+
+
+uint8_t i2c_async_busy(void)
+{
+	return _async_head != NULL;
+}
+
+
+i2c_err_t i2c_async_wait(i2c_xfer_t *xfer)
+{
+	// Sleep between interrupts. WFI wakes on a pending IRQ even with them
+	// masked, so a completion between the check and the WFI is not lost
+	uint32_t start = SysTick->CNT;
+	for(;;)
+	{
+		__disable_irq();
+		if(xfer->done) break;
+		if(SysTick->CNT - start > I2C_ASYNC_TIMEOUT_MS * DELAY_MS_TIME)
+		{
+			_async_abort(I2C_ERR_TIMEOUT);
+			break;
+		}
+		__WFI();
+		__enable_irq();
+	}
+	__enable_irq();
+
+	return xfer->status;
+}
+
+#endif
@@ -93,6 +93,7 @@ typedef enum {
 	I2C_ERR_ARLO,	 // Arbitration Lost
 	I2C_ERR_OVR,	 // Overun/underrun condition
 	I2C_ERR_BUSY,	 // Bus was busy and timed out
+	I2C_ERR_TIMEOUT, // Async transfer did not finish in time
 } i2c_err_t;
 
 
@@ -174,4 +175,79 @@ i2c_err_t i2c_write_reg(const i2c_device_t *dev,    const uint32_t reg,
                                                     const uint8_t *buf,
                                                     const size_t len);
 
+
+
+/*** Asynchronous DMA Transactions *******************************************/
+// Define I2C_ASYNC (e.g. in funconfig.h) to build the queued, DMA driven
+// transaction API. It owns DMA1 Channel 6 (TX), Channel 7 (RX) and the
+// I2C1_EV / I2C1_ER interrupt handlers, so it can not be used together with
+// i2c_slave.h. Do not call the blocking functions while transfers are queued.
+#ifdef I2C_ASYNC
+
+#if defined(FUN_USES_DMA1_CH6) || defined(FUN_USES_DMA1_CH7)
+	#error "I2C_ASYNC needs DMA1_CH6/CH7, another module already uses them"
+#endif
+#define FUN_USES_DMA1_CH6
+#define FUN_USES_DMA1_CH7
+
+/// @brief How long i2c_async_wait() waits before it drops the queue. A full
+/// SSD1306 frame takes ~25ms at 400KHz and ~100ms at 100KHz
+#ifndef I2C_ASYNC_TIMEOUT_MS
+	#define I2C_ASYNC_TIMEOUT_MS 250
+#endif
+
+/// @brief Transfer flags
+#define I2C_XFER_WRITE    0x00  // write [len] bytes from [buf]
+#define I2C_XFER_READ     0x01  // read [len] bytes into [buf]
+#define I2C_XFER_REG      0x02  // send [reg] (dev->regb bytes, MSB First)
+                                // first. Reads use a repeated START
+
+typedef struct i2c_xfer i2c_xfer_t;
+
+/// @brief One I2C transaction. Queued transactions are joined by repeated
+/// STARTs, with one STOP after the last. Must stay valid until done
+struct i2c_xfer {
+	const i2c_device_t *dev;        // Device to talk to
+	uint32_t            reg;        // Register, with I2C_XFER_REG
+	uint8_t            *buf;        // Data to write, or to read into
+	uint16_t            len;        // Number of data bytes
+	uint8_t             flags;      // I2C_XFER_*
+	void (*callback)(i2c_xfer_t *); // Called from the IRQ when done, or NULL
+
+	volatile uint8_t    done;       // Set when the transfer has finished
+	volatile i2c_err_t  status;     // Result, valid once done is set
+	i2c_xfer_t         *_next;      // Queue link, owned by the driver
+};
+
+
+/// @brief Sets up the DMA Channels and Interrupts. Call after i2c_init()
+/// @param None
+/// @return None
+void i2c_async_init(void);
+
+
+/// @brief Queues [count] transfers to run back to back, behind anything
+/// already queued. Returns immediately, the transfers run from interrupts
+/// @param xfers, array of transfers
+/// @param count, number of transfers in the array
+/// @return i2c_err_t, I2C_OK when queued
+i2c_err_t i2c_async_submit(i2c_xfer_t *xfers, const size_t count);
+
+
+/// @brief Returns 1 while any transfer is queued or running
+/// @param None
+/// @return uint8_t busy state
+uint8_t i2c_async_busy(void);
+
+
+/// @brief Sleeps until a queued transfer finishes. After I2C_ASYNC_TIMEOUT_MS
+/// (measured on SysTick->CNT) the bus is stopped and every queued transfer
+/// ends with I2C_ERR_TIMEOUT. The deadline is checked when an interrupt
+/// wakes the CPU, e.g. the SysTick IRQ of systick_irq.h
+/// @param xfer, transfer to wait for
+/// @return i2c_err_t status of the transfer
+i2c_err_t i2c_async_wait(i2c_xfer_t *xfer);
+
+#endif
+
 #endif
\ No newline at end of file
@@ -30,8 +30,7 @@
 
 // #define IR_RECEIVER_DEBUG_LOG
 
-// uncomment to show cycle log
-// #define IR_RECEIVER_CYCLE_LOG
+// fun_irReceiver_task() is profiled as zone ir_task when FUN_PROFILE is on
 
 //! ####################################
 //! RECEIVE FUNCTIONS USING GPIO
@@ -68,9 +67,18 @@ typedef struct {
 	u16 LOGICAL_0_US;					// LOGICAL_0 in microseconds
 	u16 START_SIGNAL_THRESHOLD_US;		// START_SIGNAL_THRESHOLD in microseconds
 	void (*onHandle_data)(u8*, u16);
+
+	#ifdef IR_RECEIVER_USE_DMA
+		// time_ref holds the last edge in timer ticks
+		u32 tick_ref;					// TIM1->CNT extended to 32 bits
+	#endif
 } IR_Receiver_t;
 
-Cycle_Info_t ir_cycle;
+PROFILE_ZONE(ir_task);
+
+#ifdef IR_RECEIVER_USE_DMA
+	void fun_irReceiver_capture_init(IR_Receiver_t* model);
+#endif
 
 
 //* INIT FUNCTION
@@ -92,7 +100,9 @@ void fun_irReceiver_init(IR_Receiver_t* model) {
 	model->prev_state = 0,
 	model->current_state = 0,
 
-	UTIL_cycleInfo_clear(&ir_cycle);		// clear cycle
+	#ifdef IR_RECEIVER_USE_DMA
+		fun_irReceiver_capture_init(model);
+	#endif
 }
 
 //* PROCESS BUFFER FUNCTION
@@ -117,66 +127,202 @@ void _irReceiver_processBuffer(IR_Receiver_t *model) {
 	#endif
 }
 
-//* TASK FUNCTION
-void fun_irReceiver_task(IR_Receiver_t* model) {
-	if (model->pin == -1) return;
-	u8 new_state = funDigitalRead(model->pin);
-	u32 moment = micros();
-
-	//! check for state change
-	if (new_state != model->prev_state) {
-		u16 elapsed = moment - model->time_ref;
-
-		//# STEP 1: Filter out high thresholds
-		// NEC protocol uses the PWM's OFF state spacing for LOGICAL value
-		u8 valid_signal = (elapsed < model->START_SIGNAL_THRESHOLD_US) && 
-						(model->LOGICAL_1_US != IR_NEC_LOGICAL_1_US || !new_state);
-
-		if (valid_signal) {
-			//! prevent overflow
-			if (model->byte_idx >= model->RECEIVE_MAX_LEN) {
-				printf("max byte reached: %d\n", model->byte_idx);
-				//# STEP 3: Process Buffer when it's full
-				_irReceiver_processBuffer(model);
-				return;
-			}
-
-			//# STEP 2: collect data
-			model->BIT_BUFFER[model->bit_idx] = elapsed;
-
-			//# Debug log
-			#ifdef IR_RECEIVER_DEBUG_LOG
-				UTIL_DebugBuffer_addValue(&debug_buffer, elapsed);
-			#endif
-
-			// Determine bit value
-			int bit = ABS(model->LOGICAL_1_US - elapsed) < ABS(model->LOGICAL_0_US - elapsed);
-			u8 bit_pos = 7 - (model->bit_idx % 8);
-			// Set bit in current byte (MSB first)
-			if (bit) model->RECEIVE_BUF[model->byte_idx] |= 1 << bit_pos;
-
-            // Increment and handle byte completion
-            if (++model->bit_idx >= 8) {
-                model->byte_idx++;        // next byte
-                model->bit_idx = 0;   // reset bit counter
-            }
+//* EDGE DECODER
+// One line transition to [new_state] after [elapsed] us in the previous state.
+// Returns 0 when the buffer was full and got flushed instead.
+u8 _irReceiver_edge(IR_Receiver_t* model, u8 new_state, u16 elapsed) {
+	//# STEP 1: Filter out high thresholds
+	// NEC protocol uses the PWM's OFF state spacing for LOGICAL value
+	u8 valid_signal = (elapsed < model->START_SIGNAL_THRESHOLD_US) && 
+					(model->LOGICAL_1_US != IR_NEC_LOGICAL_1_US || !new_state);
+
+	if (valid_signal) {
+		//! prevent overflow
+		if (model->byte_idx >= model->RECEIVE_MAX_LEN) {
+			printf("max byte reached: %d\n", model->byte_idx);
+			//# STEP 3: Process Buffer when it's full
+			_irReceiver_processBuffer(model);
+			return 0;
 		}
 
-		model->time_ref = model->timeout_ref = micros();
+		//# STEP 2: collect data
+		model->BIT_BUFFER[model->bit_idx] = elapsed;
+
+		//# Debug log
+		#ifdef IR_RECEIVER_DEBUG_LOG
+			UTIL_DebugBuffer_addValue(&debug_buffer, elapsed);
+		#endif
+
+		// Determine bit value
+		int bit = ABS(model->LOGICAL_1_US - elapsed) < ABS(model->LOGICAL_0_US - elapsed);
+		u8 bit_pos = 7 - (model->bit_idx % 8);
+		// Set bit in current byte (MSB first)
+		if (bit) model->RECEIVE_BUF[model->byte_idx] |= 1 << bit_pos;
+
+		// Increment and handle byte completion
+		if (++model->bit_idx >= 8) {
+			model->byte_idx++;        // next byte
+			model->bit_idx = 0;   // reset bit counter
+		}
 	}
+	return 1;
+}
 
+//* TIMEOUT HANDLER
+void _irReceiver_timeout(IR_Receiver_t* model) {
 	//# STEP 4: Timeout handler
 	if ((micros() - model->timeout_ref) > IR_RECEIVER_TIMEOUT_US) {
 		model->timeout_ref = micros();
 
 		//! process the buffer
 		_irReceiver_processBuffer(model);
+	}
+}
 
-		#ifdef IR_RECEIVER_CYCLE_LOG
-			UTIL_cycleInfo_flush(&ir_cycle);		// flush cycle
-		#endif
+#ifndef IR_RECEIVER_USE_DMA
+
+//* POLL
+void _irReceiver_poll(IR_Receiver_t* model) {
+	if (model->pin == -1) return;
+	u8 new_state = funDigitalRead(model->pin);
+	u32 moment = micros();
+
+	//! check for state change
+	if (new_state != model->prev_state) {
+		if (!_irReceiver_edge(model, new_state, moment - model->time_ref)) return;
+		model->time_ref = model->timeout_ref = micros();
 	}
 
+	_irReceiver_timeout(model);
+
 	model->prev_state = model->current_state = new_state;
-	UTIL_cycleInfo_updateWithLimit(&ir_cycle, micros() - moment, 50);
-}
\ No newline at end of file
+}
+
+#else
+
+//! ####################################
+//! RECEIVE FUNCTIONS USING TIMER CAPTURE
+//! ####################################
+
+// TIM1 counts microseconds and timestamps both edges of the receiver pin
+// without the CPU: CH2 captures the falling edges of PA1 directly, CH1
+// captures its rising edges through the CH2 input (CC1S = 10). Each channel
+// has its own circular DMA ring (CH1 -> DMA1_CH2, CH2 -> DMA1_CH3). Edges
+// alternate, so the task merges the rings by reading the one the current
+// line level says comes next, and decodes every edge since the last call.
+// The task has to run at least once per IR_CAPTURE_EDGES edges of each kind
+// and once per 65 ms, the 16-bit counter is extended to 32 bits on each call.
+//! the receiver pin must be PA1 (TIM1_CH2), owns TIM1 and DMA1_CH2/CH3.
+//! That rules out fun_irSender.h (its carrier runs on TIM1) and
+//! fun_ws2812_spi.h (SPI1_TX streams on DMA1_CH3) in the same build.
+
+#if defined(FUN_USES_TIM1) || defined(FUN_USES_DMA1_CH2) || defined(FUN_USES_DMA1_CH3)
+	#error "IR_RECEIVER_USE_DMA needs TIM1 and DMA1_CH2/CH3, another module already uses them"
+#endif
+#define FUN_USES_TIM1
+#define FUN_USES_DMA1_CH2
+#define FUN_USES_DMA1_CH3
+
+#define IR_DMA_RISE		DMA1_Channel2		// TIM1_CH1
+#define IR_DMA_FALL		DMA1_Channel3		// TIM1_CH2
+
+//! power of 2, per edge direction
+#ifndef IR_CAPTURE_EDGES
+	#define IR_CAPTURE_EDGES 32
+#endif
+
+u16 ir_rise_buf[IR_CAPTURE_EDGES];
+u16 ir_fall_buf[IR_CAPTURE_EDGES];
+UTIL_Ring_t ir_rise_ring, ir_fall_ring;
+
+void _irReceiver_dma_ring(DMA_Channel_TypeDef *dma, volatile u32 *ccr, u16 *buf) {
+	dma->CFGR = 0;
+	dma->MADDR = (u32)(uintptr_t)buf;
+	dma->PADDR = (u32)(uintptr_t)ccr;
+	dma->CNTR = IR_CAPTURE_EDGES;
+	dma->CFGR =
+		0					|				// PERIPHERAL to MEMORY
+		DMA_CFGR1_MSIZE_0	|				// 16-bit memory
+		DMA_CFGR1_PSIZE_0	|				// 16-bit peripheral
+		DMA_CFGR1_MINC		|				// Increase memory.
+		DMA_CFGR1_CIRC		|				// Circular mode.
+		DMA_CFGR1_EN;						// Enable
+}
+
+void fun_irReceiver_capture_init(IR_Receiver_t* model) {
+	//! TIM1_CH2 only sees PA1, leave the timer alone for any other pin
+	if (model->pin != PA1) {
+		printf("IRReceiver: capture needs PA1\n");
+		return;
+	}
+
+	RCC->APB2PCENR |= RCC_APB2Periph_TIM1 | RCC_APB2Periph_AFIO;
+	RCC->AHBPCENR |= RCC_AHBPeriph_DMA1;
+
+	_irReceiver_dma_ring(IR_DMA_RISE, &TIM1->CH1CVR, ir_rise_buf);
+	_irReceiver_dma_ring(IR_DMA_FALL, &TIM1->CH2CVR, ir_fall_buf);
+	UTIL_ring_init(&ir_rise_ring, ir_rise_buf, IR_CAPTURE_EDGES, sizeof(u16));
+	UTIL_ring_init(&ir_fall_ring, ir_fall_buf, IR_CAPTURE_EDGES, sizeof(u16));
+
+	TIM1->PSC = FUNCONF_SYSTEM_CORE_CLOCK / 1000000 - 1;	// 1 tick = 1 us
+	TIM1->ATRLR = 0xFFFF;
+
+	//# CH1 <- TI2 (CC1S = 10), CH2 <- TI2 (CC2S = 01)
+	TIM1->CHCTLR1 = TIM_CC1S_1 | TIM_CC2S_0;
+	//# CH1 on the rising edge, CH2 on the falling edge
+	TIM1->CCER = TIM_CC1E | TIM_CC2E | TIM_CC2P;
+	TIM1->SWEVGR = TIM_UG;
+	TIM1->CTLR1 = TIM_CEN;
+	TIM1->DMAINTENR = TIM_CC1DE | TIM_CC2DE;
+
+	model->prev_state = model->current_state = funDigitalRead(model->pin);
+	model->tick_ref = model->time_ref = TIM1->CNT;
+}
+
+//* POLL
+void _irReceiver_poll(IR_Receiver_t* model) {
+	if (model->pin != PA1) return;
+
+	UTIL_ring_dmaHead(&ir_rise_ring, IR_DMA_RISE);
+	UTIL_ring_dmaHead(&ir_fall_ring, IR_DMA_FALL);
+
+	// extend the counter after taking the heads, so no drained edge is newer
+	u16 now = TIM1->CNT;
+	model->tick_ref += (u16)(now - model->tick_ref);
+	u8 drained = 0;
+
+	for (;;) {
+		u8 rising = !model->prev_state;
+		UTIL_Ring_t *ring = rising ? &ir_rise_ring : &ir_fall_ring;
+
+		if (!UTIL_ring_count(ring)) {
+			//! two edges of the other kind waiting: a level was missed, follow them
+			if (UTIL_ring_count(rising ? &ir_fall_ring : &ir_rise_ring) < 2) break;
+			model->prev_state = rising;
+			continue;
+		}
+
+		u16 tick = *(u16*)UTIL_ring_at(ring, 0);
+		UTIL_ring_consume(ring, 1);
+
+		u32 edge = model->tick_ref - (u16)(now - tick);
+		u32 elapsed = edge - model->time_ref;
+		model->time_ref = edge;
+		model->prev_state = model->current_state = rising;
+		drained = 1;
+
+		if (!_irReceiver_edge(model, rising, elapsed > 0xFFFF ? 0xFFFF : elapsed)) break;
+	}
+
+	if (drained) model->timeout_ref = micros();
+	_irReceiver_timeout(model);
+}
+
+#endif
+
+//* TASK FUNCTION
+void fun_irReceiver_task(IR_Receiver_t* model) {
+	PROFILE_BEGIN(ir_task);
+	_irReceiver_poll(model);
+	PROFILE_END(ir_task);
+}
@@ -55,8 +55,23 @@ typedef struct {
 	u16 LOGICAL_0_US;			// Logical_0 spacing in microseconds
 	u16 START_HI_US;			// Start_HI spacing in microseconds
 	u16 START_LO_US;			// Start_LO spacing in microseconds
+
+	// DMA mode only
+	void (*onDone)(u8 *data, u16 len);	// frame is off the air, [data] may be reused
+	u16 segment;				// next mark/space of the frame being encoded
+	u16 segment_count;			// marks + spaces of that frame
 } IR_Sender_t;
 
+#ifdef IR_SENDER_USE_DMA
+	void _irSender_dma_init(void);
+#endif
+
+// The 38kHz carrier is TIM1 CH1N in every mode, so TIM1 belongs to the sender
+#ifdef FUN_USES_TIM1
+	#error "fun_irSender.h drives its carrier on TIM1, another module already uses it"
+#endif
+#define FUN_USES_TIM1
+
 // Enable/disable PWM carrier
 static inline void PWM_ON(void)  { TIM1->CCER |=  TIM_CC1NE; }
 static inline void PWM_OFF(void) { TIM1->CCER &= ~TIM_CC1NE; }
@@ -88,6 +103,10 @@ u8 fun_irSender_init(IR_Sender_t *model) {
 	TIM1->CTLR1 |= TIM_CEN;		// Enable TIM1
 
 	TIM1->CCER |= TIM_CC1NP;
+
+	#ifdef IR_SENDER_USE_DMA
+		_irSender_dma_init();
+	#endif
 	return 1;
 }
 
@@ -95,14 +114,7 @@ u8 fun_irSender_init(IR_Sender_t *model) {
 //! ASYNC TRANSMIT FUNCTIONS
 //! ####################################
 
-void fun_irSender_asyncSend(IR_Sender_t *model, u8 *data, u16 len) {
-	//! start the pulses
-	model->state = IR_Start_Pulse;
-	model->time_ref = micros();
-	model->buffer_idx = 0;
-	model->BUFFER = data;
-	model->BUFFER_LEN = len;
-
+void _irSender_defaults(IR_Sender_t *model) {
 	if (model->LOGICAL_1_US < 250 || model->LOGICAL_0_US < 250 ||
 		model->START_HI_US < 2000 || model->START_LO_US < 2000
 	) {
@@ -113,6 +125,18 @@ void fun_irSender_asyncSend(IR_Sender_t *model, u8 *data, u16 len) {
 	}
 }
 
+#ifndef IR_SENDER_USE_DMA
+
+void fun_irSender_asyncSend(IR_Sender_t *model, u8 *data, u16 len) {
+	//! start the pulses
+	model->state = IR_Start_Pulse;
+	model->time_ref = micros();
+	model->buffer_idx = 0;
+	model->BUFFER = data;
+	model->BUFFER_LEN = len;
+	_irSender_defaults(model);
+}
+
 //* NEC TRANSMIT ASYNC. 
 //! NOTE: Only works with PWM
 void fun_irSender_asyncTask(IR_Sender_t *model) {
@@ -209,6 +233,245 @@ void fun_irSender_asyncTask(IR_Sender_t *model) {
 }
 
 
+#else
+
+//! ####################################
+//! ASYNC TRANSMIT FUNCTIONS USING DMA
+//! ####################################
+
+// A frame is a list of alternating mark/space durations. TIM1 keeps
+// generating the carrier; TIM2 counts microseconds and its counter reload
+// ends each segment. At every reload two DMA requests (compare at 0 on
+// CH3 and CH4) load the next duration into TIM2->ATRLR and the next carrier
+// state into TIM1->CCER, so marks and spaces are timed by hardware.
+// Durations stream through a small ring: a frame that fits is encoded in
+// full by fun_irSender_asyncSend(), longer ones are refilled from the DMA
+// half/complete interrupt every IR_SENDER_DMA_SEGMENTS / 2 segments.
+// Frames queue up and go out back to back, IR_SENDER_GAP_US apart.
+//! owns TIM2, DMA1_CH1 (durations + IRQ) and DMA1_CH7 (carrier state).
+//! The TIM2 requests are hardwired to those channels, so this mode can not
+//! share a build with fun_joystick.h (ADC on DMA1_CH1), I2C_ASYNC (I2C RX
+//! and its IRQ on DMA1_CH7) or fun_encoder_tim2.h.
+
+#if defined(FUN_USES_TIM2) || defined(FUN_USES_DMA1_CH1) || defined(FUN_USES_DMA1_CH7)
+	#error "IR_SENDER_USE_DMA needs TIM2 and DMA1_CH1/CH7, another module already uses them"
+#endif
+#define FUN_USES_TIM2
+#define FUN_USES_DMA1_CH1
+#define FUN_USES_DMA1_CH7
+
+#define IR_DMA_DURATION		DMA1_Channel1		// TIM2_CH3
+#define IR_DMA_CARRIER		DMA1_Channel7		// TIM2_CH4
+
+//! even, mark/space segments in flight
+#ifndef IR_SENDER_DMA_SEGMENTS
+	#define IR_SENDER_DMA_SEGMENTS 16
+#endif
+
+//! queue slots, holds IR_SENDER_QUEUE - 1 frames including the one on the air
+#ifndef IR_SENDER_QUEUE
+	#define IR_SENDER_QUEUE 4
+#endif
+
+// space after every frame, before the next one starts
+#ifndef IR_SENDER_GAP_US
+	#define IR_SENDER_GAP_US 40000
+#endif
+
+// carrier off filler once the queue runs dry
+#define IR_SENDER_PAD_US 1000
+
+#define IR_SENDER_HALF (IR_SENDER_DMA_SEGMENTS / 2)
+
+u16 ir_duration_buf[IR_SENDER_DMA_SEGMENTS];		// TIM2->ATRLR values
+u16 ir_carrier_buf[IR_SENDER_DMA_SEGMENTS];		// TIM1->CCER values
+
+IR_Sender_t *ir_sender;
+u8 *ir_queue_data[IR_SENDER_QUEUE];
+u16 ir_queue_len[IR_SENDER_QUEUE];
+// [done, tail) encoded and waiting for onDone, tail is being encoded,
+// [tail, head) queued
+volatile u8 ir_queue_done, ir_queue_tail, ir_queue_head;
+volatile u8 ir_sender_busy;
+
+// per ring half: frames that ended inside it, it holds only filler
+u8 ir_half_done[2], ir_half_pad[2];
+u16 ir_ccer_on, ir_ccer_off;
+
+#define IR_SEGMENT		0
+#define IR_SEGMENT_LAST	1
+#define IR_SEGMENT_PAD	2
+
+//* SEGMENT DURATION
+// [seg] of a frame: start mark, start space, the bits, a closing mark and
+// the gap. NEC sends a LOGICAL_0_US mark before every bit space, the
+// custom protocol flips the carrier on every bit.
+u16 _irSender_segment_us(IR_Sender_t *model, u8 *data, u16 seg) {
+	if (seg == 0) return model->START_HI_US;
+	if (seg == 1) return model->START_LO_US;
+	if (seg == model->segment_count - 1) return IR_SENDER_GAP_US;
+	if (seg == model->segment_count - 2) return model->LOGICAL_0_US;
+
+	u16 bit_idx = seg - 2;
+	if (model->LOGICAL_1_US == NEC_LOGICAL_1_US) {
+		if (!(bit_idx & 1)) return model->LOGICAL_0_US;
+		bit_idx >>= 1;
+	}
+
+	u8 bit = (data[bit_idx / 8] >> (7 - bit_idx % 8)) & 1;		// MSB first
+	return bit ? model->LOGICAL_1_US : model->LOGICAL_0_US;
+}
+
+//* NEXT SEGMENT
+// as the TIM2->ATRLR and TIM1->CCER values to load, filler when the queue is empty
+u8 _irSender_next(IR_Sender_t *model, u16 *arr, u16 *ccer) {
+	u8 idx = ir_queue_tail;
+	if (idx == ir_queue_head) {
+		*arr = IR_SENDER_PAD_US - 1;
+		*ccer = ir_ccer_off;
+		return IR_SEGMENT_PAD;
+	}
+
+	if (model->segment == 0) {
+		u16 bits = ir_queue_len[idx] * IR_DATA_BITs_LEN;
+		if (model->LOGICAL_1_US == NEC_LOGICAL_1_US) bits *= 2;
+		model->segment_count = 2 + bits + 2;
+	}
+
+	u16 seg = model->segment++;
+	*arr = _irSender_segment_us(model, ir_queue_data[idx], seg) - 1;
+	*ccer = (seg & 1) ? ir_ccer_off : ir_ccer_on;
+	if (model->segment < model->segment_count) return IR_SEGMENT;
+
+	//! frame fully encoded, the next one follows right after its gap
+	model->segment = 0;
+	ir_queue_tail = (idx + 1) % IR_SENDER_QUEUE;
+	return IR_SEGMENT_LAST;
+}
+
+void _irSender_fill_half(IR_Sender_t *model, u8 half) {
+	u16 *arr = ir_duration_buf + half * IR_SENDER_HALF;
+	u16 *ccer = ir_carrier_buf + half * IR_SENDER_HALF;
+	u8 pad = 1;
+
+	for (int i = 0; i < IR_SENDER_HALF; i++) {
+		u8 kind = _irSender_next(model, &arr[i], &ccer[i]);
+		if (kind == IR_SEGMENT_LAST) ir_half_done[half]++;
+		if (kind != IR_SEGMENT_PAD) pad = 0;
+	}
+	ir_half_pad[half] = pad;
+}
+
+void _irSender_dma_init(void) {
+	RCC->APB1PCENR |= RCC_APB1Periph_TIM2;
+	RCC->AHBPCENR |= RCC_AHBPeriph_DMA1;
+	ir_ccer_off = TIM1->CCER & ~TIM_CC1NE;
+	ir_ccer_on = ir_ccer_off | TIM_CC1NE;
+	NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+}
+
+void _irSender_dma_stop(void) {
+	TIM2->CTLR1 = 0;
+	TIM2->DMAINTENR = 0;
+	IR_DMA_DURATION->CFGR = 0;
+	IR_DMA_CARRIER->CFGR = 0;
+	TIM1->CCER = ir_ccer_off;
+	ir_sender_busy = 0;
+}
+
+void _irSender_dma_ring(DMA_Channel_TypeDef *dma, volatile u16 *reg, u16 *buf, u32 irq) {
+	dma->CFGR = 0;
+	dma->MADDR = (u32)(uintptr_t)buf;
+	dma->PADDR = (u32)(uintptr_t)reg;
+	dma->CNTR = IR_SENDER_DMA_SEGMENTS;
+	dma->CFGR =
+		DMA_CFGR1_DIR		|				// MEMORY to PERIPHERAL
+		DMA_Priority_VeryHigh |			// both requests within a reload
+		DMA_CFGR1_MSIZE_0	|				// 16-bit memory
+		DMA_CFGR1_PSIZE_0	|				// 16-bit peripheral
+		DMA_CFGR1_MINC		|				// Increase memory.
+		DMA_CFGR1_CIRC		|				// Circular mode.
+		irq					|
+		DMA_CFGR1_EN;						// Enable
+}
+
+void _irSender_dma_start(IR_Sender_t *model) {
+	ir_sender_busy = 1;
+	ir_half_done[0] = ir_half_done[1] = 0;
+	_irSender_fill_half(model, 0);
+	_irSender_fill_half(model, 1);
+
+	_irSender_dma_ring(IR_DMA_DURATION, &TIM2->ATRLR, ir_duration_buf, DMA_CFGR1_HTIE | DMA_CFGR1_TCIE);
+	_irSender_dma_ring(IR_DMA_CARRIER, &TIM1->CCER, ir_carrier_buf, 0);
+
+	TIM2->CTLR1 = 0;
+	TIM2->PSC = FUNCONF_SYSTEM_CORE_CLOCK / 1000000 - 1;	// 1 tick = 1 us
+	TIM2->ATRLR = 0;				// reload after 1 us, the DMA loads the first segment
+	TIM2->CH3CVR = 0;				// both requests fire on the counter reload
+	TIM2->CH4CVR = 0;
+	TIM2->SWEVGR = TIM_UG;
+	TIM2->DMAINTENR = TIM_CC3DE | TIM_CC4DE;
+	TIM2->CTLR1 = TIM_CEN;
+}
+
+void DMA1_Channel1_IRQHandler(void) __attribute__((interrupt));
+void DMA1_Channel1_IRQHandler(void) {
+	volatile int intfr = DMA1->INTFR;
+	DMA1->INTFCR = DMA1_IT_GL1;
+
+	// the half the DMA just left: its last segment is playing now
+	u8 half = (intfr & DMA1_IT_TC1) ? 1 : 0;
+
+	while (ir_half_done[half]) {
+		ir_half_done[half]--;
+		u8 idx = ir_queue_done;
+		ir_queue_done = (idx + 1) % IR_SENDER_QUEUE;
+		if (ir_sender->onDone) ir_sender->onDone(ir_queue_data[idx], ir_queue_len[idx]);
+	}
+
+	//! filler playing and nothing but filler coming: the queue ran dry
+	if (ir_half_pad[half] && ir_half_pad[!half] && ir_queue_tail == ir_queue_head) {
+		_irSender_dma_stop();
+		return;
+	}
+	_irSender_fill_half(ir_sender, half);
+}
+
+//* QUEUE A FRAME
+// [data] is read while the frame is encoded: keep it until onDone.
+// Returns 0 when the queue is full.
+u8 fun_irSender_asyncSend(IR_Sender_t *model, u8 *data, u16 len) {
+	_irSender_defaults(model);
+
+	__disable_irq();
+	u8 next = (ir_queue_head + 1) % IR_SENDER_QUEUE;
+	if (next == ir_queue_done) {
+		__enable_irq();
+		return 0;
+	}
+
+	ir_queue_data[ir_queue_head] = data;
+	ir_queue_len[ir_queue_head] = len;
+	ir_queue_head = next;
+
+	if (!ir_sender_busy) {
+		ir_sender = model;
+		_irSender_dma_start(model);
+	}
+	__enable_irq();
+	return 1;
+}
+
+u8 fun_irSender_busy(void) {
+	return ir_sender_busy;
+}
+
+//* nothing to poll, kept so main loops written for the GPIO sender still build
+void fun_irSender_asyncTask(IR_Sender_t *model) {}
+
+#endif
+
+
 //! ####################################
 //! BLOCKING TRANSMIT FUNCTIONS
 //! ####################################
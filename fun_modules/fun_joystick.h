@@ -2,6 +2,12 @@
 #include "ch32fun.h"
 #include <stdio.h>
 
+// The ADC scans into a buffer over DMA1_CH1, its only DMA request
+#ifdef FUN_USES_DMA1_CH1
+	#error "fun_joystick.h reads the ADC over DMA1_CH1, another module already uses it"
+#endif
+#define FUN_USES_DMA1_CH1
+
 #define ADC_NUMCHLS 2
 volatile uint16_t adc_buffer[ADC_NUMCHLS];
 
@@ -53,8 +59,8 @@ void fun_joystick_setup() {
 	RCC->AHBPCENR |= RCC_AHBPeriph_DMA1;
 	
 	//DMA1_Channel1 is for ADC
-	DMA1_Channel1->PADDR = (uint32_t)&ADC1->RDATAR;
-	DMA1_Channel1->MADDR = (uint32_t)adc_buffer;
+	DMA1_Channel1->PADDR = (uint32_t)(uintptr_t)&ADC1->RDATAR;
+	DMA1_Channel1->MADDR = (uint32_t)(uintptr_t)adc_buffer;
 	DMA1_Channel1->CNTR  = ADC_NUMCHLS;
 	DMA1_Channel1->CFGR  =
 		DMA_M2M_Disable |		 
@@ -73,6 +79,10 @@ void fun_joystick_setup() {
 	ADC1->CTLR2 |= ADC_SWSTART;             // start conversion
 }
 
+#ifndef JOYSTICK_TASK_PERIOD_MS
+	#define JOYSTICK_TASK_PERIOD_MS 100
+#endif
+
 uint32_t joystick_timeRef = 0;
 
 void fun_joystick_task(void (*handler)(uint16_t, uint16_t)) {
@@ -83,7 +93,7 @@ void fun_joystick_task(void (*handler)(uint16_t, uint16_t)) {
 }
 
 void fun_joystick_timerTask(uint32_t time, void (*handler)(uint16_t, uint16_t)) {
-	if (time - joystick_timeRef < 100) return;
+	if (time - joystick_timeRef < JOYSTICK_TASK_PERIOD_MS) return;
     joystick_timeRef = time;
 	
 	fun_joystick_task(handler);
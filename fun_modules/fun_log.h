@@ -32,6 +32,7 @@
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 //------------------------------------------------------------------------------
 // Module exported defines
@@ -40,6 +41,49 @@
 #define CONFIG_DEBUG_ENABLE_LOGS (1)
 #endif
 
+// a LOG line is formatted here first and written out in one piece
+#ifndef LOG_LINE_MAX
+#define LOG_LINE_MAX (128)
+#endif
+
+// uncomment for binary records instead of text, see DEFERRED LOGGING below
+// #define LOG_DEFERRED
+
+#ifdef LOG_DEFERRED
+#include "fun_utilities.h"
+
+#ifndef LOG_DEFERRED_WORDS
+#define LOG_DEFERRED_WORDS (64)	// record ring in 32-bit words, power of 2
+#endif
+
+#define _LOG_STR_(x)	#x
+#define _LOG_STR(x)		_LOG_STR_(x)
+#define _LOG_CAT_(a, b)	a##b
+#define _LOG_CAT(a, b)	_LOG_CAT_(a, b)
+
+#define _LOG_NARGS(...)	_LOG_NARGS_(_, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define _LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, n, ...)	n
+
+#define _LOG_W(x)			(uint32_t)(uintptr_t)(x)
+#define _LOG_ARGS_0()
+#define _LOG_ARGS_1(a)		_LOG_W(a)
+#define _LOG_ARGS_2(a, ...)	_LOG_W(a), _LOG_ARGS_1(__VA_ARGS__)
+#define _LOG_ARGS_3(a, ...)	_LOG_W(a), _LOG_ARGS_2(__VA_ARGS__)
+#define _LOG_ARGS_4(a, ...)	_LOG_W(a), _LOG_ARGS_3(__VA_ARGS__)
+#define _LOG_ARGS_5(a, ...)	_LOG_W(a), _LOG_ARGS_4(__VA_ARGS__)
+#define _LOG_ARGS_6(a, ...)	_LOG_W(a), _LOG_ARGS_5(__VA_ARGS__)
+#define _LOG_ARGS_7(a, ...)	_LOG_W(a), _LOG_ARGS_6(__VA_ARGS__)
+#define _LOG_ARGS_8(a, ...)	_LOG_W(a), _LOG_ARGS_7(__VA_ARGS__)
+#define _LOG_ARGS(...)		_LOG_CAT(_LOG_ARGS_, _LOG_NARGS(__VA_ARGS__))(__VA_ARGS__)
+
+#define LOG_DEFER(style, color, tag, f_, ...) do { \
+	static const char _site[] = "\033[" _LOG_STR(style) ";" _LOG_STR(color) "m[" tag "] \0" f_; \
+	_LOG_defer(_site, _LOG_NARGS(__VA_ARGS__), (const uint32_t[]){ _LOG_ARGS(__VA_ARGS__) }); \
+} while (0)
+
+void _LOG_defer(const char *site, uint32_t nargs, const uint32_t *args);
+#endif
+
 //# ANSI color codes
 #define LOG_COLOR_NORMAL		39
 #define LOG_COLOR_BLACK			30
@@ -64,7 +108,22 @@
 
 void LOG(uint8_t style, uint8_t color, const char *tag, char *format, ...);
 
-#if (CONFIG_DEBUG_ENABLE_LOGS)
+#if (CONFIG_DEBUG_ENABLE_LOGS) && defined(LOG_DEFERRED)
+	// tag and format are stored at the call site, only the arguments are sent
+	#define SLOG_Debug(style, tag, f_, ...)		LOG_DEFER(style, LOG_COLOR_NORMAL, tag, f_, ##__VA_ARGS__)
+	#define SLOG_Info(style, tag, f_, ...)		LOG_DEFER(style, LOG_COLOR_CYAN, tag, f_, ##__VA_ARGS__)
+	#define SLOG_Warn(style, tag, f_, ...)		LOG_DEFER(style, LOG_COLOR_YELLOW, tag, f_, ##__VA_ARGS__)
+	#define SLOG_Err(style, tag, f_, ...)		LOG_DEFER(style, LOG_COLOR_RED, tag, f_, ##__VA_ARGS__)
+	#define SLOG_Ok(style, tag, f_, ...)		LOG_DEFER(style, LOG_COLOR_GREEN, tag, f_, ##__VA_ARGS__)
+	#define SLOG_Notice(style, tag, f_, ...)	LOG_DEFER(style, LOG_COLOR_MAGENTA, tag, f_, ##__VA_ARGS__)
+
+	#define LOG_Debug(tag, f_, ...)		LOG_DEFER(LOG_STYLE_NORMAL, LOG_COLOR_NORMAL, tag, f_, ##__VA_ARGS__)
+	#define LOG_Info(tag, f_, ...)		LOG_DEFER(LOG_STYLE_NORMAL, LOG_COLOR_CYAN, tag, f_, ##__VA_ARGS__)
+	#define LOG_Warn(tag, f_, ...)		LOG_DEFER(LOG_STYLE_ITALIC, LOG_COLOR_YELLOW, tag, f_, ##__VA_ARGS__)
+	#define LOG_Err(tag, f_, ...)		LOG_DEFER(LOG_STYLE_BOLD, LOG_COLOR_RED, tag, f_, ##__VA_ARGS__)
+	#define LOG_Ok(tag, f_, ...)		LOG_DEFER(LOG_STYLE_BOLD, LOG_COLOR_GREEN, tag, f_, ##__VA_ARGS__)
+	#define LOG_Notice(tag, f_, ...)	LOG_DEFER(LOG_STYLE_NORMAL, LOG_COLOR_MAGENTA, tag, f_, ##__VA_ARGS__)
+#elif (CONFIG_DEBUG_ENABLE_LOGS)
 	// Log with style
 	#define SLOG_Debug(style, tag, f_, ...)		LOG(style, LOG_COLOR_NORMAL, tag, (f_), ##__VA_ARGS__)
 	#define SLOG_Info(style, tag, f_, ...)		LOG(style, LOG_COLOR_CYAN, tag, (f_), ##__VA_ARGS__)
@@ -134,20 +193,31 @@ void LOG(uint8_t style, uint8_t color, const char *tag, char *format, ...);
 #define LOG_FG256(n) "\033[38;5;" #n "m"
 #define LOG_BG256(n) "\033[48;5;" #n "m"
 
-static const uint32_t *s_systick = NULL;
+static const volatile uint32_t *s_systick = NULL;
+static uint16_t (*s_write)(const void *data, uint16_t len) = NULL;
+
+static void _LOG_write(const char *buf, int len) {
+	if (s_write) s_write(buf, len);
+	else printf("%.*s", len, buf);
+}
 
 void _LOG_Print_inStyle(uint8_t style, uint8_t color) {
 	printf("\033[%d;%dm", style, color);
 }
 
-void LOG_Init(const uint32_t *const systick) {
+void LOG_Init(const volatile uint32_t *const systick) {
 	s_systick = systick;
 }
 
+// send LOG output somewhere other than printf, eg. uart_tx_write from fun_uart.h
+void LOG_setOutput(uint16_t (*write)(const void *data, uint16_t len)) {
+	s_write = write;
+}
+
 void LOG_banner(const char *name) {
-	printf(LOG_BG_RGB(70, 130, 180));
-	printf(name);
-	printf(LOG_RESET "\n");
+	char line[LOG_LINE_MAX];
+	int n = snprintf(line, sizeof(line), LOG_BG_RGB(70, 130, 180) "%s" LOG_RESET "\n", name);
+	_LOG_write(line, n < (int)sizeof(line) ? n : (int)sizeof(line) - 1);
 }
 
 void LOG_listUsages() {
@@ -168,16 +238,90 @@ void LOG_listUsages() {
 
 #if (CONFIG_DEBUG_ENABLE_LOGS)
 void LOG(uint8_t style, uint8_t color, const char *tag, char *format, ...) {
-    _LOG_Print_inStyle(style, color);
-    printf("[%s] %lu: ", tag, *s_systick);
-    
-    va_list args;
-    va_start(args, format);
-    vprintf(format, args);
-    va_end(args);
-    
-    printf("\033[0;39m");  // Reset color
-    printf("\n");  // Just newline, not \r\n
+	static const char end[] = "\033[0;39m\n";	// Reset color, just newline, not \r\n
+	const int room = LOG_LINE_MAX - (sizeof(end) - 1);
+	char line[LOG_LINE_MAX];
+
+	// style and header, then the message, truncated to leave room for the end
+	int n = snprintf(line, room, "\033[%d;%dm[%s] %lu: ", style, color, tag, (unsigned long)*s_systick);
+	if (n > room - 1) n = room - 1;
+
+	va_list args;
+	va_start(args, format);
+	n += vsnprintf(line + n, room - n, format, args);
+	va_end(args);
+	if (n > room - 1) n = room - 1;
+
+	memcpy(line + n, end, sizeof(end) - 1);
+	_LOG_write(line, n + sizeof(end) - 1);
+}
+#endif
+
+
+#ifdef LOG_DEFERRED
+//! ####################################
+//! DEFERRED LOGGING
+//! ####################################
+
+// With LOG_DEFERRED nothing is formatted on the device. Each LOG_* call site
+// keeps a static string "<ESC>[style;colorm[tag] \0format" and queues one
+// record of 32-bit words:
+//   [nargs << 28 | site address][timestamp][arg]...
+// LOG_flush() sends the records out through the LOG output as raw little
+// endian words, fun_host/log_decode rebuilds the text from the firmware ELF.
+// A record is reserved, filled and queued with interrupts off, so LOG_* may
+// be used from interrupts as well as the main loop. LOG_flush() is for the
+// main loop only.
+//! tag, format, style and color must be literals or macros of them
+//! up to 8 integer or pointer arguments, %s only for string constants
+
+#ifndef LOG_FLUSH_WORDS
+#define LOG_FLUSH_WORDS (16)	// words per write to the LOG output
+#endif
+
+static uint32_t s_log_words[LOG_DEFERRED_WORDS];
+static UTIL_Ring_t s_log_ring = {
+	.buf = (u8 *)s_log_words,
+	.mask = LOG_DEFERRED_WORDS - 1,
+	.elem_size = sizeof(uint32_t),
+};
+uint32_t LOG_dropped;	// records that did not fit the ring
+
+void _LOG_defer(const char *site, uint32_t nargs, const uint32_t *args) {
+	UTIL_RingSpan_t span;
+	const uint32_t words = 2 + nargs;
+
+	__disable_irq();
+	if (UTIL_ring_reserve(&s_log_ring, &span) < words) {
+		LOG_dropped++;
+		__enable_irq();
+		return;
+	}
+
+	for (uint32_t i = 0; i < words; i++) {
+		uint32_t *w = i < span.len[0] ? (uint32_t *)span.ptr[0] + i : (uint32_t *)span.ptr[1] + (i - span.len[0]);
+		*w = i == 0 ? nargs << 28 | ((uint32_t)(uintptr_t)site & 0x0FFFFFFF) :
+			i == 1 ? *s_systick : args[i - 2];
+	}
+	UTIL_ring_produce(&s_log_ring, words);
+	__enable_irq();
+}
+
+// Send queued records to the LOG output, returns 0 when it ran out of room
+uint8_t LOG_flush(void) {
+	UTIL_RingSpan_t span;
+
+	while (UTIL_ring_peek(&s_log_ring, &span)) {
+		uint16_t n = span.len[0] < LOG_FLUSH_WORDS ? span.len[0] : LOG_FLUSH_WORDS;
+
+		if (s_write) {
+			if (!s_write(span.ptr[0], n * sizeof(uint32_t))) return 0;
+		} else {
+			for (uint16_t i = 0; i < n * sizeof(uint32_t); i++) putchar(span.ptr[0][i]);
+		}
+		UTIL_ring_consume(&s_log_ring, n);
+	}
+	return 1;
 }
 #endif
 
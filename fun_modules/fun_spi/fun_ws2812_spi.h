@@ -29,7 +29,26 @@
 
 // #define WSGRB // For SK6805-EC15
 
+// #define WS2812_PRECOMPUTED // Encode whole frames outside the ISR, see PRECOMPUTED BITSTREAM
+// #define WS2812_STREAMING // Strips longer than DMALEDS, see STREAMING RENDERER
+// #define WS2812_OUTPUT_STAGE // Gamma, brightness and dithering, see OUTPUT STAGE
+
+#if defined(WS2812_PRECOMPUTED) && defined(WS2812_STREAMING)
+	#error "WS2812_PRECOMPUTED and WS2812_STREAMING are exclusive"
+#endif
+
+#if defined(WS2812_OUTPUT_STAGE) && defined(WSRAW)
+	#error "WS2812_OUTPUT_STAGE works on 24 bit colors, not WSRAW"
+#endif
+
+// The bitstream goes out on SPI1_TX, which is hardwired to DMA1_CH3
+#ifdef FUN_USES_DMA1_CH3
+	#error "fun_ws2812_spi.h streams on DMA1_CH3, another module already uses it"
+#endif
+#define FUN_USES_DMA1_CH3
+
 // Must be divisble by 4.
+// With WS2812_STREAMING this only sizes the DMA buffer, the strip can be longer.
 #ifndef DMALEDS
 	#define DMALEDS 16
 #endif
@@ -45,20 +64,120 @@
 	#define DMA_BUFFER_LEN (((DMALEDS)/2)*6)
 #endif
 
-static uint16_t WS2812_DMA_BUF[DMA_BUFFER_LEN];
-static volatile int WS2812LEDs;
-static volatile int WS2812LED_Place;
-static volatile int WS2812BLED_InUse;
-
 uint32_t WS2812BLEDCallback(int ledno);
 
+//! ####################################
+//! STRIP INSTANCES
+//! ####################################
+
+// One WS2812_Strip_t per strip on an SPI: its DMA channel and ring buffer,
+// its length and color order, and where the refresh is. The CH32V003 has a
+// single SPI (SPI1, TX on DMA1_Channel3), so one strip runs on SPI at a
+// time; more strips go on the PARALLEL GPIO OUTPUT below. WS2812_strip is
+// the one SPI_DMA_WS2812_init() sets up and the animation engine drives.
+
+// Color order on the wire, as the RGB_t byte sent first, second and third
+#define WS2812_ORDER(first, second, third)	((first) | (second) << 2 | (third) << 4)
+
+enum {
+	WS2812_ORDER_RGB = WS2812_ORDER(0, 1, 2),
+	WS2812_ORDER_RBG = WS2812_ORDER(0, 2, 1),
+	WS2812_ORDER_GRB = WS2812_ORDER(1, 0, 2),
+	WS2812_ORDER_GBR = WS2812_ORDER(1, 2, 0),
+	WS2812_ORDER_BRG = WS2812_ORDER(2, 0, 1),
+	WS2812_ORDER_BGR = WS2812_ORDER(2, 1, 0),
+};
+
+// WSGRB and WSRBG only pick the default order now, both have always sent G R B
+#if defined(WSGRB) || defined(WSRBG)
+	#define WS2812_ORDER_DEFAULT	WS2812_ORDER_GRB
+#else
+	#define WS2812_ORDER_DEFAULT	WS2812_ORDER_BGR
+#endif
+
+// 24 bit color with the byte to send first on top
+static inline u32 WS2812_color_order(u32 c, u8 order) {
+	if (order == WS2812_ORDER_BGR) return c & 0xFFFFFF;
+	return (c >> (8 * (order & 3)) & 0xFF) << 16 |
+		(c >> (8 * (order >> 2 & 3)) & 0xFF) << 8 |
+		(c >> (8 * (order >> 4)) & 0xFF);
+}
+
+typedef struct {
+	SPI_TypeDef *spi;
+	DMA_Channel_TypeDef *dma;		// TX channel of spi
+	u16 *buf;						// DMA ring, refilled a half at a time
+	int buf_len;					// halfwords, a whole number of LEDs per half
+	u8 order;						// WS2812_ORDER_*, not used with WSRAW
+	volatile int leds;
+	volatile int place;				// next LED to encode, negative in the reset slots
+	volatile int in_use;			// a refresh is on the wire
+	u32 (*color)(int ledIdx);		// color of a LED, 24 bits (32 with WSRAW)
+} WS2812_Strip_t;
+
+// the precomputed path sends from its own double buffer instead
+#ifndef WS2812_PRECOMPUTED
+	static uint16_t WS2812_DMA_BUF[DMA_BUFFER_LEN];
+#endif
+static WS2812_Strip_t WS2812_strip;
+
+// strip the DMA1_Channel3 ISR refills
+static WS2812_Strip_t *WS2812_spi_strip = &WS2812_strip;
+
+//! ####################################
+//! OUTPUT STAGE
+//! ####################################
+
+// With WS2812_OUTPUT_STAGE every color goes through LUT_GAMMA16 (gamma 2.6
+// with 8 fractional bits) and the global WS2812_brightness right before it
+// is encoded, in the DMA fill or in the batch encode. The fraction left
+// after rounding is kept per pixel and channel and added on the next frame,
+// so a level between two output steps shows as their mix over a few frames
+// instead of a band. Pixels past WS2812_DITHER_LEDS (long streaming strips)
+// are rounded instead.
+
+#ifndef WS2812_DITHER_LEDS
+	#define WS2812_DITHER_LEDS DMALEDS
+#endif
+
+#ifdef WS2812_OUTPUT_STAGE
+
+u8 WS2812_brightness = 255;		// global scale, 255 is full
+static u8 WS2812_dither_err[WS2812_DITHER_LEDS][3];
+
+static inline u32 WS2812_output(int ledIdx, u32 color) {
+	u8 *err = ledIdx < WS2812_DITHER_LEDS ? WS2812_dither_err[ledIdx] : NULL;
+	u32 scale = WS2812_brightness + 1;
+	u32 out = 0;
+
+	for (int ch = 0; ch < 24; ch += 8) {
+		u32 v = LUT_GAMMA16[(color >> ch) & 0xFF];
+		if (scale != 256) v = v * scale >> 8;
+
+		// LUT_GAMMA16 tops out at 0xFF00, adding the error cannot pass 255
+		if (err) {
+			v += *err;
+			*err++ = v;
+		} else {
+			v += 0x80;
+		}
+		out |= (v >> 8) << ch;
+	}
+	return out;
+}
+
+#define WS2812_OUTPUT(ledIdx, color)	WS2812_output(ledIdx, color)
+#else
+#define WS2812_OUTPUT(ledIdx, color)	(color)
+#endif
+
 //! ####################################
 //! CORE FUNCTIONS
 //! ####################################
 
-// This is the code that updates a portion of the WS2812_DMA_BUF with new data.
+// This is the code that updates a portion of the strip's DMA buffer with new data.
 // This effectively creates the bitstream that outputs to the LEDs.
-static void WS2812FillBuffSec(uint16_t * ptr, int numhalfwords, int tce) {
+static void WS2812FillBuffSec(WS2812_Strip_t *s, uint16_t * ptr, int numhalfwords, int tce) {
 	const static uint16_t bitquartets[16] = {
 		0b1000100010001000, 0b1000100010001110, 0b1000100011101000, 0b1000100011101110,
 		0b1000111010001000, 0b1000111010001110, 0b1000111011101000, 0b1000111011101110,
@@ -66,10 +185,9 @@ static void WS2812FillBuffSec(uint16_t * ptr, int numhalfwords, int tce) {
 		0b1110111010001000, 0b1110111010001110, 0b1110111011101000, 0b1110111011101110
 	};
 
-	int i;
 	uint16_t * end = ptr + numhalfwords;
-	int ledcount = WS2812LEDs;
-	int place = WS2812LED_Place;
+	int ledcount = s->leds;
+	int place = s->place;
 
 	#ifdef WSRAW
 		while( place < 0 && ptr != end ) {
@@ -93,12 +211,14 @@ static void WS2812FillBuffSec(uint16_t * ptr, int numhalfwords, int tce) {
 			while( ptr != end )
 				(*ptr++) = 0;//0xffff;
 
-			// Only safe to do this when we're on the second leg.
+			// Only safe to do this when we're on the second leg, and only once
+			// the half holding the last LEDs went out: stopping on the first
+			// pass would end the DMA before this half is sent.
 			if( tce ) {
-				if( place == ledcount ) {
+				if( place == ledcount + 1 ) {
 					// Take the DMA out of circular mode and let it expire.
-					DMA1_Channel3->CFGR &= ~DMA_Mode_Circular;
-					WS2812BLED_InUse = 0;
+					s->dma->CFGR &= ~DMA_Mode_Circular;
+					s->in_use = 0;
 				}
 				place++;
 			}
@@ -107,7 +227,7 @@ static void WS2812FillBuffSec(uint16_t * ptr, int numhalfwords, int tce) {
 		}
 
 		#ifdef WSRAW
-			uint32_t ledval32bit = WS2812BLEDCallback( place++ );
+			uint32_t ledval32bit = s->color( place++ );
 			ptr[6] = bitquartets[(ledval32bit>>28)&0xf];
 			ptr[7] = bitquartets[(ledval32bit>>24)&0xf];
 			ptr[4] = bitquartets[(ledval32bit>>20)&0xf];
@@ -117,45 +237,126 @@ static void WS2812FillBuffSec(uint16_t * ptr, int numhalfwords, int tce) {
 			ptr[0] = bitquartets[(ledval32bit>>4)&0xf];
 			ptr[1] = bitquartets[(ledval32bit>>0)&0xf];
 			ptr += 8;
-			i += 8;
 		#else
 			// Use a LUT to figure out how we should set the SPI line.
-			uint32_t ledval24bit = WS2812BLEDCallback( place++ );
-
-			#ifdef WSGRB
-				ptr[0] = bitquartets[(ledval24bit>>12)&0xf];
-				ptr[1] = bitquartets[(ledval24bit>>8)&0xf];
-				ptr[2] = bitquartets[(ledval24bit>>4)&0xf];
-				ptr[3] = bitquartets[(ledval24bit>>0)&0xf];
-				ptr[4] = bitquartets[(ledval24bit>>20)&0xf];
-				ptr[5] = bitquartets[(ledval24bit>>16)&0xf];
-			#elif defined( WSRBG )
-				ptr[0] = bitquartets[(ledval24bit>>12)&0xf];
-				ptr[1] = bitquartets[(ledval24bit>>8)&0xf];
-				ptr[2] = bitquartets[(ledval24bit>>4)&0xf];
-				ptr[3] = bitquartets[(ledval24bit>>0)&0xf];
-				ptr[4] = bitquartets[(ledval24bit>>20)&0xf];
-				ptr[5] = bitquartets[(ledval24bit>>16)&0xf];
-			#else
-				ptr[0] = bitquartets[(ledval24bit>>20)&0xf];
-				ptr[1] = bitquartets[(ledval24bit>>16)&0xf];
-				ptr[2] = bitquartets[(ledval24bit>>12)&0xf];
-				ptr[3] = bitquartets[(ledval24bit>>8)&0xf];
-				ptr[4] = bitquartets[(ledval24bit>>4)&0xf];
-				ptr[5] = bitquartets[(ledval24bit>>0)&0xf];
-			#endif
-			
+			uint32_t ledval24bit = WS2812_OUTPUT( place, s->color( place ) );
+			ledval24bit = WS2812_color_order( ledval24bit, s->order );
+			place++;
+
+			ptr[0] = bitquartets[(ledval24bit>>20)&0xf];
+			ptr[1] = bitquartets[(ledval24bit>>16)&0xf];
+			ptr[2] = bitquartets[(ledval24bit>>12)&0xf];
+			ptr[3] = bitquartets[(ledval24bit>>8)&0xf];
+			ptr[4] = bitquartets[(ledval24bit>>4)&0xf];
+			ptr[5] = bitquartets[(ledval24bit>>0)&0xf];
 			ptr += 6;
-			i += 6;
 		#endif
 	}
 
-	WS2812LED_Place = place;
+	s->place = place;
 }
 
+//! ####################################
+//! PRECOMPUTED BITSTREAM
+//! ####################################
+
+// With WS2812_PRECOMPUTED a frame is rendered into WS2812_BUF and encoded in
+// one batch by the main loop, into the back half of a double buffer. DMA sends
+// the front half in one shot and the ISR only swaps halves, so no render or
+// encode work runs in interrupt context.
+
+#ifdef WS2812_PRECOMPUTED
+
+#ifdef WSRAW
+	#define WS2812_LED_HALFWORDS 8
+#else
+	#define WS2812_LED_HALFWORDS 6
+#endif
+
+// reset slots + LEDs + one trailing slot to leave the line low
+#define WS2812_STREAM_LEN ((WS2812B_RESET_PERIOD + DMALEDS + 1) * WS2812_LED_HALFWORDS)
+
+// one color byte -> two SPI halfwords, high nibble first (little endian word)
+#define _WS_Q(n)	(((n)&8 ? 0xE000 : 0x8000) | ((n)&4 ? 0x0E00 : 0x0800) | \
+					((n)&2 ? 0x00E0 : 0x0080) | ((n)&1 ? 0x000E : 0x0008))
+#define _WS_B(b)	((u32)_WS_Q((b) >> 4) | ((u32)_WS_Q((b) & 15) << 16))
+#define _WS_B4(b)	_WS_B(b), _WS_B((b)+1), _WS_B((b)+2), _WS_B((b)+3)
+#define _WS_B16(b)	_WS_B4(b), _WS_B4((b)+4), _WS_B4((b)+8), _WS_B4((b)+12)
+#define _WS_B64(b)	_WS_B16(b), _WS_B16((b)+16), _WS_B16((b)+32), _WS_B16((b)+48)
+
+static const u32 WS2812_BYTE_LUT[256] = {
+	_WS_B64(0), _WS_B64(64), _WS_B64(128), _WS_B64(192)
+};
+
+static u32 WS2812_STREAM_BUF[2][WS2812_STREAM_LEN / 2];
+static volatile u8 WS2812_stream_front;		// half on the wire
+static volatile u8 WS2812_stream_pending;	// back half holds a frame not sent yet
+
+// Batch encode `count` colors in `order`, one LUT word per color byte
+static void WS2812_encode(u32 *dst, const RGB_t *src, int count, u8 order) {
+	const u32 *lut = WS2812_BYTE_LUT;
+
+	for (int i = 0; i < count; i++) {
+		u32 c = WS2812_OUTPUT(i, src[i].packed);
+
+		#ifdef WSRAW
+			dst[0] = lut[c & 0xFF];
+			dst[1] = lut[(c >> 8) & 0xFF];
+			dst[2] = lut[(c >> 16) & 0xFF];
+			dst[3] = lut[c >> 24];
+			dst += 4;
+		#else
+			c = WS2812_color_order(c, order);
+			dst[0] = lut[c >> 16];
+			dst[1] = lut[(c >> 8) & 0xFF];
+			dst[2] = lut[c & 0xFF];
+			dst += 3;
+		#endif
+	}
+}
+
+// Encode a frame for the SPI strip into the back half. Returns 0 while the
+// previous frame is still queued, the caller keeps its colors and tries again later.
+u8 WS2812_stream_encode(const RGB_t *src, int count) {
+	if (WS2812_stream_pending) return 0;
+	u32 *dst = WS2812_STREAM_BUF[WS2812_stream_front ^ 1];
+	WS2812_encode(dst + WS2812B_RESET_PERIOD * WS2812_LED_HALFWORDS / 2, src, count, WS2812_spi_strip->order);
+	WS2812_stream_pending = 1;
+	return 1;
+}
+
+// Swap halves and send the new front in one shot
+static void WS2812_stream_start(WS2812_Strip_t *s) {
+	WS2812_stream_front ^= 1;
+	WS2812_stream_pending = 0;
+
+	s->dma->CFGR &= ~DMA_CFGR1_EN;
+	s->dma->CNTR  = (WS2812B_RESET_PERIOD + s->leds + 1) * WS2812_LED_HALFWORDS;
+	s->dma->MADDR = (u32)(uintptr_t)WS2812_STREAM_BUF[WS2812_stream_front];
+	s->dma->CFGR |= DMA_CFGR1_EN;
+}
+
+#endif
+
 //# interrupt handler
 void DMA1_Channel3_IRQHandler( void ) __attribute__((interrupt));
+
+#ifdef WS2812_PRECOMPUTED
+
 void DMA1_Channel3_IRQHandler( void )  {
+	DMA1->INTFCR = DMA1_IT_GL3;
+
+	// back-to-back frames: the leading reset slots keep the latch gap
+	if (WS2812_stream_pending) WS2812_stream_start(WS2812_spi_strip);
+	else WS2812_spi_strip->in_use = 0;
+}
+
+#else
+
+void DMA1_Channel3_IRQHandler( void )  {
+	WS2812_Strip_t *s = WS2812_spi_strip;
+	int half = s->buf_len / 2;
+
 	// Backup flags.
 	volatile int intfr = DMA1->INTFR;
 
@@ -168,32 +369,46 @@ void DMA1_Channel3_IRQHandler( void )  {
 		// LED jitter.  I am henseforth flipping the order.
 		if( intfr & DMA1_IT_HT3 ) {
 			// Halfwaay (Fill in first part)
-			WS2812FillBuffSec( WS2812_DMA_BUF, DMA_BUFFER_LEN / 2, 1 );
+			WS2812FillBuffSec( s, s->buf, half, 1 );
 		}
 		if( intfr & DMA1_IT_TC3 ) {
 			// Complete (Fill in second part)
-			WS2812FillBuffSec( WS2812_DMA_BUF + DMA_BUFFER_LEN / 2, DMA_BUFFER_LEN / 2, 0 );
+			WS2812FillBuffSec( s, s->buf + half, half, 0 );
 		}
 		intfr = DMA1->INTFR;
 	} while( intfr & DMA1_IT_GL3 );
 }
 
+#endif
+
 
 //# DMA init function
-static void SPI_DMA_WS2812_init(int leds, DMA_Channel_TypeDef* DMA_Channel) {
-	WS2812LEDs = leds;
+// Bind a strip to an SPI and its TX channel. buf holds buf_len halfwords,
+// two halves of whole LEDs (6 halfwords each, 8 with WSRAW). Only
+// DMA1_Channel3 has a handler here, it serves the strip set up last.
+static void WS2812_strip_init(WS2812_Strip_t *s, SPI_TypeDef *spi, DMA_Channel_TypeDef *dma,
+		u16 *buf, int buf_len, int leds, u8 order, u32 (*color)(int ledIdx)) {
+	s->spi = spi;
+	s->dma = dma;
+	s->buf = buf;
+	s->buf_len = buf_len;
+	s->leds = leds;
+	s->order = order;
+	s->color = color;
+	s->place = 0;
+	s->in_use = 0;
+	WS2812_spi_strip = s;
 
 	// Enable DMA peripheral
 	RCC->AHBPCENR |= RCC_AHBPeriph_DMA1;
 
-	SPI1->CTLR2 = SPI_CTLR2_TXDMAEN;  // Enable Tx buffer DMA
-	SPI1->HSCR = 1; // Enable high-speed read mode
+	spi->CTLR2 = SPI_CTLR2_TXDMAEN;  // Enable Tx buffer DMA
+	spi->HSCR = 1; // Enable high-speed read mode
 
-	//DMA1_Channel3 is for SPI1TX
-	DMA1_Channel3->PADDR = (u32)&SPI1->DATAR;
-	DMA1_Channel3->MADDR = (u32)WS2812_DMA_BUF;
-	DMA1_Channel3->CNTR  = 0;// sizeof( bufferset )/2; // Number of unique copies.  (Don't start, yet!)
-	DMA1_Channel3->CFGR  =
+	dma->PADDR = (u32)(uintptr_t)&spi->DATAR;
+	dma->MADDR = (u32)(uintptr_t)buf;
+	dma->CNTR  = 0;// sizeof( bufferset )/2; // Number of unique copies.  (Don't start, yet!)
+	dma->CFGR  =
 		DMA_M2M_Disable |		 
 		DMA_Priority_VeryHigh |
 		DMA_MemoryDataSize_HalfWord |
@@ -201,341 +416,680 @@ static void SPI_DMA_WS2812_init(int leds, DMA_Channel_TypeDef* DMA_Channel) {
 		DMA_MemoryInc_Enable |
 		DMA_Mode_Normal | // OR DMA_Mode_Circular or DMA_Mode_Normal
 		DMA_DIR_PeripheralDST |
+	#ifdef WS2812_PRECOMPUTED
+		DMA_IT_TC; // one shot per frame, started by WS2812_stream_start()
+	#else
 		DMA_IT_TC | DMA_IT_HT; // Transmission Complete + Half Empty Interrupts. 
+	#endif
 
 	NVIC_EnableIRQ( DMA1_Channel3_IRQn );
-	DMA1_Channel3->CFGR |= DMA_CFGR1_EN;
+	#ifndef WS2812_PRECOMPUTED
+		dma->CFGR |= DMA_CFGR1_EN;
+	#endif
+}
+
+// The default strip: SPI1, WS2812_DMA_BUF and WS2812BLEDCallback()
+static void SPI_DMA_WS2812_init(int leds, DMA_Channel_TypeDef* DMA_Channel) {
+	//DMA1_Channel3 is for SPI1TX
+	#ifdef WS2812_PRECOMPUTED
+		WS2812_strip_init(&WS2812_strip, SPI1, DMA_Channel, NULL, 0,
+			leds, WS2812_ORDER_DEFAULT, WS2812BLEDCallback);
+	#else
+		WS2812_strip_init(&WS2812_strip, SPI1, DMA_Channel, WS2812_DMA_BUF, DMA_BUFFER_LEN,
+			leds, WS2812_ORDER_DEFAULT, WS2812BLEDCallback);
+	#endif
 }
 
 
 //# tick function
-void SPI_DMA_WS2812_tick() {
+#ifdef WS2812_PRECOMPUTED
+
+void WS2812_strip_tick(WS2812_Strip_t *s) {
+	__disable_irq();
+	if (!s->in_use && WS2812_stream_pending) {
+		s->in_use = 1;
+		WS2812_stream_start(s);
+	}
+	__enable_irq();
+}
+
+#else
+
+void WS2812_strip_tick(WS2812_Strip_t *s) {
 	// Enter critical section.
 	__disable_irq();
-	WS2812BLED_InUse = 1;
+	s->in_use = 1;
 
-	DMA1_Channel3->CFGR &= ~DMA_Mode_Circular;
-	DMA1_Channel3->CNTR  = 0;
-	DMA1_Channel3->MADDR = (uint32_t)WS2812_DMA_BUF;
+	s->dma->CFGR &= ~DMA_Mode_Circular;
+	s->dma->CNTR  = 0;
+	s->dma->MADDR = (uint32_t)(uintptr_t)s->buf;
 	
 	__enable_irq();
-	WS2812LED_Place = -WS2812B_RESET_PERIOD;
+	s->place = -WS2812B_RESET_PERIOD;
 
-	WS2812FillBuffSec( WS2812_DMA_BUF, DMA_BUFFER_LEN, 0 );
-	DMA1_Channel3->CNTR = DMA_BUFFER_LEN; // Number of unique uint16_t entries.
-	DMA1_Channel3->CFGR |= DMA_Mode_Circular;
+	WS2812FillBuffSec( s, s->buf, s->buf_len, 0 );
+	s->dma->CNTR = s->buf_len; // Number of unique uint16_t entries.
+	s->dma->CFGR |= DMA_Mode_Circular;
 }
 
+#endif
+
+void SPI_DMA_WS2812_tick() {
+	WS2812_strip_tick(&WS2812_strip);
+}
 
 //! ####################################
-//! IMPLEMENTATIONS
+//! PARALLEL GPIO OUTPUT
 //! ####################################
 
+// Up to 8 strips on pins 0-7 of one GPIO port, strip n on pin n, sent
+// together by the CPU in the manner of ws2812_gpio_basic: three port writes
+// per bit slot, all strips high, the strips sending a 0 low, then all low.
+// Each LED's 24 slot words come from one 8x8 bit transpose per color byte,
+// done in the low gap before the LED (a few us, far below the latch time)
+// and sent with interrupts off. BSHR/BCR leave the other pins of the port
+// alone. There is no DMA: the CPU is busy for the whole frame, ~30us per
+// LED however many strips. The output stage is not applied, the buffers go
+// out as they are.
+
+#ifndef WS2812_GPIO_NOP
+	#define WS2812_GPIO_NOP()	__asm__ volatile ("nop")
+#endif
+
+// nops after each write of a bit slot, for 48MHz
+#ifndef WS2812_GPIO_T0H_NOPS
+	#define WS2812_GPIO_T0H_NOPS	6		// all high, ~0.4us
+#endif
+#ifndef WS2812_GPIO_T1H_NOPS
+	#define WS2812_GPIO_T1H_NOPS	6		// zeros low, ones stay high ~0.8us
+#endif
+#ifndef WS2812_GPIO_TL_NOPS
+	#define WS2812_GPIO_TL_NOPS		6		// all low
+#endif
+#ifndef WS2812_GPIO_RESET_US
+	#define WS2812_GPIO_RESET_US	60		// low before a frame, like WS2812B_RESET_PERIOD
+#endif
+
+#define _WS_GPIO_WAIT(nops) do { \
+	_Pragma("GCC unroll 32") \
+	for (int _n = 0; _n < (nops); _n++) WS2812_GPIO_NOP(); \
+} while (0)
+
 typedef struct {
-	u32 frame_duration_ms;	  	// Duration for each frame in ms
-	int8_t frame_step;		  	// Step for moving LEDs
-	u16 modifier;				// modifier for each frame
+	GPIO_TypeDef *port;
+	u8 count;						// strips, 1 to 8
+	int leds;						// per strip, shorter strips ignore the tail
+	const RGB_t *bufs[8];			// colors of strip n
+	u8 order[8];					// WS2812_ORDER_* of strip n
+} WS2812_Gpio_t;
+
+// out[i] bit n = bit 7-i of in[n]: one byte per strip in, one port word per slot out
+static inline void _ws2812_transpose8(const u8 *in, u8 *out) {
+	u32 x = (u32)in[7] << 24 | (u32)in[6] << 16 | (u32)in[5] << 8 | in[4];
+	u32 y = (u32)in[3] << 24 | (u32)in[2] << 16 | (u32)in[1] << 8 | in[0];
+	u32 t;
+
+	t = (x ^ (x >> 7)) & 0x00AA00AA;	x ^= t ^ (t << 7);
+	t = (y ^ (y >> 7)) & 0x00AA00AA;	y ^= t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000CCCC;	x ^= t ^ (t << 14);
+	t = (y ^ (y >> 14)) & 0x0000CCCC;	y ^= t ^ (t << 14);
+	t = (x & 0xF0F0F0F0) | ((y >> 4) & 0x0F0F0F0F);
+	y = ((x << 4) & 0xF0F0F0F0) | (y & 0x0F0F0F0F);
+
+	out[0] = t >> 24; out[1] = t >> 16; out[2] = t >> 8; out[3] = t;
+	out[4] = y >> 24; out[5] = y >> 16; out[6] = y >> 8; out[7] = y;
+}
+
+// Pins 0 to count-1 of port become push-pull outputs, low. The port clock
+// must be on (funGpioInitAll()). Point bufs[] at the colors before sending.
+void WS2812_gpio_init(WS2812_Gpio_t *g, GPIO_TypeDef *port, u8 count, int leds) {
+	g->port = port;
+	g->count = count;
+	g->leds = leds;
+
+	for (int n = 0; n < count; n++) {
+		g->bufs[n] = NULL;
+		g->order[n] = WS2812_ORDER_DEFAULT;
+		port->CFGLR = (port->CFGLR & ~(0xFu << (4 * n))) | ((GPIO_Speed_50MHz | GPIO_CNF_OUT_PP) << (4 * n));
+	}
+	port->BCR = (1u << count) - 1;
+}
+
+// Send one frame to all strips, blocking
+void WS2812_gpio_send(const WS2812_Gpio_t *g) {
+	GPIO_TypeDef *port = g->port;
+	u32 mask = (1u << g->count) - 1;
+	u8 slots[24];
+
+	port->BCR = mask;
+	Delay_Us(WS2812_GPIO_RESET_US);
+
+	for (int led = 0; led < g->leds; led++) {
+		u8 bytes[3][8] = { 0 };
+		for (int n = 0; n < g->count; n++) {
+			u32 c = WS2812_color_order(g->bufs[n][led].packed, g->order[n]);
+			bytes[0][n] = c >> 16;
+			bytes[1][n] = c >> 8;
+			bytes[2][n] = c;
+		}
+		for (int b = 0; b < 3; b++) _ws2812_transpose8(bytes[b], slots + 8 * b);
+
+		__disable_irq();
+		for (int i = 0; i < 24; i++) {
+			u32 zeros = mask & ~slots[i];
+			port->BSHR = mask;
+			_WS_GPIO_WAIT(WS2812_GPIO_T0H_NOPS);
+			port->BCR = zeros;
+			_WS_GPIO_WAIT(WS2812_GPIO_T1H_NOPS);
+			port->BCR = mask;
+			_WS_GPIO_WAIT(WS2812_GPIO_TL_NOPS);
+		}
+		__enable_irq();
+	}
+}
 
-	u8 prev_index;			  	// Previous index used
-	u8 curr_index;			   	// Last index used
-	u32 ref_time;			   	// Last time the move was updated
-} WS2812_frame_t;
+
+//! ####################################
+//! ANIMATION ENGINE
+//! ####################################
+
+// Animations are const tables in flash, not code. An animation is a stack
+// of layers, each one an effect (Neo_Fx_e) over a segment of the strip,
+// combined bottom up with its blend mode and opacity. Colors come from
+// keyframe tables: a timeline for the effects that change over time, a
+// palette along 0-255 for the ones that map an intensity. Every pixel is a
+// pure function of (pixel, frame), so the same tables drive the buffered
+// modes and the streaming renderer, and Neo_play() crossfades from the
+// animation on the strip to the next one.
+//
+//  static const Neo_Key_t breathe[] = { {0, 0,0,0}, {1000, 0,0,0x40}, {2000, 0,0,0} };
+//  static const Neo_Layer_t layers[] = {
+//      { NEO_FX_SOLID, NEO_BLEND_NORMAL, 255, .span = 2000, NEO_KEYS(breathe) },
+//  };
+//  static const Neo_Anim_t anim = NEO_ANIM(layers);
+//  Neo_play(&anim, 500);
+
+#ifndef NEO_FRAME_MS
+	#define NEO_FRAME_MS		10		// engine time step, one render per frame
+#endif
+
+#ifndef NEO_CROSSFADE_MS
+	#define NEO_CROSSFADE_MS	400		// Neo_loadCommand() crossfade
+#endif
+
+// Layers per animation that get drawn, the rest are ignored. Each one keeps
+// 16 bytes of per frame state, twice over for the crossfade
+#ifndef NEO_MAX_LAYERS
+	#define NEO_MAX_LAYERS		4
+#endif
 
 typedef struct {
-	RGB_t* COLOR_BUF;		   	// Array of colors to cycle through
-	u8 colors_len;			  	// Number of colors in the array
-	u8 index;				   	// Current color index
-} animation_color_t;
+	u16 at;					// ms into the timeline, or 0-255 along a palette
+	u8 r, g, b;
+} Neo_Key_t;
 
+// rate and width mean per effect:
 typedef enum {
-	NEO_COLOR_FLASHING = 0x00,   // default
-	NEO_COLOR_CHASE = 0x01,
-	NEO_SOLO_COLOR_CHASE = 0x02,
-	NEO_COLOR_FADE = 0x03,
-	NEO_SOLO_COLOR_FADE = 0x04,
-	NEO_SOLO_RANDOM_FADE = 0x05,
-	NEO_RAINBOW_WAVE = 0x06,
-	NEO_RAINBOW_FAST = 0x07,
-	NEO_FIRE = 0x08,
-	NEO_ICE = 0x09,
-} Neo_Event_e;
+	NEO_FX_SOLID,			// timeline color on the whole segment
+	NEO_FX_CHASE,			// palette colors `width` pixels each, moving `rate` px per 1024 ms
+	NEO_FX_COMET,			// head moving `rate` px per 1024 ms, `width` pixel tail, timeline color
+	NEO_FX_TWINKLE,			// one pixel fades in each `rate` ms, in order, or random if width
+	NEO_FX_RAINBOW,			// sine hue wheel, `width` hue steps per pixel, `rate` per 1024 ms
+	NEO_FX_WHEEL,			// linear hue wheel spread over the strip, `rate` per 1024 ms, at half brightness
+	NEO_FX_NOISE,			// per pixel flicker through the palette, `rate` phase speed
+} Neo_Fx_e;
 
-RGB_t WS2812_BUF[DMALEDS] = {0};
+typedef enum {
+	NEO_BLEND_NORMAL,		// over what is below, by opacity
+	NEO_BLEND_ADD,			// added to what is below, scaled by opacity
+} Neo_Blend_e;
 
-WS2812_frame_t leds_frame = {
-	.frame_duration_ms = 0,		// disabled 
-	.frame_step = 1,			// Move one LED at a time
-	.modifier = 0,
+typedef struct {
+	u8 fx;					// Neo_Fx_e
+	u8 blend;				// Neo_Blend_e
+	u8 opacity;				// 255 is opaque
+	u8 width;
+	u16 rate;
+	u16 start, len;			// segment, len 0 runs to the end of the strip
+	u16 span;				// timeline length in ms, it loops
+	u8 key_count;
+	const Neo_Key_t *keys;
+} Neo_Layer_t;
 
-	.curr_index = 0,
-	.prev_index = 0,
-	.ref_time = 0,
-};
+typedef struct {
+	const Neo_Layer_t *layers;
+	u8 count;
+} Neo_Anim_t;
 
-RGB_t color_arr[] = {
-	COLOR_RED_LOW, COLOR_GREEN_LOW, COLOR_BLUE_LOW
-};
+#define NEO_KEYS(keys_)		.key_count = sizeof(keys_) / sizeof(Neo_Key_t), .keys = keys_
+#define NEO_ANIM(layers_)	{ layers_, sizeof(layers_) / sizeof(Neo_Layer_t) }
 
-animation_color_t color_ani = {
-	.COLOR_BUF = color_arr,
-	.colors_len = sizeof(color_arr)/sizeof(RGB_t),
-	.index = 0,
-};
+// What every pixel of a layer shares in one frame, so the per pixel path
+// runs no divides but the ones that depend on the pixel
+typedef struct {
+	RGB_t color;			// timeline color, TWINKLE: already faded in
+	u32 moved;				// (t * rate) >> 10
+	u16 len;				// segment length, 0 when there is nothing to draw
+	u16 at;					// COMET: head pixel, TWINKLE: the lit pixel
+	u16 step;				// COMET: tail fade per pixel, 8.8
+} Neo_Layer_Frame_t;
 
+typedef struct {
+	const Neo_Anim_t *anim;
+	const Neo_Anim_t *prev;		// being faded out
+	u32 start, prev_start;		// frame each one started
+	u32 fade_start;
+	u16 fade_frames;
+
+	//# the frame prepared below, see _neo_prepare()
+	u8 ready;					// cleared by Neo_play()
+	u16 fade;					// 0-255 weight of anim over prev, 256 when not fading
+	u32 frame;
+	Neo_Layer_Frame_t layer[NEO_MAX_LAYERS], prev_layer[NEO_MAX_LAYERS];
+} Neo_Engine_t;
+
+Neo_Engine_t Neo_engine = { 0 };
+u32 Neo_frame = 0;				// frames rendered, the engine clock
+RGB_t WS2812_BUF[DMALEDS] = {0};	// buffered modes render a frame here
+
+//# color at `pos` along keys sorted by .at, the first key at 0. Between keys
+// the color is interpolated, past the last one it runs to keys[0] at `span`.
+static RGB_t Neo_keys_at(const Neo_Key_t *keys, u8 count, u32 pos, u32 span) {
+	if (!count) return COLOR_BLACK;
+
+	u8 k = 0;
+	while (k + 1 < count && keys[k + 1].at <= pos) k++;
+
+	const Neo_Key_t *a = &keys[k];
+	const Neo_Key_t *b = k + 1 < count ? &keys[k + 1] : &keys[0];
+	u32 to = k + 1 < count ? b->at : span;
+	RGB_t ca = MAKE_COLOR_RGB(a->r, a->g, a->b);
+	if (to <= a->at || a == b) return ca;
+
+	u32 t = (pos - a->at) * 256 / (to - a->at);
+	return COLOR_blend(ca, MAKE_COLOR_RGB(b->r, b->g, b->b), t > 255 ? 255 : t);
+}
 
-//# NEO_COLOR_FLASHING
-void Neo_render_colorFlashing(WS2812_frame_t* frame, animation_color_t* ani, int ledIdx) {
-	// Combine frame update and reset check
-	if (++frame->modifier >= 100) {
-		frame->modifier = 0;
-		ani->index = (ani->index + 1) % ani->colors_len;
-	}
+//# the per frame part of a layer, t ms into the animation
+static void _neo_layer_prepare(const Neo_Layer_t *L, Neo_Layer_Frame_t *f, u32 t) {
+	u32 leds = WS2812_strip.leds;
+	u32 timeline = L->span ? t % L->span : 0;
+
+	f->len = L->len ? L->len : leds > L->start ? leds - L->start : 0;
+	f->moved = (t * L->rate) >> 10;
 
-	RGB_t color = ani->COLOR_BUF[ani->index];
-	RGB_t new_color = COLOR_SET_BRIGHTNESS(color, frame->modifier);
+	switch (L->fx) {
+		case NEO_FX_SOLID:
+			f->color = Neo_keys_at(L->keys, L->key_count, timeline, L->span);
+			break;
+
+		case NEO_FX_CHASE:
+			if (!L->width || !L->key_count) f->len = 0;
+			break;
+
+		case NEO_FX_COMET:
+			if (!f->len || !L->width) {
+				f->len = 0;
+				break;
+			}
+			f->at = f->moved % f->len;
+			f->step = (255 << 8) / L->width;
+			f->color = Neo_keys_at(L->keys, L->key_count, timeline, L->span);
+			break;
 
-	for (int i=0; i < DMALEDS; i++) {
-		WS2812_BUF[i] = new_color;
+		case NEO_FX_TWINKLE: {
+			if (!f->len || !L->rate) {
+				f->len = 0;
+				break;
+			}
+			u32 slot = t / L->rate;
+			f->at = L->width ? (LUT_RANDS[slot & 0xFF] | LUT_RANDS[(slot >> 8) & 0xFF] << 8) % f->len : slot % f->len;
+			RGB_t c = Neo_keys_at(L->keys, L->key_count, timeline, L->span);
+			f->color = COLOR_brightness(c, (t - slot * L->rate) * 255 / L->rate);
+			break;
+		}
 	}
 }
 
-//# NEO_COLOR_CHASE
-void Neo_render_colorChase(WS2812_frame_t* frame, animation_color_t* ani, int ledIdx) {
-	for (int i=0; i < DMALEDS; i++) {
-		WS2812_BUF[i] = ani->COLOR_BUF[((i + frame->curr_index) / 3) % ani->colors_len];
-	}
+//# one effect at segment pixel i of the frame f
+static RGB_t _neo_fx(const Neo_Layer_t *L, const Neo_Layer_Frame_t *f, u32 i) {
+	switch (L->fx) {
+		case NEO_FX_SOLID:
+			return f->color;
 
-	frame->curr_index += frame->frame_step;
-}
+		case NEO_FX_CHASE: {
+			const Neo_Key_t *k = &L->keys[((i + f->moved) / L->width) % L->key_count];
+			return MAKE_COLOR_RGB(k->r, k->g, k->b);
+		}
 
-//# NEO_SOLO_COLOR_CHASE
-void Neo_render_soloColorChase(WS2812_frame_t* frame, animation_color_t* ani, int ledIdx) {
-	WS2812_BUF[frame->prev_index] = COLOR_BLACK;	   // Turn off previous LED
-	WS2812_BUF[frame->curr_index] = ani->COLOR_BUF[ani->index];;
+		case NEO_FX_COMET: {
+			u32 dist = f->at + f->len - i;
+			if (dist >= f->len) dist -= f->len;
+			if (dist >= L->width) return COLOR_BLACK;
+			return COLOR_scale(f->color, 255 - (dist * f->step >> 8));
+		}
 
-	// update indexes
-	frame->prev_index = frame->curr_index;
-	frame->curr_index += frame->frame_step;
-	
-	if (frame->curr_index >= DMALEDS) {
-		frame->curr_index %= DMALEDS;
-		ani->index = (ani->index + 1) % ani->colors_len;
-	}
-}
+		case NEO_FX_TWINKLE:
+			return i == f->at ? f->color : COLOR_BLACK;
 
-//# NEO_COLOR_FADE
-void Neo_render_colorFade(WS2812_frame_t* frame, animation_color_t* ani, int ledIdx) {
-	// Fade all LEDs slightly
-	for (int i = 0; i < DMALEDS; i++) {
-		u8 diff = frame->curr_index - i;
-		WS2812_BUF[i] = COLOR_DECREMENT(ani->COLOR_BUF[ani->index], diff*49);	   // Triangular diff growth
-	}
+		case NEO_FX_RAINBOW: {
+			u8 hue = f->moved + i * L->width;
+			return MAKE_COLOR_RGB(sine_8bits(hue), sine_8bits(hue + 85), sine_8bits(hue + 170));
+		}
 
-	// update indexes
-	frame->curr_index += frame->frame_step;
+		case NEO_FX_WHEEL: {
+			u8 hue = i * 200 / f->len + f->moved;
+			u8 r, g, b;
+			if (hue < 85) {
+				r = 255 - hue * 3; g = hue * 3; b = 0;
+			} else if (hue < 170) {
+				hue -= 85;
+				r = 0; g = 255 - hue * 3; b = hue * 3;
+			} else {
+				hue -= 170;
+				r = hue * 3; g = 0; b = 255 - hue * 3;
+			}
+			return MAKE_COLOR_RGB(r >> 1, g >> 1, b >> 1);
+		}
 
-	if (frame->curr_index >= DMALEDS) {
-		frame->curr_index %= DMALEDS;
-		ani->index = (ani->index + 1) % ani->colors_len;
+		case NEO_FX_NOISE: {
+			// every pixel its own phase and speed, from the random table
+			u8 seed = LUT_RANDS[i & 0xFF];
+			u32 phase = (seed << 8) + f->moved * (4 + (seed & 3)) / 4;
+			u8 level = sine_8bits(phase >> 8);
+			return Neo_keys_at(L->keys, L->key_count, level, 256);
+		}
 	}
+	return COLOR_BLACK;
 }
 
-//# NEO_SOLO_COLOR_FADE
-void Neo_render_soloColorFade(WS2812_frame_t* frame, animation_color_t* ani, int ledIdx) {
-	frame->modifier += 3;
-	RGB_t color = ani->COLOR_BUF[ani->index];;
-	WS2812_BUF[frame->curr_index] = COLOR_SET_BRIGHTNESS(color, frame->modifier);
+static void _neo_anim_prepare(const Neo_Anim_t *anim, Neo_Layer_Frame_t *frames, u32 t) {
+	u8 count = anim->count < NEO_MAX_LAYERS ? anim->count : NEO_MAX_LAYERS;
+	for (u8 n = 0; n < count; n++) _neo_layer_prepare(&anim->layers[n], &frames[n], t);
+}
 
-	if (frame->modifier >= 100) {
-		frame->modifier = 0;
+static RGB_t _neo_anim_pixel(const Neo_Anim_t *anim, const Neo_Layer_Frame_t *frames, int ledIdx) {
+	RGB_t out = COLOR_BLACK;
+	u8 count = anim->count < NEO_MAX_LAYERS ? anim->count : NEO_MAX_LAYERS;
+
+	for (u8 n = 0; n < count; n++) {
+		const Neo_Layer_t *L = &anim->layers[n];
+		const Neo_Layer_Frame_t *f = &frames[n];
+		u32 i = ledIdx - L->start;
+		if (i >= f->len) continue;
+
+		RGB_t c = _neo_fx(L, f, i);
+		if (L->blend == NEO_BLEND_ADD) {
+			out = COLOR_add(out, L->opacity == 255 ? c : COLOR_scale(c, L->opacity));
+		} else {
+			out = L->opacity == 255 ? c : COLOR_blend(out, c, L->opacity);
+		}
+	}
+	return out;
+}
 
-		u8 next_idx = frame->curr_index + frame->frame_step;
-		frame->curr_index = next_idx % DMALEDS;
+//# everything the pixels of a frame share, once per frame
+static void _neo_prepare(u32 frame) {
+	Neo_Engine_t *e = &Neo_engine;
+	_neo_anim_prepare(e->anim, e->layer, (frame - e->start) * NEO_FRAME_MS);
 
-		if (next_idx >= DMALEDS) {
-			ani->index = (ani->index + 1) % ani->colors_len;
-		}
+	u32 faded = frame - e->fade_start;
+	e->fade = 256;
+	if (e->prev && faded < e->fade_frames) {
+		_neo_anim_prepare(e->prev, e->prev_layer, (frame - e->prev_start) * NEO_FRAME_MS);
+		e->fade = faded * 256 / e->fade_frames;
 	}
+	e->frame = frame;
+	e->ready = 1;
 }
 
-//# NEO_SOLO_RANDOM_FADE
-void Neo_render_soloRandomFade(WS2812_frame_t* frame, animation_color_t* ani, int ledIdx) {
-	frame->modifier += 3;
-	RGB_t color = ani->COLOR_BUF[ani->index];
-	WS2812_BUF[frame->curr_index] = COLOR_SET_BRIGHTNESS(color, frame->modifier);
+static void _neo_ready(u32 frame) {
+	Neo_Engine_t *e = &Neo_engine;
+	if (e->anim && (!e->ready || e->frame != frame)) _neo_prepare(frame);
+}
 
-	if (frame->modifier >= 100) {
-		frame->modifier = 0;
+// a pixel of the prepared frame
+static RGB_t _neo_pixel(int ledIdx) {
+	Neo_Engine_t *e = &Neo_engine;
+	if (!e->anim) return COLOR_BLACK;
 
-        // Branchless different random index
-        u8 next_idx = (frame->curr_index + 1 + (rand_make_u32() % (DMALEDS - 1))) % DMALEDS;
-        frame->curr_index = next_idx;
+	RGB_t c = _neo_anim_pixel(e->anim, e->layer, ledIdx);
+	if (e->fade < 256) {
+		RGB_t p = _neo_anim_pixel(e->prev, e->prev_layer, ledIdx);
+		c = COLOR_blend(p, c, e->fade);
 	}
+	return c;
 }
 
-//# NEO_RAINBOW_WAVE
-void Neo_render_rainbow_wave(WS2812_frame_t* frame, animation_color_t* ani, int ledIdx) {
-    for (int i = 0; i < DMALEDS; i++) {
-        // Moving rainbow with smooth sine transitions
-        u8 base_hue = (frame->curr_index * 4 + i * 8) & 0xFF;
-        
-        u8 r = sine_8bits(base_hue);
-        u8 g = sine_8bits((base_hue + 85) & 0xFF);   // 120° offset
-        u8 b = sine_8bits((base_hue + 170) & 0xFF);  // 240° offset
-        
-        WS2812_BUF[i] = MAKE_COLOR_RGB(r, g, b);
-    }
-    
-    frame->curr_index += frame->frame_step;
-}
-
-//# NEO_RAINBOW_FAST
-void Neo_render_rainbow_fast(WS2812_frame_t* frame, animation_color_t* ani, int ledIdx) {
-    // Adjustable parameters
-    static const u8 SPEED = 3;           // Movement speed (1-20)
-    static const u8 WIDTH = 200;         // Rainbow width (1-255)
-    static const u8 divider = 2;
-	
-    for (int i = 0; i < DMALEDS; i++) {
-        // Calculate hue with adjustable speed and width
-        u8 hue = ((i * WIDTH / DMALEDS) + frame->curr_index * SPEED) & 0xFF;
-        u8 r, g, b;
-        
-        // Rainbow color wheel
-        if (hue < 85) {
-            r = 255 - hue * 3;
-            g = hue * 3;
-            b = 0;
-        } else if (hue < 170) {
-            hue -= 85;
-            r = 0;
-            g = 255 - hue * 3;
-            b = hue * 3;
-        } else {
-            hue -= 170;
-            r = hue * 3;
-            g = 0;
-            b = 255 - hue * 3;
-        }
-		
-        WS2812_BUF[i] = MAKE_COLOR_RGB(r/divider, g/divider, b/divider);
-    }
-    
-    frame->curr_index += frame->frame_step;
-}
-
-//# NEO_FIRE - Stolen from ch32fun ws2812 example
-uint16_t WS2812_PHASE_BUF[DMALEDS];
-
-u8 sawtooth_hue(u8 index) {
-	index &= 0xFF;
-	
-	// Continuous sawtooth: 0-255 repeating
-	return (index * 255) / 255;  // Simple linear ramp
+//# the engine's color of a pixel at a frame, the first pixel of a frame
+// prepares it
+RGB_t Neo_pixel(int ledIdx, u32 frame) {
+	_neo_ready(frame);
+	return _neo_pixel(ledIdx);
 }
 
-u8 generate_hue_value(u8 index) {
-	index &= 0xFF;
-	
-	if (index < 42) return (index * 6);		   // 0-252 in steps of 6
-	if (index < 170) return 0xFF;				 // Plateau
-	if (index < 212) return ((211 - index) * 6);  // 252-0 in steps of 6
-	return 0x00;								  // Bottom
+//# render a frame into WS2812_BUF
+void Neo_render(u32 frame) {
+	for (int i = 0; i < DMALEDS; i++) WS2812_BUF[i] = Neo_pixel(i, frame);
 }
 
-void Neo_render_fire(WS2812_frame_t* frame, animation_color_t* ani, int ledIdx) {
-	for (int i = 0; i < DMALEDS; i++ ) {
-		// u8 rand = LUT_make_rand(i);
-		u8 rand = rand_make_byte() * 2;
-		WS2812_PHASE_BUF[i] += ((rand << 2) + (rand << 1)) >> 1;
+// The animation on the strip fades out over fade_ms while this one fades in
+void Neo_play(const Neo_Anim_t *anim, u16 fade_ms) {
+	Neo_Engine_t *e = &Neo_engine;
 
-		u8 sin_value = sine_8bits(WS2812_PHASE_BUF[i] >> 8);
-		u8 intensity = sin_value >> 3;		// scale down sin_value/8
+	e->prev = fade_ms ? e->anim : NULL;
+	e->prev_start = e->start;
+	e->anim = anim;
+	e->start = e->fade_start = Neo_frame;
+	e->fade_frames = fade_ms / NEO_FRAME_MS;
+	e->ready = 0;
 
-		u8 rChannel = generate_hue_value(intensity + 30);
-		u8 gChannel = generate_hue_value((intensity + 0)) >> 1;
-		u8 bChannel = generate_hue_value(intensity + 190) >> 1;
-
-		u32 fire =	rChannel | (u16)(gChannel << 8) | (u16)(bChannel << 16);
-		WS2812_BUF[i] = MAKE_COLOR_FROM32(fire);
-	}
+	// a streaming refresh may be on the wire, its ISR does not prepare
+	_neo_ready(Neo_frame);
 }
 
-//# NEO_ICE - Stolen from ch32fun ws2812 example
-void Neo_render_ice(WS2812_frame_t* frame, animation_color_t* ani, int ledIdx) {
-	for (int i = 0; i < DMALEDS; i++ ) {
-		u8 rand = LUT_make_rand(i);
-		// u8 rand = rand_make_byte() * 2;
-		WS2812_PHASE_BUF[i] += ((rand << 2) + (rand << 1)) >> 1;
+//! ####################################
+//! ANIMATIONS
+//! ####################################
 
-		u8 sin_value = sine_8bits(WS2812_PHASE_BUF[i] >> 8);
-		u32 ice = (sin_value>>1) | ((sin_value>>1)<<8) | 0x7f0000;
-		WS2812_BUF[i] = MAKE_COLOR_FROM32(ice);
-	}
-}
+typedef enum {
+	NEO_COLOR_FLASHING = 0x00,
+	NEO_COLOR_CHASE = 0x01,
+	NEO_SOLO_COLOR_CHASE = 0x02,
+	NEO_COLOR_FADE = 0x03,
+	NEO_SOLO_COLOR_FADE = 0x04,
+	NEO_SOLO_RANDOM_FADE = 0x05,
+	NEO_RAINBOW_WAVE = 0x06,
+	NEO_RAINBOW_FAST = 0x07,
+	NEO_FIRE = 0x08,
+	NEO_ICE = 0x09,
+	NEO_STARRY = 0x0A,
+	NEO_ANIMATION_COUNT
+} Neo_Event_e;
 
+// ramp up each color, then cut to the next
+static const Neo_Key_t NEO_KEYS_FLASHING[] = {
+	{    0, 0x00, 0x00, 0x00 }, {  990, 0x33, 0x00, 0x00 },
+	{ 1000, 0x00, 0x00, 0x00 }, { 1990, 0x00, 0x33, 0x00 },
+	{ 2000, 0x00, 0x00, 0x00 }, { 2990, 0x00, 0x00, 0x33 },
+};
 
-void (*onNeo_handler)(WS2812_frame_t* frame, animation_color_t* ani, int ledIdx) = Neo_render_colorFlashing;
+// a hard switch every 3 s
+static const Neo_Key_t NEO_KEYS_STEPS[] = {
+	{    0, 0x33, 0x00, 0x00 }, { 2999, 0x33, 0x00, 0x00 },
+	{ 3000, 0x00, 0x33, 0x00 }, { 5999, 0x00, 0x33, 0x00 },
+	{ 6000, 0x00, 0x00, 0x33 }, { 8999, 0x00, 0x00, 0x33 },
+};
+
+static const Neo_Key_t NEO_KEYS_RGB_LOW[] = {
+	{ 0, 0x33, 0x00, 0x00 }, { 0, 0x00, 0x33, 0x00 }, { 0, 0x00, 0x00, 0x33 },
+};
+
+static const Neo_Key_t NEO_PALETTE_FIRE[] = {
+	{ 0, 0x00, 0x00, 0x00 }, { 90, 0x60, 0x00, 0x00 }, { 170, 0xFF, 0x30, 0x00 }, { 255, 0xFF, 0x90, 0x10 },
+};
+
+static const Neo_Key_t NEO_PALETTE_ICE[] = {
+	{ 0, 0x00, 0x00, 0x7F }, { 200, 0x40, 0x40, 0x7F }, { 255, 0x7F, 0x7F, 0x7F },
+};
+
+static const Neo_Key_t NEO_KEYS_NIGHT[] = {
+	{ 0, 0x00, 0x00, 0x08 }, { 2000, 0x00, 0x02, 0x18 }, { 4000, 0x00, 0x00, 0x08 },
+};
 
+static const Neo_Key_t NEO_KEYS_WHITE[] = {
+	{ 0, 0x60, 0x60, 0x60 },
+};
+
+#define _NEO_LAYER(name_, ...)	static const Neo_Layer_t name_[] = { __VA_ARGS__ }
+
+_NEO_LAYER(NEO_LAYERS_FLASHING,
+	{ NEO_FX_SOLID, NEO_BLEND_NORMAL, 255, .span = 3000, NEO_KEYS(NEO_KEYS_FLASHING) });
+_NEO_LAYER(NEO_LAYERS_CHASE,
+	{ NEO_FX_CHASE, NEO_BLEND_NORMAL, 255, .width = 3, .rate = 7, NEO_KEYS(NEO_KEYS_RGB_LOW) });
+_NEO_LAYER(NEO_LAYERS_SOLO_CHASE,
+	{ NEO_FX_COMET, NEO_BLEND_NORMAL, 255, .width = 1, .rate = 15, .span = 9000, NEO_KEYS(NEO_KEYS_STEPS) });
+_NEO_LAYER(NEO_LAYERS_FADE,
+	{ NEO_FX_COMET, NEO_BLEND_NORMAL, 255, .width = 3, .rate = 15, .span = 9000, NEO_KEYS(NEO_KEYS_STEPS) });
+_NEO_LAYER(NEO_LAYERS_SOLO_FADE,
+	{ NEO_FX_TWINKLE, NEO_BLEND_NORMAL, 255, .rate = 340, .span = 9000, NEO_KEYS(NEO_KEYS_STEPS) });
+_NEO_LAYER(NEO_LAYERS_RANDOM_FADE,
+	{ NEO_FX_TWINKLE, NEO_BLEND_NORMAL, 255, .width = 1, .rate = 510, .span = 9000, NEO_KEYS(NEO_KEYS_STEPS) });
+_NEO_LAYER(NEO_LAYERS_RAINBOW_WAVE,
+	{ NEO_FX_RAINBOW, NEO_BLEND_NORMAL, 255, .width = 8, .rate = 137 });
+_NEO_LAYER(NEO_LAYERS_RAINBOW_FAST,
+	{ NEO_FX_WHEEL, NEO_BLEND_NORMAL, 255, .rate = 102 });
+_NEO_LAYER(NEO_LAYERS_FIRE,
+	{ NEO_FX_NOISE, NEO_BLEND_NORMAL, 255, .rate = 700, NEO_KEYS(NEO_PALETTE_FIRE) });
+_NEO_LAYER(NEO_LAYERS_ICE,
+	{ NEO_FX_NOISE, NEO_BLEND_NORMAL, 255, .rate = 300, NEO_KEYS(NEO_PALETTE_ICE) });
+// a breathing night sky with random white stars added on top
+_NEO_LAYER(NEO_LAYERS_STARRY,
+	{ NEO_FX_SOLID, NEO_BLEND_NORMAL, 255, .span = 4000, NEO_KEYS(NEO_KEYS_NIGHT) },
+	{ NEO_FX_TWINKLE, NEO_BLEND_ADD, 255, .width = 1, .rate = 250, NEO_KEYS(NEO_KEYS_WHITE) });
+
+static const Neo_Anim_t NEO_ANIMATIONS[NEO_ANIMATION_COUNT] = {
+	[NEO_COLOR_FLASHING]	= NEO_ANIM(NEO_LAYERS_FLASHING),
+	[NEO_COLOR_CHASE]		= NEO_ANIM(NEO_LAYERS_CHASE),
+	[NEO_SOLO_COLOR_CHASE]	= NEO_ANIM(NEO_LAYERS_SOLO_CHASE),
+	[NEO_COLOR_FADE]		= NEO_ANIM(NEO_LAYERS_FADE),
+	[NEO_SOLO_COLOR_FADE]	= NEO_ANIM(NEO_LAYERS_SOLO_FADE),
+	[NEO_SOLO_RANDOM_FADE]	= NEO_ANIM(NEO_LAYERS_RANDOM_FADE),
+	[NEO_RAINBOW_WAVE]		= NEO_ANIM(NEO_LAYERS_RAINBOW_WAVE),
+	[NEO_RAINBOW_FAST]		= NEO_ANIM(NEO_LAYERS_RAINBOW_FAST),
+	[NEO_FIRE]				= NEO_ANIM(NEO_LAYERS_FIRE),
+	[NEO_ICE]				= NEO_ANIM(NEO_LAYERS_ICE),
+	[NEO_STARRY]			= NEO_ANIM(NEO_LAYERS_STARRY),
+};
+
+//! ####################################
+//! REFRESH
+//! ####################################
+
+typedef struct {
+	u32 frame_duration_ms;	  	// 0 until an animation is loaded
+	u32 ref_time;			   	// Last time a frame was rendered
+} WS2812_frame_t;
+
+WS2812_frame_t leds_frame = {
+	.frame_duration_ms = 0,		// disabled 
+	.ref_time = 0,
+};
+
+// Play one of NEO_ANIMATIONS, crossfading from the one on the strip
 void Neo_loadCommand(u8 cmd) {
-	cmd = cmd % 10;
+	cmd = cmd % NEO_ANIMATION_COUNT;
 	printf("Neo_loadCommand: %02X\n", cmd);
 
-	leds_frame.curr_index = 0;
-	leds_frame.ref_time = millis();
-	color_ani.index = 0;
-	memset(WS2812_BUF, 0, sizeof(WS2812_BUF));
-
-	leds_frame.frame_duration_ms = 10;
-
-	for(int k = 0; k < DMALEDS; k++ ) WS2812_PHASE_BUF[k] = k<<8;
-
-	switch (cmd) {
-		case NEO_COLOR_CHASE:
-			leds_frame.frame_duration_ms = 150;
-			onNeo_handler = Neo_render_colorChase; break;
-		case NEO_SOLO_COLOR_CHASE:
-			leds_frame.frame_duration_ms = 70;
-			onNeo_handler = Neo_render_soloColorChase; break;
-		case NEO_COLOR_FADE:
-			leds_frame.frame_duration_ms = 70;
-			onNeo_handler = Neo_render_colorFade; break;
-		case NEO_SOLO_COLOR_FADE:
-			onNeo_handler = Neo_render_soloColorFade; break;
-		case NEO_SOLO_RANDOM_FADE:
-			leds_frame.frame_duration_ms = 15;
-			onNeo_handler = Neo_render_soloRandomFade; break;
-		case NEO_RAINBOW_WAVE:
-			leds_frame.frame_duration_ms = 30;
-			onNeo_handler = Neo_render_rainbow_wave; break;
-		case NEO_RAINBOW_FAST:
-			leds_frame.frame_duration_ms = 30;
-			onNeo_handler = Neo_render_rainbow_fast; break;
-		case NEO_FIRE:
-			onNeo_handler = Neo_render_fire; break;
-		case NEO_ICE:
-			onNeo_handler = Neo_render_ice; break;
-		default:
-			onNeo_handler = Neo_render_colorFlashing; break;
-	}
+	leds_frame.frame_duration_ms = NEO_FRAME_MS;
+	Neo_play(&NEO_ANIMATIONS[cmd], NEO_CROSSFADE_MS);
 }
 
+// With WS2812_STREAMING the DMA ISR evaluates Neo_pixel() for every pixel
+// while it fills each half buffer. Nothing is kept per pixel, so RAM is
+// O(DMALEDS) whatever the strip length passed to SPI_DMA_WS2812_init(). A
+// half holds DMALEDS/2 pixels and must be filled while the other half is on
+// the wire (~32us per pixel), which leaves room for ~1500 cycles per pixel
+// at 48MHz. The per frame work (keyframe lookups, divides) is done by
+// Neo_step() and Neo_play() before, the ISR only evaluates pixels.
+
+#ifdef WS2812_STREAMING
+
+u32 WS2812BLEDCallback(int ledIdx) {
+	return _neo_pixel(ledIdx).packed;
+}
+
+#else
+
 u32 WS2812BLEDCallback(int ledIdx){
 	u32 moment = millis();
 	if (moment - leds_frame.ref_time > leds_frame.frame_duration_ms) {
 		leds_frame.ref_time = moment;
-		onNeo_handler(&leds_frame, &color_ani, ledIdx);
+		Neo_render(++Neo_frame);
 	}
 	
 	return WS2812_BUF[ledIdx].packed;
 }
 
+#endif
+
+#ifndef NEO_TASK_PERIOD_MS
+	#define NEO_TASK_PERIOD_MS	12
+#endif
+
 u32 neo_timeRef = 0;
 
-void Neo_task(u32 time) {
-	if (WS2812BLED_InUse || leds_frame.frame_duration_ms < 1) return;
-	if (time - neo_timeRef < 12) return;
-	neo_timeRef = time;
+#ifdef WS2812_PRECOMPUTED
+
+// Render the next frame when it is due and encode it into the back half.
+// Runs in the main loop; the frame goes out on the next tick or, if a frame
+// is still on the wire, straight from the DMA ISR when that one finishes.
+void Neo_render_frame(u32 time) {
+	if (WS2812_stream_pending) return;
+	if (time - leds_frame.ref_time <= leds_frame.frame_duration_ms) return;
+
+	leds_frame.ref_time = time;
+	Neo_render(++Neo_frame);
+	WS2812_stream_encode(WS2812_BUF, WS2812_strip.leds);
+}
+
+u8 Neo_step(u32 time) {
+	if (leds_frame.frame_duration_ms < 1) return 0;
+
+	Neo_render_frame(time);
+	SPI_DMA_WS2812_tick();
+	return 1;
+}
+
+#elif defined(WS2812_STREAMING)
+
+u8 Neo_step(u32 time) {
+	if (WS2812_strip.in_use || leds_frame.frame_duration_ms < 1) return 0;
+
+	if (time - leds_frame.ref_time > leds_frame.frame_duration_ms) {
+		leds_frame.ref_time = time;
+		Neo_frame++;
+	}
+
+	_neo_ready(Neo_frame);
+	SPI_DMA_WS2812_tick();
+	return 1;
+}
+
+#else
+
+u8 Neo_step(u32 time) {
+	if (WS2812_strip.in_use || leds_frame.frame_duration_ms < 1) return 0;
 
 	SPI_DMA_WS2812_tick(DMALEDS);
-}
\ No newline at end of file
+	return 1;
+}
+
+#endif
+
+// Neo_step() is the ungated refresh, 0 when the strip is busy or idle.
+// Call it from a Sched_Task_t with period NEO_TASK_PERIOD_MS, or poll Neo_task().
+void Neo_task(u32 time) {
+	if (time - neo_timeRef < NEO_TASK_PERIOD_MS) return;
+	if (Neo_step(time)) neo_timeRef = time;
+}
@@ -2,6 +2,10 @@
 
 uint8_t SPI_DC_PIN = -1;
 
+// data/command line, defined with the INTERFACES below
+void FN_SPI_DC_LOW();
+void FN_SPI_DC_HIGH();
+
 static void SPI_init(uint8_t rst_pin, uint8_t dc_pin) {
 	// reset control register
 	SPI1->CTLR1 = 0;
@@ -56,7 +60,7 @@ static void SPI_init(uint8_t rst_pin, uint8_t dc_pin) {
 	}
 }
 
-static void SPI_DMA_init(DMA_Channel_TypeDef* DMA_Channel, u32 *DATA_BUF) {
+static inline void SPI_DMA_init(DMA_Channel_TypeDef* DMA_Channel, u32 *DATA_BUF) {
 	// Enable DMA peripheral
 	RCC->AHBPCENR |= RCC_AHBPeriph_DMA1;
 
@@ -64,7 +68,7 @@ static void SPI_DMA_init(DMA_Channel_TypeDef* DMA_Channel, u32 *DATA_BUF) {
 	SPI1->CTLR2 |= SPI_I2S_DMAReq_Tx;
 
 	// Configure DMA
-	DMA_Channel->PADDR = (uint32_t)&SPI1->DATAR;
+	DMA_Channel->PADDR = (uint32_t)(uintptr_t)&SPI1->DATAR;
 	// DMA1_Channel3->MADDR = *DATA_BUF;
 	DMA_Channel->CFGR = DMA_M2M_Disable |
 						DMA_Priority_VeryHigh |
@@ -76,11 +80,11 @@ static void SPI_DMA_init(DMA_Channel_TypeDef* DMA_Channel, u32 *DATA_BUF) {
 						DMA_DIR_PeripheralDST;
 }
 
-static void SPI_send_DMA(const uint8_t* buffer, uint16_t len) {
+static inline void SPI_send_DMA(const uint8_t* buffer, uint16_t len) {
 	FN_SPI_DC_HIGH();
 	
 	DMA1_Channel3->CNTR  = len;
-	DMA1_Channel3->MADDR = (uint32_t)buffer;
+	DMA1_Channel3->MADDR = (uint32_t)(uintptr_t)buffer;
 
 	// Start DMA transfer
 	DMA1_Channel3->CFGR |= DMA_CFGR1_EN;  
@@ -135,19 +139,19 @@ void FN_SPI_DC_HIGH() {
 	funDigitalWrite(SPI_DC_PIN, 1);
 }
 
-static void SPI_cmd_8(uint8_t cmd) {
+static inline void SPI_cmd_8(uint8_t cmd) {
 	FN_SPI_DC_LOW();
 	SPI_write_8(cmd);
 	SPI_wait_TX_complete();
 }
 
-static void SPI_cmd_data_8(uint8_t data) {
+static inline void SPI_cmd_data_8(uint8_t data) {
 	FN_SPI_DC_HIGH();
 	SPI_write_8(data);
 	SPI_wait_TX_complete();
 }
 
-static void SPI_cmd_data_16(uint16_t data) {
+static inline void SPI_cmd_data_16(uint16_t data) {
 	FN_SPI_DC_HIGH();
 
 	SPI_write_8(data >> 8);
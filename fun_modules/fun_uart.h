@@ -1,20 +1,13 @@
 #include "ch32fun.h"
+#include "fun_utilities.h"
+#include "fun_log.h"
 
 // Set UART baud rate here
+#ifndef UART_BR
 #define UART_BR 115200
+#endif
 
 
-// DMA transfer completion interrupt. It will fire when the DMA transfer is
-// complete. We use it just to blink the LED
-__attribute__((interrupt)) __attribute__((section(".srodata")))
-void DMA1_Channel4_IRQHandler(void) {
-	// Clear flag
-	DMA1->INTFCR |= DMA_CTCIF4;
-
-	// Blink LED
-	// GPIOD->OUTDR ^= 1<<LED_PIN;
-}
-
 static void uart_setup(void) {
 	// Enable UART and GPIOD
 	RCC->APB2PCENR |= RCC_APB2Periph_GPIOD | RCC_APB2Periph_USART1;
@@ -33,7 +26,81 @@ static void uart_setup(void) {
 	USART1->CTLR1 |= CTLR1_UE_Set;
 }
 
-static void dma_uart_setup(void) {
+//# UART TRANSMIT
+// dma_uart_tx(), LOG() and with UART_TX_PRINTF also printf() copy into a
+// ring that DMA1_Channel4 drains in the background: every transfer complete
+// interrupt releases the bytes just sent and chains the next contiguous run.
+// Writers never wait. A write that does not fit is dropped whole and
+// counted in uart_tx_dropped, so the output never has torn lines.
+// The copy into the ring runs with interrupts off, so the main loop and
+// interrupts may both write; a 256 byte write holds them off ~20us.
+
+#ifndef UART_TX_BUF_LEN
+#define UART_TX_BUF_LEN 256 // size of transmit circular buffer, power of 2
+#endif
+
+u8 tx_buf[UART_TX_BUF_LEN] = {0};
+UTIL_Ring_t tx_ring;
+volatile u16 tx_inflight; // bytes of the running transfer, 0 when idle
+u32 uart_tx_dropped; // bytes that did not fit the ring
+
+// send the next contiguous run of tx_ring, only when no transfer runs
+static void _uart_tx_start(void) {
+	UTIL_RingSpan_t span;
+	if (!UTIL_ring_peek(&tx_ring, &span)) return;
+
+	tx_inflight = span.len[0];
+	// the channel must be off to reload it
+	DMA1_Channel4->CFGR &= ~DMA_CFGR1_EN;
+	DMA1_Channel4->CNTR = span.len[0];
+	DMA1_Channel4->MADDR = (u32)(uintptr_t)span.ptr[0];
+	DMA1_Channel4->CFGR |= DMA_CFGR1_EN;
+}
+
+PROFILE_ISR_ZONE(uart_tx_isr);
+
+// DMA transfer completion interrupt: release what was sent, chain the rest
+__attribute__((interrupt)) __attribute__((section(".srodata")))
+void DMA1_Channel4_IRQHandler(void) {
+	PROFILE_BEGIN(uart_tx_isr);
+	// Clear flag
+	DMA1->INTFCR = DMA_CTCIF4;
+
+	UTIL_ring_consume(&tx_ring, tx_inflight);
+	tx_inflight = 0;
+	_uart_tx_start();
+	PROFILE_END(uart_tx_isr);
+}
+
+// queue len bytes, returns len or 0 when they did not fit
+u16 uart_tx_write(const void *data, u16 len) {
+	UTIL_RingSpan_t span;
+	__disable_irq();
+	if (UTIL_ring_reserve(&tx_ring, &span) < len) {
+		uart_tx_dropped += len;
+		__enable_irq();
+		return 0;
+	}
+
+	u16 first = len < span.len[0] ? len : span.len[0];
+	memcpy(span.ptr[0], data, first);
+	if (len > first) memcpy(span.ptr[1], (const u8*)data + first, len - first);
+	UTIL_ring_produce(&tx_ring, len);
+
+	// a running transfer chains the new bytes from its interrupt
+	if (!tx_inflight) _uart_tx_start();
+	__enable_irq();
+	return len;
+}
+
+static inline u8 uart_tx_busy(void) {
+	return tx_inflight != 0;
+}
+
+static inline void dma_uart_setup(void) {
+	UTIL_ring_init(&tx_ring, tx_buf, UART_TX_BUF_LEN, 1);
+	tx_inflight = 0;
+
 	// Enable DMA peripheral
 	RCC->AHBPCENR = RCC_AHBPeriph_SRAM | RCC_AHBPeriph_DMA1;
 
@@ -41,7 +108,7 @@ static void dma_uart_setup(void) {
 	DMA1_Channel4->CFGR &= ~DMA_CFGR1_EN;
 
 	// USART1 TX uses DMA channel 4
-	DMA1_Channel4->PADDR = (uint32_t)&USART1->DATAR;
+	DMA1_Channel4->PADDR = (uint32_t)(uintptr_t)&USART1->DATAR;
 	// MEM2MEM: 0 (memory to peripheral)
 	// PL: 0 (low priority since UART is a relatively slow peripheral)
 	// MSIZE/PSIZE: 0 (8-bit)
@@ -56,40 +123,225 @@ static void dma_uart_setup(void) {
 
 	// Enable channel 4 interrupts
 	NVIC_EnableIRQ(DMA1_Channel4_IRQn);
+
+	// LOG lines go out through the ring too
+	LOG_setOutput(uart_tx_write);
 }
 
-static void dma_uart_tx(const void *data, uint32_t len)
-{
-	// Disable DMA channel (just in case a transfer is pending)
-	// DMA1_Channel4->CFGR &= ~DMA_CFGR1_EN;
-	// Set transfer length and source address
-	DMA1_Channel4->CNTR = len;
-	DMA1_Channel4->MADDR = (uint32_t)data;
-	// Enable DMA channel to start the transfer
-	DMA1_Channel4->CFGR |= DMA_CFGR1_EN;
+// data is copied, the caller may reuse it right away
+static inline void dma_uart_tx(const void *data, uint32_t len) {
+	uart_tx_write(data, len);
 }
 
+#ifdef UART_TX_PRINTF
+// ch32fun's printf() ends up here, this replaces its weak SDI/UART version
+int _write(int fd, const char *buf, int size) {
+	uart_tx_write(buf, size);
+	return size;
+}
+#endif
+
 
 
 
 //# UART RECEIVE
-void process_cmd(u8* buf) {
-	if (strncmp((char*)buf, "toggle\r\n", 9) == 0) {
-		GPIOC->OUTDR ^= (1<<7);
-		printf("Horay!\r\n");
-	} else {
-		printf("Invalid cmd: %s\r\n", buf);
-	}	
+// USART1 RX runs into a circular DMA ring. The half/full transfer and the
+// IDLE line interrupts publish the DMA position as the ring head and raise
+// uart_rx_wake, uart_rx_task() then splits each complete line into tokens
+// in place and looks the first one up in a command table sorted by name.
+// Every interrupt is at most half a ring apart, so the main loop has about
+// half a ring of byte times to call the task: 320 us for 64 bytes at 1 Mbaud.
+//! Lines longer than half the ring may be dropped
+
+#ifndef UART_RX_BUF_LEN
+#define UART_RX_BUF_LEN 64 // size of receive circular buffer, power of 2
+#endif
+
+#ifndef UART_MAX_ARGS
+#define UART_MAX_ARGS 8 // tokens per line including the command, the rest are ignored
+#endif
+
+// a token in place in rx_buf, in two parts when it wraps around the end
+typedef UTIL_RingSpan_t UART_Token_t;
+
+typedef struct {
+	const char *name;
+	void (*handler)(UART_Token_t *argv, u8 argc); // argv[0] is the command
+} UART_Cmd_t;
+
+u8 rx_buf[UART_RX_BUF_LEN] = {0}; // DMA receive buffer for incoming data
+UTIL_Ring_t rx_ring; // head is moved by the interrupts, tail by uart_rx_task
+volatile u8 uart_rx_wake; // new bytes were published to rx_ring
+u16 uart_rx_overruns; // times the DMA wrote over unread bytes
+u16 uart_rx_dropped; // lines too long for the ring
+
+static const UART_Cmd_t *uart_cmds;
+static u8 uart_cmd_count;
+
+static inline u16 uart_token_len(const UART_Token_t *tok) {
+	return tok->len[0] + tok->len[1];
+}
+
+static inline u8 uart_token_char(const UART_Token_t *tok, u16 i) {
+	return i < tok->len[0] ? tok->ptr[0][i] : tok->ptr[1][i - tok->len[0]];
+}
+
+// strcmp() of a token against a string
+int uart_token_cmp(const UART_Token_t *tok, const char *str) {
+	u16 len = uart_token_len(tok);
+
+	for (u16 i = 0; i < len; i++, str++) {
+		u8 c = uart_token_char(tok, i);
+		if (c != (u8)*str) return c - (u8)*str;
+	}
+	return -(u8)*str;
 }
 
-#define RX_BUF_LEN 16 // size of receive circular buffer
+// decimal or 0x prefixed hex number, returns 0 when the token is not one
+u8 uart_token_u32(const UART_Token_t *tok, u32 *out) {
+	u16 len = uart_token_len(tok), i = 0;
+	u8 base = 10;
+	u32 value = 0;
+
+	if (len > 2 && uart_token_char(tok, 0) == '0' && (uart_token_char(tok, 1) | 0x20) == 'x') {
+		base = 16;
+		i = 2;
+	}
+	if (i == len) return 0;
 
-u8 rx_buf[RX_BUF_LEN] = {0}; // DMA receive buffer for incoming data
-u8 cmd_buf[RX_BUF_LEN] = {0}; // buffer for complete command strings
+	for (; i < len; i++) {
+		u8 c = uart_token_char(tok, i), d;
+		if (c >= '0' && c <= '9') d = c - '0';
+		else if (base == 16 && (c | 0x20) >= 'a' && (c | 0x20) <= 'f') d = (c | 0x20) - 'a' + 10;
+		else return 0;
+		value = value * base + d;
+	}
+
+	*out = value;
+	return 1;
+}
+
+// copy a token out as a string, returns its length
+u16 uart_token_copy(const UART_Token_t *tok, char *out, u16 size) {
+	u16 len = uart_token_len(tok);
+	if (!size) return 0;
+	if (len > size - 1) len = size - 1;
+
+	for (u16 i = 0; i < len; i++) out[i] = uart_token_char(tok, i);
+	out[len] = 0;
+	return len;
+}
+
+static void uart_cmd_toggle(UART_Token_t *argv, u8 argc) {
+	GPIOC->OUTDR ^= (1<<7);
+	printf("Horay!\r\n");
+}
+
+#ifdef FUN_PROFILE
+// "prof" dumps the profiler zones, "prof reset" clears them after the dump
+static void uart_cmd_prof(UART_Token_t *argv, u8 argc) {
+	UTIL_profile_dump(argc > 1 && uart_token_cmp(&argv[1], "reset") == 0);
+}
+#endif
+
+static const UART_Cmd_t uart_default_cmds[] = {
+	#ifdef FUN_PROFILE
+		{ "prof", uart_cmd_prof },
+	#endif
+	{ "toggle", uart_cmd_toggle },
+};
+
+// replace the command table, it must be sorted by name in strcmp() order
+void uart_rx_commands(const UART_Cmd_t *cmds, u8 count) {
+	uart_cmds = cmds;
+	uart_cmd_count = count;
+}
+
+// the token at [off, off + len) of a line, without copying
+static void uart_line_token(const UTIL_RingSpan_t *line, u16 off, u16 len, UART_Token_t *tok) {
+	if (off >= line->len[0]) {
+		tok->ptr[0] = tok->ptr[1] = line->ptr[1] + (off - line->len[0]);
+		tok->len[0] = len;
+		tok->len[1] = 0;
+		return;
+	}
+
+	u16 first = line->len[0] - off;
+	tok->ptr[0] = line->ptr[0] + off;
+	tok->ptr[1] = line->ptr[1];
+	tok->len[0] = first < len ? first : len;
+	tok->len[1] = len - tok->len[0];
+}
+
+void process_cmd(const UTIL_RingSpan_t *line, u16 len) {
+	UART_Token_t argv[UART_MAX_ARGS];
+	u8 argc = 0;
+	u16 start = 0;
+
+	// split on blanks, a trailing '\r' included
+	for (u16 i = 0; i <= len; i++) {
+		u8 c = i < len ? uart_token_char(line, i) : ' ';
+		if (c != ' ' && c != '\t' && c != '\r') continue;
+
+		if (i > start && argc < UART_MAX_ARGS) {
+			uart_line_token(line, start, i - start, &argv[argc++]);
+		}
+		start = i + 1;
+	}
+	if (!argc) return;
+
+	// binary search of the sorted table
+	u8 lo = 0, hi = uart_cmd_count;
+	while (lo < hi) {
+		u8 mid = (lo + hi) / 2;
+		int cmp = uart_token_cmp(&argv[0], uart_cmds[mid].name);
+
+		if (cmp == 0) {
+			uart_cmds[mid].handler(argv, argc);
+			return;
+		}
+		if (cmp < 0) hi = mid;
+		else lo = mid + 1;
+	}
+
+	printf("Invalid cmd: %.*s%.*s\r\n", argv[0].len[0], argv[0].ptr[0], argv[0].len[1], argv[0].ptr[1]);
+}
+
+// publish what the DMA wrote. Runs at least every half ring, so the head
+// never moves by a full lap between two calls
+static inline void uart_rx_publish(void) {
+	UTIL_ring_dmaHead(&rx_ring, DMA1_Channel5);
+	uart_rx_wake = 1;
+}
+
+PROFILE_ISR_ZONE(uart_rx_isr);
+
+__attribute__((interrupt)) __attribute__((section(".srodata")))
+void DMA1_Channel5_IRQHandler(void) {
+	PROFILE_BEGIN(uart_rx_isr);
+	// Clear half and full transfer flags
+	DMA1->INTFCR = DMA1_IT_GL5;
+	uart_rx_publish();
+	PROFILE_END(uart_rx_isr);
+}
+
+__attribute__((interrupt)) __attribute__((section(".srodata")))
+void USART1_IRQHandler(void) {
+	PROFILE_BEGIN(uart_rx_isr);
+	// IDLE clears by reading STATR then DATAR, the DMA already took the data
+	if (USART1->STATR & USART_STATR_IDLE) {
+		(void)USART1->DATAR;
+		uart_rx_publish();
+	}
+	PROFILE_END(uart_rx_isr);
+}
 
 void uart_rx_setup() {
-	// enable rx pin
-	USART1->CTLR1 |= USART_CTLR1_RE;
+	UTIL_ring_init(&rx_ring, rx_buf, UART_RX_BUF_LEN, 1);
+	uart_rx_commands(uart_default_cmds, sizeof(uart_default_cmds) / sizeof(uart_default_cmds[0]));
+
+	// enable rx pin, wake on a quiet line
+	USART1->CTLR1 |= USART_CTLR1_RE | USART_CTLR1_IDLEIE;
 
 	// enable usart's dma rx requests
 	USART1->CTLR3 |= USART_CTLR3_DMAR;
@@ -98,9 +350,9 @@ void uart_rx_setup() {
 	RCC->AHBPCENR |= RCC_DMA1EN;
 
 	// configure dma for UART reception, it should fire on RXNE
-	DMA1_Channel5->MADDR = (u32)&rx_buf;
-	DMA1_Channel5->PADDR = (u32)&USART1->DATAR;
-	DMA1_Channel5->CNTR = RX_BUF_LEN;
+	DMA1_Channel5->MADDR = (u32)(uintptr_t)&rx_buf;
+	DMA1_Channel5->PADDR = (u32)(uintptr_t)&USART1->DATAR;
+	DMA1_Channel5->CNTR = UART_RX_BUF_LEN;
 
 	// MEM2MEM: 0 (memory to peripheral)
 	// PL: 0 (low priority since UART is a relatively slow peripheral)
@@ -110,52 +362,54 @@ void uart_rx_setup() {
 	// CIRC: 1 (circular)
 	// DIR: 0 (read from peripheral)
 	// TEIE: 0 (no tx error interrupt)
-	// HTIE: 0 (no half tx interrupt)
-	// TCIE: 0 (no transmission complete interrupt)
+	// HTIE: 1 (half transfer interrupt, wakes the parser)
+	// TCIE: 1 (transfer complete interrupt, wakes the parser)
 	// EN: 1 (enable DMA)
-	DMA1_Channel5->CFGR = DMA_CFGR1_CIRC | DMA_CFGR1_MINC | DMA_CFGR1_EN;
+	DMA1_Channel5->CFGR = DMA_CFGR1_CIRC | DMA_CFGR1_MINC | DMA_CFGR1_HTIE | DMA_CFGR1_TCIE | DMA_CFGR1_EN;
+
+	NVIC_EnableIRQ(DMA1_Channel5_IRQn);
+	NVIC_EnableIRQ(USART1_IRQn);
 }
 
 
 void uart_rx_task() {
-	static u32 tail = 0; // current read position in rx_buf
-	static u32 cmd_end = 0; // end index of current command in rx_buf
-	static u32 cmd_st = 0; // start index of current command in rx_buf
-
-	// calculate head position based on DMA counter (modulo when DMA1_Channel5->CNTR = 0)
-	u32 head = (RX_BUF_LEN - DMA1_Channel5->CNTR) % RX_BUF_LEN; // current write position in rx_buf
-	
-	// process new bytes in rx_buf. when a newline character is detected, the command is copied to cmd_buf
-	while (tail != head)
-	{
-		if ( rx_buf[tail] == '\n' ) 
-		{
-			cmd_end = tail;
-			u32 cmd_i = 0; // carret position in cmd_buf
-			if (cmd_end > cmd_st)
-			{
-				for (u32 rx_i = cmd_st; rx_i < cmd_end + 1; rx_i++, cmd_i++) {
-					cmd_buf[cmd_i] = rx_buf[rx_i];
-				}
-			} else if (cmd_st > cmd_end) { // handle wrap around
-				for (u32 rx_i = cmd_st; rx_i < RX_BUF_LEN; rx_i++, cmd_i++) {
-					cmd_buf[cmd_i] = rx_buf[rx_i];
-				}
-				for (u32 rx_i = 0; rx_i < cmd_end + 1; rx_i++, cmd_i++) {
-					cmd_buf[cmd_i] = rx_buf[rx_i];
-				}
-			}
-
-			// null terminate
-			cmd_buf[cmd_i] = '\0';
-
-			process_cmd(cmd_buf);
-
-			// update start position for next command
-			cmd_st = (cmd_end + 1) % RX_BUF_LEN;
-		}
+	static u16 scanned = 0; // bytes of the pending line already searched for '\n'
+	static u8 discard = 0; // the pending line lost its start, skip to its end
+
+	if (!uart_rx_wake) return;
+	uart_rx_wake = 0;
+
+	u16 count = UTIL_ring_count(&rx_ring);
+
+	// the DMA lapped the tail: drop everything, the newest byte tells
+	// whether a line is still in progress
+	if (count > UART_RX_BUF_LEN) {
+		uart_rx_overruns++;
+		discard = *(u8*)UTIL_ring_at(&rx_ring, count - 1) != '\n';
+		UTIL_ring_consume(&rx_ring, count);
+		scanned = count = 0;
+	}
+
+	// each complete line is tokenized and dispatched in place
+	while (scanned < count) {
+		if (*(u8*)UTIL_ring_at(&rx_ring, scanned++) != '\n') continue;
+
+		UTIL_RingSpan_t line;
+		UTIL_ring_peek(&rx_ring, &line);
+		if (!discard) process_cmd(&line, scanned - 1);
+		discard = 0;
 
-		// move to next position 
-		tail = (tail+1) % RX_BUF_LEN;
+		// next line starts at the new tail
+		UTIL_ring_consume(&rx_ring, scanned);
+		count -= scanned;
+		scanned = 0;
 	}
-}
\ No newline at end of file
+
+	// a line this long may not complete before the DMA comes around
+	if (count > UART_RX_BUF_LEN / 2) {
+		if (!discard) uart_rx_dropped++;
+		UTIL_ring_consume(&rx_ring, count);
+		discard = 1;
+		scanned = 0;
+	}
+}
@@ -4,6 +4,7 @@
 #include "ch32fun.h"
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 
 typedef struct {
@@ -22,7 +23,7 @@ void UTIL_cycleInfo_clear(Cycle_Info_t *info) {
 
 void UTIL_cycleInfo_flush(Cycle_Info_t *info) {
     printf("\nCycle count: %ld, max/min: %ld/%d us, lim_counter: %ld\n",
-            info->count, info->time_max, info->time_min, info->limit_counter);
+            (long)info->count, (long)info->time_max, info->time_min, (long)info->limit_counter);
     UTIL_cycleInfo_clear(info);
 }
 
@@ -51,7 +52,7 @@ void UTIL_minMax_clear(MinMax_Info32_t *info) {
 }
 
 void UTIL_minMax_flush(MinMax_Info32_t *info) {
-    printf("MinMax Max: %ld, Min: %ld\n", info->max, info->min);
+    printf("MinMax Max: %ld, Min: %ld\n", (long)info->max, (long)info->min);
     UTIL_minMax_clear(info);
 }
 
@@ -83,10 +84,10 @@ void fun_thresholdBuffer_clear(Threshold_Buffer_t *info) {
 }
 
 void fun_thresholdBuffer_flush(Threshold_Buffer_t *info) {
-    printf("\nThreshold: %ld, count: %d\n", info->threshold_limit, info->buf_idx);
+    printf("\nThreshold: %ld, count: %d\n", (long)info->threshold_limit, info->buf_idx);
 
     for (int i = 0; i < info->buf_idx; i++) {
-        printf("%ld ", info->buf[i]);
+        printf("%ld ", (long)info->buf[i]);
     }
     printf("\n");
 
@@ -134,4 +135,279 @@ void UTIL_DebugBuffer_addValue(Debug_Buffer_t *model, u16 value) {
     model->buf_idx++;
 }
 
+
+
+//! ####################################
+//! SPSC RING
+//! ####################################
+
+// Single producer, single consumer ring of fixed size elements. head and
+// tail run free and are masked on access, so full and empty need no spare
+// slot and count = head - tail even across the u16 wrap. Only the producer
+// writes head, only the consumer writes tail: one side can live in an ISR
+// or be a DMA channel (UTIL_ring_dmaHead) without locking.
+//! capacity must be a power of 2
+
+#define UTIL_RING_BARRIER() __sync_synchronize()
+
+typedef struct {
+    u8 *buf;
+    u16 mask;               // capacity - 1
+    u8 elem_size;
+    volatile u16 head;      // elements produced
+    volatile u16 tail;      // elements consumed
+} UTIL_Ring_t;
+
+// up to two contiguous runs, the second one starts at buf after a wrap
+typedef struct {
+    u8 *ptr[2];
+    u16 len[2];             // in elements
+} UTIL_RingSpan_t;
+
+void UTIL_ring_init(UTIL_Ring_t *ring, void *buf, u16 capacity, u8 elem_size) {
+    ring->buf = buf;
+    ring->mask = capacity - 1;
+    ring->elem_size = elem_size;
+    ring->head = ring->tail = 0;
+}
+
+static inline u16 UTIL_ring_count(UTIL_Ring_t *ring) {
+    return (u16)(ring->head - ring->tail);
+}
+
+static inline u16 UTIL_ring_space(UTIL_Ring_t *ring) {
+    return ring->mask + 1 - UTIL_ring_count(ring);
+}
+
+// element [i] after the oldest unread one
+static inline void *UTIL_ring_at(UTIL_Ring_t *ring, u16 i) {
+    return ring->buf + ((ring->tail + i) & ring->mask) * ring->elem_size;
+}
+
+u16 _UTIL_ring_span(UTIL_Ring_t *ring, UTIL_RingSpan_t *span, u16 from, u16 len) {
+    u16 idx = from & ring->mask;
+    u16 first = ring->mask + 1 - idx;
+    if (first > len) first = len;
+
+    span->ptr[0] = ring->buf + idx * ring->elem_size;
+    span->len[0] = first;
+    span->ptr[1] = ring->buf;
+    span->len[1] = len - first;
+    return len;
+}
+
+//# PRODUCER
+// free space as spans to fill in place, publish with UTIL_ring_produce
+u16 UTIL_ring_reserve(UTIL_Ring_t *ring, UTIL_RingSpan_t *span) {
+    return _UTIL_ring_span(ring, span, ring->head, UTIL_ring_space(ring));
+}
+
+static inline void UTIL_ring_produce(UTIL_Ring_t *ring, u16 n) {
+    UTIL_RING_BARRIER();        // element writes land before the new head
+    ring->head += n;
+}
+
+u8 UTIL_ring_push(UTIL_Ring_t *ring, const void *elem) {
+    if (!UTIL_ring_space(ring)) return 0;
+    memcpy(ring->buf + (ring->head & ring->mask) * ring->elem_size, elem, ring->elem_size);
+    UTIL_ring_produce(ring, 1);
+    return 1;
+}
+
+// head from a circular peripheral -> memory DMA channel filling the whole
+// buffer. Call at least once per lap: the DMA does not see tail, so a
+// consumer more than a lap behind has lost data.
+static inline void UTIL_ring_dmaHead(UTIL_Ring_t *ring, DMA_Channel_TypeDef *dma) {
+    // Must perform modulus here, in case CNTR == 0.
+    u16 pos = (ring->mask + 1 - dma->CNTR) & ring->mask;
+    ring->head += (u16)(pos - ring->head) & ring->mask;
+}
+
+//# CONSUMER
+// unread elements as spans, nothing is released until UTIL_ring_consume
+u16 UTIL_ring_peek(UTIL_Ring_t *ring, UTIL_RingSpan_t *span) {
+    u16 count = UTIL_ring_count(ring);
+    UTIL_RING_BARRIER();        // element reads after the head they belong to
+    return _UTIL_ring_span(ring, span, ring->tail, count);
+}
+
+static inline void UTIL_ring_consume(UTIL_Ring_t *ring, u16 n) {
+    UTIL_RING_BARRIER();        // element reads done before the slots are handed back
+    ring->tail += n;
+}
+
+u8 UTIL_ring_pop(UTIL_Ring_t *ring, void *elem) {
+    if (!UTIL_ring_count(ring)) return 0;
+    UTIL_RING_BARRIER();
+    memcpy(elem, UTIL_ring_at(ring, 0), ring->elem_size);
+    UTIL_ring_consume(ring, 1);
+    return 1;
+}
+
+
+
+//! ####################################
+//! PROFILER
+//! ####################################
+
+// Named zones timed in raw SysTick->CNT cycles. Compiled in with FUN_PROFILE,
+// otherwise the macros are empty.
+//
+//  PROFILE_ZONE(ir_task);                      // once, at file scope
+//  PROFILE_ISR_ZONE(systick);                  // a zone timing an interrupt handler
+//  PROFILE_BEGIN(ir_task); ... PROFILE_END(ir_task);
+//
+// Zones nest. Time in an inner zone is child time of the outer one, time in
+// an ISR zone is charged as isr time to whichever zone it interrupted. Both
+// are taken out of that zone's self time. Every zone keeps a log2 histogram
+// of its inclusive durations: bucket b counts [2^b, 2^(b+1)) cycles.
+// UTIL_profile_dump() prints one line per zone, fun_host/prof_flame turns
+// them into a flame-style summary.
+//
+// A zone is 80 bytes of RAM with the default 20 buckets. Cycle counts are
+// 40 bits, a u32 plus a carry byte (6 hours at 48MHz) so no u64 math runs
+// on the hot path. Buckets are bytes: when one fills, all of them are
+// halved, which keeps the shape and so the percentiles.
+//! a zone must not be entered again before it ends
+
+#ifndef PROFILE_BUCKETS
+#define PROFILE_BUCKETS 20          // the last one also holds everything longer
+#endif
+
+typedef struct Profile_Zone {
+    const char *name;
+    struct Profile_Zone *next;      // every zone that ran, for the dump
+    struct Profile_Zone *parent;    // enclosing zone of the last run
+
+    u32 count;
+    u32 total;                      // inclusive cycles
+    u32 self;                       // minus child zones and interrupts
+    u32 isr_cycles;                 // interrupts while it was the innermost zone
+    u32 min, max;
+
+    //# current run
+    u32 start;
+    u32 child;
+    u32 stolen;
+    struct Profile_Zone *prev;
+
+    u8 isr;
+    u8 linked;
+    u8 total_hi, self_hi, isr_cycles_hi;    // bits 32..39 of the counts above
+    u8 hist[PROFILE_BUCKETS];
+} Profile_Zone_t;
+
+// 40-bit value of a cycle count, e.g. PROFILE_CYCLES(&profile_frame, self)
+#define PROFILE_CYCLES(zone, field)     ((u64)(zone)->field##_hi << 32 | (zone)->field)
+
+Profile_Zone_t *profile_zones = NULL;
+Profile_Zone_t *profile_current = NULL;
+
+void _UTIL_profile_link(Profile_Zone_t *zone) {
+    zone->next = profile_zones;
+    profile_zones = zone;
+    zone->linked = 1;
+    zone->min = 0xFFFFFFFF;
+}
+
+static inline void UTIL_profile_begin(Profile_Zone_t *zone) {
+    if (!zone->linked) _UTIL_profile_link(zone);
+    zone->prev = profile_current;
+    zone->child = zone->stolen = 0;
+    profile_current = zone;
+    zone->start = SysTick->CNT;     // last, the setup is not timed
+}
+
+static inline void _UTIL_profile_add(u32 *lo, u8 *hi, u32 v) {
+    u32 sum = *lo + v;
+    *hi += sum < v;
+    *lo = sum;
+}
+
+static inline void UTIL_profile_end(Profile_Zone_t *zone) {
+    u32 elapsed = SysTick->CNT - zone->start;
+    Profile_Zone_t *prev = zone->prev;
+
+    profile_current = prev;
+    if (prev) {
+        if (zone->isr) prev->stolen += elapsed;
+        else prev->child += elapsed;
+    }
+    if (!zone->isr) zone->parent = prev;
+
+    // an interrupt right at begin or end can be charged without being timed
+    u32 inner = zone->child + zone->stolen;
+    if (inner > elapsed) inner = elapsed;
+
+    zone->count++;
+    _UTIL_profile_add(&zone->total, &zone->total_hi, elapsed);
+    _UTIL_profile_add(&zone->self, &zone->self_hi, elapsed - inner);
+    _UTIL_profile_add(&zone->isr_cycles, &zone->isr_cycles_hi, zone->stolen);
+    if (elapsed < zone->min) zone->min = elapsed;
+    if (elapsed > zone->max) zone->max = elapsed;
+
+    u8 b = 31 - __builtin_clz(elapsed | 1);
+    if (b >= PROFILE_BUCKETS) b = PROFILE_BUCKETS - 1;
+    if (zone->hist[b] == 0xFF) {
+        for (u8 i = 0; i < PROFILE_BUCKETS; i++) zone->hist[i] >>= 1;
+    }
+    zone->hist[b]++;
+}
+
+void UTIL_profile_reset(void) {
+    for (Profile_Zone_t *z = profile_zones; z; z = z->next) {
+        z->count = 0;
+        z->total = z->self = z->isr_cycles = 0;
+        z->total_hi = z->self_hi = z->isr_cycles_hi = 0;
+        z->min = 0xFFFFFFFF;
+        z->max = 0;
+        memset(z->hist, 0, sizeof(z->hist));
+    }
+}
+
+static void _UTIL_profile_hex40(u8 hi, u32 lo) {
+    if (hi) printf(" %x%08lx", hi, (unsigned long)lo);
+    else printf(" %lx", (unsigned long)lo);
+}
+
+// One line per zone, numbers in hex, histogram as bucket=count pairs:
+//  #prof <name> <parent|-> <isr> <count> <total> <self> <isr_cycles> <min> <max> [b=n,...]
+// between "#prof-clock <Hz>" and "#prof-end"
+void UTIL_profile_dump(u8 reset) {
+    printf("#prof-clock %lu\n", (unsigned long)FUNCONF_SYSTEM_CORE_CLOCK);
+
+    for (Profile_Zone_t *z = profile_zones; z; z = z->next) {
+        if (!z->count) continue;
+        printf("#prof %s %s %d %lx", z->name, z->parent ? z->parent->name : "-", z->isr, (unsigned long)z->count);
+        _UTIL_profile_hex40(z->total_hi, z->total);
+        _UTIL_profile_hex40(z->self_hi, z->self);
+        _UTIL_profile_hex40(z->isr_cycles_hi, z->isr_cycles);
+        printf(" %lx %lx ", (unsigned long)z->min, (unsigned long)z->max);
+
+        char sep = 0;
+        for (u8 b = 0; b < PROFILE_BUCKETS; b++) {
+            if (!z->hist[b]) continue;
+            if (sep) putchar(sep);
+            printf("%x=%x", b, z->hist[b]);
+            sep = ',';
+        }
+        printf("\n");
+    }
+
+    printf("#prof-end\n");
+    if (reset) UTIL_profile_reset();
+}
+
+#ifdef FUN_PROFILE
+    #define PROFILE_ZONE(zone)          Profile_Zone_t profile_##zone = { .name = #zone }
+    #define PROFILE_ISR_ZONE(zone)      Profile_Zone_t profile_##zone = { .name = #zone, .isr = 1 }
+    #define PROFILE_BEGIN(zone)         UTIL_profile_begin(&profile_##zone)
+    #define PROFILE_END(zone)           UTIL_profile_end(&profile_##zone)
+#else
+    #define PROFILE_ZONE(zone)          extern char profile_off_##zone
+    #define PROFILE_ISR_ZONE(zone)      extern char profile_off_##zone
+    #define PROFILE_BEGIN(zone)         ((void)0)
+    #define PROFILE_END(zone)           ((void)0)
+#endif
+
 #endif
\ No newline at end of file
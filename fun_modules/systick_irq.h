@@ -12,6 +12,7 @@
 
 #include "ch32fun.h"
 #include <stdio.h>
+#include "fun_utilities.h"
 
 // Number of ticks elapsed per millisecond (48,000 when using 48MHz Clock)
 #define SYSTICK_ONE_MILLISECOND ((uint32_t)FUNCONF_SYSTEM_CORE_CLOCK / 1000)
@@ -60,9 +61,13 @@ void systick_init(void)
 * Increments Compare Register and systick_millis when triggered (every 1ms)
 * NOTE: the `__attribute__((interrupt))` attribute is very important
 */
+PROFILE_ISR_ZONE(systick);
+
 void SysTick_Handler(void) __attribute__((interrupt));
 void SysTick_Handler(void)
 {
+	PROFILE_BEGIN(systick);
+
 	// Increment the Compare Register for the next trigger
 	// If more than this number of ticks elapse before the trigger is reset,
 	// you may miss your next interrupt trigger
@@ -74,6 +79,8 @@ void SysTick_Handler(void)
 
 	// Increment the milliseconds count
 	systick_millis++;
+
+	PROFILE_END(systick);
 }
 
 uint32_t SysTick_getRunTime(void *handler(void)) {
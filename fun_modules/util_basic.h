@@ -41,4 +41,4 @@
     printf("%s: 0x%08lX \t", label, reg); \
     UTIL_PRINT_BITS_32(reg); \
     printf("\n"); \
-} while(0)
\ No newline at end of file
+} while(0)
@@ -37,32 +37,77 @@ typedef union {
 
 #define DECREMENT_OR_ZERO(value, decr) (((value) > (decr)) ? ((value) - (decr)) : 0)
 
-// MAX of the 2 values
-#define DECREMENT_PERCENTAGE(value, perc) \
-    ((uint8_t)( \
-        ((value) - ((value) * (perc)) / 100) > 0 \
-        ? ((value) - ((value) * (perc)) / 100) \
-        : 0 \
-    ))
-
-
-#define COLOR_DECREMENT(color_t, perc) \
-    MAKE_COLOR_RGB( \
-        DECREMENT_PERCENTAGE(color_t.R, perc), \
-        DECREMENT_PERCENTAGE(color_t.G, perc), \
-        DECREMENT_PERCENTAGE(color_t.B, perc) \
-    )
-
-#define COLOR_SET_BRIGHTNESS(color, percent) \
-    ({ \
-        RGB_t result = color; \
-        uint8_t lut_index = (percent * 255) / 100; \
-        uint8_t factor = LUT_SIN[lut_index]; \
-        result.R = ((uint16_t)result.R * factor) >> 8; \
-        result.G = ((uint16_t)result.G * factor) >> 8; \
-        result.B = ((uint16_t)result.B * factor) >> 8; \
-        result; \
-    })
-
-
-#endif
\ No newline at end of file
+
+//! ####################################
+//! PACKED KERNELS
+//! ####################################
+
+// An RGB_t is worked on as one 32-bit word: R and B sit 16 bits apart, so
+// one multiply scales both and a second one scales G. Scale factors are
+// 0-255, where 255 keeps the color and 0 is black. The unused top byte of
+// the input is ignored and comes out as 0. COLOR_scale_buffer() does the
+// same over a whole pixel buffer.
+
+#define COLOR_MASK_RB               0x00FF00FF
+#define COLOR_MASK_G                0x0000FF00
+
+// 0-100 % to a 0-255 scale factor without a divide, exact for 0-100
+#define COLOR_PERCENT(perc)         ((perc) >= 100 ? 255 : (uint8_t)(((perc) * 5223u) >> 11))
+
+//# every channel times (scale + 1) / 256
+static inline RGB_t COLOR_scale(RGB_t color, uint8_t scale) {
+    uint32_t c = color.packed, s = scale + 1;
+    uint32_t rb = ((c & COLOR_MASK_RB) * s >> 8) & COLOR_MASK_RB;
+    uint32_t g = ((c & COLOR_MASK_G) * s >> 8) & COLOR_MASK_G;
+    return (RGB_t){ .packed = rb | g };
+}
+
+//# take amount / 255 off every channel
+static inline RGB_t COLOR_dim(RGB_t color, uint8_t amount) {
+    return COLOR_scale(color, 255 - amount);
+}
+
+//# brightness level 0-255 on the LUT_SIN curve
+static inline RGB_t COLOR_brightness(RGB_t color, uint8_t level) {
+    return COLOR_scale(color, LUT_SIN[level]);
+}
+
+//# a + (b - a) * t / 256, both lanes at once
+static inline RGB_t COLOR_blend(RGB_t a, RGB_t b, uint8_t t) {
+    uint32_t ca = a.packed, cb = b.packed, ta = 256 - t;
+    uint32_t rb = ((ca & COLOR_MASK_RB) * ta + (cb & COLOR_MASK_RB) * t) >> 8;
+    uint32_t g = ((ca & COLOR_MASK_G) * ta + (cb & COLOR_MASK_G) * t) >> 8;
+    return (RGB_t){ .packed = (rb & COLOR_MASK_RB) | (g & COLOR_MASK_G) };
+}
+
+//# a + b per channel, saturating at 255
+static inline RGB_t COLOR_add(RGB_t a, RGB_t b) {
+    uint32_t rb = (a.packed & COLOR_MASK_RB) + (b.packed & COLOR_MASK_RB);
+    uint32_t g = (a.packed & COLOR_MASK_G) + (b.packed & COLOR_MASK_G);
+
+    // a carry out of a lane fills that lane
+    rb |= (rb >> 8 & 0x00010001) * 0xFF;
+    g |= (g >> 8 & 0x00000100) * 0xFF;
+    return (RGB_t){ .packed = (rb & COLOR_MASK_RB) | (g & COLOR_MASK_G) };
+}
+
+//# COLOR_scale() over n pixels, in place
+static inline void COLOR_scale_buffer(RGB_t *buf, uint16_t n, uint8_t scale) {
+    uint32_t s = scale + 1;
+    uint32_t *p = &buf->packed;
+
+    for (uint16_t i = 0; i < n; i++) {
+        uint32_t c = p[i];
+        p[i] = (((c & COLOR_MASK_RB) * s >> 8) & COLOR_MASK_RB) |
+               (((c & COLOR_MASK_G) * s >> 8) & COLOR_MASK_G);
+    }
+}
+
+//# n copies of one color at a scale
+static inline void COLOR_fill_scaled(RGB_t *buf, uint16_t n, RGB_t color, uint8_t scale) {
+    RGB_t c = COLOR_scale(color, scale);
+    for (uint16_t i = 0; i < n; i++) buf[i] = c;
+}
+
+
+#endif
@@ -41,4 +41,26 @@ static const u8 LUT_RANDS[] = {
 u8 LUT_make_rand(u8 index) {
 	// ensure within bounds
 	return LUT_RANDS[index & 0xff];
-}
\ No newline at end of file
+}
+
+
+// gamma 2.6 in 8.8 fixed point, round(0xFF00 * (i / 255)^2.6)
+// the top is 0xFF00 so a dither error below 0x100 never carries past 255
+static const u16 LUT_GAMMA16[] = {
+	0x0000, 0x0000, 0x0000, 0x0001, 0x0001, 0x0002, 0x0004, 0x0006, 0x0008, 0x000b, 0x000e, 0x0012, 0x0017, 0x001c, 0x0022, 0x0029,
+	0x0031, 0x0039, 0x0042, 0x004c, 0x0057, 0x0063, 0x0070, 0x007d, 0x008c, 0x009c, 0x00ac, 0x00be, 0x00d1, 0x00e5, 0x00fa, 0x0110,
+	0x0128, 0x0141, 0x015a, 0x0176, 0x0192, 0x01b0, 0x01cf, 0x01ef, 0x0211, 0x0234, 0x0258, 0x027e, 0x02a5, 0x02ce, 0x02f8, 0x0324,
+	0x0351, 0x0380, 0x03b0, 0x03e2, 0x0416, 0x044b, 0x0481, 0x04ba, 0x04f4, 0x0530, 0x056d, 0x05ac, 0x05ed, 0x0630, 0x0674, 0x06ba,
+	0x0702, 0x074c, 0x0798, 0x07e5, 0x0834, 0x0886, 0x08d9, 0x092e, 0x0985, 0x09de, 0x0a39, 0x0a96, 0x0af5, 0x0b56, 0x0bb9, 0x0c1e,
+	0x0c85, 0x0cee, 0x0d59, 0x0dc7, 0x0e36, 0x0ea8, 0x0f1c, 0x0f92, 0x100a, 0x1085, 0x1101, 0x1180, 0x1201, 0x1285, 0x130a, 0x1392,
+	0x141d, 0x14a9, 0x1538, 0x15c9, 0x165d, 0x16f3, 0x178b, 0x1826, 0x18c4, 0x1963, 0x1a05, 0x1aaa, 0x1b51, 0x1bfb, 0x1ca7, 0x1d56,
+	0x1e07, 0x1eba, 0x1f71, 0x202a, 0x20e5, 0x21a3, 0x2264, 0x2327, 0x23ed, 0x24b6, 0x2581, 0x264f, 0x271f, 0x27f3, 0x28c9, 0x29a2,
+	0x2a7d, 0x2b5c, 0x2c3d, 0x2d21, 0x2e07, 0x2ef1, 0x2fdd, 0x30cc, 0x31be, 0x32b3, 0x33ab, 0x34a6, 0x35a3, 0x36a4, 0x37a7, 0x38ad,
+	0x39b7, 0x3ac3, 0x3bd2, 0x3ce4, 0x3dfa, 0x3f12, 0x402d, 0x414b, 0x426d, 0x4391, 0x44b9, 0x45e3, 0x4711, 0x4842, 0x4975, 0x4aac,
+	0x4be7, 0x4d24, 0x4e64, 0x4fa8, 0x50ef, 0x5239, 0x5386, 0x54d7, 0x562b, 0x5782, 0x58dc, 0x5a3a, 0x5b9a, 0x5cfe, 0x5e66, 0x5fd1,
+	0x613f, 0x62b0, 0x6425, 0x659d, 0x6719, 0x6898, 0x6a1a, 0x6ba0, 0x6d29, 0x6eb5, 0x7045, 0x71d9, 0x7370, 0x750a, 0x76a8, 0x784a,
+	0x79ef, 0x7b97, 0x7d43, 0x7ef3, 0x80a6, 0x825c, 0x8417, 0x85d4, 0x8796, 0x895b, 0x8b24, 0x8cf0, 0x8ec0, 0x9093, 0x926b, 0x9446,
+	0x9624, 0x9806, 0x99ed, 0x9bd6, 0x9dc4, 0x9fb5, 0xa1aa, 0xa3a3, 0xa59f, 0xa79f, 0xa9a3, 0xabab, 0xadb7, 0xafc6, 0xb1da, 0xb3f1,
+	0xb60c, 0xb82b, 0xba4d, 0xbc74, 0xbe9e, 0xc0cd, 0xc2ff, 0xc536, 0xc770, 0xc9ae, 0xcbf0, 0xce36, 0xd080, 0xd2ce, 0xd520, 0xd776,
+	0xd9d0, 0xdc2e, 0xde90, 0xe0f7, 0xe361, 0xe5cf, 0xe842, 0xeab8, 0xed33, 0xefb1, 0xf234, 0xf4bb, 0xf746, 0xf9d5, 0xfc68, 0xff00,
+};